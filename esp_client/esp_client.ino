@@ -1,5 +1,7 @@
 #include "main.h"
 #include "./src/env_config/env_config.h"
+#include "./src/boot_metrics/boot_metrics.h"
+#include "./src/diagnostics/log.h"
 
 Env env;
 
@@ -7,15 +9,16 @@ void setup(){
   Serial.begin(115200);
 
   if (!SPIFFS.begin(true)) {
-      Serial.println("SPIFFS Mount Failed");
+      LOG_PRINTLN("SPIFFS Mount Failed");
       return;
   }
 
   env = ensureEnvInNVS();
   if (!env.ok) {
-    Serial.println("ENV not found in NVS and SPIFFS. Check config.env.");
+    LOG_PRINTLN("ENV not found in NVS and SPIFFS. Check config.env.");
     return;
   }
+  boot_mark(BootMark::config_ready);
 
   // Create MQTT task on Core 0
   xTaskCreatePinnedToCore(mqttTask, "MQTT Task", 4096, NULL, 1, NULL, 0);
@@ -0,0 +1,153 @@
+// Host benchmark: the table-driven MQTT command dispatcher (src/commands) against
+// the callback it replaced, per message as PubSubClient delivers it.
+//
+//   pio run -e native_bench_commands && .pio/build/native_bench_commands/program
+//
+// Three dispatchers over the same topic mix:
+//   original   the old fn_on_message_received(): strchr + strcmp for relay/on|off,
+//              then the payload echoed to Serial a byte at a time
+//   strcmp     that style grown to the full command set: a strcmp chain, the payload
+//              copied out to NUL-terminate it for atoi/strtof, no Serial
+//   table      command_dispatch(): hashed table lookup, in-place parse, queue push
+//              (the hardwareTask pop is timed with it)
+// and, on its own, the name lookup: a strcmp() chain over every command name against
+// command_find().
+// Host CPU time only. The Serial column is what the original wrote per message; at
+// 115200 baud each byte is 87 us of UART time, and print() blocks once the TX FIFO
+// is full, which is the stall inside client.loop() the table removes.
+#include "../../src/commands/commands.h"
+#include "../../src/commands/command_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct Message { std::string topic; std::string payload; };
+
+static const char* SUB = "zot_plug_000001/cmd/#";
+static volatile uint32_t g_sink;
+
+/* === original callback === */
+static size_t g_serial_bytes = 0;
+static void serial_print(const char* s) { g_serial_bytes += strlen(s); }
+static void serial_println(const char* s) { g_serial_bytes += strlen(s) + 2; }
+
+static void original(char* topic, const uint8_t* payload, unsigned int length) {
+    if (strncmp(topic, SUB, strlen(SUB) - 1) != 0) return;
+    const char* slash = strchr(topic, '/');
+    if (strcmp(slash + 1, "cmd/relay/on") == 0) { serial_println("Relay On"); g_sink = 1; }
+    else if (strcmp(slash + 1, "cmd/relay/off") == 0) { g_sink = 0; serial_println("Relay off"); }
+    serial_println("Message received");
+    serial_print("Payload: ");
+    for (unsigned int i = 0; i < length; i++) { g_serial_bytes++; g_sink += payload[i]; }
+    serial_println("");
+}
+
+/* === strcmp chain with a payload copy === */
+static void strcmp_chain(char* topic, const uint8_t* payload, unsigned int length) {
+    if (strncmp(topic, SUB, strlen(SUB) - 1) != 0) return;
+    const char* name = topic + strlen(SUB) - 1;
+    char text[64];
+    size_t n = length < sizeof(text) - 1 ? length : sizeof(text) - 1;
+    memcpy(text, payload, n);
+    text[n] = '\0';
+    char* end;
+    if (strcmp(name, "relay/on") == 0) g_sink = 1;
+    else if (strcmp(name, "relay/off") == 0) g_sink = 0;
+    else if (strcmp(name, "relay/toggle") == 0) g_sink ^= 1;
+    else if (strcmp(name, "interval") == 0) g_sink = (uint32_t)strtoul(text, &end, 10);
+    else if (strcmp(name, "window") == 0) g_sink = (uint32_t)strtoul(text, &end, 10);
+    else if (strcmp(name, "deadband") == 0) { float w = strtof(text, &end); float p = strtof(end + 1, &end); g_sink = (uint32_t)(w + p); }
+    else if (strcmp(name, "cal") == 0) g_sink = (uint32_t)(strtof(text, &end) * 1000);
+    else if (strcmp(name, "diag") == 0) g_sink = 2;
+}
+
+/* === table === */
+static void table(char* topic, const uint8_t* payload, unsigned int length) {
+    if (strncmp(topic, SUB, strlen(SUB) - 1) != 0) return;
+    command_dispatch(topic + strlen(SUB) - 1, payload, length);
+    Command cmd;
+    while (command_pop(cmd)) g_sink += (uint32_t)cmd.id;
+}
+
+/* === name lookup only === */
+static const char* const NAMES[] = {
+    "relay/on", "relay/off", "relay/toggle", "interval", "window", "deadband", "mode",
+    "cal", "bands", "tune/reset", "policy", "time", "diag", "diag/every",
+};
+
+static void lookup_strcmp(char* name, const uint8_t*, unsigned int) {
+    uint32_t id = 0;
+    for (const char* n : NAMES) {
+        if (strcmp(n, name) == 0) break;
+        id++;
+    }
+    g_sink += id;
+}
+
+static void lookup_table(char* name, const uint8_t*, unsigned int) {
+    CommandId id;
+    g_sink += command_find(name, id) ? (uint32_t)id : 0;
+}
+
+template <typename Fn>
+static double ns_per_message(Fn fn, std::vector<Message>& msgs, size_t rounds) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; r++)
+        for (auto& m : msgs) fn(&m.topic[0], (const uint8_t*)m.payload.data(), (unsigned int)m.payload.size());
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / (rounds * msgs.size());
+}
+
+int main() {
+    const char* names[][2] = {
+        {"relay/on", ""}, {"relay/off", "{\"tip\":\"any payload\"}"}, {"relay/toggle", ""},
+        {"interval", "5000"}, {"window", "250"}, {"deadband", "2.5,5,300"},
+        {"cal", "1.02,2.275"}, {"diag", ""}, {"firmware/update", "x"},
+    };
+    std::vector<Message> mix;
+    for (auto& n : names) mix.push_back({std::string("zot_plug_000001/cmd/") + n[0], n[1]});
+    std::vector<Message> relay = {{"zot_plug_000001/cmd/relay/on", ""}, {"zot_plug_000001/cmd/relay/off", ""}};
+
+    const size_t rounds = 200000;
+    // Warm up, and check the hash agrees at compile time and run time.
+    ns_per_message(table, mix, 1000);
+    if (command_hash("deadband") != command_hash_rt("deadband")) { fprintf(stderr, "hash mismatch\n"); return 1; }
+
+    printf("%zu rounds; ns per message (host), Serial bytes the original printed per message\n\n", rounds);
+    printf("%-26s %10s %10s %10s %12s\n", "mix", "original", "strcmp", "table", "serial B/msg");
+    struct { const char* name; std::vector<Message>* msgs; } sets[] = {
+        {"relay on/off (2 cmds)", &relay}, {"all commands + unknown", &mix},
+    };
+    for (auto& set : sets) {
+        g_serial_bytes = 0;
+        double o = ns_per_message(original, *set.msgs, rounds);
+        double bytes = (double)g_serial_bytes / (rounds * set.msgs->size());
+        double c = ns_per_message(strcmp_chain, *set.msgs, rounds);
+        double t = ns_per_message(table, *set.msgs, rounds);
+        printf("%-26s %10.1f %10.1f %10.1f %12.1f\n", set.name, o, c, t, bytes);
+        printf("%-26s %10s %10s %10s %9.2f ms at 115200 baud\n", "", "", "", "", bytes * 10 / 115.2);
+    }
+
+    std::vector<Message> names_only;
+    for (const char* n : NAMES) names_only.push_back({n, ""});
+    names_only.push_back({"firmware/update", ""});
+    for (auto& m : names_only) {
+        CommandId id;
+        if (!command_find(m.topic.c_str(), id) != (m.topic == "firmware/update")) {
+            fprintf(stderr, "lookup mismatch: %s\n", m.topic.c_str());
+            return 1;
+        }
+    }
+    printf("\n%-26s %10s %10s\n", "name lookup only", "strcmp", "table");
+    printf("%-26s %10.1f %10.1f\n", "all 14 names + unknown",
+           ns_per_message(lookup_strcmp, names_only, rounds), ns_per_message(lookup_table, names_only, rounds));
+
+    const CommandStats& s = command_stats();
+    printf("\ntable stats: %u received, %u applied, %u unknown, %u rejected, %u dropped\n",
+           s.received, s.applied, s.unknown, s.rejected, s.dropped);
+    printf("(original parses no payloads and knows 2 of the %zu names)\n", sizeof(names) / sizeof(names[0]) - 1);
+    return 0;
+}
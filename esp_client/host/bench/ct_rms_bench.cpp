@@ -0,0 +1,176 @@
+// Host benchmark: the continuous CT sampler (ct_rms.cpp) against the EmonLib
+// snapshot it replaced, on synthetic waveforms with known RMS.
+//
+//   pio run -e native_bench_ct && .pio/build/native_bench_ct/program
+//
+// Each waveform is turned into 12-bit ADC counts the way the front end does
+// (bias near mid-scale, optional noise and slow bias drift) and fed to:
+//   - CtRms at CT_SAMPLE_RATE_HZ, as the I2S DMA delivers it
+//   - an EmonLib calcIrms(1480) emulation: ~10 kHz analogRead, offset IIR /1024
+// The reference is the AC RMS of the waveform (a CT doesn't pass DC), integrated
+// at 1 MHz.
+// The energy section compares a cycling load metered every mains cycle with
+// the old one-snapshot-per-report estimate.
+#include "../../src/hardware_config/current_sensor/ct_rms.h"
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <vector>
+
+using Wave = std::function<double(double t)>;   // amps at time t (s)
+
+static const double PI = 3.14159265358979323846;
+static const double W = 2 * PI * CT_MAINS_HZ;
+static const double V_LINE = 120.0;
+
+static double reference_rms(const Wave& i, double t0, double seconds, double dt = 1e-6) {
+    long double sum = 0, sumsq = 0;
+    size_t n = (size_t)(seconds / dt);
+    for (size_t k = 0; k < n; k++) { double v = i(t0 + k * dt); sum += v; sumsq += v * v; }
+    long double mean = sum / n;
+    return sqrt((double)(sumsq / n - mean * mean));
+}
+
+struct Adc {
+    double noise_counts;
+    double drift_counts;      // peak bias drift, over a 20 s period
+    std::mt19937 rng{7};
+    std::normal_distribution<double> g{0.0, 1.0};
+
+    uint16_t sample(const Wave& i, double t) {
+        double c = 2048.0 + drift_counts * sin(2 * PI * t / 20.0) + i(t) / CT_AMPS_PER_COUNT;
+        if (noise_counts > 0) c += noise_counts * g(rng);
+        long v = lround(c);
+        return (uint16_t)(v < 0 ? 0 : v > 4095 ? 4095 : v);
+    }
+};
+
+// EmonLib EnergyMonitor::calcIrms(), including the offset IIR that persists across calls.
+struct EmonLibSnapshot {
+    double offset = 2048;
+    static constexpr double RATE_HZ = 10000;
+
+    double calc_irms(Adc& adc, const Wave& i, double t0, unsigned samples = 1480) {
+        double sumsq = 0;
+        for (unsigned k = 0; k < samples; k++) {
+            double s = adc.sample(i, t0 + k / RATE_HZ);
+            offset += (s - offset) / 1024;
+            double f = s - offset;
+            sumsq += f * f;
+        }
+        return CT_AMPS_PER_COUNT * sqrt(sumsq / samples);
+    }
+};
+
+static void feed(CtRms& ct, Adc& adc, const Wave& i, double t0, double seconds) {
+    uint16_t block[256];
+    size_t n = (size_t)(seconds * CT_SAMPLE_RATE_HZ), k = 0;
+    while (k < n) {
+        size_t m = n - k < 256 ? n - k : 256;
+        for (size_t j = 0; j < m; j++) block[j] = adc.sample(i, t0 + (double)(k + j) / CT_SAMPLE_RATE_HZ);
+        ct_rms_push(ct, block, m);
+        k += m;
+    }
+}
+
+struct Case { const char* name; Wave i; double noise; double drift; };
+
+static void accuracy() {
+    std::vector<Case> cases = {
+        { "sine 0.5 A",             [](double t) { return 0.5 * sqrt(2) * sin(W * t); }, 0, 0 },
+        { "sine 5 A",               [](double t) { return 5.0 * sqrt(2) * sin(W * t); }, 0, 0 },
+        { "sine 15 A",              [](double t) { return 15.0 * sqrt(2) * sin(W * t); }, 0, 0 },
+        { "sine 5 A + 3rd/5th",     [](double t) { return 5.0 * sqrt(2) * (sin(W * t) + 0.3 * sin(3 * W * t) + 0.15 * sin(5 * W * t)); }, 0, 0 },
+        { "dimmer, 95 deg cut",     [](double t) { double ph = fmod(W * t, PI); return ph < 95 * PI / 180 ? 0.0 : 8.0 * sin(W * t); }, 0, 0 },
+        { "half-wave rectified",    [](double t) { double s = sin(W * t); return s > 0 ? 6.0 * s : 0.0; }, 0, 0 },
+        { "sine 2 A, noise 3 cts",  [](double t) { return 2.0 * sqrt(2) * sin(W * t); }, 3, 0 },
+        { "sine 2 A, 40 ct drift",  [](double t) { return 2.0 * sqrt(2) * sin(W * t); }, 0, 40 },
+    };
+
+    printf("Irms after 5 s of load, error vs 1 MHz reference\n");
+    printf("%-24s %9s %14s %14s\n", "waveform", "ref A", "CtRms", "EmonLib(1480)");
+    for (auto& c : cases) {
+        const double t = 5.0;
+        double window_s = (double)CT_WINDOW_CYCLES / CT_MAINS_HZ;
+        double ref = reference_rms(c.i, t - window_s, window_s);
+
+        CtRms ct;
+        ct_rms_init(ct, CT_AMPS_PER_COUNT, V_LINE, 1.0f);
+        Adc a1{c.noise, c.drift};
+        feed(ct, a1, c.i, 0, t);
+
+        // EmonLib called once a second, as the old read loop did; last call ends at t.
+        EmonLibSnapshot emon;
+        Adc a2{c.noise, c.drift};
+        double snap = 0;
+        double call_s = 1480 / EmonLibSnapshot::RATE_HZ;
+        for (int k = 1; k <= 5; k++) snap = emon.calc_irms(a2, c.i, k - call_s);
+
+        printf("%-24s %9.4f %+13.2f%% %+13.2f%%\n", c.name, ref,
+               100 * (ct_rms_irms(ct) - ref) / ref, 100 * (snap - ref) / ref);
+    }
+}
+
+// Load that cycles on and off (a compressor, a thermostat) against a 3 s report.
+static void energy() {
+    const double seconds = 600, report_s = 3;
+    Wave load = [](double t) { return fmod(t, 7.3) < 2.1 ? 9.0 * sqrt(2) * sin(W * t) : 0.2 * sqrt(2) * sin(W * t); };
+
+    long double ref_kwh = 0;
+    for (double t = 0; t < seconds; t += 1.0 / CT_MAINS_HZ)
+        ref_kwh += V_LINE * reference_rms(load, t, 1.0 / CT_MAINS_HZ, 1e-5) / (CT_MAINS_HZ * 3600000.0);
+
+    CtRms ct;
+    ct_rms_init(ct, CT_AMPS_PER_COUNT, V_LINE, 1.0f);
+    Adc a1{2, 0};
+    double ct_kwh = 0;
+    EmonLibSnapshot emon;
+    Adc a2{2, 0};
+    double snap_kwh = 0;
+    for (double t = 0; t < seconds; t += report_s) {
+        feed(ct, a1, load, t, report_s);
+        ct_kwh += ct_rms_take_energy_kwh(ct);
+        snap_kwh += V_LINE * emon.calc_irms(a2, load, t + report_s) * report_s / 3600.0 / 1000.0;
+    }
+    printf("\nEnergy, 9 A / 0.2 A load cycling every 7.3 s, 3 s reports, %.0f s\n", seconds);
+    printf("  reference %.6f kWh   CtRms %+.3f%%   snapshot per report %+.3f%%\n", (double)ref_kwh,
+           100 * (ct_kwh - (double)ref_kwh) / (double)ref_kwh, 100 * (snap_kwh - (double)ref_kwh) / (double)ref_kwh);
+}
+
+static void cost() {
+    const size_t n = 1 << 22;
+    std::vector<uint16_t> s(n);
+    Adc adc{3, 0};
+    Wave w = [](double t) { return 5.0 * sqrt(2) * sin(W * t); };
+    for (size_t k = 0; k < n; k++) s[k] = adc.sample(w, (double)k / CT_SAMPLE_RATE_HZ);
+
+    CtRms ct;
+    ct_rms_init(ct, CT_AMPS_PER_COUNT, V_LINE, 1.0f);
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t k = 0; k < n; k += 256) ct_rms_push(ct, &s[k], 256);
+    auto t1 = std::chrono::steady_clock::now();
+
+    // EmonLib's per-sample work, minus analogRead() itself.
+    volatile double sink;
+    double offset = 2048, sumsq = 0;
+    for (size_t k = 0; k < n; k++) { offset += (s[k] - offset) / 1024; double f = s[k] - offset; sumsq += f * f; }
+    sink = sumsq;
+    (void)sink;
+    auto t2 = std::chrono::steady_clock::now();
+
+    double ns_ct = std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+    double ns_emon = std::chrono::duration<double, std::nano>(t2 - t1).count() / n;
+    printf("\nCost per sample (host): CtRms %.2f ns, EmonLib filter %.2f ns (plus a blocking analogRead each)\n",
+           ns_ct, ns_emon);
+    printf("CtRms state: %zu bytes; irms %.3f A\n", sizeof(CtRms), ct_rms_irms(ct));
+}
+
+int main() {
+    printf("CT_SAMPLE_RATE_HZ %u, window %d cycles\n\n", (unsigned)CT_SAMPLE_RATE_HZ, CT_WINDOW_CYCLES);
+    accuracy();
+    energy();
+    cost();
+    return 0;
+}
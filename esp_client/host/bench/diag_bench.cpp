@@ -0,0 +1,84 @@
+// Host benchmark: what the diagnostics instrumentation (src/diagnostics) costs,
+// against the Serial debug lines it replaces.
+//
+//   pio run -e native_bench_diag && .pio/build/native_bench_diag/program
+//
+//   loop       diag_task_loop(), once per task iteration, over a spread of busy times
+//   message    diag_collect() + diag_write_json(), once per diag period
+//   serial     the line calculate_energy_ic() / read_and_print_Irms_ic() printed per
+//              sample, formatted the way Serial.print(float, digits) does; at 115200
+//              baud each byte is 87 us of UART time, and print() blocks once the
+//              TX FIFO is full
+// Host CPU time only.
+#include "../../src/diagnostics/diagnostics.h"
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+static volatile size_t g_sink;
+
+template <typename Fn>
+static double ns_per_call(Fn fn, size_t n) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n; i++) fn(i);
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+}
+
+int main() {
+    // Busy times: mostly short wakes, a tail of slow ones (log-uniform 5 us .. 50 ms).
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> exp10(0.7, 4.7);
+    std::vector<uint32_t> busy(1 << 16);
+    for (auto& b : busy) b = (uint32_t)pow(10.0, exp10(rng));
+
+    const size_t loops = 20000000;
+    double loop_ns = ns_per_call([&](size_t i) {
+        diag_task_loop(i & 1 ? DiagTask::hardware : DiagTask::mqtt, busy[i & (busy.size() - 1)]);
+    }, loops);
+
+    char out[1024];
+    size_t bytes = 0;
+    uint32_t now_ms = 0;
+    const size_t messages = 200000;
+    double message_ns = ns_per_call([&](size_t) {
+        now_ms += 300000;
+        bytes = diag_write_json(diag_collect(now_ms), out, sizeof(out));
+        g_sink = g_sink + bytes;
+    }, messages);
+
+    // "Irms est (A): 1.234 | Power (W): 14.8 | Energy (kWh): 0.012345678\r\n"
+    char line[128];
+    size_t line_bytes = 0;
+    double serial_ns = ns_per_call([&](size_t i) {
+        float a = 1.0f + (i & 255) / 1000.0f;
+        line_bytes = snprintf(line, sizeof(line), "Irms est (A): %.3f | Power (W): %.1f | Energy (kWh): %.9f\r\n",
+                              a, a * 12.0f, i * 1e-9);
+        g_sink = g_sink + line_bytes;
+    }, 2000000);
+
+    printf("ns per call (host)\n\n");
+    printf("%-34s %10.1f\n", "diag_task_loop", loop_ns);
+    printf("%-34s %10.1f   %zu B payload part\n", "diag_collect + diag_write_json", message_ns, bytes);
+    printf("%-34s %10.1f   %zu B, %.2f ms of UART at 115200 baud\n", "serial debug line (format only)", serial_ns,
+           line_bytes, line_bytes * 10 / 115.2);
+
+    // Per hour: both tasks wake about twice a second (500 ms window, MQTT_POLL_MS), one diag per DIAG_PERIOD_S.
+    double windows_h = 3600 / 0.5, diag_h = 3600.0 / DIAG_PERIOD_S;
+    printf("\nper hour: instrumentation %.2f ms CPU + %.0f B on <cid>/diag, one debug line per window %.0f B "
+           "(%.1f s of UART)\n",
+           (2 * windows_h * loop_ns + diag_h * message_ns) / 1e6, diag_h * (bytes + 420), windows_h * line_bytes,
+           windows_h * line_bytes * 10 / 115200.0);
+    printf("(diag bytes include the ~420 B of status fields main.cpp writes around this part)\n");
+
+    // One period of the busy-time spread above, as the message would report it.
+    diag_collect(now_ms);
+    for (size_t i = 0; i < 10000; i++) diag_task_loop(DiagTask::hardware, busy[i]);
+    DiagReport r = diag_collect(now_ms + 300000);
+    printf("\nhistogram of 10000 iterations (log-uniform 5 us .. 50 ms):");
+    for (size_t b = 0; b < DIAG_LATENCY_BUCKETS; b++) printf(" %u", r.task[(size_t)DiagTask::hardware].hist[b]);
+    printf("\nbuckets: <64 us, <256 us, <1 ms, <4 ms, <16 ms, <64 ms, >=64 ms\n");
+    return 0;
+}
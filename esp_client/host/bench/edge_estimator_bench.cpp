@@ -0,0 +1,221 @@
+// Host benchmark: HLW8012 frequency estimate, window pulse counting (the old
+// refresh_measurements_from_window) vs the per-edge reciprocal estimator in
+// edge_capture.cpp (ISR input mode) vs the PCNT count-snapshot estimator in
+// pcnt_capture.cpp (PCNT input mode), all sampled every WINDOW_MS like
+// hardwareTask does. The irq/s columns are the CPU interrupts each input mode
+// takes per channel: one per edge, or one per PCNT_COUNTER_LIMIT edges.
+//
+//   pio run -e native_bench_edges && .pio/build/native_bench_edges/program
+//   .pio/build/native_bench_edges/program --trace edges.csv [--pin cf|cf1]
+//
+// Built-in scenarios hold a load, step it off and back on, with 1% period jitter:
+//   error    mean |estimate - true| / true over the steady part of each hold
+//   rise     step 0 -> f until the estimate stays within 5% of f
+//   fall     step f -> 0 until the estimate stays below 5% of f
+// A recorded trace has no ground truth, so each window is compared with the
+// period that straddles its end (error only).
+#include "../../src/hardware_config/current_sensor/edge_capture.h"
+#include "../../src/hardware_config/current_sensor/pcnt_capture.h"
+#include <math.h>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include <vector>
+
+static constexpr uint32_t WINDOW_US  = 500000;    // WINDOW_MS in ic_sensor.cpp
+static constexpr uint32_t TIMEOUT_US = 2000000;   // PULSE_TIMEOUT_US in ic_sensor.cpp
+
+struct Segment { uint64_t start_us; double hz; };   // reference load, piecewise constant
+
+struct Sample { uint64_t t_us; double truth; double counting; double reciprocal; double pcnt; };
+
+// The old estimator: pulses since the previous window over the window length.
+struct CountingEstimator {
+    uint32_t pulses = 0;
+    uint64_t last_edge_us = 0;
+    uint64_t last_window_us = 0;
+
+    void edge(uint64_t t_us) { pulses++; last_edge_us = t_us; }
+    double sample(uint64_t now_us) {
+        double seconds = (now_us - last_window_us) / 1e6;
+        uint32_t p = pulses;
+        pulses = 0;
+        last_window_us = now_us;
+        if (now_us - last_edge_us > TIMEOUT_US) p = 0;
+        return seconds > 0 ? p / seconds : 0.0;
+    }
+};
+
+static std::vector<Sample> run(const std::vector<uint64_t>& edges, uint64_t end_us,
+                               double (*truth)(uint64_t, const void*), const void* ctx) {
+    static EdgeChannel ch;
+    ch = EdgeChannel();
+    CountChannel pc = {};
+    uint32_t pulses = 0;
+    CountingEstimator counting;
+    std::vector<Sample> out;
+    size_t i = 0;
+    for (uint64_t w = WINDOW_US; w <= end_us; w += WINDOW_US) {
+        for (; i < edges.size() && edges[i] < w; i++) {
+            edge_capture_record(ch, (uint32_t)edges[i]);
+            counting.edge(edges[i]);
+            pulses++;
+        }
+        double c = counting.sample(w);
+        double r = edge_capture_frequency_hz(ch, (uint32_t)w, TIMEOUT_US);
+        double p = pcnt_capture_frequency_hz(pc, pulses, (uint32_t)w, TIMEOUT_US);
+        out.push_back({w, truth(w, ctx), c, r, p});
+    }
+    return out;
+}
+
+/* === Built-in step scenarios === */
+static double segment_truth(uint64_t t_us, const void* ctx) {
+    const std::vector<Segment>& segs = *(const std::vector<Segment>*)ctx;
+    double hz = 0;
+    for (const auto& s : segs) if (s.start_us <= t_us) hz = s.hz;
+    return hz;
+}
+
+static std::vector<uint64_t> synthesize(const std::vector<Segment>& segs, uint64_t end_us, double jitter) {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    std::vector<uint64_t> edges;
+    for (size_t k = 0; k < segs.size(); k++) {
+        uint64_t seg_end = k + 1 < segs.size() ? segs[k + 1].start_us : end_us;
+        if (segs[k].hz <= 0) continue;
+        double period = 1e6 / segs[k].hz;
+        // Random phase, so the first edge isn't conveniently on the step.
+        for (double t = segs[k].start_us + period * (0.5 + 0.5 * dist(rng)); t < seg_end;
+             t += period * (1.0 + jitter * dist(rng)))
+            edges.push_back((uint64_t)t);
+    }
+    return edges;
+}
+
+struct Result { double err_counting, err_reciprocal, err_pcnt; double rise_c, rise_r, rise_p, fall_c, fall_r, fall_p; };
+
+// Time from `from_us` until the estimate settles (stays) inside the band, or -1.
+template <typename Pick, typename InBand>
+static double settle_s(const std::vector<Sample>& s, uint64_t from_us, uint64_t to_us, Pick pick, InBand ok) {
+    uint64_t settled = 0;
+    for (const auto& x : s) {
+        if (x.t_us < from_us || x.t_us >= to_us) continue;
+        if (!ok(pick(x))) settled = 0;
+        else if (!settled) settled = x.t_us;
+    }
+    return settled ? (settled - from_us) / 1e6 : -1.0;
+}
+
+static Result step_scenario(double hz) {
+    const uint64_t S = 1000000;
+    // on 20 s, off 10 s, on 20 s
+    std::vector<Segment> segs = {{0, hz}, {20 * S, 0}, {30 * S, hz}};
+    uint64_t end = 50 * S;
+    std::vector<Sample> s = run(synthesize(segs, end, 0.01), end, segment_truth, &segs);
+
+    Result r = {};
+    double sum_c = 0, sum_r = 0, sum_p = 0;
+    int n = 0;
+    for (const auto& x : s) {
+        // steady part: 5 s into each on-segment
+        bool steady = (x.t_us >= 5 * S && x.t_us < 20 * S) || (x.t_us >= 35 * S && x.t_us < 50 * S);
+        if (!steady) continue;
+        sum_c += fabs(x.counting - x.truth) / x.truth;
+        sum_r += fabs(x.reciprocal - x.truth) / x.truth;
+        sum_p += fabs(x.pcnt - x.truth) / x.truth;
+        n++;
+    }
+    r.err_counting = 100 * sum_c / n;
+    r.err_reciprocal = 100 * sum_r / n;
+    r.err_pcnt = 100 * sum_p / n;
+
+    auto near = [hz](double v) { return fabs(v - hz) <= 0.05 * hz; };
+    auto off = [hz](double v) { return v < 0.05 * hz; };
+    auto pc = [](const Sample& x) { return x.counting; };
+    auto pr = [](const Sample& x) { return x.reciprocal; };
+    auto pp = [](const Sample& x) { return x.pcnt; };
+    r.rise_c = settle_s(s, 30 * S, 50 * S, pc, near);
+    r.rise_r = settle_s(s, 30 * S, 50 * S, pr, near);
+    r.rise_p = settle_s(s, 30 * S, 50 * S, pp, near);
+    r.fall_c = settle_s(s, 20 * S, 30 * S, pc, off);
+    r.fall_r = settle_s(s, 20 * S, 30 * S, pr, off);
+    r.fall_p = settle_s(s, 20 * S, 30 * S, pp, off);
+    return r;
+}
+
+/* === Recorded traces === */
+static double straddle_truth(uint64_t t_us, const void* ctx) {
+    const std::vector<uint64_t>& e = *(const std::vector<uint64_t>*)ctx;
+    auto it = std::upper_bound(e.begin(), e.end(), t_us);
+    if (it == e.begin() || it == e.end()) return 0;
+    uint64_t period = *it - *(it - 1);
+    return period > TIMEOUT_US ? 0 : 1e6 / period;
+}
+
+static int run_trace(const char* path, const char* pin) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) { perror(path); return 1; }
+    bool want_cf1 = strcmp(pin, "cf1") == 0;
+    std::vector<uint64_t> edges;
+    char line[128];
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        char* rest;
+        uint64_t t = strtoull(line, &rest, 10);
+        while (*rest == ',' || *rest == ' ' || *rest == '\t') rest++;
+        bool is_cf1 = strncmp(rest, "cf1", 3) == 0 || rest[0] == '1';
+        bool is_cf = !is_cf1 && (strncmp(rest, "cf", 2) == 0 || rest[0] == '0');
+        if ((want_cf1 && is_cf1) || (!want_cf1 && is_cf)) edges.push_back(t);
+    }
+    fclose(fp);
+    if (edges.empty()) { fprintf(stderr, "no %s edges in %s\n", pin, path); return 1; }
+
+    std::vector<Sample> s = run(edges, edges.back(), straddle_truth, &edges);
+    double sum_c = 0, sum_r = 0, sum_p = 0;
+    int n = 0;
+    for (const auto& x : s) {
+        if (x.truth <= 0) continue;
+        sum_c += fabs(x.counting - x.truth) / x.truth;
+        sum_r += fabs(x.reciprocal - x.truth) / x.truth;
+        sum_p += fabs(x.pcnt - x.truth) / x.truth;
+        n++;
+    }
+    printf("%s: %zu %s edges, %d windows with load\n", path, edges.size(), pin, n);
+    printf("mean error  counting %.2f%%  reciprocal %.2f%%  pcnt %.2f%%\n", n ? 100 * sum_c / n : 0.0,
+           n ? 100 * sum_r / n : 0.0, n ? 100 * sum_p / n : 0.0);
+    return 0;
+}
+
+struct Cell { char c[16]; };
+static Cell seconds(double s) {
+    Cell cell;
+    if (s < 0) snprintf(cell.c, sizeof(cell.c), "never");
+    else snprintf(cell.c, sizeof(cell.c), "%.1fs", s);
+    return cell;
+}
+
+int main(int argc, char** argv) {
+    const char* trace = nullptr;
+    const char* pin = "cf1";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--trace") == 0) trace = argv[i + 1];
+        else if (strcmp(argv[i], "--pin") == 0) pin = argv[i + 1];
+    }
+    if (trace) return run_trace(trace, pin);
+
+    printf("window %u ms, timeout %u ms, ring %u edges, pcnt %u snapshots / %u pulses min\n", WINDOW_US / 1000,
+           TIMEOUT_US / 1000, (unsigned)EDGE_RING_SIZE, (unsigned)PCNT_SNAPSHOTS, (unsigned)PCNT_MIN_PULSES);
+    printf("%9s | %9s %9s %9s | %8s %8s %8s | %8s %8s %8s | %9s %9s\n", "load Hz", "err cnt", "err recip", "err pcnt",
+           "rise cnt", "rise rec", "rise pc", "fall cnt", "fall rec", "fall pc", "irq/s isr", "irq/s pc");
+    const double loads[] = {0.75, 1.3, 2.7, 5.5, 12.3, 37, 110, 330, 1100};
+    for (double hz : loads) {
+        Result r = step_scenario(hz);
+        printf("%9.2f | %8.2f%% %8.2f%% %8.2f%% | %8s %8s %8s | %8s %8s %8s | %9.2f %9.5f\n", hz, r.err_counting,
+               r.err_reciprocal, r.err_pcnt, seconds(r.rise_c).c, seconds(r.rise_r).c, seconds(r.rise_p).c,
+               seconds(r.fall_c).c, seconds(r.fall_r).c, seconds(r.fall_p).c, hz, hz / PCNT_COUNTER_LIMIT);
+    }
+    return 0;
+}
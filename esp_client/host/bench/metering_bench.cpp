@@ -0,0 +1,125 @@
+// Host benchmark: per-window metering math, the old double pipeline vs the
+// float one in metering_math.h, and how well each keeps a month-long energy total.
+//
+//   pio run -e native_bench_metering && .pio/build/native_bench_metering/program [days]
+//
+// "cycles" are host TSC cycles (x86) or ns elsewhere. The host has a double FPU,
+// so this shows the float path isn't slower and computes the same numbers. On
+// the ESP32 each double op in the old path is a soft-float call on top of this.
+// Month error is against a long double sum of the exact same window increments.
+#include "../../src/hardware_config/current_sensor/metering_math.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t cycles() { return __rdtsc(); }
+static const char* CYCLE_UNIT = "cycles";
+#else
+static inline uint64_t cycles() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+static const char* CYCLE_UNIT = "ns";
+#endif
+
+/* Must match ic_sensor.cpp */
+static constexpr float CAL_A_PER_HZ = 0.0166f;
+static constexpr float OFFSET_A = 2.275f;
+static constexpr float STRENGTH = 1.0f;
+static const CurrentCalBand BANDS[] = { {4.50f, 0.53f}, {2.00f, 0.63f}, {1.5f, 0.81f}, {0.6f, 0.688f}, {0.30f, 1.12f} };
+static constexpr size_t BAND_COUNT = sizeof(BANDS) / sizeof(BANDS[0]);
+
+/* === The previous double implementation, verbatim apart from names === */
+struct DoubleBand { double max_offset_corrected_amps; double scale; };
+static const DoubleBand DBANDS[] = { {4.50, 0.53}, {2.00, 0.63}, {1.5, 0.81}, {0.6, 0.688}, {0.30, 1.12} };
+
+static double calibrate_current_double(double current_raw_amps) {
+    double offset_corrected = current_raw_amps - 2.275;
+    if (offset_corrected <= 0.0) return 0.0;
+    for (const auto& band : DBANDS) {
+        if (offset_corrected >= band.max_offset_corrected_amps) {
+            double scaled = offset_corrected * band.scale;
+            return offset_corrected + (scaled - offset_corrected) * 1.0;
+        }
+    }
+    return offset_corrected;
+}
+
+struct Window { float current_hz; uint32_t elapsed_ms; };
+
+// A month of 500 ms windows: a load that wanders between idle and ~15 A,
+// with timer jitter on the window length.
+static std::vector<Window> make_windows(double days) {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> u(0.0f, 1.0f);
+    size_t n = (size_t)(days * 86400.0 * 2);
+    std::vector<Window> w(n);
+    float hz = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (u(rng) < 0.002f) hz = u(rng) < 0.3f ? 0.0f : 140.0f + 900.0f * u(rng);   // load changes
+        float noisy = hz > 0 ? hz * (1.0f + 0.01f * (u(rng) - 0.5f)) : 0.0f;
+        w[i] = { noisy, 500u + (uint32_t)(u(rng) * 3.0f) - 1u };
+    }
+    return w;
+}
+
+int main(int argc, char** argv) {
+    double days = argc > 1 ? atof(argv[1]) : 30;
+    std::vector<Window> windows = make_windows(days);
+    size_t n = windows.size();
+
+    // Per-window pipeline: Hz -> raw A -> calibrated A -> W (x 12 V) -> kWh -> total.
+    double d_total = 0;
+    uint64_t c0 = cycles();
+    for (const Window& w : windows) {
+        double raw = (double)(w.current_hz * CAL_A_PER_HZ);
+        double a = calibrate_current_double(raw);
+        double p = a * 12.0;
+        double elapsedHours = w.elapsed_ms / 3600000.0;
+        d_total += (p * elapsedHours) / 1000.0;
+    }
+    uint64_t c1 = cycles();
+
+    float f_naive = 0;
+    EnergyAccumulator f_kahan = {};
+    uint64_t c2 = cycles();
+    for (const Window& w : windows) {
+        float a = calibrate_current(w.current_hz * CAL_A_PER_HZ, OFFSET_A, BANDS, BAND_COUNT, STRENGTH);
+        f_kahan.add(energy_kwh(a * 12.0f, w.elapsed_ms));
+    }
+    uint64_t c3 = cycles();
+    for (const Window& w : windows) {
+        float a = calibrate_current(w.current_hz * CAL_A_PER_HZ, OFFSET_A, BANDS, BAND_COUNT, STRENGTH);
+        f_naive += energy_kwh(a * 12.0f, w.elapsed_ms);
+    }
+
+    // Reference: the float pipeline's own increments summed exactly, and the
+    // double pipeline's per-window values, so calibration and summation error separate.
+    long double ref_float_inc = 0, ref_double_inc = 0;
+    double max_cal_abs = 0;
+    size_t band_flips = 0;   // float and double land on different sides of a band threshold
+    for (const Window& w : windows) {
+        float a = calibrate_current(w.current_hz * CAL_A_PER_HZ, OFFSET_A, BANDS, BAND_COUNT, STRENGTH);
+        ref_float_inc += (long double)energy_kwh(a * 12.0f, w.elapsed_ms);
+        double ad = calibrate_current_double((double)(w.current_hz * CAL_A_PER_HZ));
+        ref_double_inc += (long double)(ad * 12.0) * w.elapsed_ms / 3600000.0L / 1000.0L;
+        double diff = fabs(a - ad);
+        if (diff > 1e-4) band_flips++;
+        else if (diff > max_cal_abs) max_cal_abs = diff;
+    }
+
+    auto rel = [](long double got, long double want) { return (double)((got - want) / want); };
+    printf("%.0f days, %zu windows, %.3f kWh\n", days, n, (double)ref_double_inc);
+    printf("per window   double %6.1f %s   float+kahan %6.1f %s\n",
+           (double)(c1 - c0) / n, CYCLE_UNIT, (double)(c3 - c2) / n, CYCLE_UNIT);
+    printf("calibration  float vs double max diff %.2e A (%zu windows flip band at a threshold)\n", max_cal_abs, band_flips);
+    printf("month total  (relative error vs exact sum of its own increments)\n");
+    printf("  double naive  %.9f kWh  %+.2e\n", d_total, rel(d_total, ref_double_inc));
+    printf("  float naive   %.9f kWh  %+.2e\n", f_naive, rel(f_naive, ref_float_inc));
+    printf("  float kahan   %.9f kWh  %+.2e\n", f_kahan.total(), rel(f_kahan.total(), ref_float_inc));
+    printf("  float vs double pipeline  %+.2e\n", rel(ref_float_inc, ref_double_inc));
+    return 0;
+}
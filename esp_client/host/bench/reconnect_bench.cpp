@@ -0,0 +1,238 @@
+// Host benchmark: WiFi/MQTT link bring-up (mqtt_config.cpp) on the virtual clock.
+//
+//   pio run -e native_bench_reconnect && .pio/build/native_bench_reconnect/program [--scan-ms MS]
+//       [--assoc-ms MS] [--dhcp-ms MS] [--broker-ms MS] [--plugs N] [--down-s S] [--accept-per-s R]
+//       [--ap-down-ms MS]
+//
+// Part 1 boots the firmware's own link state machine against the host WiFi model
+// and the stub broker (host_hal.h: scan, association, DHCP and CONNECT each take
+// virtual time) and reports reset -> WiFi up -> MQTT connected -> first publish,
+// the publish being one that was waiting in the queue. Time before the app starts
+// (ROM + second-stage bootloader, ~0.3 s) and the config load are not included.
+// The "old" row replays the blocking setup_wifi()/reconnect() this replaced: full
+// scan + DHCP, WiFi.status() polled every 500 ms.
+// It then takes the AP away from a plug that is online, for a blip (--ap-down-ms)
+// and for longer than a cached join waits, and reports how long after the AP is
+// back the plug publishes again.
+//
+// Part 2 is the stampede after a broker restart: N plugs lose the connection at
+// once, the broker is down for a while and then accepts a limited number of
+// CONNECTs per second (token bucket; anything over is refused). Each retry policy
+// gets the same plugs; the jittered one is the firmware's backoff.h.
+#include "../../src/mqtt_config/mqtt_config.h"
+#include "../../src/mqtt_config/backoff.h"
+#include "../hal/host_hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <queue>
+#include <random>
+#include <vector>
+
+struct Options {
+    hal_wifi_timing wifi = { 2100, 180, 900 };
+    uint32_t broker_ms = 35;
+    int plugs = 500;
+    double down_s = 10;
+    double accept_per_s = 100;
+    uint32_t ap_down_ms = 2000;
+};
+
+/* === Part 1: boot to first publish === */
+
+struct BootResult { double wifi_ms, mqtt_ms, publish_ms; uint64_t scans; };
+
+static double since_ms(uint64_t t0) { return (hal_now_us() - t0) / 1000.0; }
+
+static BootResult boot(esp_reset_reason_t reason) {
+    client.disconnect();
+    WiFi.disconnect();
+    hal_set_reset_reason(reason);
+
+    BootResult r = { -1, -1, -1, hal_wifi_scans() };
+    uint64_t t0 = hal_now_us();
+    connect_setup_mqtt("zotnet", "secret", "broker.local", 1883, nullptr);
+    while (since_ms(t0) < 120000) {
+        uint32_t wait_ms = check_maintain_mqtt_connection("zot_plug_000001", "zot_plug_000001", "pw", "zot_plug_000001/cmd/#");
+        if (mqtt_link_state() == LinkState::online) {
+            if (r.wifi_ms < 0) r.wifi_ms = (hal_wifi_ready_us() - t0) / 1000.0;
+            if (r.mqtt_ms < 0) r.mqtt_ms = since_ms(t0);
+            if (publish_message("zot_plug_000001/data", "{}", 2)) { r.publish_ms = since_ms(t0); break; }
+        }
+        hal_advance_us((uint64_t)(wait_ms ? wait_ms : 1) * 1000);
+    }
+    r.scans = hal_wifi_scans() - r.scans;
+    return r;
+}
+
+// The blocking bring-up this replaced, step for step.
+static BootResult boot_old() {
+    client.disconnect();
+    WiFi.disconnect();
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+
+    BootResult r = { -1, -1, -1, hal_wifi_scans() };
+    uint64_t t0 = hal_now_us();
+    hal_advance_us(10 * 1000);                  // vTaskDelay(10)
+    WiFi.begin("zotnet", "secret");
+    while (WiFi.status() != WL_CONNECTED) hal_advance_us(500 * 1000);
+    r.wifi_ms = since_ms(t0);
+    while (!client.connect("zot_plug_000001", "zot_plug_000001", "pw")) hal_advance_us(500 * 1000);
+    r.mqtt_ms = since_ms(t0);
+    hal_advance_us(500 * 1000);                 // publish_queue_wait(500) before the queue is serviced
+    if (client.publish("zot_plug_000001/data", (const uint8_t*)"{}", 2)) r.publish_ms = since_ms(t0);
+    r.scans = hal_wifi_scans() - r.scans;
+    return r;
+}
+
+static void print_boot(const char* name, const BootResult& r) {
+    printf("  %-40s %9.0f %9.0f %9.0f %6llu\n", name, r.wifi_ms, r.mqtt_ms, r.publish_ms, (unsigned long long)r.scans);
+}
+
+static void boot_latency(const Options& o) {
+    hal_set_wifi_timing(o.wifi);
+    hal_set_broker_connect_ms(o.broker_ms);
+    printf("Reset to first publish (scan %u ms, assoc %u ms, DHCP %u ms, CONNECT %u ms)\n",
+           o.wifi.scan_ms, o.wifi.assoc_ms, o.wifi.dhcp_ms, o.broker_ms);
+    printf("  %-40s %9s %9s %9s %6s\n", "boot", "wifi ms", "mqtt ms", "pub ms", "scans");
+
+    print_boot("old: blocking, full scan + DHCP", boot_old());
+    print_boot("power-on, nothing cached", boot(ESP_RST_POWERON));
+    print_boot("power-on, NVS: BSSID/channel", boot(ESP_RST_POWERON));
+    print_boot("brownout, RTC: BSSID/channel/lease", boot(ESP_RST_BROWNOUT));
+    print_boot("software reset, RTC", boot(ESP_RST_SW));
+
+    const uint8_t moved[6] = { 0x24, 0x0A, 0xC4, 0x5E, 0x10, 0x02 };
+    hal_set_wifi_ap(moved, 11);
+    print_boot("software reset, AP moved (stale cache)", boot(ESP_RST_SW));
+
+    const MqttLinkStats& ls = mqtt_link_stats();
+    printf("  link totals: %u WiFi attempts, %u from cache, %u cache misses, %u MQTT attempts\n\n",
+           ls.wifi_attempts, ls.wifi_fast, ls.wifi_fast_failed, ls.mqtt_attempts);
+}
+
+// The AP disappears under a plug that is online and comes back after down_ms.
+static BootResult wifi_drop(uint32_t down_ms) {
+    boot(ESP_RST_SW);
+    BootResult r = { -1, -1, -1, hal_wifi_scans() };
+    uint64_t t0 = hal_now_us();
+    uint64_t back_us = t0 + (uint64_t)down_ms * 1000;
+    hal_set_wifi_up(false);
+    while (since_ms(t0) < 300000) {
+        if (hal_now_us() >= back_us) hal_set_wifi_up(true);
+        uint32_t wait_ms = check_maintain_mqtt_connection("zot_plug_000001", "zot_plug_000001", "pw", "zot_plug_000001/cmd/#");
+        if (hal_now_us() >= back_us && mqtt_link_state() == LinkState::online) {
+            if (r.wifi_ms < 0) r.wifi_ms = (std::max(hal_wifi_ready_us(), back_us) - back_us) / 1000.0;
+            if (r.mqtt_ms < 0) r.mqtt_ms = (hal_now_us() - back_us) / 1000.0;
+            if (publish_message("zot_plug_000001/data", "{}", 2)) { r.publish_ms = (hal_now_us() - back_us) / 1000.0; break; }
+        }
+        uint64_t step_us = (uint64_t)(wait_ms ? wait_ms : 1) * 1000;
+        if (hal_now_us() < back_us) step_us = std::min(step_us, back_us - hal_now_us());
+        hal_advance_us(step_us);
+    }
+    r.scans = hal_wifi_scans() - r.scans;
+    return r;
+}
+
+static void wifi_drop_latency(const Options& o) {
+    printf("WiFi lost while online (times from the AP coming back)\n");
+    printf("  %-40s %9s %9s %9s %6s\n", "AP down", "wifi ms", "mqtt ms", "pub ms", "scans");
+    char name[64];
+    snprintf(name, sizeof(name), "%u ms", o.ap_down_ms);
+    print_boot(name, wifi_drop(o.ap_down_ms));
+    snprintf(name, sizeof(name), "%u ms (past the cached join's timeout)", WIFI_FAST_TIMEOUT_MS + 2000);
+    print_boot(name, wifi_drop(WIFI_FAST_TIMEOUT_MS + 2000));
+    printf("\n");
+}
+
+/* === Part 2: stampede after a broker restart === */
+
+enum class Policy { fixed_500ms, exponential, exponential_jitter };
+
+struct StampedeResult { double all_s, p50_s, p95_s; uint64_t attempts, refused; };
+
+static StampedeResult stampede(const Options& o, Policy policy, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> phase(0, 0.05);   // mqttTask wakeups aren't perfectly aligned
+
+    struct Ev { double t; int plug; bool operator>(const Ev& e) const { return t > e.t; } };
+    std::priority_queue<Ev, std::vector<Ev>, std::greater<Ev>> q;
+    std::vector<Backoff> backoff(o.plugs, Backoff{ MQTT_BACKOFF_BASE_MS, LINK_BACKOFF_CAP_MS, 0 });
+    std::vector<double> connected_at;
+
+    // Every plug sees the drop at t = 0; the firmware's first retry is already backed off.
+    auto next_delay_s = [&](int p) -> double {
+        switch (policy) {
+            case Policy::fixed_500ms: return 0.5;
+            case Policy::exponential: {
+                double d = backoff_ceiling_ms(backoff[p]) / 1000.0;
+                if (backoff[p].attempt < 31) backoff[p].attempt++;
+                return d;
+            }
+            default: return backoff_next_ms(backoff[p], rng()) / 1000.0;
+        }
+    };
+    for (int p = 0; p < o.plugs; p++) q.push({ phase(rng) + next_delay_s(p), p });
+
+    double burst = std::max(1.0, o.accept_per_s / 5), tokens = burst, refill_t = o.down_s;
+    StampedeResult r = {};
+    while (!q.empty()) {
+        Ev e = q.top();
+        q.pop();
+        r.attempts++;
+        bool accepted = false;
+        if (e.t >= o.down_s) {
+            tokens = std::min(burst, tokens + (e.t - refill_t) * o.accept_per_s);
+            refill_t = e.t;
+            if (tokens >= 1) { tokens -= 1; accepted = true; }
+        }
+        if (accepted) { connected_at.push_back(e.t - o.down_s); continue; }
+        if (e.t >= o.down_s) r.refused++;
+        q.push({ e.t + next_delay_s(e.plug), e.plug });
+    }
+    std::sort(connected_at.begin(), connected_at.end());
+    r.all_s = connected_at.back();
+    r.p50_s = connected_at[connected_at.size() / 2];
+    r.p95_s = connected_at[connected_at.size() * 95 / 100];
+    return r;
+}
+
+static void stampede_table(const Options& o) {
+    printf("Broker restart: %d plugs, down %.0f s, then accepting %.0f CONNECT/s (times from broker up)\n",
+           o.plugs, o.down_s, o.accept_per_s);
+    printf("  %-30s %9s %9s %9s %10s %10s\n", "retry policy", "p50 s", "p95 s", "all s", "attempts", "refused*");
+    const struct { const char* name; Policy p; } rows[] = {
+        { "fixed 500 ms (old)", Policy::fixed_500ms },
+        { "exponential 1-60 s", Policy::exponential },
+        { "exponential + full jitter", Policy::exponential_jitter },
+    };
+    for (const auto& row : rows) {
+        StampedeResult r = stampede(o, row.p, 7);
+        printf("  %-30s %9.2f %9.2f %9.2f %10llu %10llu\n", row.name, r.p50_s, r.p95_s, r.all_s,
+               (unsigned long long)r.attempts, (unsigned long long)r.refused);
+    }
+    printf("  * attempts turned away by the rate limit once the broker was back up\n");
+}
+
+int main(int argc, char** argv) {
+    Options o;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* a = argv[i];
+        double v = atof(argv[i + 1]);
+        if (strcmp(a, "--scan-ms") == 0) o.wifi.scan_ms = (uint32_t)v;
+        else if (strcmp(a, "--assoc-ms") == 0) o.wifi.assoc_ms = (uint32_t)v;
+        else if (strcmp(a, "--dhcp-ms") == 0) o.wifi.dhcp_ms = (uint32_t)v;
+        else if (strcmp(a, "--broker-ms") == 0) o.broker_ms = (uint32_t)v;
+        else if (strcmp(a, "--plugs") == 0) o.plugs = (int)v;
+        else if (strcmp(a, "--down-s") == 0) o.down_s = v;
+        else if (strcmp(a, "--accept-per-s") == 0) o.accept_per_s = v;
+        else if (strcmp(a, "--ap-down-ms") == 0) o.ap_down_ms = (uint32_t)v;
+        else { fprintf(stderr, "unknown option %s\n", a); return 1; }
+    }
+    if (o.plugs < 1 || o.accept_per_s <= 0) { fprintf(stderr, "need --plugs >= 1 and --accept-per-s > 0\n"); return 1; }
+    boot_latency(o);
+    wifi_drop_latency(o);
+    stampede_table(o);
+    return 0;
+}
@@ -0,0 +1,210 @@
+// Host benchmark: report-by-exception and adaptive reporting (report_policy.h)
+// against fixed-interval reporting, messages sent vs how well the backend can
+// follow the load.
+//
+//   pio run -e native_bench_report_policy && .pio/build/native_bench_report_policy/program [--profile FILE]
+//
+// A load profile is a series of 500 ms measurement-window powers. Built-in
+// profiles model typical plug loads over 24 h; --profile replays a recorded
+// one instead ("<t_s>,<watts>" per line, resampled to windows by holding
+// the last value; '#' lines ignored).
+//
+// Each configuration drives the firmware's own report_policy and window_stats
+// code with the same timer logic hardware_task_step() uses. "Fidelity" is what
+// the backend sees between reports, holding the last reported power:
+//   MAE      mean |held - actual| over all windows
+//   >10%     share of windows where the held power is off by more than 10% (and 2 W)
+//   peak     highest window max any report carried (window stats), vs the true peak
+// Energy is exact in every mode: it accumulates on the device until the next report.
+#include "../../src/telemetry/report_policy.h"
+#include "../../src/telemetry/window_stats.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+static constexpr uint32_t WINDOW_MS = 500;
+
+struct Profile { std::string name; std::vector<float> watts; };
+
+static size_t windows_for_hours(double h) { return (size_t)(h * 3600e3 / WINDOW_MS); }
+
+// Fridge: compressor ~120 W with a start-up spike, ~35% duty, idle at 2 W.
+static Profile fridge(std::mt19937& rng) {
+    Profile p{"fridge", {}};
+    std::uniform_real_distribution<float> on_min(10, 20), off_min(20, 40);
+    std::normal_distribution<float> noise(0, 1.5f);
+    size_t n = windows_for_hours(24);
+    while (p.watts.size() < n) {
+        size_t on = (size_t)(on_min(rng) * 120), off = (size_t)(off_min(rng) * 120);
+        for (size_t i = 0; i < on; i++) p.watts.push_back(i < 2 ? 600.0f : 118.0f + noise(rng) - 0.002f * i);
+        for (size_t i = 0; i < off; i++) p.watts.push_back(2.0f + 0.1f * noise(rng));
+    }
+    p.watts.resize(n);
+    return p;
+}
+
+// Router / standby loads: flat with a little noise.
+static Profile steady(std::mt19937& rng) {
+    Profile p{"steady 9 W", {}};
+    std::normal_distribution<float> noise(0, 0.15f);
+    for (size_t i = 0, n = windows_for_hours(24); i < n; i++) p.watts.push_back(9.0f + noise(rng));
+    return p;
+}
+
+// Desktop PC: 8 h of use wandering 60-250 W, otherwise 1 W standby.
+static Profile desktop(std::mt19937& rng) {
+    Profile p{"desktop PC", {}};
+    std::normal_distribution<float> step(0, 4.0f);
+    std::uniform_real_distribution<float> u(0, 1);
+    size_t n = windows_for_hours(24), on_from = windows_for_hours(9), on_to = windows_for_hours(17);
+    float w = 90;
+    for (size_t i = 0; i < n; i++) {
+        if (i < on_from || i >= on_to) { p.watts.push_back(1.0f); continue; }
+        w += step(rng);
+        if (u(rng) < 0.002f) w += 120;   // bursts of load
+        w = std::min(250.0f, std::max(60.0f, w + (90 - w) * 0.01f));
+        p.watts.push_back(w);
+    }
+    return p;
+}
+
+// Space heater on a thermostat: 1500 W for a few minutes at a time, evenings only.
+static Profile heater(std::mt19937& rng) {
+    Profile p{"heater", {}};
+    std::uniform_real_distribution<float> on_min(2, 6), off_min(4, 12);
+    std::normal_distribution<float> noise(0, 6.0f);
+    size_t n = windows_for_hours(24), from = windows_for_hours(17), to = windows_for_hours(23);
+    p.watts.assign(from, 0.0f);
+    while (p.watts.size() < to) {
+        size_t on = (size_t)(on_min(rng) * 120), off = (size_t)(off_min(rng) * 120);
+        for (size_t i = 0; i < on; i++) p.watts.push_back(1500.0f + noise(rng));
+        for (size_t i = 0; i < off; i++) p.watts.push_back(0.0f);
+    }
+    p.watts.resize(to);
+    p.watts.resize(n, 0.0f);
+    return p;
+}
+
+static bool load_profile(const char* path, Profile& p) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    p.name = path;
+    char line[128];
+    double next_t = 0;
+    float last = 0;
+    bool any = false;
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        char* rest;
+        double t = strtod(line, &rest);
+        while (*rest == ',' || *rest == ' ') rest++;
+        float w = strtof(rest, nullptr);
+        if (!any) { next_t = t; any = true; }
+        while (next_t < t) { p.watts.push_back(last); next_t += WINDOW_MS / 1000.0; }
+        last = w;
+    }
+    p.watts.push_back(last);
+    fclose(f);
+    return any;
+}
+
+struct Config { const char* name; ReportPolicy policy; uint32_t interval_ms; };
+
+struct Result { uint64_t messages; double mae; double stale; float peak_reported; };
+
+static Result run(const Profile& prof, const Config& c) {
+    report_policy_set(c.policy);
+    WindowStats stats;
+    window_stats_reset(stats);
+
+    Result r = {};
+    uint32_t period = report_policy_period_ms(c.interval_ms);
+    uint32_t next_report_ms = period;
+    float held = -1.0f, last_window = -1.0f;
+    double err_sum = 0;
+    uint64_t stale = 0;
+
+    auto send = [&](ReportReason reason) {
+        PowerStats s = window_stats_summary(stats);
+        if (s.windows && s.max > r.peak_reported) r.peak_reported = s.max;
+        window_stats_reset(stats);
+        report_policy_sent(reason, last_window);
+        held = last_window;
+        r.messages++;
+    };
+
+    for (size_t i = 0; i < prof.watts.size(); i++) {
+        uint32_t now_ms = (uint32_t)((i + 1) * WINDOW_MS);
+        float w = prof.watts[i];
+        last_window = w;
+        window_stats_add(stats, w);
+        bool outside = report_policy_window(w);
+
+        // The period is re-read after each report: adaptive mode stretches and resets it.
+        if (now_ms >= next_report_ms) {
+            send(c.policy.mode == ReportMode::exception ? ReportReason::heartbeat : ReportReason::interval);
+            period = report_policy_period_ms(c.interval_ms);
+            next_report_ms = now_ms + period;
+        } else if (outside) {
+            send(ReportReason::deadband);
+            period = report_policy_period_ms(c.interval_ms);
+            next_report_ms = now_ms + period;
+        }
+
+        if (held >= 0) {
+            float err = fabsf(held - w);
+            err_sum += err;
+            if (err > 2.0f && err > 0.1f * w) stale++;
+        }
+    }
+    r.mae = err_sum / prof.watts.size();
+    r.stale = (double)stale / prof.watts.size();
+    return r;
+}
+
+int main(int argc, char** argv) {
+    std::vector<Profile> profiles;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--profile") == 0) {
+            Profile p;
+            if (!load_profile(argv[++i], p)) { perror(argv[i]); return 1; }
+            profiles.push_back(p);
+        }
+    }
+    if (profiles.empty()) {
+        std::mt19937 rng(11);
+        profiles = { fridge(rng), steady(rng), desktop(rng), heater(rng) };
+    }
+
+    const Config configs[] = {
+        { "interval 3 s",              { ReportMode::interval, 0, 0, 0 }, 3000 },
+        { "interval 60 s",             { ReportMode::interval, 0, 0, 0 }, 60000 },
+        { "exception 2 W / 5%, 300 s", { ReportMode::exception, 2, 5, 300000 }, 3000 },
+        { "exception 5 W / 10%, 300 s",{ ReportMode::exception, 5, 10, 300000 }, 3000 },
+        { "exception 10 W / 20%, 900 s",{ ReportMode::exception, 10, 20, 900000 }, 3000 },
+        { "adaptive 3-60 s, 2 W / 10%", { ReportMode::adaptive, 0, 0, 60000 }, 3000 },
+        { "adaptive 3-300 s, 2 W / 5%",{ ReportMode::adaptive, 2, 5, 300000 }, 3000 },
+    };
+
+    for (const auto& prof : profiles) {
+        float peak = *std::max_element(prof.watts.begin(), prof.watts.end());
+        double hours = prof.watts.size() * (WINDOW_MS / 3600e3);
+        printf("%s (%.1f h, peak %.0f W)\n", prof.name.c_str(), hours, peak);
+        printf("  %-28s %9s %9s %9s %8s %11s\n", "config", "msgs/h", "vs 3 s", "MAE W", ">10%", "peak seen");
+        double base = 0;
+        for (const auto& c : configs) {
+            Result r = run(prof, c);
+            double per_h = r.messages / hours;
+            if (base == 0) base = per_h;
+            printf("  %-28s %9.1f %8.1fx %9.2f %7.2f%% %9.0f W\n", c.name, per_h, base / per_h, r.mae,
+                   100 * r.stale, r.peak_reported);
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+// Host benchmark: report payload size and encode cost, JSON vs binary.
+//
+//   pio run -e native_bench_telemetry && .pio/build/native_bench_telemetry/program [iterations]
+//
+// "wire" adds the MQTT 3.1.1 QoS0 PUBLISH framing (fixed header, topic length, topic)
+// that every report pays on top of the payload.
+#include "../../src/telemetry/telemetry.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+static const char* DEVICE_NAME = "zot_plug_000001";
+static const char* PUB_TOPIC   = "zot_plug_000001/data";
+
+static size_t mqtt_wire_bytes(size_t topic_len, size_t payload_len) {
+    size_t remaining = 2 + topic_len + payload_len;
+    size_t varint = remaining < 128 ? 1 : remaining < 16384 ? 2 : 3;
+    return 1 + varint + remaining;
+}
+
+template <typename Encode>
+static void run(const char* name, const std::vector<DeviceReading>& readings, Encode encode) {
+    uint8_t buf[256];
+    size_t bytes = 0;
+    volatile size_t sink = 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (const auto& r : readings) {
+        size_t n = encode(r, buf, sizeof(buf));
+        bytes += n;
+        sink = sink + buf[n / 2];
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+
+    double avg = (double)bytes / readings.size();
+    printf("%-8s payload %6.1f B  wire %6.1f B  encode %7.1f ns\n", name, avg,
+           (double)mqtt_wire_bytes(strlen(PUB_TOPIC), (size_t)(avg + 0.5)), ns / readings.size());
+}
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? (size_t)atol(argv[1]) : 1000000;
+
+    // Realistic spread of plug loads so JSON number formatting isn't flattered by constants.
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> amps(0.0, 12.0);
+    std::vector<DeviceReading> readings(n);
+    for (auto& r : readings) {
+        r.current = amps(rng);
+        r.voltage = 120;
+        r.power = r.current * r.voltage;
+        r.energyIncrement = r.power * (3.0 / 3600.0) / 1000.0;
+        r.relayOn = true;
+    }
+
+    printf("%zu readings, topic \"%s\"\n", n, PUB_TOPIC);
+    run("json", readings, [](const DeviceReading& r, uint8_t* buf, size_t cap) {
+        return encode_reading_json(r, DEVICE_NAME, (char*)buf, cap);
+    });
+    run("binary", readings, [](const DeviceReading& r, uint8_t* buf, size_t cap) {
+        return encode_reading_binary(r, buf, cap);
+    });
+    return 0;
+}
@@ -0,0 +1,774 @@
+// Fleet simulator: thousands of virtual plugs on real MQTT connections to a local
+// broker, to load-test the broker (infra/broker_mqtt) and ingestion
+// (infra/rest_api/mqtt_conf) the way a deployment of plugs would hit them.
+//
+//   pio run -e native_fleet
+//   .pio/build/native_fleet/program --plugs 10000 --broker 127.0.0.1:1883 --password loadtest
+//       --observer api:apipass --ack --seconds 600 --storm-at 300 --storm-frac 0.5
+//
+// Every plug speaks with the firmware's own code: payloads come from the telemetry
+// encoders send_device_reading() feeds (encode_reading / encode_batch_binary, with
+// window_stats over the interval's windows), incoming topics go through
+// val_incoming_topic(), reconnects wait the firmware's full-jitter backoff
+// (mqtt_config/backoff.h), readings taken while offline are kept and drained
+// READING_STORE_DRAIN_BATCH per report like reading_store.h, and the template
+// config is config.env parsed by ensureEnvInNVS(). Readings carry a boot ID, a per-boot
+// sequence number and a capture time like reading_clock.h; the boot ID is the run's start
+// (unix seconds), so a rerun against the same database isn't taken for a replay of the
+// last one and dropped as duplicates. Only the plug's identity differs:
+// "<prefix><NNNNNN>", topics "<cid>/data" and "<cid>/cmd/#", one password for all
+// (the broker accepts them when started with LOADTEST_PASSWORD, see server_conf.ts).
+//
+// Connections are non-blocking sockets on one epoll loop; a plug's state machine
+// and report timer run off a heap of deadlines, so a single thread carries 10k+
+// plugs. Raise the fd limit (ulimit -n) above --plugs if setrlimit can't.
+//
+// Latency, per published message (matched by a FNV-1a hash of the payload):
+//   broker   publish -> the observer connection (--observer USER:PASS, subscribed
+//            to "+/data" like the ingestion client) receives it
+//   ingest   publish -> "<cid>/cmd/ingested" comes back to the plug, sent by the
+//            REST API's MQTT client once the readings are stored (INGEST_ACK=1 on
+//            the API, --ack here)
+// A command sent with an ack id ("<cid>/cmd/<name>@<id>", src/commands/commands.h) is
+// acked on "<cid>/ack" at once, in the firmware's format, with relay/* switching the
+// plug's relay; POST /mqtt/publish with awaitAck times the round trip across the fleet.
+// --storm-at S drops --storm-frac of the connected plugs at once (an AP or broker
+// restart); --no-jitter retries them on the backoff ceiling, in lockstep, instead.
+#include "../../src/env_config/env_config.h"
+#include "../../src/mqtt_config/mqtt_config.h"
+#include "../../src/mqtt_config/backoff.h"
+#include "../../src/telemetry/telemetry.h"
+#include "../../src/telemetry/window_stats.h"
+#include "../../src/telemetry/report_batch.h"
+#include "../../src/reading_store/reading_store.h"
+#include "../../src/tuning/tuning.h"
+#include "../../src/commands/command_table.h"
+#include "../../src/commands/commands.h"
+#include "../hal/host_hal.h"
+#include "mqtt_wire.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+Env env;
+
+/* === Options === */
+struct Options {
+    const char* config_root = "data";
+    const char* broker = nullptr;      // host[:port]; default MQTT_SERVER from config.env
+    const char* prefix = "loadtest_";
+    const char* password = nullptr;    // default CLIENT_PASS from config.env
+    const char* observer = nullptr;    // USER:PASS
+    const char* format = nullptr;      // overrides TELEMETRY_FMT
+    int batch_samples = -1;            // overrides BATCH_SAMPLES
+    uint32_t plugs = 1000;
+    uint32_t interval_ms = DEFAULT_REPORT_INTERVAL_MS;
+    double jitter = 0.05;              // +- fraction of the interval, per report
+    double seconds = 60;
+    double ramp_s = 10;                // plugs power up spread over this
+    double storm_at_s = -1;
+    double storm_frac = 1.0;
+    double report_s = 5;               // progress line period
+    double load_w = 60;                // mean plug load
+    bool ack = false;
+    bool no_jitter = false;
+};
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+        "usage: %s [--plugs N] [--broker HOST[:PORT]] [--prefix P] [--password PASS]\n"
+        "          [--interval-ms MS] [--jitter FRAC] [--seconds S] [--ramp-s S] [--load-w W]\n"
+        "          [--format json|binary] [--batch N] [--observer USER:PASS] [--ack]\n"
+        "          [--storm-at S [--storm-frac F]] [--no-jitter] [--report-s S] [--config-root DIR]\n", argv0);
+}
+
+static bool parse_args(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (strcmp(a, "--ack") == 0)       { o.ack = true; continue; }
+        if (strcmp(a, "--no-jitter") == 0) { o.no_jitter = true; continue; }
+        if (!v) return false;
+        if      (strcmp(a, "--plugs") == 0)       o.plugs = (uint32_t)atoi(v);
+        else if (strcmp(a, "--broker") == 0)      o.broker = v;
+        else if (strcmp(a, "--prefix") == 0)      o.prefix = v;
+        else if (strcmp(a, "--password") == 0)    o.password = v;
+        else if (strcmp(a, "--observer") == 0)    o.observer = v;
+        else if (strcmp(a, "--format") == 0)      o.format = v;
+        else if (strcmp(a, "--batch") == 0)       o.batch_samples = atoi(v);
+        else if (strcmp(a, "--interval-ms") == 0) o.interval_ms = (uint32_t)atoi(v);
+        else if (strcmp(a, "--jitter") == 0)      o.jitter = atof(v);
+        else if (strcmp(a, "--seconds") == 0)     o.seconds = atof(v);
+        else if (strcmp(a, "--ramp-s") == 0)      o.ramp_s = atof(v);
+        else if (strcmp(a, "--storm-at") == 0)    o.storm_at_s = atof(v);
+        else if (strcmp(a, "--storm-frac") == 0)  o.storm_frac = atof(v);
+        else if (strcmp(a, "--report-s") == 0)    o.report_s = atof(v);
+        else if (strcmp(a, "--load-w") == 0)      o.load_w = atof(v);
+        else if (strcmp(a, "--config-root") == 0) o.config_root = v;
+        else return false;
+        i++;
+    }
+    return o.plugs > 0 && o.interval_ms > 0 && o.seconds > 0;
+}
+
+/* === Clock (real time: the HAL's micros() is the simulator's virtual clock) === */
+static uint64_t now_us() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint32_t payload_hash(const uint8_t* p, size_t n) {
+    uint32_t h = FNV1A_BASIS;
+    for (size_t i = 0; i < n; i++) h = (h ^ p[i]) * FNV1A_PRIME;
+    return h;
+}
+
+/* === Latency samples === */
+struct Latencies {
+    std::vector<uint32_t> us;
+
+    void add(uint64_t v) { us.push_back(v > UINT32_MAX ? UINT32_MAX : (uint32_t)v); }
+    double pct(double p) {
+        if (us.empty()) return 0;
+        size_t k = std::min(us.size() - 1, (size_t)(p / 100.0 * us.size()));
+        std::nth_element(us.begin(), us.begin() + k, us.end());
+        return us[k] / 1000.0;
+    }
+    double max() const { return us.empty() ? 0 : *std::max_element(us.begin(), us.end()) / 1000.0; }
+};
+
+struct Totals {
+    uint64_t connects = 0, connect_failed = 0, drops = 0, storm_drops = 0;
+    uint64_t published = 0, publish_bytes = 0, readings = 0, publish_stalled = 0;
+    uint64_t observed = 0, acked = 0, commands = 0;
+    uint64_t unmatched = 0;        // observed / acked payloads no plug had in flight
+    uint64_t lost_broker = 0, lost_ack = 0;   // pushed out of the in-flight ring unseen
+    Latencies connect, broker, ingest;
+};
+
+static Totals g_all, g_period;
+
+/* === Plugs === */
+enum class PlugState : uint8_t { down, connecting, handshake, online };
+
+constexpr size_t INFLIGHT = 16;            // per plug; an unseen entry pushed out counts as lost
+constexpr size_t SEND_BUFFER_MAX = 16384;  // a slower broker than this: the plug's publish fails
+constexpr uint16_t KEEPALIVE_S = 15;       // PubSubClient's default
+constexpr uint64_t PING_AFTER_US = KEEPALIVE_S * 500000ull;   // half the keepalive idle
+constexpr uint64_t CONNECT_TIMEOUT_US = 10000000;
+constexpr uint32_t WINDOW_MS = 500;        // HLW8012 default measurement window
+
+struct InFlight {
+    uint32_t hash;
+    uint32_t readings;
+    uint64_t sent_us;
+    bool seen_broker;
+    bool seen_ack;
+};
+
+struct Plug {
+    uint32_t idx;
+    PlugState state = PlugState::down;
+    int fd = -1;
+    uint32_t gen = 0;               // bumps on every reschedule; stale heap entries are skipped
+    uint64_t boot_us = 0;
+    uint64_t attempt_us = 0;
+    uint64_t next_report_us = 0;
+    uint64_t last_tx_us = 0;
+    Backoff backoff = { MQTT_BACKOFF_BASE_MS, LINK_BACKOFF_CAP_MS, 0 };
+    bool was_online = false;
+    char cid[ENV_ID_SIZE];
+    char sub[ENV_TOPIC_SIZE];
+    char pub[ENV_TOPIC_SIZE];
+    std::string out;
+    size_t out_off = 0;
+    std::string in;
+    double lifetime_kwh = 0;
+    float load_w = 0;
+    uint32_t backlog = 0;           // readings taken while offline (reading_store.h)
+    uint32_t seq = 0;               // last reading's sequence number (reading_clock.h)
+    bool relay = true;
+    std::vector<DeviceReading> batch;
+    InFlight flight[INFLIGHT] = {};
+    uint32_t flight_head = 0;
+};
+
+struct Deadline {
+    uint64_t due_us;
+    uint32_t idx;
+    uint32_t gen;
+    bool operator>(const Deadline& o) const { return due_us > o.due_us; }
+};
+
+static Options g_opt;
+static std::vector<Plug> g_plugs;
+static std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> g_timers;
+static int g_epoll = -1;
+static sockaddr_storage g_addr;
+static socklen_t g_addr_len = 0;
+static std::mt19937 g_rng(1);
+static uint64_t g_start_us = 0;
+static uint64_t g_start_unix_ms = 0;   // wall clock at g_start_us, what a synced plug reads
+static uint32_t g_boot_id = 0;
+static uint32_t g_online = 0;
+
+static uint32_t plug_ms(const Plug& p, uint64_t t_us) { return (uint32_t)((t_us - p.boot_us) / 1000); }
+
+static void schedule(Plug& p, uint64_t due_us) {
+    g_timers.push({ due_us, p.idx, ++p.gen });
+}
+
+static uint64_t report_period_us() {
+    double j = g_opt.jitter > 0 ? std::uniform_real_distribution<double>(-g_opt.jitter, g_opt.jitter)(g_rng) : 0;
+    return (uint64_t)(g_opt.interval_ms * 1000.0 * (1.0 + j));
+}
+
+// One interval of the plug's load, summarised the way hardwareTask does it.
+static DeviceReading take_reading(Plug& p, uint64_t t_us) {
+    std::normal_distribution<float> noise(0.0f, p.load_w * 0.02f + 0.1f);
+    WindowStats ws;
+    window_stats_reset(ws);
+    uint32_t windows = std::max<uint32_t>(1, g_opt.interval_ms / WINDOW_MS);
+    for (uint32_t i = 0; i < windows; i++) window_stats_add(ws, std::max(0.0f, p.load_w + noise(g_rng)));
+    PowerStats stats = window_stats_summary(ws);
+
+    double kwh = stats.mean * (g_opt.interval_ms / 3600e3) / 1000.0;
+    p.lifetime_kwh += kwh;
+    return { kwh, 120, stats.mean / 120.0, stats.mean, true, plug_ms(p, t_us), stats, p.lifetime_kwh,
+             g_boot_id, ++p.seq, g_start_unix_ms + (t_us - g_start_us) / 1000 };
+}
+
+static void track(Plug& p, const uint8_t* payload, size_t len, uint32_t readings, uint64_t t_us) {
+    InFlight& f = p.flight[p.flight_head++ % INFLIGHT];
+    if (f.sent_us) {
+        if (g_opt.observer && !f.seen_broker) { g_all.lost_broker++; g_period.lost_broker++; }
+        if (g_opt.ack && !f.seen_ack) { g_all.lost_ack++; g_period.lost_ack++; }
+    }
+    f = { payload_hash(payload, len), readings, t_us, false, false };
+}
+
+static InFlight* find_in_flight(Plug& p, uint32_t hash) {
+    for (InFlight& f : p.flight)
+        if (f.sent_us && f.hash == hash) return &f;
+    return nullptr;
+}
+
+/* === Sockets === */
+static void close_plug(Plug& p, uint64_t t_us, bool storm);
+
+static bool flush(Plug& p) {
+    while (p.out_off < p.out.size()) {
+        ssize_t n = send(p.fd, p.out.data() + p.out_off, p.out.size() - p.out_off, MSG_NOSIGNAL);
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+        p.out_off += (size_t)n;
+    }
+    p.out.clear();
+    p.out_off = 0;
+    return true;
+}
+
+static bool publish(Plug& p, const uint8_t* payload, size_t len, uint32_t readings, uint64_t t_us) {
+    if (p.out.size() - p.out_off > SEND_BUFFER_MAX) {
+        g_all.publish_stalled++; g_period.publish_stalled++;
+        return false;
+    }
+    mqtt_publish(p.out, p.pub, payload, len);
+    track(p, payload, len, readings, t_us);
+    p.last_tx_us = t_us;
+    g_all.published++; g_period.published++;
+    g_all.publish_bytes += len; g_period.publish_bytes += len;
+    g_all.readings += readings; g_period.readings += readings;
+    return true;
+}
+
+static bool batching() {
+    return env.telemetry == TelemetryFormat::binary && env.batchSamples > 1;
+}
+
+// handle_reading(), for one plug: backlog first (one batch message, or one message each), then the fresh reading.
+static void report(Plug& p, uint64_t t_us) {
+    uint8_t buf[MQTT_BUFFER_SIZE];
+    DeviceReading fresh = take_reading(p, t_us);
+    if (p.state != PlugState::online) {
+        if (p.backlog < READING_STORE_SLOTS) p.backlog++;
+        return;
+    }
+
+    if (batching()) {
+        p.batch.push_back(fresh);
+        if (p.batch.size() < env.batchSamples) return;
+    }
+
+    uint32_t drain = std::min<uint32_t>(p.backlog, READING_STORE_DRAIN_BATCH);
+    if (drain) {
+        DeviceReading old[READING_STORE_DRAIN_BATCH];
+        for (uint32_t i = 0; i < drain; i++) old[i] = take_reading(p, t_us);
+        if (batching()) {
+            size_t len = encode_batch_binary(old, drain, plug_ms(p, t_us), buf, sizeof(buf));
+            if (len && publish(p, buf, len, drain, t_us)) p.backlog -= drain;
+        } else {
+            uint32_t sent = 0;
+            while (sent < drain) {
+                size_t len = encode_reading(env.telemetry, old[sent], p.cid, buf, sizeof(buf));
+                if (!len || !publish(p, buf, len, 1, t_us)) break;
+                sent++;
+            }
+            p.backlog -= sent;
+        }
+    }
+
+    bool ok;
+    if (batching()) {
+        size_t len = encode_batch_binary(p.batch.data(), p.batch.size(), plug_ms(p, t_us), buf, sizeof(buf));
+        ok = len && publish(p, buf, len, (uint32_t)p.batch.size(), t_us);
+        if (ok) p.batch.clear();
+        else { p.backlog += (uint32_t)p.batch.size(); p.batch.clear(); }
+    } else {
+        size_t len = encode_reading(env.telemetry, fresh, p.cid, buf, sizeof(buf));
+        ok = len && publish(p, buf, len, 1, t_us);
+        if (!ok && p.backlog < READING_STORE_SLOTS) p.backlog++;
+    }
+    if (!flush(p)) close_plug(p, t_us, false);
+}
+
+static void start_connect(Plug& p, uint64_t t_us) {
+    p.fd = socket(g_addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (p.fd < 0) { close_plug(p, t_us, false); return; }
+    int one = 1;
+    setsockopt(p.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    p.attempt_us = t_us;
+    p.state = PlugState::connecting;
+    int rc = connect(p.fd, (const sockaddr*)&g_addr, g_addr_len);
+    if (rc < 0 && errno != EINPROGRESS) { close_plug(p, t_us, false); return; }
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.u32 = p.idx;
+    epoll_ctl(g_epoll, EPOLL_CTL_ADD, p.fd, &ev);
+    schedule(p, t_us + CONNECT_TIMEOUT_US);
+}
+
+// Link lost or attempt failed: wait the firmware's backoff, keep metering meanwhile.
+static void close_plug(Plug& p, uint64_t t_us, bool storm) {
+    if (p.fd >= 0) {
+        epoll_ctl(g_epoll, EPOLL_CTL_DEL, p.fd, nullptr);
+        close(p.fd);
+        p.fd = -1;
+    }
+    if (p.state == PlugState::online) {
+        g_online--;
+        if (storm) { g_all.storm_drops++; g_period.storm_drops++; }
+        else { g_all.drops++; g_period.drops++; }
+    } else if (p.state != PlugState::down) {
+        g_all.connect_failed++; g_period.connect_failed++;
+    }
+    p.state = PlugState::down;
+    p.out.clear();
+    p.out_off = 0;
+    p.in.clear();
+    uint32_t wait_ms = g_opt.no_jitter ? backoff_ceiling_ms(p.backoff) : backoff_next_ms(p.backoff, (uint32_t)g_rng());
+    if (g_opt.no_jitter && p.backoff.attempt < 31) p.backoff.attempt++;
+    p.attempt_us = t_us + (uint64_t)wait_ms * 1000;
+    schedule(p, std::min(p.attempt_us, p.next_report_us));
+}
+
+static void on_connack(Plug& p, const MqttFrame& f, uint64_t t_us) {
+    if (f.len < 2 || f.body[1] != 0) { close_plug(p, t_us, false); return; }
+    p.state = PlugState::online;
+    g_online++;
+    backoff_reset(p.backoff);
+    g_all.connects++; g_period.connects++;
+    g_all.connect.add(t_us - p.attempt_us);
+    g_period.connect.add(t_us - p.attempt_us);
+    mqtt_subscribe(p.out, 1, p.sub);
+    p.last_tx_us = t_us;
+    if (!p.was_online) {
+        p.was_online = true;
+        p.next_report_us = t_us + (uint64_t)(std::uniform_real_distribution<double>(0, 1)(g_rng) * g_opt.interval_ms * 1000);
+    }
+    schedule(p, std::min(p.next_report_us, t_us + PING_AFTER_US));
+}
+
+// Applied as soon as it arrives: receipt and actuation share one timestamp.
+static void ack_command(Plug& p, const char* cmd, uint32_t ack_id, uint64_t t_us) {
+    g_all.commands++; g_period.commands++;
+    CommandId id = COMMAND_UNKNOWN;
+    DispatchResult result = command_find(cmd, id) ? DispatchResult::queued : DispatchResult::unknown;
+    if (id == CommandId::relay_on) p.relay = true;
+    else if (id == CommandId::relay_off) p.relay = false;
+    else if (id == CommandId::relay_toggle) p.relay = !p.relay;
+
+    uint32_t ms = (uint32_t)((t_us - p.boot_us) / 1000);
+    CommandAck ack = { ack_id, id, result, p.relay, ms, ms, 0 };
+    uint64_t unix_ms = g_start_unix_ms + (t_us - g_start_us) / 1000;
+    char payload[256], topic[ENV_ID_SIZE + 8];
+    size_t len = command_ack_json(ack, unix_ms, unix_ms, payload, sizeof(payload));
+    snprintf(topic, sizeof(topic), "%s/ack", p.cid);
+    if (len > 0) mqtt_publish(p.out, topic, (const uint8_t*)payload, len);
+}
+
+// A publish to "<cid>/cmd/...", as PubSubClient hands it to fn_on_message_received().
+static void on_command(Plug& p, const MqttFrame& f, uint64_t t_us) {
+    const char* topic;
+    size_t topic_len, len;
+    const uint8_t* payload;
+    if (!mqtt_publish_parse(f, topic, topic_len, payload, len)) return;
+    char name[ENV_TOPIC_SIZE + 32];
+    if (topic_len >= sizeof(name)) return;
+    memcpy(name, topic, topic_len);
+    name[topic_len] = '\0';
+    if (!val_incoming_topic(name, p.sub)) return;
+    char* cmd = name + strlen(p.sub) - 1;
+    uint32_t ack_id = command_take_ack_id(cmd);
+    if (ack_id) { ack_command(p, cmd, ack_id, t_us); return; }
+    if (strcmp(cmd, "ingested") != 0) { g_all.commands++; g_period.commands++; return; }
+
+    char hex[16];
+    size_t n = std::min(len, sizeof(hex) - 1);
+    memcpy(hex, payload, n);
+    hex[n] = '\0';
+    InFlight* fl = find_in_flight(p, (uint32_t)strtoul(hex, nullptr, 16));
+    if (!fl || fl->seen_ack) { g_all.unmatched++; g_period.unmatched++; return; }
+    fl->seen_ack = true;
+    g_all.acked++; g_period.acked++;
+    g_all.ingest.add(t_us - fl->sent_us);
+    g_period.ingest.add(t_us - fl->sent_us);
+}
+
+static void on_readable(Plug& p, uint64_t t_us) {
+    char buf[4096];
+    for (;;) {
+        ssize_t n = recv(p.fd, buf, sizeof(buf), 0);
+        if (n > 0) { p.in.append(buf, (size_t)n); continue; }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) { close_plug(p, t_us, false); return; }
+        break;
+    }
+    size_t off = 0;
+    MqttFrame f;
+    for (;;) {
+        size_t used = mqtt_frame((const uint8_t*)p.in.data() + off, p.in.size() - off, f);
+        if (used == 0) break;
+        if (used == SIZE_MAX) { close_plug(p, t_us, false); return; }
+        off += used;
+        if (f.type == MQTT_CONNACK && p.state == PlugState::handshake) on_connack(p, f, t_us);
+        else if (f.type == MQTT_PUBLISH) on_command(p, f, t_us);
+        if (p.state == PlugState::down) return;
+    }
+    p.in.erase(0, off);
+    if (!flush(p)) close_plug(p, t_us, false);
+}
+
+static void on_writable(Plug& p, uint64_t t_us) {
+    if (p.state == PlugState::connecting) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(p.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err) { close_plug(p, t_us, false); return; }
+        p.state = PlugState::handshake;
+        const char* user = p.cid;
+        mqtt_connect(p.out, p.cid, user, g_opt.password, KEEPALIVE_S);
+    }
+    if (!flush(p)) close_plug(p, t_us, false);
+}
+
+static void on_timer(Plug& p, uint64_t t_us) {
+    switch (p.state) {
+        case PlugState::down:
+            if (t_us >= p.next_report_us && p.was_online) {
+                report(p, t_us);
+                p.next_report_us += report_period_us();
+            }
+            if (t_us >= p.attempt_us) start_connect(p, t_us);
+            else schedule(p, std::min<uint64_t>(p.attempt_us, p.was_online ? p.next_report_us : UINT64_MAX));
+            break;
+        case PlugState::connecting:
+        case PlugState::handshake:
+            if (t_us >= p.next_report_us && p.was_online) {
+                report(p, t_us);
+                p.next_report_us += report_period_us();
+            }
+            if (t_us - p.attempt_us >= CONNECT_TIMEOUT_US) close_plug(p, t_us, false);
+            else schedule(p, std::min(p.attempt_us + CONNECT_TIMEOUT_US, p.next_report_us));
+            break;
+        case PlugState::online:
+            if (t_us >= p.next_report_us) {
+                report(p, t_us);
+                p.next_report_us += report_period_us();
+                if (p.state != PlugState::online) break;
+            }
+            if (t_us - p.last_tx_us >= PING_AFTER_US) {
+                mqtt_pingreq(p.out);
+                p.last_tx_us = t_us;
+                if (!flush(p)) { close_plug(p, t_us, false); break; }
+            }
+            schedule(p, std::min(p.next_report_us, p.last_tx_us + PING_AFTER_US));
+            break;
+    }
+}
+
+/* === Observer: what the ingestion client sees on "+/data" === */
+struct Observer {
+    int fd = -1;
+    std::string in;
+    bool subscribed = false;
+};
+static Observer g_obs;
+static constexpr uint32_t OBSERVER_ID = UINT32_MAX;
+
+static bool observer_start(const char* spec) {
+    const char* colon = strchr(spec, ':');
+    if (!colon) return false;
+    std::string user(spec, colon), pass(colon + 1);
+    g_obs.fd = socket(g_addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (g_obs.fd < 0 || connect(g_obs.fd, (const sockaddr*)&g_addr, g_addr_len) != 0) return false;
+    int one = 1;
+    setsockopt(g_obs.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    std::string out;
+    mqtt_connect(out, "fleet_observer", user.c_str(), pass.c_str(), 60);
+    mqtt_subscribe(out, 1, "+/data");
+    if (send(g_obs.fd, out.data(), out.size(), MSG_NOSIGNAL) != (ssize_t)out.size()) return false;
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u32 = OBSERVER_ID;
+    return epoll_ctl(g_epoll, EPOLL_CTL_ADD, g_obs.fd, &ev) == 0;
+}
+
+static void observer_publish(const MqttFrame& f, uint64_t t_us) {
+    const char* topic;
+    size_t topic_len, len;
+    const uint8_t* payload;
+    if (!mqtt_publish_parse(f, topic, topic_len, payload, len)) return;
+    size_t plen = strlen(g_opt.prefix);
+    if (topic_len <= plen || strncmp(topic, g_opt.prefix, plen) != 0) return;   // a real plug
+    uint32_t idx = (uint32_t)strtoul(std::string(topic + plen, topic_len - plen).c_str(), nullptr, 10) - 1;
+    if (idx >= g_plugs.size()) return;
+    InFlight* fl = find_in_flight(g_plugs[idx], payload_hash(payload, len));
+    if (!fl || fl->seen_broker) { g_all.unmatched++; g_period.unmatched++; return; }
+    fl->seen_broker = true;
+    g_all.observed++; g_period.observed++;
+    g_all.broker.add(t_us - fl->sent_us);
+    g_period.broker.add(t_us - fl->sent_us);
+}
+
+static void observer_readable(uint64_t t_us) {
+    char buf[65536];
+    ssize_t n = recv(g_obs.fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n <= 0) {
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            fprintf(stderr, "observer: connection closed\n");
+            epoll_ctl(g_epoll, EPOLL_CTL_DEL, g_obs.fd, nullptr);
+            close(g_obs.fd);
+            g_obs.fd = -1;
+        }
+        return;
+    }
+    g_obs.in.append(buf, (size_t)n);
+    size_t off = 0;
+    MqttFrame f;
+    for (;;) {
+        size_t used = mqtt_frame((const uint8_t*)g_obs.in.data() + off, g_obs.in.size() - off, f);
+        if (used == 0 || used == SIZE_MAX) break;
+        off += used;
+        if (f.type == MQTT_PUBLISH) observer_publish(f, t_us);
+    }
+    g_obs.in.erase(0, off);
+}
+
+/* === Setup === */
+static bool resolve(const char* spec) {
+    std::string host(spec);
+    std::string port = "1883";
+    size_t colon = host.rfind(':');
+    if (colon != std::string::npos) { port = host.substr(colon + 1); host.resize(colon); }
+    addrinfo hints = {}, *res = nullptr;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0 || !res) return false;
+    memcpy(&g_addr, res->ai_addr, res->ai_addrlen);
+    g_addr_len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return true;
+}
+
+static void raise_fd_limit(uint32_t need) {
+    rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) return;
+    if (rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    if (rl.rlim_cur < need + 16)
+        fprintf(stderr, "warning: fd limit %llu is below %u plugs; raise ulimit -n\n",
+                (unsigned long long)rl.rlim_cur, need);
+}
+
+static void load_template(const Options& o) {
+    hal_set_fs_root(o.config_root);
+    SPIFFS.begin(true);
+    env = ensureEnvInNVS();
+    if (o.format) env.telemetry = parse_telemetry_format(o.format);
+    if (o.batch_samples >= 0) env.batchSamples = (uint8_t)std::min(o.batch_samples, REPORT_BATCH_CAPACITY);
+    if (!g_opt.password) g_opt.password = env.ok && env.cpass[0] ? env.cpass : "loadtest";
+    if (!g_opt.broker) g_opt.broker = env.ok && env.mqtt[0] ? env.mqtt : "127.0.0.1";
+}
+
+/* === Output === */
+static void print_latency(const char* name, Latencies& l) {
+    if (l.us.empty()) { printf("%-10s -\n", name); return; }
+    printf("%-10s %8zu samples  p50 %8.2f  p90 %8.2f  p99 %8.2f  p99.9 %8.2f  max %8.2f ms\n", name, l.us.size(),
+           l.pct(50), l.pct(90), l.pct(99), l.pct(99.9), l.max());
+}
+
+static void print_period(double t_s, double dt_s) {
+    Totals& p = g_period;
+    printf("%7.1f s  %6u online  %8.0f msg/s %8.0f readings/s %7.0f kB/s  connects %5llu  drops %5llu",
+           t_s, g_online, p.published / dt_s, p.readings / dt_s, p.publish_bytes / dt_s / 1e3,
+           (unsigned long long)p.connects, (unsigned long long)(p.drops + p.storm_drops));
+    if (g_opt.observer) printf("  broker p50 %.1f p99 %.1f ms", p.broker.pct(50), p.broker.pct(99));
+    if (g_opt.ack) printf("  ingest p50 %.1f p99 %.1f ms", p.ingest.pct(50), p.ingest.pct(99));
+    printf("\n");
+    fflush(stdout);
+    g_period = Totals();
+}
+
+int main(int argc, char** argv) {
+    if (!parse_args(argc, argv, g_opt)) { usage(argv[0]); return 2; }
+    load_template(g_opt);
+    if (!resolve(g_opt.broker)) { fprintf(stderr, "can't resolve broker %s\n", g_opt.broker); return 1; }
+    raise_fd_limit(g_opt.plugs + 1);
+
+    g_epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (g_opt.observer && !observer_start(g_opt.observer)) {
+        fprintf(stderr, "observer: can't connect to %s\n", g_opt.broker);
+        return 1;
+    }
+
+    printf("fleet       %u plugs \"%s000001\".. -> %s, %s%s, report every %u ms +-%.0f%%, %.0f s\n",
+           g_opt.plugs, g_opt.prefix, g_opt.broker, telemetry_format_name(env.telemetry),
+           batching() ? (" batch " + std::to_string(env.batchSamples)).c_str() : "", g_opt.interval_ms,
+           g_opt.jitter * 100, g_opt.seconds);
+
+    g_start_us = now_us();
+    timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    g_start_unix_ms = (uint64_t)wall.tv_sec * 1000 + wall.tv_nsec / 1000000;
+    g_boot_id = (uint32_t)wall.tv_sec;
+    std::lognormal_distribution<float> load(logf((float)g_opt.load_w), 0.6f);
+    g_plugs.resize(g_opt.plugs);
+    for (uint32_t i = 0; i < g_opt.plugs; i++) {
+        Plug& p = g_plugs[i];
+        p.idx = i;
+        snprintf(p.cid, sizeof(p.cid), "%s%06u", g_opt.prefix, i + 1);
+        snprintf(p.sub, sizeof(p.sub), "%s/cmd/#", p.cid);
+        snprintf(p.pub, sizeof(p.pub), "%s/data", p.cid);
+        p.load_w = load(g_rng);
+        p.boot_us = g_start_us + (uint64_t)(g_opt.ramp_s * 1e6 * i / g_opt.plugs);
+        p.attempt_us = p.boot_us;
+        p.next_report_us = UINT64_MAX;
+        schedule(p, p.boot_us);
+    }
+
+    uint64_t end_us = g_start_us + (uint64_t)(g_opt.seconds * 1e6);
+    uint64_t storm_us = g_opt.storm_at_s >= 0 ? g_start_us + (uint64_t)(g_opt.storm_at_s * 1e6) : UINT64_MAX;
+    uint64_t period_us = (uint64_t)(g_opt.report_s * 1e6);
+    uint64_t next_print_us = g_start_us + period_us, last_print_us = g_start_us;
+    std::vector<epoll_event> events(4096);
+
+    for (;;) {
+        uint64_t t = now_us();
+        if (t >= end_us) break;
+
+        while (!g_timers.empty() && g_timers.top().due_us <= t) {
+            Deadline d = g_timers.top();
+            g_timers.pop();
+            Plug& p = g_plugs[d.idx];
+            if (d.gen == p.gen) on_timer(p, t);
+        }
+        if (t >= storm_us) {
+            uint32_t dropped = 0;
+            std::uniform_real_distribution<double> pick(0, 1);
+            for (Plug& p : g_plugs)
+                if (p.state == PlugState::online && pick(g_rng) < g_opt.storm_frac) { close_plug(p, t, true); dropped++; }
+            printf("storm       dropped %u connections at %.1f s\n", dropped, (t - g_start_us) / 1e6);
+            storm_us = UINT64_MAX;
+        }
+        if (t >= next_print_us) {
+            print_period((t - g_start_us) / 1e6, (t - last_print_us) / 1e6);
+            last_print_us = t;
+            next_print_us += period_us;
+        }
+
+        uint64_t next = std::min({ end_us, next_print_us, storm_us,
+                                   g_timers.empty() ? UINT64_MAX : g_timers.top().due_us });
+        int timeout_ms = next > t ? (int)std::min<uint64_t>((next - t + 999) / 1000, 100) : 0;
+        int n = epoll_wait(g_epoll, events.data(), (int)events.size(), timeout_ms);
+        t = now_us();
+        for (int i = 0; i < n; i++) {
+            uint32_t id = events[i].data.u32;
+            if (id == OBSERVER_ID) { observer_readable(t); continue; }
+            Plug& p = g_plugs[id];
+            if (p.fd < 0) continue;
+            uint32_t ev = events[i].events;
+            if (ev & (EPOLLERR | EPOLLHUP)) { close_plug(p, t, false); continue; }
+            if (ev & EPOLLOUT) on_writable(p, t);
+            if (p.fd >= 0 && (ev & (EPOLLIN | EPOLLRDHUP))) on_readable(p, t);
+        }
+    }
+
+    // Whatever is still in flight at the end had no time to arrive: not counted as lost.
+    uint64_t pending_broker = 0, pending_ack = 0, backlog = 0;
+    for (Plug& p : g_plugs) {
+        backlog += p.backlog;
+        for (const InFlight& f : p.flight) {
+            if (!f.sent_us) continue;
+            if (!f.seen_broker) pending_broker++;
+            if (!f.seen_ack) pending_ack++;
+        }
+        if (p.fd >= 0) {
+            mqtt_disconnect(p.out);
+            flush(p);
+            close(p.fd);
+        }
+    }
+
+    double run_s = (now_us() - g_start_us) / 1e6;
+    Totals& a = g_all;
+    printf("\nsummary     %.1f s, %u plugs, %u online at the end\n", run_s, g_opt.plugs, g_online);
+    printf("published   %llu messages (%.0f/s), %llu readings (%.0f/s), %.1f MB; %llu refused on a full send buffer\n",
+           (unsigned long long)a.published, a.published / run_s, (unsigned long long)a.readings, a.readings / run_s,
+           a.publish_bytes / 1e6, (unsigned long long)a.publish_stalled);
+    printf("links       %llu connects, %llu failed attempts, %llu drops, %llu storm drops; %llu readings still stored\n",
+           (unsigned long long)a.connects, (unsigned long long)a.connect_failed, (unsigned long long)a.drops,
+           (unsigned long long)a.storm_drops, (unsigned long long)backlog);
+    print_latency("connect", a.connect);
+    if (g_opt.observer) {
+        printf("broker      %llu of %llu seen by the observer, %llu lost, %llu still in flight\n",
+               (unsigned long long)a.observed, (unsigned long long)a.published, (unsigned long long)a.lost_broker,
+               (unsigned long long)pending_broker);
+        print_latency("broker", a.broker);
+    }
+    if (g_opt.ack) {
+        printf("ingest      %llu of %llu acknowledged, %llu lost, %llu still in flight\n",
+               (unsigned long long)a.acked, (unsigned long long)a.published, (unsigned long long)a.lost_ack,
+               (unsigned long long)pending_ack);
+        print_latency("ingest", a.ingest);
+    }
+    if (a.unmatched || a.commands)
+        printf("other       %llu unmatched observations/acks, %llu other commands received\n",
+               (unsigned long long)a.unmatched, (unsigned long long)a.commands);
+    return 0;
+}
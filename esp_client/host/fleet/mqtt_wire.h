@@ -0,0 +1,116 @@
+#pragma once
+// MQTT 3.1.1 framing for the fleet simulator: only the packets a plug (and the
+// observer) exchange with the broker, QoS 0 publishes like PubSubClient's default.
+// Encoders append to a std::string send buffer; mqtt_frame() cuts one packet off
+// the front of a receive buffer.
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+enum MqttType : uint8_t {
+    MQTT_CONNECT = 1, MQTT_CONNACK = 2, MQTT_PUBLISH = 3, MQTT_PUBACK = 4,
+    MQTT_SUBSCRIBE = 8, MQTT_SUBACK = 9, MQTT_PINGREQ = 12, MQTT_PINGRESP = 13, MQTT_DISCONNECT = 14
+};
+
+struct MqttFrame {
+    uint8_t type;
+    uint8_t flags;          // low nibble of the fixed header
+    const uint8_t* body;    // variable header + payload
+    size_t len;
+};
+
+inline void mqtt_put_length(std::string& out, size_t len) {
+    do {
+        uint8_t b = len & 0x7f;
+        len >>= 7;
+        out.push_back((char)(len ? b | 0x80 : b));
+    } while (len);
+}
+
+inline void mqtt_put_u16(std::string& out, uint16_t v) {
+    out.push_back((char)(v >> 8));
+    out.push_back((char)(v & 0xff));
+}
+
+inline void mqtt_put_str(std::string& out, const char* s, size_t n) {
+    mqtt_put_u16(out, (uint16_t)n);
+    out.append(s, n);
+}
+
+inline void mqtt_connect(std::string& out, const char* client_id, const char* user, const char* pass,
+                         uint16_t keepalive_s) {
+    size_t id = strlen(client_id), u = user ? strlen(user) : 0, p = pass ? strlen(pass) : 0;
+    size_t len = 10 + 2 + id + (user ? 2 + u : 0) + (pass ? 2 + p : 0);
+    uint8_t flags = 0x02;                 // clean session
+    if (user) flags |= 0x80;
+    if (pass) flags |= 0x40;
+    out.push_back((char)(MQTT_CONNECT << 4));
+    mqtt_put_length(out, len);
+    mqtt_put_str(out, "MQTT", 4);
+    out.push_back(4);                     // protocol level 3.1.1
+    out.push_back((char)flags);
+    mqtt_put_u16(out, keepalive_s);
+    mqtt_put_str(out, client_id, id);
+    if (user) mqtt_put_str(out, user, u);
+    if (pass) mqtt_put_str(out, pass, p);
+}
+
+inline void mqtt_subscribe(std::string& out, uint16_t packet_id, const char* filter) {
+    size_t n = strlen(filter);
+    out.push_back((char)(MQTT_SUBSCRIBE << 4 | 0x02));
+    mqtt_put_length(out, 2 + 2 + n + 1);
+    mqtt_put_u16(out, packet_id);
+    mqtt_put_str(out, filter, n);
+    out.push_back(0);                     // QoS 0
+}
+
+inline void mqtt_publish(std::string& out, const char* topic, const uint8_t* payload, size_t len) {
+    size_t n = strlen(topic);
+    out.push_back((char)(MQTT_PUBLISH << 4));
+    mqtt_put_length(out, 2 + n + len);
+    mqtt_put_str(out, topic, n);
+    out.append((const char*)payload, len);
+}
+
+inline void mqtt_pingreq(std::string& out) {
+    out.push_back((char)(MQTT_PINGREQ << 4));
+    out.push_back(0);
+}
+
+inline void mqtt_disconnect(std::string& out) {
+    out.push_back((char)(MQTT_DISCONNECT << 4));
+    out.push_back(0);
+}
+
+// One packet from the front of buf: its size, 0 if incomplete, SIZE_MAX if malformed.
+inline size_t mqtt_frame(const uint8_t* buf, size_t n, MqttFrame& f) {
+    if (n < 2) return 0;
+    size_t len = 0, i = 1;
+    for (int shift = 0; ; shift += 7, i++) {
+        if (i >= n) return 0;
+        if (shift > 21) return SIZE_MAX;
+        len |= (size_t)(buf[i] & 0x7f) << shift;
+        if (!(buf[i] & 0x80)) break;
+    }
+    i++;
+    if (n - i < len) return 0;
+    f.type = buf[0] >> 4;
+    f.flags = buf[0] & 0x0f;
+    f.body = buf + i;
+    f.len = len;
+    return i + len;
+}
+
+// Topic and payload of a PUBLISH frame (QoS 0 or 1).
+inline bool mqtt_publish_parse(const MqttFrame& f, const char*& topic, size_t& topic_len,
+                               const uint8_t*& payload, size_t& payload_len) {
+    if (f.len < 2) return false;
+    topic_len = (size_t)f.body[0] << 8 | f.body[1];
+    size_t off = 2 + topic_len + ((f.flags & 0x06) ? 2 : 0);   // packet id above QoS 0
+    if (off > f.len) return false;
+    topic = (const char*)f.body + 2;
+    payload = f.body + off;
+    payload_len = f.len - off;
+    return true;
+}
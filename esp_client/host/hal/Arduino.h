@@ -0,0 +1,190 @@
+#pragma once
+// Host (Linux) stand-in for the Arduino-ESP32 core.
+// Only what the firmware in ../../src actually uses is provided here.
+// Time is virtual: it only moves when the simulator (or vTaskDelay/delay) advances it.
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <strings.h>
+#include <string>
+#include <algorithm>
+#include <functional>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR   // plain static storage: it survives a simulated reboot, as RTC .noinit does
+#define F(str) (str)
+
+/* === String === */
+class String {
+public:
+    String() {}
+    String(const char* s) : s_(s ? s : "") {}
+    String(const std::string& s) : s_(s) {}
+    String(char c) : s_(1, c) {}
+    explicit String(int v) : s_(std::to_string(v)) {}
+    explicit String(unsigned int v) : s_(std::to_string(v)) {}
+    explicit String(long v) : s_(std::to_string(v)) {}
+    explicit String(unsigned long v) : s_(std::to_string(v)) {}
+
+    const char* c_str() const { return s_.c_str(); }
+    unsigned int length() const { return (unsigned int)s_.size(); }
+    bool isEmpty() const { return s_.empty(); }
+    char operator[](unsigned int i) const { return i < s_.size() ? s_[i] : 0; }
+
+    void trim() {
+        size_t b = s_.find_first_not_of(" \t\r\n");
+        size_t e = s_.find_last_not_of(" \t\r\n");
+        s_ = (b == std::string::npos) ? std::string() : s_.substr(b, e - b + 1);
+    }
+    void toUpperCase() { for (auto &c : s_) c = (char)toupper((unsigned char)c); }
+    void toLowerCase() { for (auto &c : s_) c = (char)tolower((unsigned char)c); }
+    bool startsWith(const String& p) const { return s_.compare(0, p.s_.size(), p.s_) == 0; }
+    bool endsWith(const String& p) const {
+        return s_.size() >= p.s_.size() && s_.compare(s_.size() - p.s_.size(), p.s_.size(), p.s_) == 0;
+    }
+    int indexOf(char c, unsigned int from = 0) const {
+        size_t i = s_.find(c, from);
+        return i == std::string::npos ? -1 : (int)i;
+    }
+    String substring(unsigned int from) const { return from >= s_.size() ? String() : String(s_.substr(from)); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from >= s_.size() || to <= from) return String();
+        return String(s_.substr(from, to - from));
+    }
+    long toInt() const { return strtol(s_.c_str(), nullptr, 10); }
+    float toFloat() const { return strtof(s_.c_str(), nullptr); }
+
+    String& operator+=(const String& o) { s_ += o.s_; return *this; }
+    String& operator+=(const char* o) { s_ += o; return *this; }
+    String& operator+=(char c) { s_ += c; return *this; }
+    friend String operator+(String a, const String& b) { a += b; return a; }
+
+    bool operator==(const String& o) const { return s_ == o.s_; }
+    bool operator==(const char* o) const { return s_ == (o ? o : ""); }
+    bool operator!=(const String& o) const { return s_ != o.s_; }
+    bool operator!=(const char* o) const { return !(*this == o); }
+
+    const std::string& str() const { return s_; }
+
+private:
+    std::string s_;
+};
+
+/* === Serial === */
+class HardwareSerial {
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    int available();
+    int read();
+    String readStringUntil(char terminator);
+    // Called from hal_serial_feed(), standing in for the UART event task.
+    void onReceive(std::function<void(void)> cb, bool onlyOnTimeout = false) { (void)onlyOnTimeout; on_receive_ = cb; }
+    const std::function<void(void)>& on_receive() const { return on_receive_; }
+
+    size_t print(const char* s);
+    size_t print(const String& s) { return print(s.c_str()); }
+    size_t print(char c);
+    size_t print(int v);
+    size_t print(unsigned int v);
+    size_t print(long v);
+    size_t print(unsigned long v);
+    size_t print(double v, int digits = 2);
+
+    size_t println() { return print("\n"); }
+    template <typename T> size_t println(const T& v) { size_t n = print(v); return n + println(); }
+    size_t println(double v, int digits) { size_t n = print(v, digits); return n + println(); }
+
+private:
+    std::function<void(void)> on_receive_;
+};
+extern HardwareSerial Serial;
+
+/* === GPIO / interrupts === */
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+typedef enum { ADC_0db, ADC_2_5db, ADC_6db, ADC_11db } adc_attenuation_t;
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+void analogReadResolution(uint8_t bits);
+void analogSetPinAttenuation(uint8_t pin, adc_attenuation_t attenuation);
+
+#define digitalPinToInterrupt(p) (p)
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t pin);
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+/* === Time (virtual, 32-bit like the ESP32 core so wraparound behaves the same) === */
+unsigned long micros();
+unsigned long millis();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+/* === SNTP (esp32-hal-time.c); see esp_sntp.h === */
+void configTime(long gmtOffset_sec, int daylightOffset_sec, const char* server1,
+                const char* server2 = nullptr, const char* server3 = nullptr);
+
+/* === Misc === */
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+uint32_t esp_random();
+
+/* === Reset reason (esp_system.h) === */
+typedef enum {
+    ESP_RST_UNKNOWN, ESP_RST_POWERON, ESP_RST_EXT, ESP_RST_SW, ESP_RST_PANIC, ESP_RST_INT_WDT,
+    ESP_RST_TASK_WDT, ESP_RST_WDT, ESP_RST_DEEPSLEEP, ESP_RST_BROWNOUT, ESP_RST_SDIO
+} esp_reset_reason_t;
+esp_reset_reason_t esp_reset_reason();   // hal_set_reset_reason(), default ESP_RST_POWERON
+
+/* === Heap (Esp.h); the host has no ESP32 heap, so every figure is 0 === */
+class EspClass {
+public:
+    uint32_t getFreeHeap() { return 0; }
+    uint32_t getMinFreeHeap() { return 0; }
+    uint32_t getMaxAllocHeap() { return 0; }
+};
+extern EspClass ESP;
+
+/* === FreeRTOS (single-threaded on the host) === */
+typedef uint32_t TickType_t;
+typedef void* TaskHandle_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+#define portTICK_PERIOD_MS 1
+#define pdPASS 1
+void vTaskDelay(TickType_t ticks);
+#define portMAX_DELAY 0xffffffffUL
+#define pdTRUE 1
+#define pdFALSE 0
+#define portYIELD_FROM_ISR(x) ((void)(x))
+typedef enum { eNoAction, eSetBits, eIncrement, eSetValueWithOverwrite, eSetValueWithoutOverwrite } eNotifyAction;
+
+// The host has one task context. Give/Take (the publish queue's consumer wakeup)
+// never block: the simulator services the consumer side itself. The bit-style
+// notifications are real: xTaskNotifyWait() sleeps on the virtual clock, firing
+// esp_timer callbacks and handing the gaps to the simulator's idle hook.
+TaskHandle_t xTaskGetCurrentTaskHandle();
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks);
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t* higher_prio_woken);
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t ticks);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);   // 0: no real stacks on the host
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void*), const char* name, uint32_t stack, void* param,
+                                   unsigned int prio, TaskHandle_t* handle, int core);
@@ -0,0 +1,51 @@
+#pragma once
+// Host stand-in for the ESP32 FS/SPIFFS API, backed by a directory on disk
+// (by default ./data, the same folder `pio run --target uploadfs` flashes).
+#include "Arduino.h"
+#include <stdio.h>
+#include <memory>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File {
+public:
+    File() {}
+    explicit File(FILE* fp) : fp_(fp, fclose) {}
+
+    explicit operator bool() const { return fp_ != nullptr; }
+    int available();
+    int read();
+    size_t read(uint8_t* buf, size_t size);
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t size);
+    String readStringUntil(char terminator);
+    bool seek(uint32_t pos, SeekMode mode = SeekSet);
+    size_t position() const;
+    size_t size() const;
+    void flush();
+    void close();
+
+private:
+    std::shared_ptr<FILE> fp_;
+};
+
+class FS {
+public:
+    bool begin(bool formatOnFail = false);
+    File open(const char* path, const char* mode = FILE_READ, bool create = false);
+    File open(const String& path, const char* mode = FILE_READ, bool create = false) { return open(path.c_str(), mode, create); }
+    bool exists(const char* path);
+    bool remove(const char* path);
+    bool rename(const char* from, const char* to);
+};
+
+}
+
+using fs::File;
+using fs::FS;
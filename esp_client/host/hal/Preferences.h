@@ -0,0 +1,39 @@
+#pragma once
+// Host stand-in for the ESP32 Preferences (NVS) library. Namespaces live in
+// memory for the lifetime of the process; every committed write is counted
+// so wear can be measured (hal_nvs_write_count()).
+#include "Arduino.h"
+
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false, const char* partition_label = nullptr);
+    void end();
+
+    bool clear();
+    bool remove(const char* key);
+    bool isKey(const char* key);
+
+    size_t putString(const char* key, const char* value);
+    size_t putString(const char* key, const String& value) { return putString(key, value.c_str()); }
+    String getString(const char* key, const String& defaultValue = String());
+
+    size_t putBytes(const char* key, const void* value, size_t len);
+    size_t getBytesLength(const char* key);
+    size_t getBytes(const char* key, void* buf, size_t maxLen);
+
+    size_t putUInt(const char* key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0) { return get_scalar(key, defaultValue); }
+    size_t putULong64(const char* key, uint64_t value) { return putBytes(key, &value, sizeof(value)); }
+    uint64_t getULong64(const char* key, uint64_t defaultValue = 0) { return get_scalar(key, defaultValue); }
+    size_t putFloat(const char* key, float value) { return putBytes(key, &value, sizeof(value)); }
+    float getFloat(const char* key, float defaultValue = 0.0f) { return get_scalar(key, defaultValue); }
+
+private:
+    template <typename T> T get_scalar(const char* key, T def) {
+        T v;
+        return getBytes(key, &v, sizeof(v)) == sizeof(v) ? v : def;
+    }
+    String ns_;
+    bool open_ = false;
+    bool read_only_ = true;
+};
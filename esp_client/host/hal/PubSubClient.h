@@ -0,0 +1,49 @@
+#pragma once
+// Host stand-in for knolleary/PubSubClient. The overload set mirrors the real
+// library so calls resolve to the same overloads they do on the device.
+// Publishes are handed to the simulator (see host_hal.h) instead of a socket.
+#include "Arduino.h"
+#include "WiFi.h"
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+
+#define MQTT_CALLBACK_SIGNATURE void (*callback)(char*, uint8_t*, unsigned int)
+
+class PubSubClient {
+public:
+    PubSubClient() {}
+    explicit PubSubClient(Client& client) { (void)client; }
+
+    PubSubClient& setServer(const char* domain, uint16_t port) { (void)domain; (void)port; return *this; }
+    PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE) { callback_ = callback; return *this; }
+    bool setBufferSize(uint16_t size) { buffer_size_ = size; return true; }
+    uint16_t getBufferSize() { return buffer_size_; }
+
+    boolean connect(const char* id, const char* user, const char* pass);
+    void disconnect();
+    boolean connected();
+    int state() { return state_; }
+    boolean loop();
+
+    boolean publish(const char* topic, const char* payload);
+    boolean publish(const char* topic, const char* payload, boolean retained);
+    boolean publish(const char* topic, const uint8_t* payload, unsigned int plength);
+    boolean publish(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained);
+
+    boolean subscribe(const char* topic) { (void)topic; return connected(); }
+    boolean subscribe(const char* topic, uint8_t qos) { (void)qos; return subscribe(topic); }
+
+    // Simulator entry point: deliver an inbound message as the broker would.
+    void deliver(char* topic, uint8_t* payload, unsigned int length) {
+        if (callback_) callback_(topic, payload, length);
+    }
+
+private:
+    void (*callback_)(char*, uint8_t*, unsigned int) = nullptr;
+    uint16_t buffer_size_ = 256;
+    int state_ = MQTT_DISCONNECTED;
+};
@@ -0,0 +1,7 @@
+#pragma once
+#include "FS.h"
+
+namespace fs {
+class SPIFFSFS : public FS {};
+}
+extern fs::SPIFFSFS SPIFFS;
@@ -0,0 +1,50 @@
+#pragma once
+// Host stand-in for the ESP32 WiFi library. By default association is instant;
+// hal_set_wifi_timing() models scan / association / DHCP time on the virtual
+// clock, and hal_set_wifi_ap() the AP a cached BSSID/channel has to match.
+// hal_set_wifi_up(false) takes the link down and drops the association.
+#include "Arduino.h"
+
+typedef enum {
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_CONNECTION_LOST = 5,
+    WL_DISCONNECTED = 6
+} wl_status_t;
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 } wifi_mode_t;
+
+class IPAddress {
+public:
+    IPAddress() {}
+    IPAddress(uint32_t addr) : addr_(addr) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : addr_(a | b << 8 | c << 16 | (uint32_t)d << 24) {}
+    operator uint32_t() const { return addr_; }
+private:
+    uint32_t addr_ = 0;
+};
+
+class WiFiClass {
+public:
+    wl_status_t begin(const char* ssid, const char* passphrase = nullptr, int32_t channel = 0,
+                      const uint8_t* bssid = nullptr, bool connect = true);
+    bool config(IPAddress local_ip, IPAddress gateway, IPAddress subnet, IPAddress dns1 = (uint32_t)0);
+    wl_status_t status();
+    bool disconnect(bool wifioff = false);
+    bool mode(wifi_mode_t m) { (void)m; return true; }
+    void persistent(bool persistent) { (void)persistent; }
+    bool setAutoReconnect(bool autoReconnect) { (void)autoReconnect; return true; }
+
+    uint8_t* BSSID();
+    int32_t channel();
+    IPAddress localIP();
+    IPAddress gatewayIP();
+    IPAddress subnetMask();
+    IPAddress dnsIP(uint8_t dns_no = 0);
+};
+extern WiFiClass WiFi;
+
+class Client {};
+class WiFiClient : public Client {};
@@ -0,0 +1,14 @@
+#pragma once
+// Host stand-in for the ESP-IDF 4.4 legacy ADC driver: only the ADC1 setup the
+// CT sampler does before handing the ADC to I2S.
+#include "../esp_err.h"
+#include "../hal/adc_types.h"
+
+typedef enum {
+    ADC1_CHANNEL_0, ADC1_CHANNEL_1, ADC1_CHANNEL_2, ADC1_CHANNEL_3,
+    ADC1_CHANNEL_4, ADC1_CHANNEL_5, ADC1_CHANNEL_6, ADC1_CHANNEL_7, ADC1_CHANNEL_MAX
+} adc1_channel_t;
+typedef enum { ADC_WIDTH_BIT_9, ADC_WIDTH_BIT_10, ADC_WIDTH_BIT_11, ADC_WIDTH_BIT_12 } adc_bits_width_t;
+
+esp_err_t adc1_config_width(adc_bits_width_t width);
+esp_err_t adc1_config_channel_atten(adc1_channel_t channel, adc_atten_t atten);
@@ -0,0 +1,37 @@
+#pragma once
+// Host stand-in for the ESP-IDF 4.4 legacy I2S driver in built-in ADC mode.
+// "DMA" runs on the virtual clock: i2s_read() returns the samples that would
+// have been captured since the last read, taken from hal_set_ct_adc_source(),
+// and drops the oldest if more than the DMA ring holds (like an overrun).
+#include "../Arduino.h"
+#include "../esp_err.h"
+#include "adc.h"
+
+typedef enum { I2S_NUM_0, I2S_NUM_1 } i2s_port_t;
+typedef enum {
+    I2S_MODE_MASTER = 1, I2S_MODE_SLAVE = 2, I2S_MODE_TX = 4, I2S_MODE_RX = 8,
+    I2S_MODE_DAC_BUILT_IN = 16, I2S_MODE_ADC_BUILT_IN = 32
+} i2s_mode_t;
+typedef enum { I2S_BITS_PER_SAMPLE_8BIT = 8, I2S_BITS_PER_SAMPLE_16BIT = 16, I2S_BITS_PER_SAMPLE_32BIT = 32 } i2s_bits_per_sample_t;
+typedef enum { I2S_CHANNEL_FMT_RIGHT_LEFT, I2S_CHANNEL_FMT_ALL_RIGHT, I2S_CHANNEL_FMT_ALL_LEFT,
+               I2S_CHANNEL_FMT_ONLY_RIGHT, I2S_CHANNEL_FMT_ONLY_LEFT } i2s_channel_fmt_t;
+typedef enum { I2S_COMM_FORMAT_STAND_I2S = 1, I2S_COMM_FORMAT_STAND_MSB = 2 } i2s_comm_format_t;
+
+typedef struct {
+    i2s_mode_t mode;
+    uint32_t sample_rate;
+    i2s_bits_per_sample_t bits_per_sample;
+    i2s_channel_fmt_t channel_format;
+    i2s_comm_format_t communication_format;
+    int intr_alloc_flags;
+    int dma_buf_count;
+    int dma_buf_len;
+    bool use_apll;
+    bool tx_desc_auto_clear;
+    int fixed_mclk;
+} i2s_config_t;
+
+esp_err_t i2s_driver_install(i2s_port_t port, const i2s_config_t* config, int queue_size, void* queue);
+esp_err_t i2s_set_adc_mode(adc_unit_t unit, adc1_channel_t channel);
+esp_err_t i2s_adc_enable(i2s_port_t port);
+esp_err_t i2s_read(i2s_port_t port, void* dest, size_t size, size_t* bytes_read, TickType_t ticks_to_wait);
@@ -0,0 +1,49 @@
+#pragma once
+// Host stand-in for the ESP-IDF 5 ADC continuous-mode driver (esp_adc), ESP32
+// flavour: TYPE1 output, 2 bytes per conversion. It shares the virtual-clock
+// "DMA" of the legacy I2S stub: adc_continuous_read() returns the conversions
+// since the last read from hal_set_ct_adc_source(), and drops the oldest if
+// more than the pool holds (like an overrun).
+#include "../Arduino.h"
+#include "../esp_err.h"
+#include "../hal/adc_types.h"
+
+typedef struct adc_continuous_ctx_t* adc_continuous_handle_t;
+
+typedef enum { ADC_CONV_SINGLE_UNIT_1 = 1, ADC_CONV_SINGLE_UNIT_2, ADC_CONV_BOTH_UNIT, ADC_CONV_ALTER_UNIT } adc_digi_convert_mode_t;
+typedef enum { ADC_DIGI_OUTPUT_FORMAT_TYPE1, ADC_DIGI_OUTPUT_FORMAT_TYPE2 } adc_digi_output_format_t;
+
+typedef struct {
+    uint32_t max_store_buf_size;
+    uint32_t conv_frame_size;
+    struct { uint32_t flush_pool : 1; } flags;
+} adc_continuous_handle_cfg_t;
+
+typedef struct {
+    uint8_t atten;
+    uint8_t channel;
+    uint8_t unit;
+    uint8_t bit_width;
+} adc_digi_pattern_config_t;
+
+typedef struct {
+    uint32_t pattern_num;
+    adc_digi_pattern_config_t* adc_pattern;
+    uint32_t sample_freq_hz;
+    adc_digi_convert_mode_t conv_mode;
+    adc_digi_output_format_t format;
+} adc_continuous_config_t;
+
+typedef struct {
+    union {
+        struct { uint16_t data : 12; uint16_t channel : 4; } type1;
+        struct { uint16_t data : 11; uint16_t channel : 4; uint16_t unit : 1; } type2;
+        uint16_t val;
+    };
+} adc_digi_output_data_t;
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t* cfg, adc_continuous_handle_t* ret_handle);
+esp_err_t adc_continuous_config(adc_continuous_handle_t handle, const adc_continuous_config_t* config);
+esp_err_t adc_continuous_start(adc_continuous_handle_t handle);
+esp_err_t adc_continuous_read(adc_continuous_handle_t handle, uint8_t* buf, uint32_t length_max, uint32_t* out_length, uint32_t timeout_ms);
+esp_err_t adc_continuous_io_to_channel(int io_num, adc_unit_t* unit_id, adc_channel_t* channel);
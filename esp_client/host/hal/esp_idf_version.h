@@ -0,0 +1,16 @@
+#pragma once
+// Host stand-in for esp_idf_version.h: reports the ESP-IDF of the Arduino core 3.x
+// build (compile_flags.txt). Build with -D ESP_IDF_VERSION_MAJOR=4
+// -D ESP_IDF_VERSION_MINOR=4 to take the code paths of core 2.x instead.
+#ifndef ESP_IDF_VERSION_MAJOR
+#define ESP_IDF_VERSION_MAJOR 5
+#endif
+#ifndef ESP_IDF_VERSION_MINOR
+#define ESP_IDF_VERSION_MINOR 4
+#endif
+#ifndef ESP_IDF_VERSION_PATCH
+#define ESP_IDF_VERSION_PATCH 0
+#endif
+
+#define ESP_IDF_VERSION_VAL(major, minor, patch) (((major) << 16) | ((minor) << 8) | (patch))
+#define ESP_IDF_VERSION ESP_IDF_VERSION_VAL(ESP_IDF_VERSION_MAJOR, ESP_IDF_VERSION_MINOR, ESP_IDF_VERSION_PATCH)
@@ -0,0 +1,18 @@
+#pragma once
+// Host stand-in for ESP-IDF's esp_sntp.h. The wall clock is the virtual clock plus
+// an epoch (hal_set_sntp()); like an unsynced ESP32 it reads as 1970 until
+// configTime() has run and the sync delay has passed with WiFi up. A sync then
+// completes every hour, as lwIP's default update interval.
+#include <sys/time.h>
+
+typedef enum {
+    SNTP_SYNC_STATUS_RESET,
+    SNTP_SYNC_STATUS_COMPLETED,
+    SNTP_SYNC_STATUS_IN_PROGRESS,
+} sntp_sync_status_t;
+
+sntp_sync_status_t sntp_get_sync_status(void);
+
+// Firmware reads the wall clock through gettimeofday(); on the host that has to be the virtual one.
+int hal_gettimeofday(struct timeval* tv, void* tz);
+#define gettimeofday(tv, tz) hal_gettimeofday(tv, tz)
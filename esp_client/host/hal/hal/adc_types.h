@@ -0,0 +1,19 @@
+#pragma once
+// Host stand-in for hal/adc_types.h (and the soc_caps.h limits it brings in):
+// the types both ADC drivers share, ESP32 values.
+#include <stdint.h>
+
+#define SOC_ADC_SAMPLE_FREQ_THRES_HIGH (2 * 1000 * 1000)
+#define SOC_ADC_SAMPLE_FREQ_THRES_LOW (20 * 1000)
+#define SOC_ADC_DIGI_RESULT_BYTES 2
+
+typedef enum { ADC_UNIT_1, ADC_UNIT_2 } adc_unit_t;
+typedef enum {
+    ADC_CHANNEL_0, ADC_CHANNEL_1, ADC_CHANNEL_2, ADC_CHANNEL_3, ADC_CHANNEL_4,
+    ADC_CHANNEL_5, ADC_CHANNEL_6, ADC_CHANNEL_7, ADC_CHANNEL_8, ADC_CHANNEL_9
+} adc_channel_t;
+typedef enum {
+    ADC_ATTEN_DB_0, ADC_ATTEN_DB_2_5, ADC_ATTEN_DB_6, ADC_ATTEN_DB_12,
+    ADC_ATTEN_DB_11 = ADC_ATTEN_DB_12
+} adc_atten_t;
+typedef enum { ADC_BITWIDTH_DEFAULT, ADC_BITWIDTH_9 = 9, ADC_BITWIDTH_10, ADC_BITWIDTH_11, ADC_BITWIDTH_12 } adc_bitwidth_t;
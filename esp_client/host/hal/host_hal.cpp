@@ -0,0 +1,668 @@
+#include "host_hal.h"
+#include "HardwareSerial.h"
+#include "WiFi.h"
+#include "PubSubClient.h"
+#include "Preferences.h"
+#include "SPIFFS.h"
+#include "esp_timer.h"
+#include "esp_sntp.h"
+#include "driver/i2s.h"
+#include "esp_adc/adc_continuous.h"
+#include "driver/pcnt.h"
+#include <stdio.h>
+#include <deque>
+#include <map>
+#include <random>
+#include <vector>
+
+/* === Virtual clock === */
+static uint64_t g_now_us = 0;
+
+uint64_t hal_now_us() { return g_now_us; }
+void hal_set_time_us(uint64_t t_us) { if (t_us > g_now_us) g_now_us = t_us; }
+void hal_advance_us(uint64_t dt_us) { g_now_us += dt_us; }
+
+unsigned long micros() { return (uint32_t)g_now_us; }
+unsigned long millis() { return (uint32_t)(g_now_us / 1000); }
+void delay(uint32_t ms) { hal_advance_us((uint64_t)ms * 1000); }
+void delayMicroseconds(uint32_t us) { hal_advance_us(us); }
+
+void vTaskDelay(TickType_t ticks) { delay(ticks * portTICK_PERIOD_MS); }
+
+/* === esp_timer + task notifications === */
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    uint64_t period_us;   // 0 = one-shot
+    uint64_t due_us;
+    bool armed;
+};
+static std::vector<esp_timer*> g_timers;
+static uint32_t g_notify_bits = 0;
+static hal_idle_hook g_idle_hook;
+static int g_host_task;   // its address is the one task handle
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out_handle) {
+    if (!args || !out_handle) return ESP_FAIL;
+    esp_timer* t = new esp_timer{args->callback, args->arg, 0, 0, false};
+    g_timers.push_back(t);
+    *out_handle = t;
+    return ESP_OK;
+}
+esp_err_t esp_timer_start_once(esp_timer_handle_t t, uint64_t timeout_us) {
+    if (t->armed) return ESP_FAIL;
+    t->period_us = 0; t->due_us = g_now_us + timeout_us; t->armed = true;
+    return ESP_OK;
+}
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t t, uint64_t period_us) {
+    if (t->armed || period_us == 0) return ESP_FAIL;
+    t->period_us = period_us; t->due_us = g_now_us + period_us; t->armed = true;
+    return ESP_OK;
+}
+esp_err_t esp_timer_stop(esp_timer_handle_t t) {
+    if (!t->armed) return ESP_FAIL;
+    t->armed = false;
+    return ESP_OK;
+}
+bool esp_timer_is_active(esp_timer_handle_t t) { return t->armed; }
+int64_t esp_timer_get_time() { return (int64_t)g_now_us; }
+
+static void fire_due_timers() {
+    for (esp_timer* t : g_timers) {
+        if (!t->armed || t->due_us > g_now_us) continue;
+        if (t->period_us) {
+            // Like esp_timer, a late periodic timer fires once and keeps its phase.
+            while (t->due_us <= g_now_us) t->due_us += t->period_us;
+        } else {
+            t->armed = false;
+        }
+        t->callback(t->arg);
+    }
+}
+
+static uint64_t next_timer_due() {
+    uint64_t next = UINT64_MAX;
+    for (esp_timer* t : g_timers) if (t->armed && t->due_us < next) next = t->due_us;
+    return next;
+}
+
+void hal_set_idle_hook(hal_idle_hook hook) { g_idle_hook = hook; }
+bool hal_task_notified() { return g_notify_bits != 0; }
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return &g_host_task; }
+BaseType_t xTaskNotifyGive(TaskHandle_t task) { (void)task; return pdPASS; }
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) { (void)clear_on_exit; (void)ticks; return 0; }
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    (void)task;
+    if (action == eSetBits) g_notify_bits |= value;
+    return pdPASS;
+}
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t* higher_prio_woken) {
+    if (higher_prio_woken) *higher_prio_woken = pdFALSE;
+    return xTaskNotify(task, value, action);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t* value, TickType_t ticks) {
+    g_notify_bits &= ~clear_on_entry;
+    uint64_t deadline = ticks == portMAX_DELAY ? UINT64_MAX : g_now_us + (uint64_t)ticks * portTICK_PERIOD_MS * 1000;
+    for (;;) {
+        fire_due_timers();
+        if (g_notify_bits) break;
+        if (g_now_us >= deadline) return pdFALSE;
+        uint64_t until = std::min(next_timer_due(), deadline);
+        if (g_idle_hook) {
+            if (!g_idle_hook(until)) return pdFALSE;   // simulation over
+        } else if (until == UINT64_MAX) {
+            return pdFALSE;                            // nothing could ever wake us
+        } else {
+            hal_set_time_us(until);
+        }
+    }
+    if (value) *value = g_notify_bits;
+    g_notify_bits &= ~clear_on_exit;
+    return pdTRUE;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) { (void)task; return 0; }
+
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void*), const char* name, uint32_t stack, void* param,
+                                   unsigned int prio, TaskHandle_t* handle, int core) {
+    // Tasks are never spawned on the host; the simulator drives the firmware directly.
+    (void)fn; (void)name; (void)stack; (void)param; (void)prio; (void)core;
+    if (handle) *handle = nullptr;
+    return pdPASS;
+}
+
+/* === GPIO / interrupts === */
+static constexpr int NUM_PINS = 40;
+static int g_pin_level[NUM_PINS];
+static void (*g_isr[NUM_PINS])(void);
+static uint64_t g_isr_count[NUM_PINS];
+
+void pinMode(uint8_t pin, uint8_t mode) { (void)pin; (void)mode; }
+void digitalWrite(uint8_t pin, uint8_t val) { if (pin < NUM_PINS) g_pin_level[pin] = val; }
+int digitalRead(uint8_t pin) { return pin < NUM_PINS ? g_pin_level[pin] : LOW; }
+uint16_t analogRead(uint8_t pin) { (void)pin; return 0; }
+void analogReadResolution(uint8_t bits) { (void)bits; }
+void analogSetPinAttenuation(uint8_t pin, adc_attenuation_t attenuation) { (void)pin; (void)attenuation; }
+
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode) {
+    (void)mode;
+    if (pin < NUM_PINS) g_isr[pin] = isr;
+}
+void detachInterrupt(uint8_t pin) { if (pin < NUM_PINS) g_isr[pin] = nullptr; }
+
+bool hal_fire_interrupt(uint8_t pin) {
+    if (pin >= NUM_PINS || !g_isr[pin]) return false;
+    g_isr_count[pin]++;
+    g_isr[pin]();
+    return true;
+}
+uint64_t hal_interrupt_count(uint8_t pin) { return pin < NUM_PINS ? g_isr_count[pin] : 0; }
+
+/* === Pulse counter (PCNT) === */
+struct PcntUnit {
+    bool configured;
+    bool running;
+    pcnt_config_t cfg;
+    int16_t count;
+    uint32_t events;          // enabled PCNT_EVT_* bits
+    uint32_t status;          // events latched at the last wrap
+    void (*isr)(void*);
+    void* arg;
+};
+static PcntUnit g_pcnt[PCNT_UNIT_MAX];
+static uint64_t g_pcnt_isr_count = 0;
+
+static bool pcnt_ok(pcnt_unit_t unit) { return unit >= PCNT_UNIT_0 && unit < PCNT_UNIT_MAX; }
+
+esp_err_t pcnt_unit_config(const pcnt_config_t* config) {
+    if (!config || !pcnt_ok(config->unit)) return ESP_FAIL;
+    PcntUnit& u = g_pcnt[config->unit];
+    u.configured = true;
+    u.running = true;
+    u.cfg = *config;
+    u.count = 0;
+    return ESP_OK;
+}
+esp_err_t pcnt_get_counter_value(pcnt_unit_t unit, int16_t* count) {
+    if (!pcnt_ok(unit) || !count) return ESP_FAIL;
+    *count = g_pcnt[unit].count;
+    return ESP_OK;
+}
+esp_err_t pcnt_counter_pause(pcnt_unit_t unit) { if (!pcnt_ok(unit)) return ESP_FAIL; g_pcnt[unit].running = false; return ESP_OK; }
+esp_err_t pcnt_counter_resume(pcnt_unit_t unit) { if (!pcnt_ok(unit)) return ESP_FAIL; g_pcnt[unit].running = true; return ESP_OK; }
+esp_err_t pcnt_counter_clear(pcnt_unit_t unit) { if (!pcnt_ok(unit)) return ESP_FAIL; g_pcnt[unit].count = 0; return ESP_OK; }
+esp_err_t pcnt_set_filter_value(pcnt_unit_t unit, uint16_t filter_val) { (void)filter_val; return pcnt_ok(unit) ? ESP_OK : ESP_FAIL; }
+esp_err_t pcnt_filter_enable(pcnt_unit_t unit) { return pcnt_ok(unit) ? ESP_OK : ESP_FAIL; }
+esp_err_t pcnt_event_enable(pcnt_unit_t unit, pcnt_evt_type_t evt_type) {
+    if (!pcnt_ok(unit)) return ESP_FAIL;
+    g_pcnt[unit].events |= evt_type;
+    return ESP_OK;
+}
+esp_err_t pcnt_get_event_status(pcnt_unit_t unit, uint32_t* status) {
+    if (!pcnt_ok(unit) || !status) return ESP_FAIL;
+    *status = g_pcnt[unit].status;
+    return ESP_OK;
+}
+esp_err_t pcnt_isr_service_install(int intr_alloc_flags) { (void)intr_alloc_flags; return ESP_OK; }
+esp_err_t pcnt_isr_handler_add(pcnt_unit_t unit, void (*isr_handler)(void*), void* args) {
+    if (!pcnt_ok(unit)) return ESP_FAIL;
+    g_pcnt[unit].isr = isr_handler;
+    g_pcnt[unit].arg = args;
+    return ESP_OK;
+}
+
+// One rising edge into every running unit on `pin`. Returns true if any counted it.
+static bool pcnt_edge(uint8_t pin) {
+    bool counted = false;
+    for (PcntUnit& u : g_pcnt) {
+        if (!u.configured || !u.running || u.cfg.pulse_gpio_num != pin || u.cfg.pos_mode != PCNT_COUNT_INC) continue;
+        counted = true;
+        if (++u.count < u.cfg.counter_h_lim) continue;
+        u.count = 0;
+        u.status = PCNT_EVT_H_LIM;
+        if ((u.events & PCNT_EVT_H_LIM) && u.isr) {
+            g_pcnt_isr_count++;
+            u.isr(u.arg);
+        }
+    }
+    return counted;
+}
+
+bool hal_pin_edge(uint8_t pin) {
+    bool counted = pcnt_edge(pin);
+    return hal_fire_interrupt(pin) || counted;
+}
+uint64_t hal_pcnt_interrupt_count() { return g_pcnt_isr_count; }
+
+void hal_set_digital_input(uint8_t pin, int level) { if (pin < NUM_PINS) g_pin_level[pin] = level; }
+int hal_get_digital_output(uint8_t pin) { return pin < NUM_PINS ? g_pin_level[pin] : LOW; }
+
+/* === CT ADC "DMA" on the virtual clock: legacy I2S (IDF 4) and adc_continuous (IDF 5) === */
+static hal_adc_source g_ct_adc_source;
+static uint32_t g_ct_rate = 0;
+static uint64_t g_ct_capacity = 0;      // conversions the DMA ring holds
+static uint64_t g_ct_next = 0;          // index of the next conversion to hand out
+static int g_ct_channel = 0;
+static bool g_ct_running = false;
+
+void hal_set_ct_adc_source(hal_adc_source source) { g_ct_adc_source = source; }
+
+static void ct_start() {
+    g_ct_running = true;
+    g_ct_next = g_now_us * g_ct_rate / 1000000;
+}
+
+// Up to max conversions captured since the last call, as (channel << 12) | 12-bit count.
+static size_t ct_capture(uint16_t* out, size_t max) {
+    uint64_t captured = g_now_us * g_ct_rate / 1000000;
+    if (captured - g_ct_next > g_ct_capacity) g_ct_next = captured - g_ct_capacity;   // overrun
+    uint64_t n = std::min<uint64_t>(max, captured - g_ct_next);
+    for (uint64_t i = 0; i < n; i++) {
+        double t_s = (double)(g_ct_next + i) / g_ct_rate;
+        int v = g_ct_adc_source ? g_ct_adc_source(t_s) : 2048;
+        v = std::max(0, std::min(4095, v));
+        out[i] = (uint16_t)((g_ct_channel << 12) | v);
+    }
+    g_ct_next += n;
+    return (size_t)n;
+}
+
+esp_err_t adc1_config_width(adc_bits_width_t width) { (void)width; return ESP_OK; }
+esp_err_t adc1_config_channel_atten(adc1_channel_t channel, adc_atten_t atten) { (void)channel; (void)atten; return ESP_OK; }
+
+esp_err_t i2s_driver_install(i2s_port_t port, const i2s_config_t* config, int queue_size, void* queue) {
+    (void)port; (void)queue_size; (void)queue;
+    if (!config || !config->sample_rate) return ESP_FAIL;
+    g_ct_rate = config->sample_rate;
+    g_ct_capacity = (uint64_t)config->dma_buf_count * config->dma_buf_len;
+    return ESP_OK;
+}
+esp_err_t i2s_set_adc_mode(adc_unit_t unit, adc1_channel_t channel) { (void)unit; g_ct_channel = channel; return ESP_OK; }
+esp_err_t i2s_adc_enable(i2s_port_t port) {
+    (void)port;
+    ct_start();
+    return ESP_OK;
+}
+
+esp_err_t i2s_read(i2s_port_t port, void* dest, size_t size, size_t* bytes_read, TickType_t ticks_to_wait) {
+    (void)port; (void)ticks_to_wait;
+    *bytes_read = 0;
+    if (!g_ct_running) return ESP_FAIL;
+    *bytes_read = ct_capture((uint16_t*)dest, size / sizeof(uint16_t)) * sizeof(uint16_t);
+    return ESP_OK;
+}
+
+struct adc_continuous_ctx_t { uint32_t frame_bytes; };
+static adc_continuous_ctx_t g_adc_ctx;
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t* cfg, adc_continuous_handle_t* ret_handle) {
+    if (!cfg || !ret_handle || !cfg->conv_frame_size || cfg->max_store_buf_size < cfg->conv_frame_size) return ESP_FAIL;
+    g_adc_ctx.frame_bytes = cfg->conv_frame_size;
+    g_ct_capacity = cfg->max_store_buf_size / SOC_ADC_DIGI_RESULT_BYTES;
+    *ret_handle = &g_adc_ctx;
+    return ESP_OK;
+}
+esp_err_t adc_continuous_config(adc_continuous_handle_t handle, const adc_continuous_config_t* config) {
+    if (!handle || !config || config->pattern_num != 1 || !config->adc_pattern) return ESP_FAIL;
+    if (config->sample_freq_hz < SOC_ADC_SAMPLE_FREQ_THRES_LOW || config->sample_freq_hz > SOC_ADC_SAMPLE_FREQ_THRES_HIGH) return ESP_FAIL;
+    if (config->format != ADC_DIGI_OUTPUT_FORMAT_TYPE1) return ESP_FAIL;   // the only one ESP32 has
+    g_ct_rate = config->sample_freq_hz;
+    g_ct_channel = config->adc_pattern[0].channel;
+    return ESP_OK;
+}
+esp_err_t adc_continuous_start(adc_continuous_handle_t handle) {
+    if (!handle || !g_ct_rate) return ESP_FAIL;
+    ct_start();
+    return ESP_OK;
+}
+esp_err_t adc_continuous_read(adc_continuous_handle_t handle, uint8_t* buf, uint32_t length_max, uint32_t* out_length, uint32_t timeout_ms) {
+    (void)timeout_ms;
+    *out_length = 0;
+    if (!handle || !g_ct_running) return ESP_FAIL;
+    uint32_t max = std::min(length_max, handle->frame_bytes) / SOC_ADC_DIGI_RESULT_BYTES;
+    size_t n = ct_capture((uint16_t*)buf, max);
+    if (n == 0) return ESP_ERR_TIMEOUT;
+    *out_length = (uint32_t)n * SOC_ADC_DIGI_RESULT_BYTES;
+    return ESP_OK;
+}
+esp_err_t adc_continuous_io_to_channel(int io_num, adc_unit_t* unit_id, adc_channel_t* channel) {
+    static const int adc1_pins[] = { 36, 37, 38, 39, 32, 33, 34, 35 };
+    static const int adc2_pins[] = { 4, 0, 2, 15, 13, 12, 14, 27, 25, 26 };
+    for (int c = 0; c < 8; c++)
+        if (adc1_pins[c] == io_num) { *unit_id = ADC_UNIT_1; *channel = (adc_channel_t)c; return ESP_OK; }
+    for (int c = 0; c < 10; c++)
+        if (adc2_pins[c] == io_num) { *unit_id = ADC_UNIT_2; *channel = (adc_channel_t)c; return ESP_OK; }
+    return ESP_FAIL;
+}
+
+/* === Misc === */
+static std::mt19937 g_rng(12345);
+
+long random(long howbig) { return howbig <= 0 ? 0 : (long)(g_rng() % (unsigned long)howbig); }
+long random(long howsmall, long howbig) { return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall); }
+void randomSeed(unsigned long seed) { g_rng.seed((uint32_t)seed); }
+uint32_t esp_random() { return (uint32_t)g_rng(); }
+
+/* === Reset reason === */
+static esp_reset_reason_t g_reset_reason = ESP_RST_POWERON;
+
+void hal_set_reset_reason(esp_reset_reason_t reason) { g_reset_reason = reason; }
+esp_reset_reason_t esp_reset_reason() { return g_reset_reason; }
+
+EspClass ESP;
+
+/* === Serial === */
+HardwareSerial Serial;
+static bool g_serial_echo = false;
+static std::deque<char> g_serial_in;
+
+void hal_serial_echo(bool enabled) { g_serial_echo = enabled; }
+void hal_serial_feed(const char* text) {
+    while (*text) g_serial_in.push_back(*text++);
+    if (Serial.on_receive()) Serial.on_receive()();
+}
+
+int HardwareSerial::available() { return (int)g_serial_in.size(); }
+int HardwareSerial::read() {
+    if (g_serial_in.empty()) return -1;
+    char c = g_serial_in.front();
+    g_serial_in.pop_front();
+    return (unsigned char)c;
+}
+String HardwareSerial::readStringUntil(char terminator) {
+    std::string s;
+    int c;
+    while ((c = read()) >= 0 && c != terminator) s += (char)c;
+    return String(s);
+}
+
+size_t HardwareSerial::print(const char* s) {
+    size_t n = strlen(s);
+    if (g_serial_echo) fwrite(s, 1, n, stdout);
+    return n;
+}
+size_t HardwareSerial::print(char c) { char s[2] = {c, 0}; return print(s); }
+size_t HardwareSerial::print(int v) { return print((long)v); }
+size_t HardwareSerial::print(unsigned int v) { return print((unsigned long)v); }
+size_t HardwareSerial::print(long v) {
+    if (!g_serial_echo) return 0;
+    char s[24]; snprintf(s, sizeof(s), "%ld", v); return print((const char*)s);
+}
+size_t HardwareSerial::print(unsigned long v) {
+    if (!g_serial_echo) return 0;
+    char s[24]; snprintf(s, sizeof(s), "%lu", v); return print((const char*)s);
+}
+size_t HardwareSerial::print(double v, int digits) {
+    if (!g_serial_echo) return 0;
+    char s[48]; snprintf(s, sizeof(s), "%.*f", digits, v); return print((const char*)s);
+}
+
+/* === WiFi === */
+WiFiClass WiFi;
+static bool g_wifi_up = true;
+static hal_wifi_timing g_wifi_timing = {};
+static uint8_t g_ap_bssid[6] = { 0x24, 0x0A, 0xC4, 0x5E, 0x10, 0x01 };
+static uint8_t g_ap_channel = 6;
+static uint64_t g_wifi_ready_us = UINT64_MAX;   // when the pending begin() associates; MAX = never
+static bool g_wifi_static = false;
+static uint32_t g_wifi_static_ip = 0;
+static uint64_t g_wifi_scans = 0;
+
+void hal_set_wifi_up(bool up) {
+    // The station drops its association and, with auto-reconnect off, stays off it until
+    // the next begin(); a begin() while the AP is gone completes once it is back.
+    if (!up) g_wifi_ready_us = UINT64_MAX;
+    g_wifi_up = up;
+}
+void hal_set_wifi_timing(hal_wifi_timing timing) { g_wifi_timing = timing; }
+void hal_set_wifi_ap(const uint8_t bssid[6], uint8_t channel) { memcpy(g_ap_bssid, bssid, 6); g_ap_channel = channel; }
+uint64_t hal_wifi_scans() { return g_wifi_scans; }
+uint64_t hal_wifi_ready_us() { return g_wifi_ready_us; }
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase, int32_t channel, const uint8_t* bssid, bool connect) {
+    (void)ssid; (void)passphrase;
+    if (!connect) return status();
+    uint64_t ms = g_wifi_timing.assoc_ms + (g_wifi_static ? 0 : g_wifi_timing.dhcp_ms);
+    if (channel && bssid) {
+        bool match = channel == g_ap_channel && memcmp(bssid, g_ap_bssid, 6) == 0;
+        g_wifi_ready_us = match ? hal_now_us() + ms * 1000 : UINT64_MAX;
+    } else {
+        g_wifi_scans++;
+        g_wifi_ready_us = hal_now_us() + (ms + g_wifi_timing.scan_ms) * 1000;
+    }
+    return status();
+}
+bool WiFiClass::config(IPAddress local_ip, IPAddress gateway, IPAddress subnet, IPAddress dns1) {
+    (void)gateway; (void)subnet; (void)dns1;
+    g_wifi_static = (uint32_t)local_ip != 0;
+    g_wifi_static_ip = local_ip;
+    return true;
+}
+wl_status_t WiFiClass::status() {
+    return g_wifi_up && hal_now_us() >= g_wifi_ready_us ? WL_CONNECTED : WL_DISCONNECTED;
+}
+bool WiFiClass::disconnect(bool wifioff) { (void)wifioff; g_wifi_ready_us = UINT64_MAX; return true; }
+uint8_t* WiFiClass::BSSID() { return g_ap_bssid; }
+int32_t WiFiClass::channel() { return g_ap_channel; }
+IPAddress WiFiClass::localIP() { return g_wifi_static ? IPAddress(g_wifi_static_ip) : IPAddress(192, 168, 1, 77); }
+IPAddress WiFiClass::gatewayIP() { return IPAddress(192, 168, 1, 1); }
+IPAddress WiFiClass::subnetMask() { return IPAddress(255, 255, 255, 0); }
+IPAddress WiFiClass::dnsIP(uint8_t dns_no) { (void)dns_no; return IPAddress(192, 168, 1, 1); }
+
+/* === SNTP / wall clock === */
+static uint64_t g_sntp_epoch_ms = 1767225600000ULL;   // 2026-01-01T00:00:00Z
+static uint32_t g_sntp_sync_ms = 0;
+static uint64_t g_sntp_due_us = UINT64_MAX;           // next sync; MAX = configTime() not called
+static bool g_sntp_synced = false;
+static uint64_t g_sntp_syncs = 0;
+static constexpr uint64_t SNTP_UPDATE_US = 3600ULL * 1000000;
+
+void hal_set_sntp(uint64_t epoch_ms, uint32_t sync_ms) { g_sntp_epoch_ms = epoch_ms; g_sntp_sync_ms = sync_ms; }
+uint64_t hal_wall_ms() { return g_sntp_epoch_ms + g_now_us / 1000; }
+uint64_t hal_sntp_syncs() { return g_sntp_syncs; }
+
+void configTime(long gmtOffset_sec, int daylightOffset_sec, const char* server1, const char* server2, const char* server3) {
+    (void)gmtOffset_sec; (void)daylightOffset_sec; (void)server1; (void)server2; (void)server3;
+    g_sntp_due_us = hal_now_us() + (uint64_t)g_sntp_sync_ms * 1000;
+}
+
+// A due sync completes at the first look with WiFi up; each is reported once, as in ESP-IDF.
+sntp_sync_status_t sntp_get_sync_status(void) {
+    if (hal_now_us() < g_sntp_due_us || WiFi.status() != WL_CONNECTED) return SNTP_SYNC_STATUS_RESET;
+    g_sntp_synced = true;
+    g_sntp_syncs++;
+    g_sntp_due_us = hal_now_us() + SNTP_UPDATE_US;
+    return SNTP_SYNC_STATUS_COMPLETED;
+}
+
+int hal_gettimeofday(struct timeval* tv, void* tz) {
+    (void)tz;
+    uint64_t us = (g_sntp_synced ? g_sntp_epoch_ms * 1000 : 0) + g_now_us;
+    tv->tv_sec = (time_t)(us / 1000000);
+    tv->tv_usec = (suseconds_t)(us % 1000000);
+    return 0;
+}
+
+/* === MQTT === */
+static bool g_broker_up = true;
+static hal_publish_sink g_publish_sink;
+static uint64_t g_publish_count = 0;
+static uint64_t g_publish_bytes = 0;
+
+static uint32_t g_broker_connect_ms = 0;
+
+void hal_set_broker_up(bool up) { g_broker_up = up; }
+void hal_set_broker_connect_ms(uint32_t ms) { g_broker_connect_ms = ms; }
+bool hal_broker_up() { return g_broker_up && g_wifi_up; }
+void hal_set_publish_sink(hal_publish_sink sink) { g_publish_sink = std::move(sink); }
+uint64_t hal_publish_count() { return g_publish_count; }
+uint64_t hal_publish_bytes() { return g_publish_bytes; }
+
+boolean PubSubClient::connect(const char* id, const char* user, const char* pass) {
+    (void)id; (void)user; (void)pass;
+    state_ = hal_broker_up() ? MQTT_CONNECTED : MQTT_CONNECT_FAILED;
+    if (state_ == MQTT_CONNECTED) hal_advance_us((uint64_t)g_broker_connect_ms * 1000);
+    return state_ == MQTT_CONNECTED;
+}
+void PubSubClient::disconnect() { state_ = MQTT_DISCONNECTED; }
+boolean PubSubClient::connected() {
+    if (state_ == MQTT_CONNECTED && !hal_broker_up()) state_ = MQTT_CONNECTION_LOST;
+    return state_ == MQTT_CONNECTED;
+}
+boolean PubSubClient::loop() { return connected(); }
+
+boolean PubSubClient::publish(const char* topic, const char* payload) {
+    return publish(topic, (const uint8_t*)payload, payload ? (unsigned int)strlen(payload) : 0, false);
+}
+boolean PubSubClient::publish(const char* topic, const char* payload, boolean retained) {
+    return publish(topic, (const uint8_t*)payload, payload ? (unsigned int)strlen(payload) : 0, retained);
+}
+boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength) {
+    return publish(topic, payload, plength, false);
+}
+boolean PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int plength, boolean retained) {
+    if (!connected()) return false;
+    // Same limit the real client enforces: fixed header + topic + payload must fit the buffer.
+    if (plength + strlen(topic) + 7 > buffer_size_) return false;
+    g_publish_count++;
+    g_publish_bytes += plength;
+    if (g_publish_sink) g_publish_sink(topic, payload, plength, retained);
+    return true;
+}
+
+/* === NVS === */
+static std::map<std::string, std::map<std::string, std::vector<uint8_t>>> g_nvs;
+static uint64_t g_nvs_writes = 0;
+
+uint64_t hal_nvs_write_count() { return g_nvs_writes; }
+
+bool Preferences::begin(const char* name, bool readOnly, const char* partition_label) {
+    (void)partition_label;
+    ns_ = name;
+    read_only_ = readOnly;
+    open_ = true;
+    return true;
+}
+void Preferences::end() { open_ = false; }
+
+bool Preferences::clear() {
+    if (!open_ || read_only_) return false;
+    g_nvs[ns_.str()].clear();
+    g_nvs_writes++;
+    return true;
+}
+bool Preferences::remove(const char* key) {
+    if (!open_ || read_only_) return false;
+    g_nvs_writes++;
+    return g_nvs[ns_.str()].erase(key) > 0;
+}
+bool Preferences::isKey(const char* key) {
+    if (!open_) return false;
+    auto ns = g_nvs.find(ns_.str());
+    return ns != g_nvs.end() && ns->second.count(key) > 0;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) {
+    // Real NVS rejects keys longer than 15 characters (NVS_KEY_NAME_MAX_SIZE - 1).
+    if (!open_ || read_only_ || strlen(key) > 15) return 0;
+    const uint8_t* p = (const uint8_t*)value;
+    g_nvs[ns_.str()][key].assign(p, p + len);
+    g_nvs_writes++;
+    return len;
+}
+size_t Preferences::getBytesLength(const char* key) {
+    if (!isKey(key)) return 0;
+    return g_nvs[ns_.str()][key].size();
+}
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen) {
+    size_t len = getBytesLength(key);
+    if (len == 0 || len > maxLen) return 0;
+    memcpy(buf, g_nvs[ns_.str()][key].data(), len);
+    return len;
+}
+
+size_t Preferences::putString(const char* key, const char* value) {
+    return putBytes(key, value, strlen(value) + 1) ? strlen(value) : 0;
+}
+String Preferences::getString(const char* key, const String& defaultValue) {
+    if (!isKey(key)) return defaultValue;
+    const auto& v = g_nvs[ns_.str()][key];
+    return String(std::string(v.begin(), v.end()).c_str());
+}
+
+/* === SPIFFS === */
+fs::SPIFFSFS SPIFFS;
+static std::string g_fs_root = "data";
+static uint64_t g_fs_bytes_written = 0;
+
+void hal_set_fs_root(const char* dir) { g_fs_root = dir; }
+uint64_t hal_fs_bytes_written() { return g_fs_bytes_written; }
+
+static std::string host_path(const char* path) {
+    return g_fs_root + (path[0] == '/' ? "" : "/") + path;
+}
+
+namespace fs {
+
+int File::available() {
+    if (!fp_) return 0;
+    long pos = ftell(fp_.get());
+    fseek(fp_.get(), 0, SEEK_END);
+    long end = ftell(fp_.get());
+    fseek(fp_.get(), pos, SEEK_SET);
+    return (int)(end - pos);
+}
+int File::read() {
+    if (!fp_) return -1;
+    int c = fgetc(fp_.get());
+    return c == EOF ? -1 : c;
+}
+size_t File::read(uint8_t* buf, size_t size) { return fp_ ? fread(buf, 1, size, fp_.get()) : 0; }
+size_t File::write(const uint8_t* buf, size_t size) {
+    if (!fp_) return 0;
+    size_t n = fwrite(buf, 1, size, fp_.get());
+    g_fs_bytes_written += n;
+    return n;
+}
+String File::readStringUntil(char terminator) {
+    std::string s;
+    int c;
+    while ((c = read()) >= 0 && c != terminator) s += (char)c;
+    return String(s);
+}
+bool File::seek(uint32_t pos, SeekMode mode) {
+    static const int whence[] = {SEEK_SET, SEEK_CUR, SEEK_END};
+    return fp_ && fseek(fp_.get(), (long)pos, whence[mode]) == 0;
+}
+size_t File::position() const { return fp_ ? (size_t)ftell(fp_.get()) : 0; }
+size_t File::size() const {
+    if (!fp_) return 0;
+    long pos = ftell(fp_.get());
+    fseek(fp_.get(), 0, SEEK_END);
+    long end = ftell(fp_.get());
+    fseek(fp_.get(), pos, SEEK_SET);
+    return (size_t)end;
+}
+void File::flush() { if (fp_) fflush(fp_.get()); }
+void File::close() { fp_.reset(); }
+
+bool FS::begin(bool formatOnFail) { (void)formatOnFail; return true; }
+File FS::open(const char* path, const char* mode, bool create) {
+    (void)create;
+    // Arduino's "w"/"a" are binary-safe on the device; keep them that way here.
+    std::string m = std::string(mode) + "b";
+    FILE* fp = fopen(host_path(path).c_str(), m.c_str());
+    return fp ? File(fp) : File();
+}
+bool FS::exists(const char* path) {
+    FILE* fp = fopen(host_path(path).c_str(), "rb");
+    if (fp) fclose(fp);
+    return fp != nullptr;
+}
+bool FS::remove(const char* path) { return ::remove(host_path(path).c_str()) == 0; }
+bool FS::rename(const char* from, const char* to) { return ::rename(host_path(from).c_str(), host_path(to).c_str()) == 0; }
+
+}
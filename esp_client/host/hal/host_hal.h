@@ -0,0 +1,75 @@
+#pragma once
+// Simulator-side controls for the host HAL. Firmware code never includes this;
+// only the drivers under ../sim do.
+#include "Arduino.h"
+#include <functional>
+
+/* === Virtual clock === */
+uint64_t hal_now_us();                 // full 64-bit time since boot, never wraps
+void hal_set_time_us(uint64_t t_us);   // only moves forward
+void hal_advance_us(uint64_t dt_us);
+
+/* === Scheduling === */
+// While the firmware blocks in xTaskNotifyWait() the host calls this hook to run
+// the outside world (edges, ISRs) up to `until_us`, the next timer deadline.
+// The hook may stop early once hal_task_notified(); returning false ends the wait
+// with no events, which is how the simulator shuts the firmware loop down.
+using hal_idle_hook = std::function<bool(uint64_t until_us)>;
+void hal_set_idle_hook(hal_idle_hook hook);
+bool hal_task_notified();
+
+/* === Interrupts === */
+// Fires the handler attached to `pin` (if any) at the current virtual time.
+bool hal_fire_interrupt(uint8_t pin);
+uint64_t hal_interrupt_count(uint8_t pin);
+// A rising edge on `pin`: counted by any PCNT unit on that pin, and fires its
+// GPIO interrupt if one is attached. False if nothing was listening.
+bool hal_pin_edge(uint8_t pin);
+uint64_t hal_pcnt_interrupt_count();   // PCNT overflow handler runs
+
+/* === GPIO / analog inputs === */
+void hal_set_digital_input(uint8_t pin, int level);
+int hal_get_digital_output(uint8_t pin);
+// CT sensor ADC samples (12-bit counts) as a function of time since boot, read
+// by the host ADC DMA (I2S or adc_continuous) at its configured rate. Default:
+// 2048 (no current).
+using hal_adc_source = std::function<int(double t_s)>;
+void hal_set_ct_adc_source(hal_adc_source source);
+
+/* === Serial === */
+void hal_serial_echo(bool enabled);     // default off: firmware prints are dropped
+void hal_serial_feed(const char* text); // queue bytes for Serial.available()/read()
+
+/* === Reset === */
+void hal_set_reset_reason(esp_reset_reason_t reason);
+
+/* === Network === */
+void hal_set_wifi_up(bool up);
+// Virtual time a WiFi.begin() takes. A full begin() pays all three; one with a
+// channel + BSSID matching the AP skips the scan (a mismatch never associates);
+// a static WiFi.config() skips DHCP. Default all zero: instant.
+struct hal_wifi_timing { uint32_t scan_ms; uint32_t assoc_ms; uint32_t dhcp_ms; };
+void hal_set_wifi_timing(hal_wifi_timing timing);
+void hal_set_wifi_ap(const uint8_t bssid[6], uint8_t channel);
+uint64_t hal_wifi_scans();             // begin() calls that had to scan
+uint64_t hal_wifi_ready_us();          // when the pending begin() associates (UINT64_MAX: it won't)
+// Virtual time a successful client.connect() blocks for (TCP + CONNECT/CONNACK).
+void hal_set_broker_connect_ms(uint32_t ms);
+void hal_set_broker_up(bool up);
+bool hal_broker_up();
+using hal_publish_sink = std::function<void(const char* topic, const uint8_t* payload, unsigned int length, bool retained)>;
+void hal_set_publish_sink(hal_publish_sink sink);
+uint64_t hal_publish_count();
+uint64_t hal_publish_bytes();
+
+/* === Wall clock === */
+// UTC ms at virtual time 0, and how long after configTime() (WiFi up) the first
+// SNTP sync completes. Default 2026-01-01T00:00:00Z, 0 ms.
+void hal_set_sntp(uint64_t epoch_ms, uint32_t sync_ms);
+uint64_t hal_wall_ms();                // what a synced clock reads now
+uint64_t hal_sntp_syncs();
+
+/* === Storage === */
+void hal_set_fs_root(const char* dir);  // where SPIFFS paths are rooted (default "data")
+uint64_t hal_fs_bytes_written();
+uint64_t hal_nvs_write_count();
@@ -0,0 +1,716 @@
+// Host simulator: replays HLW8012 CF/CF1 edges into the firmware's ISRs on a
+// virtual clock and runs the real event-driven hardwareTask loop against it
+// (edges are fed while the task sleeps between timer deadlines), so the
+// metering path can be measured over days of load in seconds of wall time.
+//
+//   pio run -e native && .pio/build/native/program --trace edges.csv
+//   .pio/build/native/program --cf1-hz 220 --hours 72 --csv reports.csv
+//   .pio/build/native/program --cf1-hz 300 --hours 12 --outage-at-h 2 --outage-h 6
+//   pio run -e native_pcnt && .pio/build/native_pcnt/program --cf1-hz 300 --hours 1
+//   pio run -e native_ct && .pio/build/native_ct/program --ct-amps 4.5 --hours 1
+//   .pio/build/native/program --cf1-hz 300 --hours 2 --cmd 0.5:relay/off --cmd 1:relay/on --cmd 1:interval=10000
+//   .pio/build/native/program --cf1-hz 300 --hours 3 --policy 'power>10' --policy-at 1 --cmd 2:relay/on
+//   .pio/build/native/program --cf1-hz 300 --hours 1 --cmd 0:diag/every=60
+//   .pio/build/native/program --cf1-hz 300 --hours 1 --cmd 0.5:relay/off@1 --cmd 0.5:interval@2=10
+//
+// With an outage the broker is unreachable for that window; the run keeps ticking
+// after the last edge until the store-and-forward backlog has drained, then compares
+// the energy the meter measured with the energy that actually reached the broker.
+// Every delivered reading's boot ID and sequence number are checked for gaps and
+// duplicates, and its capture time against the virtual wall clock; --sntp-s S delays
+// the first SNTP sync (readings published before it carry no time).
+//
+// --cmd H:NAME[=PAYLOAD] delivers "<cid>/cmd/NAME" to the firmware's MQTT callback at
+// hour H, the way client.loop() would (see src/commands/commands.h); repeatable.
+// NAME@ID asks for an ack on "<cid>/ack"; the acks are counted and the last one printed.
+// --policy RULE builds a binary policy set (src/policy/policy.h) sent as cmd/policy at
+// --policy-at H (default 0), with boot taken as local midnight; repeatable. RULE is
+// current>A, power>W or budget>Wh (optionally /N: hold N windows) or allow=HH:MM-HH:MM.
+//
+// Trace format: one edge per line, "<t_us>,<cf|cf1>", t_us counted from boot.
+// Lines starting with '#' are ignored.
+#include "../../main.h"
+#include "../../src/mqtt_config/mqtt_config.h"
+#include "../../src/reading_store/reading_store.h"
+#include "../../src/energy_register/energy_register.h"
+#include "../../src/reading_clock/reading_clock.h"
+#include "../../src/boot_metrics/boot_metrics.h"
+#include "../../src/telemetry/report_batch.h"
+#include "../../src/publish_queue/publish_queue.h"
+#include "../../src/hardware_config/current_sensor/ct_rms.h"
+#include "../../src/hardware_config/current_sensor/metering_config.h"
+#include "../../src/hardware_config/current_sensor/pulse_input.h"
+#include "../../src/hardware_config/current_sensor/metering_backend.h"
+#include "../../src/scheduler/scheduler.h"
+#include "../../src/commands/commands.h"
+#include "../../src/tuning/tuning.h"
+#include "../../src/policy/policy.h"
+#include "../../src/diagnostics/diagnostics.h"
+#include "../../src/hardware_config/relay/relay.h"
+#include "../hal/host_hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+/* Must match HLW8012_CF_PIN in ic_sensor.cpp and currentSensorPin in main.cpp */
+static constexpr uint8_t CF_PIN  = 25;
+static constexpr uint8_t CF1_PIN = 26;
+
+Env env;
+
+struct Edge {
+    uint64_t t_us;
+    uint8_t pin;
+};
+
+/* === Edge sources === */
+class TraceSource {
+public:
+    explicit TraceSource(const char* path) : fp_(fopen(path, "r")) {}
+    ~TraceSource() { if (fp_) fclose(fp_); }
+    bool ok() const { return fp_ != nullptr; }
+
+    bool next(Edge& e) {
+        char line[128];
+        while (fgets(line, sizeof(line), fp_)) {
+            if (line[0] == '#' || line[0] == '\n') continue;
+            char* rest;
+            e.t_us = strtoull(line, &rest, 10);
+            while (*rest == ',' || *rest == ' ' || *rest == '\t') rest++;
+            if (strncmp(rest, "cf1", 3) == 0 || rest[0] == '1') e.pin = CF1_PIN;
+            else if (strncmp(rest, "cf", 2) == 0 || rest[0] == '0') e.pin = CF_PIN;
+            else continue;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    FILE* fp_;
+};
+
+// Two independent square waves with optional period jitter, merged in time order.
+class SyntheticSource {
+public:
+    SyntheticSource(double cf_hz, double cf1_hz, double jitter, uint64_t end_us)
+        : jitter_(jitter), end_us_(end_us) {
+        ch_[0] = {cf_hz > 0 ? 1e6 / cf_hz : 0, 0, CF_PIN};
+        ch_[1] = {cf1_hz > 0 ? 1e6 / cf1_hz : 0, 0, CF1_PIN};
+        for (auto& c : ch_) if (c.period_us > 0) c.next_us = step(c);
+    }
+
+    bool next(Edge& e) {
+        Channel* c = nullptr;
+        for (auto& ch : ch_) {
+            if (ch.period_us <= 0) continue;
+            if (!c || ch.next_us < c->next_us) c = &ch;
+        }
+        if (!c || c->next_us >= (double)end_us_) return false;
+        e = {(uint64_t)c->next_us, c->pin};
+        c->next_us += step(*c);
+        return true;
+    }
+
+private:
+    struct Channel { double period_us; double next_us; uint8_t pin; };
+
+    double step(const Channel& c) {
+        if (jitter_ <= 0) return c.period_us;
+        return c.period_us * (1.0 + jitter_ * dist_(rng_));
+    }
+
+    Channel ch_[2];
+    double jitter_;
+    uint64_t end_us_;
+    std::mt19937 rng_{42};
+    std::uniform_real_distribution<double> dist_{-1.0, 1.0};
+};
+
+/* === Options === */
+struct SimCommand {
+    uint64_t t_us;
+    std::string topic;
+    std::string payload;
+};
+
+struct Options {
+    const char* trace = nullptr;
+    const char* csv = nullptr;
+    const char* config_root = "data";
+    const char* fs_root = ".pio/sim_fs";
+    double cf_hz = 0;
+    double cf1_hz = 0;
+    double jitter = 0;
+    double ct_amps = 0;             // RMS of a mains sine on the CT ADC (CT build)
+    double hours = 24;
+    unsigned int interval_ms = 0;
+    double outage_at_h = -1;
+    double outage_h = 0;
+    double sntp_s = 0;              // first SNTP sync this long after WiFi connects
+    bool relay_off = false;
+    bool serial = false;
+    const char* format = nullptr;   // overrides TELEMETRY_FMT
+    int batch_samples = -1;         // overrides BATCH_SAMPLES
+    int batch_age_s = -1;           // overrides BATCH_MAX_AGE_S
+    const char* report_mode = nullptr;   // overrides REPORT_MODE
+    double deadband_w = -1;         // overrides DEADBAND_W
+    double deadband_pct = -1;       // overrides DEADBAND_PCT
+    int heartbeat_s = -1;           // overrides HEARTBEAT_S
+    std::vector<SimCommand> commands;   // --cmd, in time order
+    PolicySet policy = {};              // --policy rules
+    double policy_at_h = 0;
+    bool policy_report_only = false;
+};
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+        "usage: %s [--trace FILE | --cf-hz HZ --cf1-hz HZ [--jitter FRAC] | --ct-amps A] [--hours H]\n"
+        "          [--interval-ms MS] [--relay-off] [--outage-at-h H --outage-h H] [--sntp-s S]\n"
+        "          [--format json|binary] [--batch N] [--batch-age S]\n"
+        "          [--report-mode interval|exception|adaptive] [--deadband-w W] [--deadband-pct P] [--heartbeat-s S]\n"
+        "          [--cmd H:NAME[=PAYLOAD]]... [--policy RULE]... [--policy-at H] [--policy-report-only]\n"
+        "          [--csv FILE] [--config-root DIR] [--fs-root DIR] [--serial]\n", argv0);
+}
+
+static bool parse_policy_rule(const char* v, PolicySet& set) {
+    if (set.count >= POLICY_MAX_RULES) return false;
+    PolicyRule r = {};
+    r.action = POLICY_ACTION_TRIP;
+    unsigned h1, m1, h2, m2;
+    if (sscanf(v, "allow=%u:%u-%u:%u", &h1, &m1, &h2, &m2) == 4) {
+        r.type = PolicyRuleType::schedule;
+        r.start_min = (uint16_t)(h1 * 60 + m1);
+        r.end_min = (uint16_t)(h2 * 60 + m2);
+    } else {
+        const char* gt = strchr(v, '>');
+        if (!gt) return false;
+        std::string kind(v, gt);
+        if (kind == "current") r.type = PolicyRuleType::max_current;
+        else if (kind == "power") r.type = PolicyRuleType::max_power;
+        else if (kind == "budget") r.type = PolicyRuleType::energy_budget;
+        else return false;
+        r.limit = (float)atof(gt + 1);
+        const char* slash = strchr(gt, '/');
+        if (slash) r.hold_windows = (uint16_t)atoi(slash + 1);
+    }
+    set.rules[set.count++] = r;
+    return true;
+}
+
+static void add_command(Options& o, const SimCommand& c) {
+    size_t k = o.commands.size();
+    while (k > 0 && o.commands[k - 1].t_us > c.t_us) k--;
+    o.commands.insert(o.commands.begin() + k, c);
+}
+
+static bool parse_args(int argc, char** argv, Options& o) {
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (strcmp(a, "--relay-off") == 0) { o.relay_off = true; continue; }
+        if (strcmp(a, "--serial") == 0)    { o.serial = true; continue; }
+        if (strcmp(a, "--policy-report-only") == 0) { o.policy_report_only = true; continue; }
+        if (!v) return false;
+        if      (strcmp(a, "--trace") == 0)       o.trace = v;
+        else if (strcmp(a, "--csv") == 0)         o.csv = v;
+        else if (strcmp(a, "--config-root") == 0) o.config_root = v;
+        else if (strcmp(a, "--fs-root") == 0)     o.fs_root = v;
+        else if (strcmp(a, "--outage-at-h") == 0) o.outage_at_h = atof(v);
+        else if (strcmp(a, "--outage-h") == 0)    o.outage_h = atof(v);
+        else if (strcmp(a, "--sntp-s") == 0)      o.sntp_s = atof(v);
+        else if (strcmp(a, "--cf-hz") == 0)       o.cf_hz = atof(v);
+        else if (strcmp(a, "--cf1-hz") == 0)      o.cf1_hz = atof(v);
+        else if (strcmp(a, "--jitter") == 0)      o.jitter = atof(v);
+        else if (strcmp(a, "--ct-amps") == 0)     o.ct_amps = atof(v);
+        else if (strcmp(a, "--hours") == 0)       o.hours = atof(v);
+        else if (strcmp(a, "--interval-ms") == 0) o.interval_ms = (unsigned int)atoi(v);
+        else if (strcmp(a, "--format") == 0)      o.format = v;
+        else if (strcmp(a, "--batch") == 0)       o.batch_samples = atoi(v);
+        else if (strcmp(a, "--batch-age") == 0)   o.batch_age_s = atoi(v);
+        else if (strcmp(a, "--report-mode") == 0) o.report_mode = v;
+        else if (strcmp(a, "--deadband-w") == 0)  o.deadband_w = atof(v);
+        else if (strcmp(a, "--deadband-pct") == 0) o.deadband_pct = atof(v);
+        else if (strcmp(a, "--heartbeat-s") == 0) o.heartbeat_s = atoi(v);
+        else if (strcmp(a, "--cmd") == 0) {
+            const char* colon = strchr(v, ':');
+            if (!colon) return false;
+            const char* eq = strchr(colon, '=');
+            SimCommand c;
+            c.t_us = (uint64_t)(atof(v) * 3600e6);
+            c.topic = eq ? std::string(colon + 1, eq) : std::string(colon + 1);
+            c.payload = eq ? eq + 1 : "";
+            add_command(o, c);
+        }
+        else if (strcmp(a, "--policy") == 0) { if (!parse_policy_rule(v, o.policy)) return false; }
+        else if (strcmp(a, "--policy-at") == 0) o.policy_at_h = atof(v);
+        else return false;
+        i++;
+    }
+    if (o.policy.count) {
+        uint8_t wire[POLICY_WIRE_MAX];
+        SimCommand c;
+        c.t_us = (uint64_t)(o.policy_at_h * 3600e6);
+        c.topic = "policy";
+        o.policy.flags = o.policy_report_only ? 0 : POLICY_FLAG_ENFORCE;
+        o.policy.tod_s = (uint32_t)((c.t_us / 1000000) % 86400);
+        c.payload.assign((const char*)wire, policy_encode(o.policy, wire, sizeof(wire)));
+        add_command(o, c);
+    }
+    return o.trace || o.cf_hz > 0 || o.cf1_hz > 0 || o.ct_amps > 0;
+}
+
+/* === Replay === */
+struct Stats {
+    uint64_t edges = 0;
+    uint64_t cf1_edges = 0;
+    uint64_t reports = 0;
+    double energy_kwh = 0;
+    double amps_sum = 0;
+    double power_sum = 0;
+    double power_max = 0;
+    double call_ns_sum = 0;
+    double call_ns_max = 0;
+    uint64_t wakes = 0;
+    double step_ns_sum = 0;     // firmware time per wake, idle hook excluded
+    double delivered_kwh = 0;   // decoded from what was actually published
+    uint64_t stat_windows = 0;  // measurement windows summarised in delivered reports
+    double stat_max = 0;        // highest window power any delivered report carried
+    double lifetime_kwh = 0;    // lifetime register in the newest delivered report
+    uint32_t trips = 0;         // policy trips seen after a wake
+    double trip_ns_sum = 0;     // host time of the wakes that tripped the relay
+    double trip_ns_max = 0;
+    uint64_t readings = 0;      // delivered readings, by (boot, seq)
+    uint32_t boot_id = 0;       // of the newest one
+    uint32_t seq_max = 0;
+    uint64_t duplicates = 0;
+    uint64_t out_of_order = 0;
+    uint64_t stamped = 0;       // carried a capture time
+    double ts_err_max_ms = 0;   // batch samples: |ts - (wall at publish - age)|
+    double ts_lag_max_s = 0;    // wall at publish - ts
+    uint64_t closed_us = 0;     // relay closed / open between wakes
+    uint64_t open_us = 0;
+    uint64_t last_wake_us = 0;
+    bool relay_was_on = true;
+};
+
+static Stats g_stats;
+
+// Host wall time of the config load at first boot (config.env parsed and migrated)
+// and of a second load from the NVS blob it left behind.
+static double g_env_first_ns = 0;
+static double g_env_blob_ns = 0;
+static EnvSource g_env_first_source = EnvSource::none;
+
+static void add_delivered_stats(uint16_t windows, float max) {
+    g_stats.stat_windows += windows;
+    if (windows && max > g_stats.stat_max) g_stats.stat_max = max;
+}
+
+static void add_delivered_lifetime(double kwh) {
+    if (kwh > g_stats.lifetime_kwh) g_stats.lifetime_kwh = kwh;
+}
+
+static std::vector<bool> g_seen_seq;
+
+// One delivered reading's identity; age_ms < 0 when the encoding has none (single reports).
+static void add_delivered_identity(uint32_t boot, uint32_t seq, uint64_t unix_ms, double age_ms) {
+    g_stats.readings++;
+    if (boot != g_stats.boot_id) { g_stats.boot_id = boot; g_stats.seq_max = 0; g_seen_seq.clear(); }
+    if (seq >= g_seen_seq.size()) g_seen_seq.resize(seq + 1024);
+    if (g_seen_seq[seq]) g_stats.duplicates++;
+    g_seen_seq[seq] = true;
+    if (seq < g_stats.seq_max) g_stats.out_of_order++;
+    else g_stats.seq_max = seq;
+    if (!unix_ms) return;
+    g_stats.stamped++;
+    double wall_ms = (double)hal_wall_ms();
+    g_stats.ts_lag_max_s = std::max(g_stats.ts_lag_max_s, (wall_ms - unix_ms) / 1e3);
+    if (age_ms >= 0) g_stats.ts_err_max_ms = std::max(g_stats.ts_err_max_ms, fabs(wall_ms - age_ms - unix_ms));
+}
+
+static void add_delivered_identity_binary(const uint8_t* at, double age_ms) {
+    uint32_t boot, seq;
+    uint64_t unix_ms;
+    memcpy(&boot, at, sizeof(boot));
+    memcpy(&seq, at + 4, sizeof(seq));
+    memcpy(&unix_ms, at + 8, sizeof(unix_ms));
+    add_delivered_identity(boot, seq, unix_ms, age_ms);
+}
+
+static void add_delivered_binary(const uint8_t* energy_at, const uint8_t* stats_at) {
+    float e, max;
+    uint16_t windows;
+    double lifetime;
+    memcpy(&e, energy_at, sizeof(e));
+    memcpy(&windows, stats_at, sizeof(windows));
+    memcpy(&max, stats_at + 6, sizeof(max));
+    memcpy(&lifetime, stats_at + TELEMETRY_STATS_SIZE, sizeof(lifetime));
+    g_stats.delivered_kwh += e;
+    add_delivered_stats(windows, max);
+    add_delivered_lifetime(lifetime);
+}
+
+// Pull energyIncrement, the window stats and the lifetime register back out of a published
+// report, whichever encoding it used.
+static std::string g_last_diag;
+static uint64_t g_diag_count = 0, g_diag_bytes = 0;
+static std::string g_last_ack;
+static uint32_t g_ack_count = 0, g_ack_applied = 0;
+
+static void on_publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained) {
+    if (length == 0) return;
+    size_t tlen = strlen(topic);
+    if (tlen >= 5 && strcmp(topic + tlen - 5, "/diag") == 0) {
+        g_last_diag.assign((const char*)payload, length);
+        g_diag_count++;
+        g_diag_bytes += length;
+        return;
+    }
+    if (tlen >= 4 && strcmp(topic + tlen - 4, "/ack") == 0) {
+        g_last_ack.assign((const char*)payload, length);
+        g_ack_count++;
+        if (g_last_ack.find("\"result\":\"applied\"") != std::string::npos) g_ack_applied++;
+        return;
+    }
+    if (payload[0] == '{') {
+        std::string text((const char*)payload, length);
+        size_t at = text.find("\"energyIncrement\":");
+        if (at != std::string::npos) g_stats.delivered_kwh += strtod(text.c_str() + at + 18, nullptr);
+        size_t lt_at = text.find("\"lifetimeKwh\":");
+        if (lt_at != std::string::npos) add_delivered_lifetime(strtod(text.c_str() + lt_at + 14, nullptr));
+        size_t n_at = text.find("\"n\":"), max_at = text.find("\"max\":");
+        if (n_at != std::string::npos && max_at != std::string::npos)
+            add_delivered_stats((uint16_t)atoi(text.c_str() + n_at + 4), strtof(text.c_str() + max_at + 6, nullptr));
+        size_t boot_at = text.find("\"boot\":"), seq_at = text.find("\"seq\":"), ts_at = text.find("\"ts\":");
+        if (boot_at != std::string::npos && seq_at != std::string::npos)
+            add_delivered_identity((uint32_t)strtoul(text.c_str() + boot_at + 7, nullptr, 10),
+                                   (uint32_t)strtoul(text.c_str() + seq_at + 6, nullptr, 10),
+                                   ts_at != std::string::npos ? strtoull(text.c_str() + ts_at + 5, nullptr, 10) : 0, -1);
+    } else if (payload[0] == TELEMETRY_BINARY_VERSION && length >= TELEMETRY_BINARY_SIZE) {
+        add_delivered_binary(payload + 2, payload + TELEMETRY_BINARY_V1_SIZE);
+        add_delivered_identity_binary(payload + TELEMETRY_BINARY_V5_SIZE, -1);
+    } else if (payload[0] == TELEMETRY_BATCH_VERSION && length >= TELEMETRY_BATCH_HEADER_SIZE) {
+        size_t count = payload[1];
+        for (size_t i = 0; i < count; i++) {
+            const uint8_t* rec = payload + TELEMETRY_BATCH_HEADER_SIZE + i * TELEMETRY_BATCH_SAMPLE_SIZE;
+            if (rec + TELEMETRY_BATCH_SAMPLE_SIZE > payload + length) break;
+            add_delivered_binary(rec + 5, rec + TELEMETRY_BATCH_V2_SAMPLE_SIZE);
+            uint32_t age_ms;
+            memcpy(&age_ms, rec, sizeof(age_ms));
+            add_delivered_identity_binary(rec + TELEMETRY_BATCH_V6_SAMPLE_SIZE, age_ms);
+        }
+    }
+}
+
+static void boot_firmware(const Options& o) {
+    hal_serial_echo(o.serial);
+    hal_set_publish_sink(on_publish);
+    hal_set_sntp(1767225600000ULL, (uint32_t)(o.sntp_s * 1000));
+
+    // config.env comes from the uploadfs folder; anything the firmware writes goes to a scratch dir.
+    hal_set_fs_root(o.config_root);
+    SPIFFS.begin(true);
+    auto t0 = std::chrono::steady_clock::now();
+    env = ensureEnvInNVS();
+    auto t1 = std::chrono::steady_clock::now();
+    g_env_first_source = env_load_info().source;
+    if (env.ok) {
+        loadCredsFromNVS();
+        g_env_blob_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t1).count();
+        boot_mark(BootMark::config_ready);
+    }
+    g_env_first_ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+
+    mkdir(o.fs_root, 0755);
+    hal_set_fs_root(o.fs_root);
+    SPIFFS.remove("/readings.ring");
+
+    if (!env.ok) {
+        // No config.env under --config-root; the topic strings are all the sim needs.
+        strcpy(env.cid, "zot_plug_sim");
+        strcpy(env.sub, "zot_plug_sim/cmd/#");
+        strcpy(env.pub, "zot_plug_sim/data");
+        env.ok = true;
+    }
+    if (o.format) env.telemetry = parse_telemetry_format(o.format);
+    if (o.batch_samples >= 0) env.batchSamples = (uint8_t)o.batch_samples;
+    if (o.batch_age_s >= 0) env.batchMaxAgeS = (uint32_t)o.batch_age_s;
+    if (o.report_mode) env.reportMode = parse_report_mode(o.report_mode);
+    if (o.deadband_w >= 0) env.deadbandW = (float)o.deadband_w;
+    if (o.deadband_pct >= 0) env.deadbandPct = (float)o.deadband_pct;
+    if (o.heartbeat_s >= 0) env.heartbeatS = (uint32_t)o.heartbeat_s;
+
+    connect_setup_mqtt(env.ssid, env.pass, env.mqtt, 1883, fn_on_message_received);
+    check_maintain_mqtt_connection(env.cid, env.cuser, env.cpass, env.sub);
+
+    init_hardware();
+    if (o.interval_ms) timeInterval = o.interval_ms;
+    if (o.relay_off) set_relay(false);
+}
+
+template <typename Source>
+static void replay(Source& src, const Options& o, FILE* csv) {
+    using clock = std::chrono::steady_clock;
+    Stats& s = g_stats;
+    bool outage = o.outage_h > 0 && o.outage_at_h >= 0;
+    uint64_t outage_start_us = outage ? (uint64_t)(o.outage_at_h * 3600e6) : 0;
+    uint64_t outage_end_us = outage ? outage_start_us + (uint64_t)(o.outage_h * 3600e6) : 0;
+    // After the last edge, keep running (no load) until the backlog and any open
+    // batch are out, bounded in case the broker never returns. A synthetic run
+    // lasts --hours even without edges (a CT load has none).
+    uint64_t load_end_us = o.trace ? 0 : (uint64_t)(o.hours * 3600e6);
+    uint64_t tail_limit_us = 0;
+
+    Edge e;
+    bool have_edge = src.next(e);
+    double hook_ns = 0;
+    size_t next_cmd = 0;
+    std::string cmd_topic;
+
+    // The MQTT callback, as mqttTask's client.loop() would run it at the command's time.
+    auto deliver_commands = [&](uint64_t upto_us) {
+        while (next_cmd < o.commands.size() && o.commands[next_cmd].t_us <= upto_us && !hal_task_notified()) {
+            const SimCommand& c = o.commands[next_cmd++];
+            hal_set_time_us(c.t_us);
+            cmd_topic = std::string(env.cid) + "/cmd/" + c.topic;
+            fn_on_message_received(&cmd_topic[0], (byte*)c.payload.data(), (unsigned int)c.payload.size());
+        }
+    };
+
+    // Runs while hardwareTask sleeps: everything between its timer deadlines.
+    hal_set_idle_hook([&](uint64_t until_us) {
+        auto t0 = clock::now();
+        while (have_edge && e.t_us < until_us && !hal_task_notified()) {
+            deliver_commands(e.t_us);
+            if (hal_task_notified()) break;
+            hal_set_time_us(e.t_us);
+            hal_pin_edge(e.pin);
+            s.edges++;
+            if (e.pin == CF1_PIN) s.cf1_edges++;
+            have_edge = src.next(e);
+        }
+        if (!hal_task_notified()) deliver_commands(until_us - 1);
+        bool keep_going = true;
+        if (!have_edge && until_us > load_end_us) {
+            if (!tail_limit_us) tail_limit_us = hal_now_us() + (uint64_t)timeInterval * 1000 * 100000;
+            bool draining = reading_store_pending() > 0 || report_batch_count() > 0 || hal_now_us() < outage_end_us;
+            keep_going = draining && until_us < tail_limit_us;
+        }
+        if (keep_going && !hal_task_notified()) hal_set_time_us(until_us);
+        hook_ns += std::chrono::duration<double, std::nano>(clock::now() - t0).count();
+        return keep_going;
+    });
+
+    start_hardware_schedule();
+    uint32_t readings_seen = 0;
+    for (;;) {
+        hook_ns = 0;
+        auto t0 = clock::now();
+        uint32_t events = hardware_task_step();
+        double ns = std::chrono::duration<double, std::nano>(clock::now() - t0).count() - hook_ns;
+        if (!events) break;
+
+        s.wakes++;
+        s.step_ns_sum += ns;
+        uint64_t wake_us = hal_now_us();
+        (s.relay_was_on ? s.closed_us : s.open_us) += wake_us - s.last_wake_us;
+        s.last_wake_us = wake_us;
+        s.relay_was_on = relay_is_on();
+        if (policy_stats().trips != s.trips) {
+            s.trips = policy_stats().trips;
+            s.trip_ns_sum += ns;
+            if (ns > s.trip_ns_max) s.trip_ns_max = ns;
+        }
+
+        // mqttTask side, as the publish queue's notify would wake it.
+        uint64_t t_us = hal_now_us();
+        if (outage) hal_set_broker_up(t_us < outage_start_us || t_us >= outage_end_us);
+        uint32_t mqtt_t0 = micros();
+        check_maintain_mqtt_connection(env.cid, env.cuser, env.cpass, env.sub);
+        reading_clock_poll();
+        service_publish_queue();
+        diag_task_loop(DiagTask::mqtt, micros() - mqtt_t0);
+
+        // One per send_device_reading(); a diag command also goes through the queue.
+        const ReportPolicyStats& rs = report_policy_stats();
+        uint32_t readings = rs.interval + rs.heartbeat + rs.deadband + rs.relay;
+        if (readings == readings_seen) continue;
+        readings_seen = readings;
+
+        s.reports++;
+        s.call_ns_sum += ns;
+        if (ns > s.call_ns_max) s.call_ns_max = ns;
+        s.energy_kwh += energyIncrement;
+        s.amps_sum += amps;
+        s.power_sum += power;
+        if (power > s.power_max) s.power_max = power;
+        if (csv) fprintf(csv, "%.3f,%.6f,%.3f,%.12f,%.0f\n", t_us / 1e6, amps, power, energyIncrement, ns);
+    }
+}
+
+int main(int argc, char** argv) {
+    Options o;
+    if (!parse_args(argc, argv, o)) { usage(argv[0]); return 2; }
+
+    if (o.ct_amps > 0) {
+        double peak_counts = o.ct_amps * 1.41421356 / CT_AMPS_PER_COUNT;
+        // the load is downstream of the relay: no current while it is open
+        hal_set_ct_adc_source([peak_counts](double t_s) {
+            if (!relay_is_on()) return 2048;
+            return (int)lround(2048 + peak_counts * sin(2 * M_PI * CT_MAINS_HZ * t_s));
+        });
+    }
+    boot_firmware(o);
+
+    FILE* csv = nullptr;
+    if (o.csv) {
+        csv = fopen(o.csv, "w");
+        if (!csv) { perror(o.csv); return 1; }
+        fprintf(csv, "t_s,current_a,power_w,energy_increment_kwh,call_ns\n");
+    }
+
+    auto wall0 = std::chrono::steady_clock::now();
+    if (o.trace) {
+        TraceSource src(o.trace);
+        if (!src.ok()) { perror(o.trace); return 1; }
+        replay(src, o, csv);
+    } else {
+        SyntheticSource src(o.cf_hz, o.cf1_hz, o.jitter, (uint64_t)(o.hours * 3600e6));
+        replay(src, o, csv);
+    }
+    const Stats& s = g_stats;
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall0).count();
+    if (csv) fclose(csv);
+
+    double sim_s = hal_now_us() / 1e6;
+    double n = s.reports ? (double)s.reports : 1.0;
+    printf("simulated   %.3f h in %.3f s wall (%.0fx real time)\n", sim_s / 3600, wall_s, wall_s > 0 ? sim_s / wall_s : 0);
+    printf("edges       %llu (cf %llu, cf1 %llu)\n", (unsigned long long)s.edges,
+           (unsigned long long)(s.edges - s.cf1_edges), (unsigned long long)s.cf1_edges);
+#if METERING_BACKEND == METERING_BACKEND_HLW8012
+    uint64_t irqs = hal_interrupt_count(CF_PIN) + hal_interrupt_count(CF1_PIN) + hal_pcnt_interrupt_count();
+    printf("inputs      %s mode, %llu interrupts (%.3f/s; %llu GPIO, %llu PCNT overflow)\n", pulse_input_mode_name(),
+           (unsigned long long)irqs, sim_s > 0 ? irqs / sim_s : 0.0, (unsigned long long)(irqs - hal_pcnt_interrupt_count()),
+           (unsigned long long)hal_pcnt_interrupt_count());
+#endif
+    printf("reports     %llu, timer every %u ms, %llu published (%llu bytes)\n", (unsigned long long)s.reports, report_policy_period_ms(timeInterval),
+           (unsigned long long)hal_publish_count(), (unsigned long long)hal_publish_bytes());
+    printf("energy      %.9f kWh measured, %.9f kWh delivered (%.3g kWh unaccounted)\n",
+           s.energy_kwh, s.delivered_kwh, s.energy_kwh - s.delivered_kwh);
+    printf("current     mean %.4f A\n", s.amps_sum / n);
+    printf("power       mean %.3f W, max %.3f W\n", s.power_sum / n, s.power_max);
+    if (s.open_us > 0) {
+        // An open relay meters nothing, so the energy can't beat the peak power over the closed time.
+        double closed_kwh = s.power_max * s.closed_us / 3.6e12;
+        printf("relay open  %.3f h of %.3f h: %.9f kWh measured, at most %.9f kWh at peak power while closed (%s)\n",
+               s.open_us / 3.6e9, (s.open_us + s.closed_us) / 3.6e9, s.energy_kwh, closed_kwh,
+               s.energy_kwh <= closed_kwh * 1.001 ? "ok" : "OVER: open time was metered");
+    }
+    const ReportPolicyStats& rp = report_policy_stats();
+    printf("reasons     %s mode: %u interval, %u heartbeat, %u deadband, %u relay (%u quiet windows, %u transients)\n",
+           report_mode_name(report_policy().mode), rp.interval, rp.heartbeat, rp.deadband, rp.relay, rp.windows_quiet,
+           rp.transients);
+    printf("win stats   %.1f windows per report, max window %.3f W delivered\n",
+           s.stat_windows / n, s.stat_max);
+    printf("report wake mean %.0f ns, max %.0f ns\n", s.call_ns_sum / n, s.call_ns_max);
+
+    // Firmware code doesn't advance the virtual clock, so the scheduler's own idle figure
+    // is ~100% here; the duty line charges the host's wall-clock ns per wake instead.
+    const SchedulerStats& ss = scheduler_stats();
+    printf("scheduler   %llu wakes (%.2f/s), idle %.3f%%, jitter mean %.1f us, max %u us\n",
+           (unsigned long long)s.wakes, sim_s > 0 ? s.wakes / sim_s : 0.0, scheduler_idle_percent(),
+           ss.timer_events ? (double)ss.jitter_sum_us / ss.timer_events : 0.0, ss.jitter_max_us);
+    printf("duty        %.0f ns firmware per wake, %.6f%% of one core (old poll loop: 100%%)\n",
+           s.wakes ? s.step_ns_sum / s.wakes : 0.0, sim_s > 0 ? 100.0 * s.step_ns_sum / (sim_s * 1e9) : 0.0);
+
+    const PublishQueueStats& qs = publish_queue_stats();
+    printf("queue       %u pushed, %u dropped, max depth %u/%u, enqueue->wire mean %.1f ms, max %.1f ms\n",
+           qs.pushed, qs.dropped, qs.depth_max, (unsigned)PUBLISH_QUEUE_CAPACITY,
+           qs.latency_count ? qs.latency_sum_us / 1e3 / qs.latency_count : 0.0, qs.latency_max_us / 1e3);
+
+
+    // A seq that never arrived is a reading the publish queue or a full store dropped (its energy rode along).
+    uint64_t seen = 0;
+    for (bool b : g_seen_seq) seen += b;
+    printf("identity    %llu readings, boot %u, seq 1..%u: %llu missing, %llu duplicate, %llu out of order; "
+           "%llu with a capture time (%u SNTP syncs), max error %.0f ms, max delivery lag %.1f s\n",
+           (unsigned long long)s.readings, s.boot_id, s.seq_max, (unsigned long long)(s.seq_max - seen),
+           (unsigned long long)s.duplicates, (unsigned long long)s.out_of_order, (unsigned long long)s.stamped,
+           reading_clock_stats().syncs, s.ts_err_max_ms, s.ts_lag_max_s);
+
+    const ReadingStoreStats& rs = reading_store_stats();
+    printf("store       %u stored, %u drained, %u pending, %u overflowed, %u corrupt\n",
+           rs.appended, rs.drained, reading_store_pending(), rs.overflowed, rs.corrupt);
+    const ReportBatchStats& bs = report_batch_stats();
+    if (bs.batches) {
+        printf("batches     %u carrying %u readings (flush: %u full, %u age, %u relay)\n",
+               bs.batches, bs.samples, bs.flush_full, bs.flush_age, bs.flush_relay);
+    }
+    printf("flash       %u writes (%u bytes), %u NVS checkpoints\n", rs.flash_writes, rs.flash_bytes, rs.nvs_writes);
+    const MqttLinkStats& ls = mqtt_link_stats();
+    printf("link        %u MQTT attempts, %u failed, %u reconnects, last backoff %u ms, %u publishes refused\n",
+           ls.mqtt_attempts, ls.mqtt_failures, ls.reconnects, ls.last_backoff_ms, ls.publish_failures);
+    if (!o.commands.empty()) {
+        const CommandStats& cs = command_stats();
+        printf("commands    %u received, %u applied, %u unknown, %u rejected, %u dropped; callback mean %.1f us, max %u us\n",
+               cs.received, cs.applied, cs.unknown, cs.rejected, cs.dropped,
+               cs.received ? (double)cs.callback_sum_us / cs.received : 0.0, cs.callback_max_us);
+        printf("            now: relay %s, interval %u ms, window %u ms, %s mode; tuning saved %u times\n",
+               relay_is_on() ? "on" : "off", timeInterval, Meter::window_ms(), report_mode_name(report_policy().mode),
+               tuning_stats().saves);
+        if (g_ack_count)
+            printf("            %u acks (%u applied, %u refused), last: %s\n", g_ack_count, g_ack_applied,
+                   g_ack_count - g_ack_applied, g_last_ack.c_str());
+        // What init_hardware() would pick up after a reboot against the same NVS.
+        Tuning saved = tuning_load();
+        printf("            after reboot: interval %u ms, window %u ms (0: default), cal gain %.3f, %u bands, %s mode\n",
+               saved.interval_ms ? saved.interval_ms : (unsigned)DEFAULT_REPORT_INTERVAL_MS, saved.window_ms,
+               saved.cal_gain > 0.0f ? saved.cal_gain : 1.0f, saved.band_count,
+               saved.has_policy ? report_mode_name(saved.policy.mode) : "config.env");
+    }
+    // Firmware code doesn't advance the virtual clock: busy times, CPU shares and the
+    // histograms' upper buckets are 0 here, and the host has no heap or stack figures.
+    if (g_diag_count) {
+        printf("diag        %llu messages (%.0f B each, %.0f B/h)\n", (unsigned long long)g_diag_count,
+               (double)g_diag_bytes / g_diag_count, sim_s > 0 ? g_diag_bytes * 3600.0 / sim_s : 0.0);
+        printf("            last: %s\n", g_last_diag.c_str());
+    }
+
+    if (o.policy.count) {
+        const PolicyStats& ps = policy_stats();
+        printf("policy      %u rules (%s), %u windows evaluated, %u violations, %u trips; relay %s\n",
+               policy_active().count, o.policy_report_only ? "report only" : "enforced", ps.evaluations,
+               ps.violations, ps.trips, relay_is_on() ? "on" : "off");
+        if (ps.last_rule >= 0)
+            printf("            last: rule %d %s at %.3f, %.3f Wh today\n", ps.last_rule, policy_rule_name(ps.last_type),
+                   ps.last_value, ps.energy_today_wh);
+        // Firmware code doesn't advance the virtual clock, so the device's own figure is 0 here;
+        // the host time of the whole tripping wake (sample, evaluate, relay off, enqueue) stands in.
+        if (s.trips)
+            printf("            detection -> relay off: wake mean %.0f ns, max %.0f ns host (%u us on the virtual clock)\n",
+                   s.trip_ns_sum / s.trips, s.trip_ns_max, ps.trip_max_us);
+    }
+
+    if (g_env_first_source != EnvSource::none) {
+        printf("config      first boot %.1f us (%s), reboot %.1f us (%s); first publish at %.1f ms virtual\n",
+               g_env_first_ns / 1e3, g_env_first_source == EnvSource::spiffs ? "config.env + migrate" : "nvs blob",
+               g_env_blob_ns / 1e3, env_load_info().migrated ? "nvs blob" : "config.env again, blob not written",
+               boot_mark_us(BootMark::first_publish) / 1e3);
+    }
+
+    // Reboot the register against the same NVS: it must resume at or above anything delivered.
+    double lifetime = energy_register_kwh();
+    uint32_t checkpoints = energy_register_stats().checkpoints;
+    energy_register_init();
+    const EnergyRegisterStats& es = energy_register_stats();
+    printf("lifetime    %.9f kWh register, %.9f kWh delivered, %u NVS checkpoints; after reboot %.9f kWh (%s)\n",
+           lifetime, s.lifetime_kwh, checkpoints, es.restored_kwh,
+           es.restored_kwh >= s.lifetime_kwh && es.restored_kwh >= lifetime ? "monotonic" : "WENT BACKWARD");
+    return 0;
+}
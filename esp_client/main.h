@@ -4,3 +4,17 @@
 extern Env env;
 void mqttTask(void * parameter);
 void hardwareTask(void * parameter);
+
+/* Exposed for the host simulator (host/sim), which drives these without the FreeRTOS tasks */
+extern unsigned int timeInterval;
+extern double energyIncrement;
+extern int volts;
+extern double amps;
+extern double power;
+void init_hardware();
+void start_hardware_schedule();
+uint32_t hardware_task_step();
+void send_device_reading(ReportReason reason);
+void set_relay(bool on);
+void service_publish_queue();
+void fn_on_message_received(char* topic, byte* payload, unsigned int length);
@@ -0,0 +1,45 @@
+#include "boot_metrics.h"
+#include "../env_config/env_config.h"
+#include "../diagnostics/log.h"
+#include <esp_timer.h>
+
+static int64_t g_marks_us[(size_t)BootMark::count] = { -1, -1, -1, -1 };
+
+static const char* source_name(EnvSource s) {
+    switch (s) {
+        case EnvSource::nvs_blob: return "nvs blob";
+        case EnvSource::spiffs: return "config.env, migrated";
+        default: return "none";
+    }
+}
+
+void boot_mark(BootMark m) {
+    int64_t& at = g_marks_us[(size_t)m];
+    if (at >= 0) return;
+    at = esp_timer_get_time();
+    if (m == BootMark::first_publish) boot_metrics_print();
+}
+
+int64_t boot_mark_us(BootMark m) {
+    return g_marks_us[(size_t)m];
+}
+
+static void print_ms(const char* label, BootMark m) {
+    LOG_PRINT(label);
+    if (boot_mark_us(m) < 0) LOG_PRINT("-");
+    else { LOG_PRINT(boot_mark_us(m) / 1000.0, 1); LOG_PRINT(" ms"); }
+}
+
+void boot_metrics_print() {
+    const EnvLoadInfo& env = env_load_info();
+    print_ms("boot: config ", BootMark::config_ready);
+    LOG_PRINT(" (");
+    LOG_PRINT(source_name(env.source));
+    LOG_PRINT(", ");
+    LOG_PRINT(env.load_us / 1000.0, 1);
+    LOG_PRINT(" ms)");
+    print_ms(", wifi ", BootMark::wifi_connected);
+    print_ms(", mqtt ", BootMark::mqtt_connected);
+    print_ms(", first publish ", BootMark::first_publish);
+    LOG_PRINTLN();
+}
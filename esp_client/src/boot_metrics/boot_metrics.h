@@ -0,0 +1,25 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+  Boot-time milestones, in microseconds since the app started (esp_timer_get_time();
+  the ~0.3 s ROM/second-stage bootloader before that isn't visible to the app).
+
+  Each milestone is recorded the first time it's reached and never again, so the
+  calls can sit on hot paths (publish_message) at the cost of one compare. When
+  the first publish lands the whole timeline is printed once:
+
+    boot: config 4.1 ms (nvs blob, 0.9 ms), wifi 1830.2 ms, mqtt 1912.7 ms, first publish 3010.4 ms
+*/
+
+enum class BootMark : uint8_t {
+    config_ready,     // Env loaded (ensureEnvInNVS returned ok)
+    wifi_connected,
+    mqtt_connected,
+    first_publish,    // first publish the client accepted
+    count
+};
+
+void boot_mark(BootMark m);
+int64_t boot_mark_us(BootMark m);    // -1 until reached
+void boot_metrics_print();
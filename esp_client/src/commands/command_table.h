@@ -0,0 +1,114 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+  Building blocks for the MQTT command table (commands.cpp).
+
+  Command names are keyed by a 32-bit FNV-1a hash, computed at compile time
+  for the table and once per message for the topic. A lookup is one pass over
+  the name, a scan of the table's hashes, then one strcmp() to confirm the match,
+  where a strcmp() chain pays a compare per command ahead of it: command_bench
+  has it at about half the time over the 14 names. That doesn't make dispatch as
+  a whole cheaper than the two-name callback it replaced; the queue hand-off costs
+  more than the lookup saves. The time saved inside client.loop() is the Serial echo.
+  command_table_unique() lets the table static_assert that no two names collide.
+
+  PayloadReader walks the PubSubClient payload buffer in place: it is not NUL
+  terminated and is never copied, so numbers are parsed straight from the bytes.
+  Arguments are separated by ',', ';' or whitespace.
+*/
+
+static constexpr uint32_t FNV1A_BASIS = 2166136261u;
+static constexpr uint32_t FNV1A_PRIME = 16777619u;
+
+// C++11 constexpr: one return statement, recursion instead of a loop.
+constexpr uint32_t command_hash(const char* s, uint32_t h = FNV1A_BASIS) {
+    return *s ? command_hash(s + 1, (h ^ (uint8_t)*s) * FNV1A_PRIME) : h;
+}
+
+// Same hash at run time, as a loop.
+static inline uint32_t command_hash_rt(const char* s) {
+    uint32_t h = FNV1A_BASIS;
+    while (*s) h = (h ^ (uint8_t)*s++) * FNV1A_PRIME;
+    return h;
+}
+
+template <typename Entry>
+constexpr bool command_table_unique(const Entry* t, size_t n, size_t i = 0, size_t j = 1) {
+    return i >= n ? true
+         : j >= n ? command_table_unique(t, n, i + 1, i + 2)
+         : t[i].hash != t[j].hash && command_table_unique(t, n, i, j + 1);
+}
+
+struct PayloadReader {
+    const uint8_t* p;
+    const uint8_t* end;
+};
+
+static inline bool payload_separator(uint8_t c) {
+    return c == ',' || c == ';' || c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline void payload_skip(PayloadReader& r) {
+    while (r.p < r.end && payload_separator(*r.p)) r.p++;
+}
+
+// True once only separators are left.
+static inline bool payload_done(PayloadReader& r) {
+    payload_skip(r);
+    return r.p == r.end;
+}
+
+// [+-]digits[.digits]. False (reader unchanged) if there is no number next.
+static inline bool payload_float(PayloadReader& r, float& out) {
+    payload_skip(r);
+    const uint8_t* p = r.p;
+    bool neg = false;
+    if (p < r.end && (*p == '-' || *p == '+')) neg = *p++ == '-';
+    float v = 0.0f, scale = 1.0f;
+    bool digits = false, frac = false;
+    for (; p < r.end; p++) {
+        uint8_t c = *p;
+        if (c >= '0' && c <= '9') {
+            if (frac) { scale *= 0.1f; v += (c - '0') * scale; }
+            else v = v * 10.0f + (c - '0');
+            digits = true;
+        } else if (c == '.' && !frac) {
+            frac = true;
+        } else {
+            break;
+        }
+    }
+    if (!digits || (p < r.end && !payload_separator(*p))) return false;
+    out = neg ? -v : v;
+    r.p = p;
+    return true;
+}
+
+// The next run of non-separator bytes, pointed to in place (not NUL terminated).
+static inline bool payload_word(PayloadReader& r, const char*& word, size_t& len) {
+    payload_skip(r);
+    const uint8_t* p = r.p;
+    while (p < r.end && !payload_separator(*p)) p++;
+    if (p == r.p) return false;
+    word = (const char*)r.p;
+    len = (size_t)(p - r.p);
+    r.p = p;
+    return true;
+}
+
+// A whole number within [lo, hi].
+static inline bool payload_uint(PayloadReader& r, uint32_t lo, uint32_t hi, uint32_t& out) {
+    payload_skip(r);
+    const uint8_t* p = r.p;
+    uint64_t v = 0;
+    for (; p < r.end && *p >= '0' && *p <= '9'; p++) {
+        v = v * 10 + (*p - '0');
+        if (v > hi) return false;
+    }
+    if (p == r.p || (p < r.end && !payload_separator(*p)) || v < lo) return false;
+    out = (uint32_t)v;
+    r.p = p;
+    return true;
+}
@@ -0,0 +1,236 @@
+#include "commands.h"
+#include "command_table.h"
+#include "../publish_queue/spsc_queue.h"
+#include "../scheduler/scheduler.h"
+#include "../hardware_config/relay/relay.h"
+
+static SpscQueue<Command, COMMAND_QUEUE_CAPACITY> queue;
+static SpscQueue<PolicySet, 2> policies;
+static SpscQueue<CommandAck, COMMAND_REFUSED_CAPACITY> refused;   // mqttTask on both ends
+static CommandStats stats = {};
+
+/* === Payload parsers: false rejects the command === */
+
+static bool no_args(PayloadReader& in, Command& out) {
+    (void)in; (void)out;
+    return true;   // a payload is allowed and ignored (the REST publish route may send one)
+}
+
+static bool parse_interval(PayloadReader& in, Command& out) {
+    return payload_uint(in, 1000, 3600000, out.ms) && payload_done(in);
+}
+
+static bool parse_window(PayloadReader& in, Command& out) {
+    return payload_uint(in, 1, 60000, out.ms) && payload_done(in);
+}
+
+static bool parse_deadband(PayloadReader& in, Command& out) {
+    while (out.argc < 3 && payload_float(in, out.arg[out.argc])) {
+        if (out.arg[out.argc] < 0.0f) return false;
+        out.argc++;
+    }
+    return out.argc >= 2 && payload_done(in);
+}
+
+static bool parse_mode(PayloadReader& in, Command& out) {
+    const char* word;
+    size_t len;
+    if (!payload_word(in, word, len)) return false;
+    const ReportMode modes[] = { ReportMode::interval, ReportMode::exception, ReportMode::adaptive };
+    bool found = false;
+    for (ReportMode m : modes) {
+        const char* name = report_mode_name(m);
+        if (strlen(name) == len && strncasecmp(name, word, len) == 0) { out.mode = m; found = true; }
+    }
+    if (!found) return false;
+    if (payload_float(in, out.arg[0])) {
+        if (out.arg[0] < 1.0f || out.arg[0] > 86400.0f) return false;   // heartbeat s
+        out.argc = 1;
+    }
+    return payload_done(in);
+}
+
+static bool parse_bands(PayloadReader& in, Command& out) {
+    while (out.argc < COMMAND_MAX_ARGS && payload_float(in, out.arg[out.argc])) out.argc++;
+    if (out.argc % 2 != 0 || !payload_done(in)) return false;
+    for (uint8_t i = 0; i < out.argc; i += 2) {
+        if (out.arg[i] < 0.0f || out.arg[i + 1] <= 0.0f || out.arg[i + 1] > 10.0f) return false;
+        if (i > 0 && out.arg[i] >= out.arg[i - 2]) return false;   // thresholds must fall
+    }
+    return true;
+}
+
+// Binary, not text: decoded straight from the payload; dispatch() posts it to the
+// policy mailbox once its command is sure to be queued.
+static PolicySet policy_in;   // mqttTask only
+
+static bool parse_policy(PayloadReader& in, Command& out) {
+    (void)out;
+    return policy_decode(in.p, (size_t)(in.end - in.p), policy_in);
+}
+
+static bool parse_time(PayloadReader& in, Command& out) {
+    return payload_uint(in, 0, 86399, out.ms) && payload_done(in);
+}
+
+static bool parse_diag_period(PayloadReader& in, Command& out) {
+    if (!payload_uint(in, 0, 86400, out.ms) || !payload_done(in)) return false;
+    return out.ms == 0 || out.ms >= 10;
+}
+
+static bool parse_calibration(PayloadReader& in, Command& out) {
+    while (out.argc < 2 && payload_float(in, out.arg[out.argc])) out.argc++;
+    if (out.argc < 1 || !payload_done(in)) return false;
+    if (out.arg[0] < 0.1f || out.arg[0] > 10.0f) return false;     // gain
+    return out.argc < 2 || (out.arg[1] >= 0.0f && out.arg[1] <= 20.0f);   // offset A
+}
+
+/* === The table === */
+
+struct CommandEntry {
+    uint32_t hash;
+    const char* name;
+    CommandId id;
+    bool (*parse)(PayloadReader& in, Command& out);
+};
+
+#define COMMAND(name, id, parse) { command_hash(name), name, id, parse }
+static constexpr CommandEntry COMMANDS[] = {
+    COMMAND("relay/on",     CommandId::relay_on,     no_args),
+    COMMAND("relay/off",    CommandId::relay_off,    no_args),
+    COMMAND("relay/toggle", CommandId::relay_toggle, no_args),
+    COMMAND("interval",     CommandId::interval,     parse_interval),
+    COMMAND("window",       CommandId::window,       parse_window),
+    COMMAND("deadband",     CommandId::deadband,     parse_deadband),
+    COMMAND("mode",         CommandId::report_mode,  parse_mode),
+    COMMAND("cal",          CommandId::calibrate,    parse_calibration),
+    COMMAND("bands",        CommandId::bands,        parse_bands),
+    COMMAND("tune/reset",   CommandId::tune_reset,   no_args),
+    COMMAND("policy",       CommandId::policy,       parse_policy),
+    COMMAND("time",         CommandId::time,         parse_time),
+    COMMAND("diag",         CommandId::diag,         no_args),
+    COMMAND("diag/every",   CommandId::diag_every,   parse_diag_period),
+};
+#undef COMMAND
+static constexpr size_t COMMAND_COUNT = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+static_assert(command_table_unique(COMMANDS, COMMAND_COUNT), "command name hash collision, rename one");
+
+static const CommandEntry* find_command(const char* name) {
+    uint32_t h = command_hash_rt(name);
+    for (const CommandEntry& e : COMMANDS) {
+        // The hash picks the entry; the compare keeps an unknown name that collides out.
+        if (e.hash == h) return strcmp(e.name, name) == 0 ? &e : nullptr;
+    }
+    return nullptr;
+}
+
+uint32_t command_take_ack_id(char* name) {
+    char* at = strrchr(name, '@');
+    if (!at) return 0;
+    uint64_t id = 0;
+    const char* p = at + 1;
+    for (; *p >= '0' && *p <= '9' && id <= UINT32_MAX; p++) id = id * 10 + (*p - '0');
+    if (*p != '\0' || p == at + 1 || id == 0 || id > UINT32_MAX) return 0;   // left in: an unknown name
+    *at = '\0';
+    return (uint32_t)id;
+}
+
+static DispatchResult dispatch(Command& cmd, const char* name, const uint8_t* payload, unsigned int length) {
+    const CommandEntry* e = find_command(name);
+    if (!e) { stats.unknown++; return DispatchResult::unknown; }
+
+    cmd.id = e->id;
+    PayloadReader in = { payload, payload + length };
+    if (!e->parse(in, cmd)) { stats.rejected++; return DispatchResult::rejected; }
+
+    // Room is checked first so a policy set is never left in the mailbox without its
+    // command; only hardwareTask pops, so the room can't go away before the push.
+    if (queue.size() == queue.capacity() || (cmd.id == CommandId::policy && !policies.push(policy_in))) {
+        stats.dropped++;
+        return DispatchResult::dropped;
+    }
+    queue.push(cmd);
+    scheduler_notify(SCHED_EVT_MESSAGE);
+    return DispatchResult::queued;
+}
+
+// Refused here, so acked from here; the relay state is hardwareTask's but only read.
+static void refuse(const Command& cmd, DispatchResult r) {
+    CommandAck ack = { cmd.ack_id, cmd.id, r, relay_is_on(), cmd.rx_ms, cmd.rx_ms, 0 };
+    refused.push(ack);   // full: the sender times out, like a lost ack
+}
+
+DispatchResult command_dispatch(char* name, const uint8_t* payload, unsigned int length) {
+    uint32_t t0 = micros();
+    stats.received++;
+    Command cmd = {};
+    cmd.id = COMMAND_UNKNOWN;
+    cmd.ack_id = command_take_ack_id(name);
+    cmd.rx_ms = millis();
+    cmd.rx_us = t0;
+    DispatchResult r = dispatch(cmd, name, payload, length);
+    if (r != DispatchResult::queued && cmd.ack_id) refuse(cmd, r);
+    uint32_t us = micros() - t0;
+    stats.callback_sum_us += us;
+    if (us > stats.callback_max_us) stats.callback_max_us = us;
+    return r;
+}
+
+bool command_pop(Command& out) {
+    if (!queue.pop(out)) return false;
+    stats.applied++;
+    return true;
+}
+
+bool command_take_policy(PolicySet& out) {
+    bool any = false;
+    while (policies.pop(out)) any = true;
+    return any;
+}
+
+CommandAck command_applied(const Command& cmd, bool relay) {
+    uint32_t us = micros() - cmd.rx_us;
+    if (us > stats.apply_max_us) stats.apply_max_us = us;
+    stats.acks++;
+    return { cmd.ack_id, cmd.id, DispatchResult::queued, relay, cmd.rx_ms, (uint32_t)millis(), us };
+}
+
+bool command_ack_pop(CommandAck& out) {
+    return refused.pop(out);
+}
+
+static const char* ack_result_name(DispatchResult r) {
+    switch (r) {
+        case DispatchResult::queued:   return "applied";
+        case DispatchResult::unknown:  return "unknown";
+        case DispatchResult::rejected: return "rejected";
+        case DispatchResult::dropped:  return "dropped";
+    }
+    return "?";
+}
+
+size_t command_ack_json(const CommandAck& ack, uint64_t rx_unix_ms, uint64_t applied_unix_ms, char* out, size_t cap) {
+    int len = snprintf(out, cap,
+        "{\"id\":%lu,\"cmd\":\"%s\",\"result\":\"%s\",\"relay\":%d,\"rxMs\":%lu,\"appliedMs\":%lu,\"applyUs\":%lu",
+        (unsigned long)ack.id, command_name(ack.cmd), ack_result_name(ack.result), ack.relay ? 1 : 0,
+        (unsigned long)ack.rx_ms, (unsigned long)ack.applied_ms, (unsigned long)ack.apply_us);
+    if (len > 0 && rx_unix_ms && (size_t)len < cap)
+        len += snprintf(out + len, cap - len, ",\"rxTs\":%llu,\"appliedTs\":%llu",
+                        (unsigned long long)rx_unix_ms, (unsigned long long)applied_unix_ms);
+    if (len <= 0 || (size_t)len + 1 >= cap) return 0;
+    out[len++] = '}';
+    return (size_t)len;
+}
+
+bool command_find(const char* name, CommandId& out) {
+    const CommandEntry* e = find_command(name);
+    if (e) out = e->id;
+    return e != nullptr;
+}
+
+const char* command_name(CommandId id) {
+    for (const CommandEntry& e : COMMANDS) if (e.id == id) return e.name;
+    return "?";
+}
+
+const CommandStats& command_stats() { return stats; }
@@ -0,0 +1,134 @@
+#pragma once
+#include <Arduino.h>
+#include "../telemetry/report_policy.h"
+#include "../policy/policy.h"
+
+/*
+  MQTT commands, "<cid>/cmd/<name>" with a plain-text payload:
+
+    name          payload                         effect
+    relay/on      -                               close the relay
+    relay/off     -                               open the relay
+    relay/toggle  -                               flip it
+    interval      <ms>                            report interval (1 s .. 1 h)
+    window        <ms>                            measurement window (backend clamps it)
+    deadband      <W>,<pct>[,<heartbeat s>]       report by exception; 0,0 goes back to
+                                                  interval (adaptive mode keeps its mode)
+    mode          interval|exception|adaptive     report mode (report_policy.h); the
+                  [,<heartbeat s>]                heartbeat also caps the adaptive period
+    cal           <gain>[,<offset A>]             current calibration: gain on the
+                                                  build-time A/Hz (A/count for the CT),
+                                                  HLW8012 base offset
+    bands         <A>,<scale>[,<A>,<scale>]...    HLW8012 calibration bands, highest
+                                                  threshold first; no payload: built-in
+    tune/reset    -                               forget the saved tuning at next boot
+    policy        binary policy set (policy.h)    replace the local policy rules
+    time          <s since local midnight>        local clock for schedule rules
+    diag          -                               publish "<cid>/diag" once
+    diag/every    <s>                             periodic diag (10 s .. 1 day), 0: off
+
+  Everything but the relay commands, diag and tune/reset is saved to NVS and
+  restored at boot (tuning.h); the policy set is saved by policy.h.
+  A policy set is too big for a Command: it is decoded into a two-slot SPSC
+  mailbox and hardwareTask takes the newest one with command_take_policy().
+
+  command_dispatch() runs in the PubSubClient callback, i.e. inside
+  client.loop() on mqttTask, so it only looks the name up in a constexpr
+  hashed table (command_table.h) and parses the payload in place into a
+  Command; it never copies, allocates or prints. The Command goes through a
+  SPSC queue to hardwareTask (SCHED_EVT_MESSAGE), which owns the relay, meter
+  and timers and applies it with command_pop(), then hands its ack back through
+  the publish queue (command_applied()). Acks for refused commands stay on
+  mqttTask (command_ack_pop()).
+
+  Acks: a command sent to "<cid>/cmd/<name>@<id>" (id 1 .. 2^32-1) is answered on
+  "<cid>/ack" once hardwareTask has applied it, or right away when it is refused:
+
+    {"id":42,"cmd":"relay/on","result":"applied","relay":1,"rxMs":81234,"appliedMs":81235,
+     "applyUs":740,"rxTs":1767225681234,"appliedTs":1767225681235}
+
+  result is applied, unknown, rejected or dropped (as DispatchResult); relay is the
+  relay state after the command. rxMs/appliedMs are millis() at receipt and once
+  applied (for the relay commands: the pin written), applyUs the time between them;
+  rxTs/appliedTs are the same in unix ms (reading_clock.h), left out before the
+  first SNTP sync. Commands without an id aren't acked.
+*/
+
+#ifndef COMMAND_QUEUE_CAPACITY
+#define COMMAND_QUEUE_CAPACITY 8   // power of two
+#endif
+
+#ifndef COMMAND_REFUSED_CAPACITY
+#define COMMAND_REFUSED_CAPACITY 4   // power of two; acks for refused commands waiting for mqttTask
+#endif
+
+enum class CommandId : uint8_t {
+    relay_on, relay_off, relay_toggle, interval, window, deadband, report_mode, calibrate, bands,
+    tune_reset, policy, time, diag, diag_every
+};
+
+// An unknown command, in its ack: not in the table, so command_name() gives "?".
+constexpr CommandId COMMAND_UNKNOWN = (CommandId)0xFF;
+
+constexpr size_t COMMAND_MAX_ARGS = 10;
+
+struct Command {
+    CommandId id;
+    uint8_t argc;        // arguments given (optional ones may be missing)
+    ReportMode mode;     // mode
+    uint32_t ms;         // interval, window; time: seconds since local midnight; diag/every: s
+    uint32_t ack_id;     // the "@<id>" of the topic, 0: no ack wanted
+    uint32_t rx_ms;      // millis() / micros() in command_dispatch()
+    uint32_t rx_us;
+    float arg[COMMAND_MAX_ARGS];   // deadband W/pct/heartbeat s, mode heartbeat s,
+                                   // cal gain/offset, bands A/scale pairs
+};
+
+enum class DispatchResult : uint8_t { queued, unknown, rejected, dropped };
+
+struct CommandAck {
+    uint32_t id;
+    CommandId cmd;           // COMMAND_UNKNOWN for an unknown name
+    DispatchResult result;   // queued: applied
+    bool relay;
+    uint32_t rx_ms;
+    uint32_t applied_ms;     // rx_ms when refused
+    uint32_t apply_us;
+};
+
+struct CommandStats {
+    uint32_t received;
+    uint32_t unknown;          // no such command
+    uint32_t rejected;         // payload missing, malformed or out of range
+    uint32_t dropped;          // hardwareTask queue full
+    uint32_t applied;          // popped by hardwareTask
+    uint32_t acks;             // applied commands acked (refused ones: unknown/rejected/dropped)
+    uint32_t apply_max_us;     // receipt -> applied, of those
+    uint32_t callback_max_us;  // command_dispatch() time
+    uint64_t callback_sum_us;
+};
+
+/* === mqttTask (PubSubClient callback) === */
+// name: the topic after "<cid>/cmd/", NUL terminated (PubSubClient terminates the topic);
+// an "@<id>" suffix is cut off in place.
+DispatchResult command_dispatch(char* name, const uint8_t* payload, unsigned int length);
+
+/* === mqttTask === */
+// Acks for commands refused by command_dispatch(), oldest first.
+bool command_ack_pop(CommandAck& out);
+// "<cid>/ack" payload; unix ms of 0 leave rxTs/appliedTs out. Returns the length, 0 if it didn't fit.
+size_t command_ack_json(const CommandAck& ack, uint64_t rx_unix_ms, uint64_t applied_unix_ms, char* out, size_t cap);
+
+/* === hardwareTask === */
+bool command_pop(Command& out);
+// The newest policy set received; false if none is waiting.
+bool command_take_policy(PolicySet& out);
+// Right after applying cmd (cmd.ack_id != 0): its ack, with relay the state it left.
+CommandAck command_applied(const Command& cmd, bool relay);
+
+// Cuts "@<id>" off the end of name and returns the id; 0 (name untouched) if there is no valid one.
+uint32_t command_take_ack_id(char* name);
+bool command_find(const char* name, CommandId& out);
+
+const char* command_name(CommandId id);
+const CommandStats& command_stats();
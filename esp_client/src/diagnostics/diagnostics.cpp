@@ -0,0 +1,109 @@
+#include "diagnostics.h"
+#include "../hardware_config/current_sensor/metering_backend.h"
+
+static constexpr size_t TASKS = (size_t)DiagTask::count;
+static const char* const TASK_KEYS[TASKS] = { "mqtt", "hw" };
+
+struct TaskCounters {
+    // written by the task
+    uint32_t loops;
+    uint32_t busy_us;        // wraps; only deltas are reported
+    uint32_t max_us;
+    uint32_t hist[DIAG_LATENCY_BUCKETS];
+    // written by diag_task_start() / the reader
+    TaskHandle_t handle;
+    volatile bool max_reset;
+};
+
+struct Snapshot {
+    uint32_t at_ms;
+    uint32_t loops[TASKS];
+    uint32_t busy_us[TASKS];
+    uint32_t hist[TASKS][DIAG_LATENCY_BUCKETS];
+    MeterInputStats inputs;
+};
+
+static TaskCounters g_tasks[TASKS] = {};
+static Snapshot g_last = {};
+
+static size_t bucket_of(uint32_t us) {
+    if (us < 64) return 0;
+    size_t b = ((32 - __builtin_clz(us)) - 7) / 2 + 1;   // 64 << 2(b-1) <= us
+    return b < DIAG_LATENCY_BUCKETS ? b : DIAG_LATENCY_BUCKETS - 1;
+}
+
+void diag_task_start(DiagTask t) {
+    g_tasks[(size_t)t].handle = xTaskGetCurrentTaskHandle();
+}
+
+void diag_task_loop(DiagTask t, uint32_t busy_us) {
+    TaskCounters& c = g_tasks[(size_t)t];
+    if (c.max_reset) { c.max_us = 0; c.max_reset = false; }
+    c.loops++;
+    c.busy_us += busy_us;
+    if (busy_us > c.max_us) c.max_us = busy_us;
+    c.hist[bucket_of(busy_us)]++;
+}
+
+static float per_s(uint32_t count, uint32_t ms) {
+    return ms ? count * 1000.0f / ms : 0.0f;
+}
+
+DiagReport diag_collect(uint32_t now_ms) {
+    DiagReport r = {};
+    Snapshot now = {};
+    now.at_ms = now_ms;
+    r.period_ms = now_ms - g_last.at_ms;
+
+    for (size_t i = 0; i < TASKS; i++) {
+        TaskCounters& c = g_tasks[i];
+        DiagTaskReport& t = r.task[i];
+        now.loops[i] = c.loops;
+        now.busy_us[i] = c.busy_us;
+        t.loops = now.loops[i] - g_last.loops[i];
+        t.busy_us = now.busy_us[i] - g_last.busy_us[i];
+        t.cpu_pct = r.period_ms ? t.busy_us / (r.period_ms * 10.0f) : 0.0f;
+        t.max_us = c.max_us;
+        c.max_reset = true;
+        for (size_t b = 0; b < DIAG_LATENCY_BUCKETS; b++) {
+            now.hist[i][b] = c.hist[b];
+            t.hist[b] = now.hist[i][b] - g_last.hist[i][b];
+        }
+        t.stack_free = c.handle ? (uint32_t)uxTaskGetStackHighWaterMark(c.handle) : 0;
+    }
+
+    now.inputs = Meter::input_stats();
+    r.cf_hz = per_s(now.inputs.cf - g_last.inputs.cf, r.period_ms);
+    r.cf1_hz = per_s(now.inputs.cf1 - g_last.inputs.cf1, r.period_ms);
+    r.irq_per_s = per_s(now.inputs.interrupts - g_last.inputs.interrupts, r.period_ms);
+
+    r.heap_free = ESP.getFreeHeap();
+    r.heap_min = ESP.getMinFreeHeap();
+    r.heap_largest = ESP.getMaxAllocHeap();
+
+    g_last = now;
+    return r;
+}
+
+size_t diag_write_json(const DiagReport& r, char* out, size_t cap) {
+    size_t len = 0;
+    auto put = [&](int n) { len = (n < 0 || len + n >= cap) ? cap : len + n; };
+
+    put(snprintf(out, cap, "\"diagPeriodMs\":%lu,\"tasks\":{", (unsigned long)r.period_ms));
+    for (size_t i = 0; i < TASKS && len < cap; i++) {
+        const DiagTaskReport& t = r.task[i];
+        put(snprintf(out + len, cap - len, "%s\"%s\":{\"cpuPct\":%.2f,\"loops\":%lu,\"maxUs\":%lu,\"stackFree\":%lu,\"hist\":[",
+                     i ? "," : "", TASK_KEYS[i], t.cpu_pct, (unsigned long)t.loops, (unsigned long)t.max_us,
+                     (unsigned long)t.stack_free));
+        for (size_t b = 0; b < DIAG_LATENCY_BUCKETS && len < cap; b++)
+            put(snprintf(out + len, cap - len, "%s%lu", b ? "," : "", (unsigned long)t.hist[b]));
+        if (len < cap) put(snprintf(out + len, cap - len, "]}"));
+    }
+    if (len < cap)
+        put(snprintf(out + len, cap - len,
+                     "},\"isr\":{\"cfHz\":%.1f,\"cf1Hz\":%.1f,\"irqPerS\":%.1f},"
+                     "\"heap\":{\"free\":%lu,\"min\":%lu,\"largest\":%lu}",
+                     r.cf_hz, r.cf1_hz, r.irq_per_s, (unsigned long)r.heap_free, (unsigned long)r.heap_min,
+                     (unsigned long)r.heap_largest));
+    return len < cap ? len : 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+  Runtime instrumentation for "<cid>/diag", cheap enough to leave on in the field.
+
+  - Each task reports its loop iterations with diag_task_loop(): the time it
+    was busy (woken, not blocked), which gives its share of its core and a
+    latency histogram. Buckets are powers of 4 from 64 us:
+      <64 us, <256 us, <1 ms, <4 ms, <16 ms, <64 ms, >=64 ms
+    Cost per iteration: two micros() reads (by the caller), a few adds and a
+    count-leading-zeros. No locks: every counter has one writer, the task itself.
+  - Stack high-water marks (bytes never used) are read with
+    uxTaskGetStackHighWaterMark() only when a diag message is built, from the
+    handles diag_task_start() records.
+  - ISR rates come from the metering backend's edge and interrupt counters
+    (MeterInputStats), heap figures from the allocator (free, lowest since
+    boot, largest free block), reconnects and publish failures from mqtt_config.
+  - Counters only grow; diag_collect() (mqttTask) keeps the previous snapshot
+    and reports the deltas since the last diag message. The per-task max is the
+    one value that restarts: the reader flags it and the task clears it on its
+    next iteration.
+
+  Messages go out every DIAG_PERIOD_S (tuning "diag/every", 0: only on the
+  "diag" command), scheduled by hardwareTask like the report timer.
+*/
+
+#ifndef DIAG_PERIOD_S
+#define DIAG_PERIOD_S 300   // periodic diag message; 0: only when asked
+#endif
+
+enum class DiagTask : uint8_t { mqtt, hardware, count };
+
+constexpr size_t DIAG_LATENCY_BUCKETS = 7;
+
+struct DiagTaskReport {
+    uint32_t loops;          // iterations in the period
+    uint32_t busy_us;
+    float cpu_pct;           // busy share of the period, of the task's core
+    uint32_t max_us;         // longest iteration in the period
+    uint32_t hist[DIAG_LATENCY_BUCKETS];
+    uint32_t stack_free;     // bytes, since boot; 0: task not started (host sim)
+};
+
+struct DiagReport {
+    uint32_t period_ms;      // since the previous report
+    DiagTaskReport task[(size_t)DiagTask::count];
+    float cf_hz;             // edges/s on CF and CF1 (HLW8012; 0 for the CT)
+    float cf1_hz;
+    float irq_per_s;         // CPU interrupts the pulse inputs took
+    uint32_t heap_free;
+    uint32_t heap_min;
+    uint32_t heap_largest;
+};
+
+/* === each task, for itself === */
+void diag_task_start(DiagTask t);
+void diag_task_loop(DiagTask t, uint32_t busy_us);
+
+/* === mqttTask: building the message === */
+DiagReport diag_collect(uint32_t now_ms);
+// Appends "tasks", "isr" and "heap" members (no braces around them); returns the length, 0 if it didn't fit.
+size_t diag_write_json(const DiagReport& r, char* out, size_t cap);
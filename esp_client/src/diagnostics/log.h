@@ -0,0 +1,21 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+  Serial logging, removable at compile time: build with -D SERIAL_LOG=0 and
+  every LOG_PRINT/LOG_PRINTLN (and the formatting of its arguments) is gone.
+  Field diagnostics go to "<cid>/diag" instead (diagnostics.h). The serial relay
+  console (relay.h) answers its own commands and is not logging.
+*/
+
+#ifndef SERIAL_LOG
+#define SERIAL_LOG 1
+#endif
+
+#if SERIAL_LOG
+#define LOG_PRINT(...) Serial.print(__VA_ARGS__)
+#define LOG_PRINTLN(...) Serial.println(__VA_ARGS__)
+#else
+#define LOG_PRINT(...) ((void)0)
+#define LOG_PRINTLN(...) ((void)0)
+#endif
@@ -0,0 +1,88 @@
+#include "energy_register.h"
+#include "../checksum/crc32.h"
+#include <Preferences.h>
+
+static const char* const NVS_NAMESPACE = "energy";
+
+struct Checkpoint {
+    double ceiling_kwh;
+    uint32_t seq;
+    uint32_t crc;             // CRC-32 of every byte above
+};
+static_assert(sizeof(Checkpoint) == 16, "checkpoint layout changed");
+
+static double g_lifetime_kwh = 0.0;
+static double g_ceiling_kwh = 0.0;
+static EnergyRegisterStats g_stats = {};
+
+static void slot_key(uint32_t seq, char* key) {
+    snprintf(key, 8, "lt%u", (unsigned)(seq % ENERGY_REGISTER_SLOTS));
+}
+
+static uint32_t checkpoint_crc(const Checkpoint& c) {
+    return crc32((const uint8_t*)&c, offsetof(Checkpoint, crc));
+}
+
+// Writes the next slot in rotation; on failure the old ceiling stands and the next add retries.
+static bool write_checkpoint(double ceiling_kwh) {
+    Checkpoint c = {};
+    c.ceiling_kwh = ceiling_kwh;
+    c.seq = g_stats.seq + 1;
+    c.crc = checkpoint_crc(c);
+
+    char key[8];
+    slot_key(c.seq, key);
+    Preferences p;
+    p.begin(NVS_NAMESPACE, false);
+    bool ok = p.putBytes(key, &c, sizeof(c)) == sizeof(c);
+    p.end();
+    if (!ok) return false;
+
+    g_ceiling_kwh = ceiling_kwh;
+    g_stats.seq = c.seq;
+    g_stats.checkpoints++;
+    return true;
+}
+
+void energy_register_init() {
+    g_stats = {};
+    bool found = false;
+    Checkpoint newest = {};
+
+    Preferences p;
+    p.begin(NVS_NAMESPACE, true);
+    for (uint32_t i = 0; i < ENERGY_REGISTER_SLOTS; i++) {
+        char key[8];
+        slot_key(i, key);
+        if (!p.isKey(key)) continue;
+        Checkpoint c;
+        if (p.getBytes(key, &c, sizeof(c)) != sizeof(c) || c.crc != checkpoint_crc(c) || !(c.ceiling_kwh >= 0.0)) {
+            g_stats.invalid_slots++;
+            continue;
+        }
+        if (!found || c.seq > newest.seq) newest = c;
+        found = true;
+    }
+    p.end();
+
+    g_lifetime_kwh = found ? newest.ceiling_kwh : 0.0;
+    g_ceiling_kwh = g_lifetime_kwh;
+    g_stats.seq = newest.seq;
+    g_stats.restored_kwh = g_lifetime_kwh;
+    // Take a fresh lease right away: anything reported from here on stays below it.
+    write_checkpoint(g_lifetime_kwh + ENERGY_REGISTER_LEASE_KWH);
+}
+
+double energy_register_add(double kwh) {
+    if (kwh > 0.0) g_lifetime_kwh += kwh;
+    if (g_lifetime_kwh >= g_ceiling_kwh) write_checkpoint(g_lifetime_kwh + ENERGY_REGISTER_LEASE_KWH);
+    return g_lifetime_kwh;
+}
+
+double energy_register_kwh() {
+    return g_lifetime_kwh;
+}
+
+const EnergyRegisterStats& energy_register_stats() {
+    return g_stats;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+  Lifetime energy register: total kWh the plug has metered since it was first
+  flashed, monotonic across reboots, carried in every report next to the
+  per-interval increment. The backend can difference consecutive values, so a
+  lost or duplicated report no longer gains or loses energy.
+
+  The running total lives in RAM; NVS only holds a ceiling it may not pass:
+    - a checkpoint stores ceiling = lifetime + ENERGY_REGISTER_LEASE_KWH
+    - a new one is written only when the lifetime reaches the ceiling, so the
+      write rate follows the energy (one per 20 Wh: 50 an hour at a steady
+      1 kW, none while the relay is off), never the report rate. NVS spreads
+      those over its pages; a default 20 KB partition outlasts decades of that
+    - at boot the register resumes from the newest valid ceiling. It is at
+      least anything reported before the reset, so the counter never goes
+      backward; the cost is up to one lease of overcount per reboot, which is
+      why the backend chains readings across boots by energyIncrement rather
+      than by the lifetime difference
+    - checkpoints rotate over ENERGY_REGISTER_SLOTS NVS keys, each a CRC'd
+      record with a sequence number, so a torn write only loses the newest
+      one and no single key takes every write
+*/
+
+#ifndef ENERGY_REGISTER_LEASE_KWH
+#define ENERGY_REGISTER_LEASE_KWH 0.02
+#endif
+
+#ifndef ENERGY_REGISTER_SLOTS
+#define ENERGY_REGISTER_SLOTS 4
+#endif
+
+struct EnergyRegisterStats {
+    uint32_t checkpoints;     // NVS writes since boot
+    uint32_t seq;             // sequence number of the newest checkpoint
+    uint8_t invalid_slots;    // slots rejected at boot (bad CRC / size), empty ones excluded
+    double restored_kwh;      // value resumed from at boot
+};
+
+void energy_register_init();
+// Adds a non-negative increment and returns the new lifetime total.
+double energy_register_add(double kwh);
+double energy_register_kwh();
+const EnergyRegisterStats& energy_register_stats();
@@ -1,8 +1,13 @@
 #include "env_config.h"
+#include "../checksum/crc32.h"
+#include "../diagnostics/log.h"
 #include <Preferences.h>
 #include <FS.h>
+#include <esp_timer.h>
 
-/* Const vars to avoid typos */
+/* config.env keys. NVS only ever sees K_BLOB: its keys are capped at 15 characters,
+   which CLIENT_SUB_TOPIC / CLIENT_PUB_TOPIC weren't, so the old per-key save never
+   completed and every boot fell back to config.env. */
 const char* const K_SSID        = "WIFI_SSID";
 const char* const K_PASS        = "WIFI_PASSWORD";
 const char* const K_MQTT_SERVER = "MQTT_SERVER";
@@ -11,58 +16,62 @@ const char* const K_CLIENT_USER = "CLIENT_USER";
 const char* const K_CLIENT_PASS = "CLIENT_PASS";
 const char* const K_CLIENT_SUB = "CLIENT_SUB_TOPIC";
 const char* const K_CLIENT_PUB = "CLIENT_PUB_TOPIC";
+const char* const K_TELEMETRY_FMT = "TELEMETRY_FMT"; // optional: "json" (default) or "binary"
+const char* const K_BATCH_SAMPLES = "BATCH_SAMPLES"; // optional: readings per publish, 1 = no batching
+const char* const K_BATCH_MAX_AGE_S = "BATCH_MAX_AGE_S"; // optional: seconds, 0 = no age limit
+const char* const K_REPORT_MODE = "REPORT_MODE";   // optional: "interval" (default) or "exception"
+const char* const K_DEADBAND_W = "DEADBAND_W";     // optional: exception mode, watts
+const char* const K_DEADBAND_PCT = "DEADBAND_PCT"; // optional: exception mode, percent of the last reported power
+const char* const K_HEARTBEAT_S = "HEARTBEAT_S";   // optional: exception mode, seconds between heartbeats
 
 const char* const NVS_NAMESPACE = "env";
+static const char* const K_BLOB = "cfg";
+static const char* const CONFIG_PATH = "/config.env";
+
+static constexpr size_t ENV_LINE_MAX = 160;   // longest config.env line, newline excluded
+
+struct EnvBlob {
+    uint16_t version;
+    uint16_t size;         // sizeof(Env) when written
+    Env env;
+    uint32_t crc;          // CRC-32 of every byte above
+};
+
+static EnvLoadInfo g_load_info = {};
 
 Preferences prefs;
 
-void saveCredsToNVS(const String& ssid, const String& pass, const String& mqtt, const String& cid, const String& cuser, const String& cpass, const String& sub, const String& pub) {
+static uint32_t blob_crc(const EnvBlob& b) {
+    return crc32((const uint8_t*)&b, offsetof(EnvBlob, crc));
+}
+
+// Writes the blob and drops anything else in the namespace (older per-key entries).
+bool saveCredsToNVS(const Env& e) {
+  EnvBlob b = {};
+  b.version = ENV_BLOB_VERSION;
+  b.size = sizeof(Env);
+  memcpy(&b.env, &e, sizeof(Env));
+  b.crc = blob_crc(b);
+
   prefs.begin(NVS_NAMESPACE, false); // namespace NVS_NAMESPACE, read-write
-  prefs.putString(K_SSID, ssid);
-  prefs.putString(K_PASS, pass);
-  prefs.putString(K_MQTT_SERVER, mqtt);
-  prefs.putString(K_CLIENT_ID, cid);
-  prefs.putString(K_CLIENT_USER, cuser);
-  prefs.putString(K_CLIENT_PASS, cpass);
-  prefs.putString(K_CLIENT_SUB, sub);
-  prefs.putString(K_CLIENT_PUB, pub);
+  prefs.clear();
+  bool ok = prefs.putBytes(K_BLOB, &b, sizeof(b)) == sizeof(b);
   prefs.end(); // important: close handle
+  return ok;
 }
 
 Env loadCredsFromNVS() {
-  Env e;
+  EnvBlob b;
   prefs.begin(NVS_NAMESPACE, true); // read-only
-  // You can check presence first
-  bool hasAll =
-    prefs.isKey(K_SSID) &&
-    prefs.isKey(K_PASS) &&
-    prefs.isKey(K_MQTT_SERVER) &&
-    prefs.isKey(K_CLIENT_ID) &&
-    prefs.isKey(K_CLIENT_USER) &&
-    prefs.isKey(K_CLIENT_PASS) &&
-    prefs.isKey(K_CLIENT_SUB) &&
-    prefs.isKey(K_CLIENT_PUB);
-
-  if (hasAll) {
-    e.ssid  = prefs.getString(K_SSID, "");
-    e.pass  = prefs.getString(K_PASS, "");
-    e.mqtt  = prefs.getString(K_MQTT_SERVER, "");
-    e.cid   = prefs.getString(K_CLIENT_ID, "");
-    e.cuser = prefs.getString(K_CLIENT_USER, "");
-    e.cpass = prefs.getString(K_CLIENT_PASS, "");
-    e.sub   = prefs.getString(K_CLIENT_SUB, "");
-    e.pub   = prefs.getString(K_CLIENT_PUB, "");
-    e.ok = true;
-  }
+  size_t got = prefs.getBytes(K_BLOB, &b, sizeof(b));
   prefs.end();
-  return e;
-}
 
-// If you need to delete one key
-void eraseClientPass() {
-  prefs.begin(NVS_NAMESPACE, false);
-  prefs.remove(K_CLIENT_PASS);
-  prefs.end();
+  if (got != sizeof(b) || b.version != ENV_BLOB_VERSION || b.size != sizeof(Env) || b.crc != blob_crc(b))
+    return Env{};
+  Env e;
+  memcpy(&e, &b.env, sizeof(Env));
+  e.ok = true;
+  return e;
 }
 
 // If you need to wipe the whole namespace
@@ -73,64 +82,128 @@ void wipeEnvNamespace() {
 }
 
 void debug_printEnv(const Env& e) {
-    Serial.println(F("---- ENV DEBUG ----"));
-    Serial.print(F("SSID: "));        Serial.println(e.ssid);
-    Serial.print(F("PASS: "));        Serial.println(e.pass);
-    Serial.print(F("MQTT: "));        Serial.println(e.mqtt);
-    Serial.print(F("CLIENT_ID: "));   Serial.println(e.cid);
-    Serial.print(F("CLIENT_USER: ")); Serial.println(e.cuser);
-    Serial.print(F("CLIENT_PASS: ")); Serial.println(e.cpass);
-    Serial.print(F("CLIENT_SUB_TOPIC: ")); Serial.println(e.sub);
-    Serial.print(F("CLIENT_PUB_TOPIC: ")); Serial.println(e.pub);
-    Serial.println(F("-------------------"));
+    LOG_PRINTLN(F("---- ENV DEBUG ----"));
+    LOG_PRINT(F("SSID: "));        LOG_PRINTLN(e.ssid);
+    LOG_PRINT(F("PASS: "));        LOG_PRINTLN(e.pass);
+    LOG_PRINT(F("MQTT: "));        LOG_PRINTLN(e.mqtt);
+    LOG_PRINT(F("CLIENT_ID: "));   LOG_PRINTLN(e.cid);
+    LOG_PRINT(F("CLIENT_USER: ")); LOG_PRINTLN(e.cuser);
+    LOG_PRINT(F("CLIENT_PASS: ")); LOG_PRINTLN(e.cpass);
+    LOG_PRINT(F("CLIENT_SUB_TOPIC: ")); LOG_PRINTLN(e.sub);
+    LOG_PRINT(F("CLIENT_PUB_TOPIC: ")); LOG_PRINTLN(e.pub);
+    LOG_PRINT(F("TELEMETRY_FMT: ")); LOG_PRINTLN(telemetry_format_name(e.telemetry));
+    LOG_PRINT(F("BATCH_SAMPLES: ")); LOG_PRINTLN(e.batchSamples);
+    LOG_PRINT(F("BATCH_MAX_AGE_S: ")); LOG_PRINTLN(e.batchMaxAgeS);
+    LOG_PRINT(F("REPORT_MODE: ")); LOG_PRINTLN(report_mode_name(e.reportMode));
+    LOG_PRINT(F("DEADBAND_W: ")); LOG_PRINTLN(e.deadbandW);
+    LOG_PRINT(F("DEADBAND_PCT: ")); LOG_PRINTLN(e.deadbandPct);
+    LOG_PRINT(F("HEARTBEAT_S: ")); LOG_PRINTLN(e.heartbeatS);
+    LOG_PRINTLN(F("-------------------"));
+}
+
+// Copies a value into one of Env's fixed buffers. Too long is an error, not a truncation:
+// a clipped password or topic would fail later in a much less obvious way.
+static bool set_str(char* dst, size_t size, const char* key, const char* v) {
+  size_t n = strlen(v);
+  if (n >= size) {
+    LOG_PRINT(F("config.env: value too long for "));
+    LOG_PRINTLN(key);
+    return false;
+  }
+  memcpy(dst, v, n + 1);
+  return true;
+}
+
+static char* trim(char* s) {
+  while (*s == ' ' || *s == '\t') s++;
+  char* end = s + strlen(s);
+  while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) end--;
+  *end = '\0';
+  return s;
+}
+
+// One "KEY=value" line, modified in place. Returns false on a value that doesn't fit.
+static bool parse_line(Env& e, char* line) {
+  line = trim(line);
+  if (*line == '\0' || *line == '#') return true;
+  char* eq = strchr(line, '=');
+  if (!eq) return true;
+  *eq = '\0';
+  const char* k = trim(line);
+  const char* v = trim(eq + 1);
+
+  if (strcmp(k, K_SSID) == 0)                return set_str(e.ssid, sizeof(e.ssid), k, v);
+  else if (strcmp(k, K_PASS) == 0)           return set_str(e.pass, sizeof(e.pass), k, v);
+  else if (strcmp(k, K_MQTT_SERVER) == 0)    return set_str(e.mqtt, sizeof(e.mqtt), k, v);
+  else if (strcmp(k, K_CLIENT_ID) == 0)      return set_str(e.cid, sizeof(e.cid), k, v);
+  else if (strcmp(k, K_CLIENT_USER) == 0)    return set_str(e.cuser, sizeof(e.cuser), k, v);
+  else if (strcmp(k, K_CLIENT_PASS) == 0)    return set_str(e.cpass, sizeof(e.cpass), k, v);
+  else if (strcmp(k, K_CLIENT_SUB) == 0)     return set_str(e.sub, sizeof(e.sub), k, v);
+  else if (strcmp(k, K_CLIENT_PUB) == 0)     return set_str(e.pub, sizeof(e.pub), k, v);
+  else if (strcmp(k, K_TELEMETRY_FMT) == 0)  e.telemetry = parse_telemetry_format(v);
+  else if (strcmp(k, K_BATCH_SAMPLES) == 0)  e.batchSamples = (uint8_t)atoi(v);
+  else if (strcmp(k, K_BATCH_MAX_AGE_S) == 0) e.batchMaxAgeS = (uint32_t)atol(v);
+  else if (strcmp(k, K_REPORT_MODE) == 0)    e.reportMode = parse_report_mode(v);
+  else if (strcmp(k, K_DEADBAND_W) == 0)     e.deadbandW = strtof(v, nullptr);
+  else if (strcmp(k, K_DEADBAND_PCT) == 0)   e.deadbandPct = strtof(v, nullptr);
+  else if (strcmp(k, K_HEARTBEAT_S) == 0)    e.heartbeatS = (uint32_t)atol(v);
+  return true;
 }
 
+// Streams config.env through one line buffer; no heap, whatever the file size.
 Env loadFromSPIFFS(const char* path) {
   Env e;
   File f = SPIFFS.open(path, FILE_READ);
   if (!f) return e;
 
-  Serial.println("File was found and opened");
-
-  while (f.available()) {
-    String line = f.readStringUntil('\n');
-    line.trim();
-    if (line.isEmpty() || line.startsWith("#")) continue;
-    int eq = line.indexOf('=');
-    if (eq < 0) continue;
-    String k = line.substring(0, eq); k.trim();
-    String v = line.substring(eq + 1); v.trim();
-
-    if (k == K_SSID)        e.ssid  = v;
-    else if (k == K_PASS) e.pass  = v;
-    else if (k == K_MQTT_SERVER)   e.mqtt  = v;
-    else if (k == K_CLIENT_ID)     e.cid   = v;
-    else if (k == K_CLIENT_USER)   e.cuser = v;
-    else if (k == K_CLIENT_PASS)   e.cpass = v;
-    else if (k == K_CLIENT_SUB)     e.sub   = v;
-    else if (k == K_CLIENT_PUB)     e.pub   = v;
+  LOG_PRINTLN("File was found and opened");
+
+  uint8_t chunk[128];
+  char line[ENV_LINE_MAX + 1];
+  size_t len = 0;
+  bool overlong = false, fits = true;
+  auto end_line = [&]() {
+    line[len] = '\0';
+    if (overlong) LOG_PRINTLN(F("config.env: skipped a line over 160 characters"));
+    else if (!parse_line(e, line)) fits = false;
+    len = 0;
+    overlong = false;
+  };
+  size_t n;
+  while ((n = f.read(chunk, sizeof(chunk))) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      if (chunk[i] == '\n') end_line();
+      else if (len < ENV_LINE_MAX) line[len++] = (char)chunk[i];
+      else overlong = true;
+    }
   }
+  if (len > 0 || overlong) end_line();   // last line without a newline
   f.close();
 
-  e.ok = !(e.ssid.isEmpty() || e.pass.isEmpty() || e.mqtt.isEmpty()
-           || e.cid.isEmpty() || e.cuser.isEmpty() || e.cpass.isEmpty() || e.sub.isEmpty() || e.pub.isEmpty());
+  e.ok = fits && e.ssid[0] && e.pass[0] && e.mqtt[0] && e.cid[0] && e.cuser[0] && e.cpass[0] && e.sub[0] && e.pub[0];
   return e;
 }
 
+const EnvLoadInfo& env_load_info() {
+  return g_load_info;
+}
+
 Env ensureEnvInNVS() {
+  int64_t t0 = esp_timer_get_time();
+  g_load_info = {};
   Env e = loadCredsFromNVS();
 
-  if (e.ok) return e;
-
-  // NVS missing. Try SPIFFS and migrate.
-  Env f;
-  f = loadFromSPIFFS("/config.env");
-
-  if (f.ok) {
-    saveCredsToNVS(f.ssid, f.pass, f.mqtt, f.cid, f.cuser, f.cpass, f.sub, f.pub);
-    return f;
+  if (e.ok) {
+    g_load_info.source = EnvSource::nvs_blob;
+  } else {
+    // No valid blob. Parse config.env and migrate it, once.
+    e = loadFromSPIFFS(CONFIG_PATH);
+    if (e.ok) {
+      g_load_info.source = EnvSource::spiffs;
+      g_load_info.migrated = saveCredsToNVS(e);
+      if (!g_load_info.migrated) LOG_PRINTLN(F("env: could not write the config blob to NVS"));
+    }
   }
-  return Env{}; // still not ok
+  g_load_info.load_us = (uint32_t)(esp_timer_get_time() - t0);
+  return e; // !ok: neither NVS nor config.env had a usable config
 }
-
-
@@ -1,20 +1,78 @@
 #pragma once
 #include <SPIFFS.h>
-#include <Arduino.h> // For String
+#include <Arduino.h>
+#include "../telemetry/telemetry.h"
+#include "../telemetry/report_policy.h"
+
+/*
+  Device configuration, loaded once at boot.
+
+  - NVS holds the whole Env as one blob (namespace "env", key "cfg"): a version,
+    the struct size and a CRC-32 around the raw struct. Boot is a single
+    getBytes() into a stack copy; strings live in the fixed char arrays below,
+    so nothing is allocated and mqttTask passes them straight to the client.
+  - With no valid blob (first boot, a firmware whose Env layout changed, a
+    corrupt write) /config.env on SPIFFS is parsed once, in place, and written
+    back as the blob. Older firmware's per-key entries are cleared then.
+  - Bump ENV_BLOB_VERSION whenever Env changes; a size or version mismatch
+    falls back to config.env rather than reading a stale layout.
+*/
+
+constexpr uint16_t ENV_BLOB_VERSION = 1;
+
+// Buffer sizes include the terminating NUL.
+constexpr size_t ENV_SSID_SIZE = 33;     // 802.11 SSID: 32 bytes
+constexpr size_t ENV_PASS_SIZE = 65;     // WPA2 passphrase: 63 chars, or 64 hex digits
+constexpr size_t ENV_HOST_SIZE = 64;
+constexpr size_t ENV_ID_SIZE = 32;
+constexpr size_t ENV_SECRET_SIZE = 64;
+constexpr size_t ENV_TOPIC_SIZE = 64;
 
 struct Env {
-    String ssid, pass, mqtt, cid, cuser, cpass, sub, pub;
+    char ssid[ENV_SSID_SIZE] = {};
+    char pass[ENV_PASS_SIZE] = {};
+    char mqtt[ENV_HOST_SIZE] = {};
+    char cid[ENV_ID_SIZE] = {};
+    char cuser[ENV_ID_SIZE] = {};
+    char cpass[ENV_SECRET_SIZE] = {};
+    char sub[ENV_TOPIC_SIZE] = {};
+    char pub[ENV_TOPIC_SIZE] = {};
+    TelemetryFormat telemetry = TelemetryFormat::json; // optional, defaults to JSON
+    uint8_t batchSamples = 1;                          // optional, readings per publish (binary only)
+    uint32_t batchMaxAgeS = 0;                         // optional, flush a batch once its oldest reading is this old
+    ReportMode reportMode = ReportMode::interval;      // optional, see report_policy.h
+    float deadbandW = 0.0f;                            // optional, exception mode: absolute deadband (W)
+    float deadbandPct = 0.0f;                          // optional, exception mode: relative deadband (% of last report)
+    uint32_t heartbeatS = 300;                         // optional, exception mode: max seconds between reports
     bool ok = false;
 };
 
-/* Const keys to prevent typos */
+enum class EnvSource : uint8_t { none, nvs_blob, spiffs };
+
+struct EnvLoadInfo {
+    EnvSource source;
+    uint32_t load_us;      // ensureEnvInNVS() wall time
+    bool migrated;         // config.env was parsed and the blob written this boot
+};
+
+/* config.env keys; const to prevent typos */
 extern const char* const K_SSID;
 extern const char* const K_PASS;
 extern const char* const K_MQTT_SERVER;
 extern const char* const K_CLIENT_ID;
 extern const char* const K_CLIENT_USER;
 extern const char* const K_CLIENT_PASS;
+extern const char* const K_CLIENT_SUB;
+extern const char* const K_CLIENT_PUB;
+extern const char* const K_TELEMETRY_FMT;
+extern const char* const K_BATCH_SAMPLES;
+extern const char* const K_BATCH_MAX_AGE_S;
+extern const char* const K_REPORT_MODE;
+extern const char* const K_DEADBAND_W;
+extern const char* const K_DEADBAND_PCT;
+extern const char* const K_HEARTBEAT_S;
 
 Env ensureEnvInNVS();
 Env loadCredsFromNVS();
-
+bool saveCredsToNVS(const Env& e);
+const EnvLoadInfo& env_load_info();
@@ -0,0 +1,66 @@
+#include "metering_config.h"
+#if METERING_BACKEND == METERING_BACKEND_CT
+#include "ct_rms.h"
+#include <string.h>
+
+static_assert(CT_SAMPLES_PER_CYCLE * 4095ull * 4095ull <= UINT32_MAX, "per-cycle sum of squares must fit 32 bits");
+
+// kWh in one mains cycle at 1 W.
+static constexpr float KWH_PER_WATT_CYCLE = 1.0f / (CT_MAINS_HZ * 3600000.0f);
+
+void ct_rms_init(CtRms& s, float amps_per_count, float volts, float power_factor) {
+    memset(&s, 0, sizeof(s));
+    s.amps_per_count = amps_per_count;
+    s.volts = volts;
+    s.power_factor = power_factor;
+}
+
+static void close_cycle(CtRms& s) {
+    const int64_t spc = CT_SAMPLES_PER_CYCLE;
+
+    if (s.filled == CT_WINDOW_CYCLES) {
+        s.window_sum -= s.cycle_sum[s.head];
+        s.window_sumsq -= s.cycle_sumsq[s.head];
+    } else {
+        s.filled++;
+    }
+    s.cycle_sum[s.head] = s.sum;
+    s.cycle_sumsq[s.head] = s.sumsq;
+    s.window_sum += s.sum;
+    s.window_sumsq += s.sumsq;
+    s.head = (s.head + 1) % CT_WINDOW_CYCLES;
+    s.cycles++;
+
+    // With N window samples summing to S1, the bias is m = S1 / N. Scaling by
+    // N^2 keeps everything integer (fits int64 for 12-bit samples):
+    //   window:  N^2 * var        = N * S2 - S1^2
+    //   cycle:   N^2 * sum (x-m)^2 = N^2 * s2 - 2 N S1 s1 + n S1^2
+    const int64_t N = (int64_t)s.filled * spc;
+    const int64_t S1 = (int64_t)s.window_sum;
+    int64_t window_num = N * (int64_t)s.window_sumsq - S1 * S1;
+    int64_t cycle_num = N * N * (int64_t)s.sumsq - 2 * N * S1 * (int64_t)s.sum + spc * S1 * S1;
+    float n2 = (float)N * (float)N;
+
+    s.irms = window_num > 0 ? sqrtf((float)window_num / n2) * s.amps_per_count : 0.0f;
+    float cycle_irms = cycle_num > 0 ? sqrtf((float)cycle_num / (n2 * (float)spc)) * s.amps_per_count : 0.0f;
+    s.energy.add(s.volts * s.power_factor * cycle_irms * KWH_PER_WATT_CYCLE);
+
+    s.n = 0;
+    s.sum = 0;
+    s.sumsq = 0;
+}
+
+void ct_rms_push(CtRms& s, const uint16_t* samples, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t x = samples[i];
+        s.sum += x;
+        s.sumsq += x * x;
+        if (++s.n == CT_SAMPLES_PER_CYCLE) close_cycle(s);
+    }
+}
+
+float ct_rms_take_energy_kwh(CtRms& s) {
+    return s.energy.take();
+}
+
+#endif // METERING_BACKEND_CT
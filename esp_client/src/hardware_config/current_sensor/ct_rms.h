@@ -0,0 +1,61 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "metering_math.h"
+
+/*
+  Incremental RMS for a continuously sampled CT.
+
+  Samples arrive in blocks (whatever the ADC DMA has filled) and are folded in
+  with two integer adds per sample. The sample rate is a whole multiple of the
+  mains frequency, so every CT_SAMPLES_PER_CYCLE samples close one mains
+  cycle. The last CT_WINDOW_CYCLES cycles form a sliding window:
+    - the window mean is the ADC bias (DC), removed exactly in integer math
+    - ct_rms_irms() is the window RMS, already computed, so reading it is free
+    - each closed cycle's RMS (about the window bias) integrates into energy,
+      so every mains cycle is metered, not just a snapshot per report
+*/
+
+#ifndef CT_MAINS_HZ
+#define CT_MAINS_HZ 60
+#endif
+#ifndef CT_SAMPLES_PER_CYCLE
+#define CT_SAMPLES_PER_CYCLE 64          // 3840 Hz at 60 Hz mains
+#endif
+#ifndef CT_WINDOW_CYCLES
+#define CT_WINDOW_CYCLES 30              // 0.5 s at 60 Hz
+#endif
+#ifndef CT_CURRENT_CAL
+#define CT_CURRENT_CAL 50.0f             // A per V at the ADC pin (EmonLib ICAL)
+#endif
+
+static constexpr uint32_t CT_SAMPLE_RATE_HZ = CT_MAINS_HZ * CT_SAMPLES_PER_CYCLE;
+static constexpr float CT_AMPS_PER_COUNT = CT_CURRENT_CAL * 3.3f / 4096.0f;   // 12-bit ADC, 3.3 V full scale
+
+struct CtRms {
+    float amps_per_count;
+    float volts;
+    float power_factor;
+
+    // cycle being filled
+    uint32_t n;
+    uint32_t sum;
+    uint32_t sumsq;
+
+    // closed cycles in the window
+    uint32_t cycle_sum[CT_WINDOW_CYCLES];
+    uint32_t cycle_sumsq[CT_WINDOW_CYCLES];
+    uint32_t head;
+    uint32_t filled;
+    uint64_t window_sum;
+    uint64_t window_sumsq;
+
+    float irms;                  // window RMS in amps, refreshed every cycle
+    uint32_t cycles;             // closed since init
+    EnergyAccumulator energy;    // kWh
+};
+
+void ct_rms_init(CtRms& s, float amps_per_count, float volts, float power_factor);
+void ct_rms_push(CtRms& s, const uint16_t* samples, size_t count);   // 12-bit samples
+static inline float ct_rms_irms(const CtRms& s) { return s.irms; }
+float ct_rms_take_energy_kwh(CtRms& s);
@@ -0,0 +1,56 @@
+#include "metering_config.h"
+#if METERING_BACKEND == METERING_BACKEND_HLW8012
+#include "edge_capture.h"
+
+static constexpr uint32_t RING_MASK = EDGE_RING_SIZE - 1;
+static_assert((EDGE_RING_SIZE & RING_MASK) == 0, "EDGE_RING_SIZE must be a power of two");
+
+float edge_capture_frequency_hz(EdgeChannel& ch, uint32_t now_us, uint32_t timeout_us) {
+    // Snapshot under the lock so the ISR can't move the ring mid-copy.
+    uint32_t stamps[EDGE_RING_SIZE];
+    noInterrupts();
+    uint32_t n = ch.count;
+    for (uint32_t i = 0; i < EDGE_RING_SIZE; i++) stamps[i] = ch.stamp_us[i];
+    interrupts();
+
+    if (n == 0) return 0.0f;
+    uint32_t last = stamps[(n - 1) & RING_MASK];
+
+    uint32_t periods = n - ch.ref_count;
+    uint32_t span = last - ch.ref_edge_us;
+    bool counted = ch.primed && periods >= EDGE_COUNTING_MIN_PERIODS && span > 0 && span <= timeout_us;
+    ch.primed = true;
+    ch.ref_count = n;
+    ch.ref_edge_us = last;
+
+    uint32_t age = now_us - last;
+    if (age > timeout_us) return 0.0f;
+
+    float hz = 0.0f;
+    if (counted) {
+        hz = (float)periods * 1000000.0f / (float)span;
+    } else {
+        uint32_t available = n < EDGE_RING_SIZE ? n : EDGE_RING_SIZE;
+        uint32_t used = 1;
+        uint32_t first = last;
+        while (used < available) {
+            uint32_t t = stamps[(n - 1 - used) & RING_MASK];
+            uint32_t back = last - t;
+            if (back > timeout_us) break;
+            if (used >= 2 && back > EDGE_LOW_LOAD_SPAN_US) break;
+            first = t;
+            used++;
+        }
+        if (used < 2 || last == first) return 0.0f;   // a single edge has no period yet
+        hz = (float)(used - 1) * 1000000.0f / (float)(last - first);
+    }
+
+    // The next edge is overdue: the true frequency can be at most 1 / age,
+    // and once it is several periods late the load has gone.
+    float overdue = (float)age * hz / 1000000.0f;
+    if (overdue > EDGE_GONE_PERIODS) return 0.0f;
+    if (overdue > 1.0f) hz = 1000000.0f / (float)age;
+    return hz;
+}
+
+#endif // METERING_BACKEND_HLW8012
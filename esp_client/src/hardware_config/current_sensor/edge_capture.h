@@ -0,0 +1,50 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+  Per-edge timestamp capture for the HLW8012 CF/CF1 outputs.
+
+  The ISR stores micros() of every rising edge in a small ring and bumps a
+  free-running edge count. edge_capture_frequency_hz() turns that into a
+  frequency with reciprocal counting, i.e. whole periods divided by the time
+  between the first and last edge, so there is no +-1 pulse quantization:
+    - high load (>= EDGE_COUNTING_MIN_PERIODS new periods since the last call):
+      count every edge since the previous estimate, timed edge to edge
+    - low load: use the last few edges still in the ring (at least one period,
+      at most EDGE_LOW_LOAD_SPAN_US back), so a few-Hz load reads from 2-3 edges
+      instead of needing seconds of counting
+  If the next edge is overdue the estimate is capped at 1 / (time since the
+  last edge), and it drops to 0 once EDGE_GONE_PERIODS periods have passed
+  without an edge, or after timeout_us.
+*/
+
+#ifndef EDGE_RING_SIZE
+#define EDGE_RING_SIZE 16            // power of two
+#endif
+#ifndef EDGE_COUNTING_MIN_PERIODS
+#define EDGE_COUNTING_MIN_PERIODS 8
+#endif
+#ifndef EDGE_GONE_PERIODS
+#define EDGE_GONE_PERIODS 3.0f
+#endif
+#ifndef EDGE_LOW_LOAD_SPAN_US
+#define EDGE_LOW_LOAD_SPAN_US 1000000UL
+#endif
+
+struct EdgeChannel {
+    // written by the ISR
+    volatile uint32_t count;
+    volatile uint32_t stamp_us[EDGE_RING_SIZE];
+    // estimator state, task side only
+    bool primed;
+    uint32_t ref_count;
+    uint32_t ref_edge_us;
+};
+
+static inline void IRAM_ATTR edge_capture_record(EdgeChannel& ch, uint32_t now_us) {
+    uint32_t n = ch.count;
+    ch.stamp_us[n & (EDGE_RING_SIZE - 1)] = now_us;
+    ch.count = n + 1;
+}
+
+float edge_capture_frequency_hz(EdgeChannel& ch, uint32_t now_us, uint32_t timeout_us);
@@ -1,13 +1,16 @@
+#include "metering_config.h"
+#if METERING_BACKEND == METERING_BACKEND_HLW8012
 #include "sensor.h"
+#include "pulse_input.h"
+#include "metering_math.h"
+#include "../../diagnostics/log.h"
 #include <Arduino.h>
 
-static volatile uint32_t cf_pulses  = 0;
-static volatile uint32_t cf1_pulses = 0;
-static volatile uint32_t cf_last_edge_us  = 0;
-static volatile uint32_t cf1_last_edge_us = 0;
-
 static uint32_t g_last_window_ms = 0;   // last time we computed window Hz
 static constexpr uint32_t WINDOW_MS = 500; // 200–500ms is typical
+static constexpr uint32_t WINDOW_MIN_MS = 100;
+static constexpr uint32_t WINDOW_MAX_MS = 5000;
+static uint32_t g_window_ms = WINDOW_MS;  // set at run time by the "window" command
 
 // setting the CF pin to pin 25, on main.cpp we need to change the CF1 pin to GPIO26
 // CF is the power pin
@@ -27,71 +30,55 @@ static constexpr uint32_t PULSE_TIMEOUT_US = 2000000UL; // 2 seconds in microsec
 static uint8_t g_cf1_pin = 0; // holds gpio number brought from main for CF1
 
 // base calibration
-static float g_current_cal_a_per_hz = 0.0166f; // !!!WILL NEED TO CHANGE THIS CALIBRATION VALUE AFTER TESTING!!!
+#ifndef CURRENT_CAL_A_PER_HZ
+#define CURRENT_CAL_A_PER_HZ 0.0166f // !!!WILL NEED TO CHANGE THIS CALIBRATION VALUE AFTER TESTING!!!
+#endif
+static float g_current_cal_a_per_hz = CURRENT_CAL_A_PER_HZ; // times the "cal" command's gain
 static float g_power_cal_w_per_hz   = POWER_CAL_W_PER_HZ;
 
 // always-applied base offset, before threshold scaling
-static double g_base_current_offset_amps = 2.275; // tune this
+static float g_base_current_offset_amps = 2.275f; // tune this
 
 // these values will be printed once per second with this
 static unsigned long lastPrintMs = 0;
 
 // these will be the variables that are output
-static double amps  = 0.0;
-static double watts = 0.0;
+// (all metering state is float: the ESP32 FPU is single precision, see metering_math.h)
+static float amps  = 0.0f;
+static float watts = 0.0f;
 
 // raw values before dynamic correction
-static double raw_amps  = 0.0;
-static double raw_watts = 0.0;
+static float raw_amps  = 0.0f;
+static float raw_watts = 0.0f;
 
 // Energy accumulations
-static double energy_kWh = 0.0;
+static EnergyAccumulator energy_kWh = {};
 static unsigned long lastSampleTimeMs = 0;
 
 // Blend amount for threshold scaling
-static double g_dynamic_strength = 1.0;
-
-// Thresholds are now based on the offset-corrected current itself,
-// not on any first reading / baseline.
-struct CurrentCalBand {
-    double max_offset_corrected_amps;
-    double scale;
+static float g_dynamic_strength = 1.0f;
+
+// Thresholds are based on the offset-corrected current itself (see CurrentCalBand).
+// The "bands" command replaces them at run time (set_current_bands_ic()).
+static constexpr CurrentCalBand DEFAULT_CURRENT_BANDS[] = {
+    {4.50f, 0.53f},
+    {2.00f, 0.63f},
+    {1.5f, 0.81f},
+    {0.6f, 0.688f},
+    {0.30f, 1.12f}
 };
+static constexpr size_t DEFAULT_BAND_COUNT = sizeof(DEFAULT_CURRENT_BANDS) / sizeof(DEFAULT_CURRENT_BANDS[0]);
+static_assert(DEFAULT_BAND_COUNT <= CURRENT_CAL_BANDS_MAX, "raise CURRENT_CAL_BANDS_MAX");
 
-static CurrentCalBand g_current_bands[] = {
-    {4.50, 0.53},
-    {2.00, 0.63},
-    {1.5, 0.81},
-    {0.6, 0.688},
-    {0.30, 1.12}
+static CurrentCalBand g_current_bands[CURRENT_CAL_BANDS_MAX] = {
+    DEFAULT_CURRENT_BANDS[0], DEFAULT_CURRENT_BANDS[1], DEFAULT_CURRENT_BANDS[2],
+    DEFAULT_CURRENT_BANDS[3], DEFAULT_CURRENT_BANDS[4]
 };
+static size_t g_band_count = DEFAULT_BAND_COUNT;
 
-static double apply_current_calibration(double current_raw_amps) {
-    // Step 1: always apply base offset first
-    double offset_corrected = current_raw_amps - g_base_current_offset_amps;
-
-    // Never allow negative readings
-    if (offset_corrected <= 0.0) return 0.0;
-
-    // Step 2: apply scale based on the current reading itself
-    for (const auto &band : g_current_bands) {
-        if (offset_corrected >= band.max_offset_corrected_amps) {
-            double scaled = offset_corrected * band.scale;
-            return offset_corrected + (scaled - offset_corrected) * g_dynamic_strength;
-        }
-    }
-
-    return offset_corrected;
-}
-
-static void IRAM_ATTR isr_cf() {
-    cf_pulses++;
-    cf_last_edge_us = (uint32_t)micros();
-}
-
-static void IRAM_ATTR isr_cf1() {
-    cf1_pulses++;
-    cf1_last_edge_us = (uint32_t)micros();
+static float apply_current_calibration(float current_raw_amps) {
+    return calibrate_current(current_raw_amps, g_base_current_offset_amps, g_current_bands,
+                             g_band_count, g_dynamic_strength);
 }
 
 /*
@@ -103,38 +90,22 @@ static void IRAM_ATTR isr_cf1() {
     Hz = 1 / period_seconds
        = 1,000,000 / period_us
 
-  NOTE: Interrupts may change period_us while we read it.
-  So we copy the values while interrupts are briefly disabled.
+  In ISR mode every edge is timestamped, so we time whole periods between edges
+  rather than counting pulses in a fixed window (which is off by up to one pulse,
+  a big error when the load only makes a few pulses per window). In PCNT mode
+  the hardware counts and the count is read here, once per window; see
+  pulse_input.h.
 */
-static float read_frequency_hz(volatile uint32_t &period_us_v,
-                               volatile uint32_t &last_edge_us_v) {
-    uint32_t period_us;
-    uint32_t last_edge_us;
-
-    noInterrupts();
-    period_us    = period_us_v;
-    last_edge_us = last_edge_us_v;
-    interrupts();
-
-    if (period_us == 0) return 0.0f;
-
-    uint32_t now = (uint32_t)micros();
-    uint32_t age = now - last_edge_us;
-    if (age > PULSE_TIMEOUT_US) return 0.0f;
-
-    return 1000000.0f / (float)period_us;
+static float read_frequency_hz(PulseChannel ch) {
+    return pulse_input_frequency_hz(ch, (uint32_t)micros(), PULSE_TIMEOUT_US);
 }
 
 void init_current_sensor_ic(unsigned int currentSensorPin) {
     // main.cpp passes "currentSensorPin" — in HLW8012 mode this is CF1 pin
     g_cf1_pin = (uint8_t) currentSensorPin;
 
-    pinMode(HLW8012_CF_PIN, INPUT);  // some boards might need INPUT_PULLUP
-    pinMode(g_cf1_pin,      INPUT);
-
-    // the HLW8012 sends the ESP32 square waves, so every rising edge counts as a pulse
-    attachInterrupt(digitalPinToInterrupt(HLW8012_CF_PIN), isr_cf, RISING);
-    attachInterrupt(digitalPinToInterrupt(g_cf1_pin),      isr_cf1, RISING);
+    pulse_input_init(PulseChannel::cf,  HLW8012_CF_PIN);
+    pulse_input_init(PulseChannel::cf1, g_cf1_pin);
 }
 
 // Only keep if we're not getting voltage from HLW8012
@@ -146,38 +117,22 @@ static bool refresh_measurements_from_window() {
     }
 
     uint32_t elapsed_ms = now_ms - g_last_window_ms;
-    if (elapsed_ms < WINDOW_MS) return false;
-
-    uint32_t p_cf, p_cf1;
-    uint32_t last_edge_cf_us, last_edge_cf1_us;
-
-    noInterrupts();
-    p_cf = cf_pulses;   cf_pulses = 0;
-    p_cf1 = cf1_pulses; cf1_pulses = 0;
-    last_edge_cf_us = cf_last_edge_us;
-    last_edge_cf1_us = cf1_last_edge_us;
-    interrupts();
+    if (elapsed_ms < g_window_ms) return false;
 
     g_last_window_ms = now_ms;
 
-    float seconds = elapsed_ms / 1000.0f;
-
-    uint32_t now_us = (uint32_t)micros();
-    if ((now_us - last_edge_cf_us)  > PULSE_TIMEOUT_US) p_cf = 0;
-    if ((now_us - last_edge_cf1_us) > PULSE_TIMEOUT_US) p_cf1 = 0;
-
-    float power_hz   = (seconds > 0.0f) ? (p_cf  / seconds) : 0.0f;
-    float current_hz = (seconds > 0.0f) ? (p_cf1 / seconds) : 0.0f;
+    float power_hz   = read_frequency_hz(PulseChannel::cf);
+    float current_hz = read_frequency_hz(PulseChannel::cf1);
 
     // Old HLW8012 power calculation block
-    // raw_watts = (double)(power_hz * g_power_cal_w_per_hz);
-    raw_amps = (double)(current_hz * g_current_cal_a_per_hz);
+    // raw_watts = power_hz * g_power_cal_w_per_hz;
+    raw_amps = current_hz * g_current_cal_a_per_hz;
 
     amps = apply_current_calibration(raw_amps);
 
     // New simplified power calculation:
     // Power = Current * 12V
-    raw_watts = amps * 12.0;
+    raw_watts = amps * 12.0f;
     watts = raw_watts;
 
     return true;
@@ -189,26 +144,26 @@ void read_and_print_Irms_ic() {
 
     refresh_measurements_from_window();
 
-    double offset_corrected = raw_amps - g_base_current_offset_amps;
-    if (offset_corrected < 0.0) offset_corrected = 0.0;
-
-    Serial.print("Raw Current: ");
-    Serial.print(raw_amps, 3);
-    Serial.print(" A | Offset Current: ");
-    Serial.print(offset_corrected, 3);
-    Serial.print(" A | Corrected Current: ");
-    Serial.print(amps, 3);
-    Serial.print(" A | Active Power: ");
-    Serial.print(watts, 1);
-    Serial.println(" W");
+    float offset_corrected = raw_amps - g_base_current_offset_amps;
+    if (offset_corrected < 0.0f) offset_corrected = 0.0f;
+
+    LOG_PRINT("Raw Current: ");
+    LOG_PRINT(raw_amps, 3);
+    LOG_PRINT(" A | Offset Current: ");
+    LOG_PRINT(offset_corrected, 3);
+    LOG_PRINT(" A | Corrected Current: ");
+    LOG_PRINT(amps, 3);
+    LOG_PRINT(" A | Active Power: ");
+    LOG_PRINT(watts, 1);
+    LOG_PRINTLN(" W");
 }
 
 double get_current_amps(bool relay_on) {
     if (!relay_on) {
-        raw_amps = 0.0;
-        raw_watts = 0.0;
-        amps = 0.0;
-        watts = 0.0;
+        raw_amps = 0.0f;
+        raw_watts = 0.0f;
+        amps = 0.0f;
+        watts = 0.0f;
         return 0.0;
     }
 
@@ -218,10 +173,10 @@ double get_current_amps(bool relay_on) {
 
 double get_active_power_watts(bool relay_on) {
     if (!relay_on) {
-        raw_amps = 0.0;
-        raw_watts = 0.0;
-        amps = 0.0;
-        watts = 0.0;
+        raw_amps = 0.0f;
+        raw_watts = 0.0f;
+        amps = 0.0f;
+        watts = 0.0f;
         return 0.0;
     }
 
@@ -229,55 +184,110 @@ double get_active_power_watts(bool relay_on) {
     return watts;
 }
 
-static double get_power_reading_watts(SensorMode mode) {
+static float get_power_reading_watts(SensorMode mode) {
     if (mode == SensorMode::pin) {
         refresh_measurements_from_window();
         return watts;
     }
 
     // Fake mode for testing
-    watts = (double)random(0, 2000);
-    amps  = watts / 120.0;
+    watts = (float)random(0, 2000);
+    amps  = watts / 120.0f;
     return watts;
 }
 
-void calculate_energy_ic(SensorMode mode) {
+// Integrates power since the last sample into energy_kWh. Returns the power used, or -1 on the first call.
+static float integrate_energy_ic(SensorMode mode) {
     unsigned long nowMs = millis();
 
     if (lastSampleTimeMs == 0) {
         lastSampleTimeMs = nowMs;
         if (mode == SensorMode::pin) refresh_measurements_from_window();
-        return;
+        return -1.0f;
     }
 
-    double p_watts = get_power_reading_watts(mode);
+    float p_watts = get_power_reading_watts(mode);
+
+    energy_kWh.add(energy_kwh(p_watts, (uint32_t)(nowMs - lastSampleTimeMs)));
+
+    lastSampleTimeMs = nowMs;
+    return p_watts;
+}
+
+void calculate_energy_ic(SensorMode mode) {
+    float p_watts = integrate_energy_ic(mode);
+    if (p_watts < 0.0f) return;
+
+    LOG_PRINT("Irms est (A): ");
+    LOG_PRINT(amps, 3);
+    LOG_PRINT(" | Power (W): ");
+    LOG_PRINT(p_watts, 1);
+    LOG_PRINT(" | Energy (kWh): ");
+    LOG_PRINTLN(energy_kWh.total(), 9);
+}
+
+uint32_t get_measurement_window_ms_ic() {
+    return g_window_ms;
+}
+
+uint32_t set_measurement_window_ms_ic(uint32_t ms) {
+    if (ms < WINDOW_MIN_MS) ms = WINDOW_MIN_MS;
+    if (ms > WINDOW_MAX_MS) ms = WINDOW_MAX_MS;
+    g_window_ms = ms;
+    return ms;
+}
 
-    double elapsedHours = (nowMs - lastSampleTimeMs) / 3600000.0;
+// gain scales the build-time A/Hz; a negative offset keeps the current one.
+void set_current_calibration_ic(float gain, float offset_amps) {
+    g_current_cal_a_per_hz = CURRENT_CAL_A_PER_HZ * gain;
+    if (offset_amps >= 0.0f) g_base_current_offset_amps = offset_amps;
+}
 
-    energy_kWh += (p_watts * elapsedHours) / 1000.0;
+// Highest threshold first, as calibrate_current() scans them. count 0 restores the built-in table.
+bool set_current_bands_ic(const CurrentCalBand* bands, size_t count) {
+    if (count > CURRENT_CAL_BANDS_MAX) return false;
+    if (count == 0) {
+        bands = DEFAULT_CURRENT_BANDS;
+        count = DEFAULT_BAND_COUNT;
+    }
+    memcpy(g_current_bands, bands, count * sizeof(CurrentCalBand));
+    g_band_count = count;
+    return true;
+}
 
+// With the relay open nothing is metered: the energy clock, the measurement window
+// and the pulse inputs restart every window, so the first window after the relay
+// closes covers only its own time, not the whole time it was open.
+static void hold_while_open() {
+    unsigned long nowMs = millis();
     lastSampleTimeMs = nowMs;
+    g_last_window_ms = nowMs;
+    read_frequency_hz(PulseChannel::cf);
+    read_frequency_hz(PulseChannel::cf1);
+    raw_amps = 0.0f;
+    raw_watts = 0.0f;
+    amps  = 0.0f;
+    watts = 0.0f;
+}
 
-    Serial.print("Irms est (A): ");
-    Serial.print(amps, 3);
-    Serial.print(" | Power (W): ");
-    Serial.print(p_watts, 1);
-    Serial.print(" | Energy (kWh): ");
-    Serial.println(energy_kWh, 9);
+// Called by hardwareTask every WINDOW_MS, so energy integrates window by window
+// instead of holding one window's power for the whole report interval.
+// Returns the window's power in W (0 with the relay open), or -1 before the first window.
+float sample_measurement_window_ic(bool relay_on) {
+    if (relay_on) return integrate_energy_ic(SensorMode::pin);
+    hold_while_open();
+    return 0.0f;
 }
 
 double get_and_reset_energy_total_ic(SensorMode mode, bool relay_on) {
     if (relay_on) {
         calculate_energy_ic(mode);
-        double temp = energy_kWh;
-        energy_kWh = 0.0;
-        return temp;
+        return energy_kWh.take();
     } else {
-        raw_amps = 0.0;
-        raw_watts = 0.0;
-        amps  = 0.0;
-        watts = 0.0;
-        energy_kWh = 0.0;
-        return energy_kWh;
+        hold_while_open();
+        energy_kWh.take();
+        return 0.0;
     }
 }
+
+#endif // METERING_BACKEND_HLW8012
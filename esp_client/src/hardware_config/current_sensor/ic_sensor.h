@@ -1,8 +1,14 @@
 #pragma once
 #include "sensor.h"
+#include "metering_math.h"
 void init_current_sensor_ic(unsigned int currentSensorPin);
 void read_and_print_Irms_ic();
 double get_current_amps(bool relay_on);
 double get_active_power_watts(bool relay_on);
 void calculate_energy(SensorMode mode);
 double get_and_reset_energy_total_ic(SensorMode mode, bool relay_on);
+uint32_t get_measurement_window_ms_ic();
+uint32_t set_measurement_window_ms_ic(uint32_t ms);   // returns the window actually set
+void set_current_calibration_ic(float gain, float offset_amps);
+bool set_current_bands_ic(const CurrentCalBand* bands, size_t count);
+float sample_measurement_window_ic(bool relay_on);
@@ -0,0 +1,101 @@
+#pragma once
+#include <Arduino.h>
+#include "metering_config.h"
+#include "sensor.h"
+#include "metering_math.h"
+#if METERING_BACKEND == METERING_BACKEND_HLW8012
+#include "ic_sensor.h"
+#include "pulse_input.h"
+#endif
+
+/*
+  MeteringBackend<Impl>: the one interface main.cpp meters through.
+
+  Impl is a policy struct of static functions, picked at compile time by
+  METERING_BACKEND, so every call is a direct (inlinable) call, with no
+  virtual dispatch or function pointers:
+    init(pin)                  attach pins / ISRs / ADC
+    window_ms()                measurement window period, 0 = no window tick
+    set_window_ms(ms)          change it (clamped to what the backend supports), returns
+                               the new period; the caller re-arms the window timer
+    calibrate(gain, offset_a)  current gain on the build-time calibration, and the
+                               HLW8012 base offset (negative: keep it; the CT has none)
+    set_bands(bands, n)        replace the current calibration bands (metering_math.h),
+                               n 0 = built-in; false if the backend has none (CT)
+    sample_window(relay_on)    called every window_ms() by hardwareTask; returns the
+                               window's power in W, negative if none was measured
+    energy_kwh(relay_on)       energy since the last call, then reset
+    current_amps(relay_on)
+    voltage(relay_on)
+    input_stats()              edges and CPU interrupts taken by the pulse inputs so far
+                               (diagnostics.h); all 0 for the CT, whose ADC runs on DMA
+*/
+
+struct MeterReading {
+    double energy_kwh;
+    int volts;
+    double amps;
+    double watts;
+};
+
+struct MeterInputStats {
+    uint32_t cf;           // edges counted per channel
+    uint32_t cf1;
+    uint32_t interrupts;   // CPU interrupts taken for them
+};
+
+template <typename Impl>
+struct MeteringBackend {
+    static inline void init(unsigned int pin) { Impl::init(pin); }
+    static inline uint32_t window_ms() { return Impl::window_ms(); }
+    static inline uint32_t set_window_ms(uint32_t ms) { return Impl::set_window_ms(ms); }
+    static inline void calibrate(float gain, float offset_a) { Impl::calibrate(gain, offset_a); }
+    static inline bool set_bands(const CurrentCalBand* bands, size_t n) { return Impl::set_bands(bands, n); }
+    static inline float sample_window(bool relay_on) { return Impl::sample_window(relay_on); }
+    // Current of the window sample_window() just closed (the policy engine's input).
+    static inline float window_amps(bool relay_on) { return (float)Impl::current_amps(relay_on); }
+    static inline MeterInputStats input_stats() { return Impl::input_stats(); }
+
+    // Energy first: it closes the integration window the other values come from.
+    static inline MeterReading read(bool relay_on) {
+        MeterReading r;
+        r.energy_kwh = Impl::energy_kwh(relay_on);
+        r.amps = Impl::current_amps(relay_on);
+        r.volts = Impl::voltage(relay_on);
+        r.watts = r.volts * r.amps;
+        return r;
+    }
+};
+
+#if METERING_BACKEND == METERING_BACKEND_HLW8012
+struct Hlw8012Backend {
+    static inline void init(unsigned int pin) { init_current_sensor_ic(pin); }
+    static inline uint32_t window_ms() { return get_measurement_window_ms_ic(); }
+    static inline uint32_t set_window_ms(uint32_t ms) { return set_measurement_window_ms_ic(ms); }
+    static inline void calibrate(float gain, float offset_a) { set_current_calibration_ic(gain, offset_a); }
+    static inline bool set_bands(const CurrentCalBand* bands, size_t n) { return set_current_bands_ic(bands, n); }
+    static inline float sample_window(bool relay_on) { return sample_measurement_window_ic(relay_on); }
+    static inline double energy_kwh(bool relay_on) { return get_and_reset_energy_total_ic(SensorMode::pin, relay_on); }
+    static inline double current_amps(bool relay_on) { return get_current_amps(relay_on); }
+    static inline int voltage(bool relay_on) { return relay_on ? 12 : 0; }   // 12 V bench supply for now
+    static inline MeterInputStats input_stats() {
+        PulseInputStats s = pulse_input_stats();
+        return { s.pulses[(int)PulseChannel::cf], s.pulses[(int)PulseChannel::cf1], s.interrupts };
+    }
+};
+using Meter = MeteringBackend<Hlw8012Backend>;
+#else
+struct CtBackend {
+    static inline void init(unsigned int pin) { init_current_sensor_old(pin); }
+    static inline uint32_t window_ms() { return get_window_ms_old(); }   // drains the ADC DMA ring (~1 s deep)
+    static inline uint32_t set_window_ms(uint32_t ms) { return set_window_ms_old(ms); }
+    static inline void calibrate(float gain, float offset_a) { (void)offset_a; set_current_calibration_old(gain); }
+    static inline bool set_bands(const CurrentCalBand* bands, size_t n) { (void)bands; return n == 0; }
+    static inline float sample_window(bool relay_on) { (void)relay_on; return sample_current_window_old(); }
+    static inline double energy_kwh(bool relay_on) { (void)relay_on; return get_and_reset_energy_total_old(SensorMode::pin); }
+    static inline double current_amps(bool relay_on) { (void)relay_on; return get_current_reading(SensorMode::pin); }
+    static inline int voltage(bool relay_on) { (void)relay_on; return get_voltage_reading(SensorMode::pin); }
+    static inline MeterInputStats input_stats() { return {}; }
+};
+using Meter = MeteringBackend<CtBackend>;
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+
+/*
+  Build-time choice of metering front end. Set from platformio.ini, e.g.
+    build_flags = -D METERING_BACKEND=METERING_BACKEND_CT
+  Each backend's sources are wrapped in #if on this, so the other one never
+  reaches the image.
+*/
+#define METERING_BACKEND_HLW8012 1   // CF/CF1 pulse outputs, ic_sensor.cpp
+#define METERING_BACKEND_CT      2   // analog CT, continuous ADC DMA, sensor.cpp + ct_rms.cpp
+
+#ifndef METERING_BACKEND
+#define METERING_BACKEND METERING_BACKEND_HLW8012
+#endif
+
+#if METERING_BACKEND != METERING_BACKEND_HLW8012 && METERING_BACKEND != METERING_BACKEND_CT
+#error "METERING_BACKEND must be METERING_BACKEND_HLW8012 or METERING_BACKEND_CT"
+#endif
+
+// The HLW8012 CF1 output, or the CT's ADC pin (must be ADC1, GPIO32-39, for ADC DMA).
+#ifndef METERING_SENSOR_PIN
+#if METERING_BACKEND == METERING_BACKEND_HLW8012
+#define METERING_SENSOR_PIN 26
+#else
+#define METERING_SENSOR_PIN 34
+#endif
+#endif
+
+// How the HLW8012 CF/CF1 pulses reach the CPU, see pulse_input.h:
+//   build_flags = -D HLW8012_PULSE_INPUT=HLW8012_PULSE_INPUT_PCNT
+#define HLW8012_PULSE_INPUT_ISR  1   // GPIO interrupt per edge, edge_capture.cpp
+#define HLW8012_PULSE_INPUT_PCNT 2   // PCNT hardware counters read once per window, pcnt_capture.cpp
+
+#ifndef HLW8012_PULSE_INPUT
+#define HLW8012_PULSE_INPUT HLW8012_PULSE_INPUT_ISR
+#endif
+
+#if HLW8012_PULSE_INPUT != HLW8012_PULSE_INPUT_ISR && HLW8012_PULSE_INPUT != HLW8012_PULSE_INPUT_PCNT
+#error "HLW8012_PULSE_INPUT must be HLW8012_PULSE_INPUT_ISR or HLW8012_PULSE_INPUT_PCNT"
+#endif
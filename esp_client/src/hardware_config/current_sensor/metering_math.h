@@ -0,0 +1,63 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+
+/*
+  Metering arithmetic, kept in single precision. The ESP32 FPU only does
+  float; every double op is a soft-float library call.
+
+  Energy totals go through EnergyAccumulator. It uses compensated
+  (Kahan-Babuska/Neumaier) summation: the rounding error of each add is
+  carried in a second float, so adding thousands of tiny window increments
+  to a large total loses nothing. This is only correct if the compiler keeps
+  float ops in order, so do not build it with -ffast-math.
+*/
+
+// Thresholds are based on the offset-corrected current itself,
+// not on any first reading / baseline.
+struct CurrentCalBand {
+    float max_offset_corrected_amps;
+    float scale;
+};
+
+// Most bands a backend holds; the "bands" command may set fewer.
+constexpr size_t CURRENT_CAL_BANDS_MAX = 5;
+
+static inline float calibrate_current(float current_raw_amps, float offset_amps,
+                                      const CurrentCalBand* bands, size_t band_count, float strength) {
+    // Step 1: always apply base offset first
+    float offset_corrected = current_raw_amps - offset_amps;
+
+    // Never allow negative readings
+    if (offset_corrected <= 0.0f) return 0.0f;
+
+    // Step 2: apply scale based on the current reading itself
+    for (size_t i = 0; i < band_count; i++) {
+        if (offset_corrected >= bands[i].max_offset_corrected_amps) {
+            float scaled = offset_corrected * bands[i].scale;
+            return offset_corrected + (scaled - offset_corrected) * strength;
+        }
+    }
+
+    return offset_corrected;
+}
+
+// W over elapsed ms -> kWh (1 kWh = 3.6e9 W*ms).
+static inline float energy_kwh(float watts, uint32_t elapsed_ms) {
+    return watts * (float)elapsed_ms * (1.0f / 3600000000.0f);
+}
+
+struct EnergyAccumulator {
+    float sum;
+    float comp;   // running compensation: what sum has rounded away so far
+
+    void add(float x) {
+        float t = sum + x;
+        if (fabsf(sum) >= fabsf(x)) comp += (sum - t) + x;
+        else                        comp += (x - t) + sum;
+        sum = t;
+    }
+    float total() const { return sum + comp; }
+    float take() { float v = total(); sum = 0.0f; comp = 0.0f; return v; }
+};
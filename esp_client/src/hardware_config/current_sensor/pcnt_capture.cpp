@@ -0,0 +1,31 @@
+#include "metering_config.h"
+#if METERING_BACKEND == METERING_BACKEND_HLW8012
+#include "pcnt_capture.h"
+#include "edge_capture.h"   // EDGE_GONE_PERIODS
+
+float pcnt_capture_frequency_hz(CountChannel& ch, uint32_t total, uint32_t now_us, uint32_t timeout_us) {
+    uint32_t n = ch.snaps;
+    if (n == 0 || total != ch.snap_count[(n - 1) % PCNT_SNAPSHOTS]) ch.last_change_us = now_us;
+    ch.snap_us[n % PCNT_SNAPSHOTS] = now_us;
+    ch.snap_count[n % PCNT_SNAPSHOTS] = total;
+    ch.snaps = ++n;
+    if (n < 2) return 0.0f;
+
+    // Walk back until the span holds enough pulses, or can't grow any further.
+    uint32_t available = n < PCNT_SNAPSHOTS ? n : PCNT_SNAPSHOTS;
+    uint32_t pulses = 0, span = 0;
+    for (uint32_t back = 1; back < available; back++) {
+        uint32_t i = (n - 1 - back) % PCNT_SNAPSHOTS;
+        pulses = total - ch.snap_count[i];
+        span = now_us - ch.snap_us[i];
+        if (pulses >= PCNT_MIN_PULSES) break;
+    }
+    if (pulses == 0 || span == 0) return 0.0f;
+    if (now_us - ch.last_change_us > timeout_us) return 0.0f;
+
+    float hz = (float)pulses * 1000000.0f / (float)span;
+    float stalled = (float)(now_us - ch.last_change_us) * hz / 1000000.0f;
+    return stalled > EDGE_GONE_PERIODS ? 0.0f : hz;
+}
+
+#endif // METERING_BACKEND_HLW8012
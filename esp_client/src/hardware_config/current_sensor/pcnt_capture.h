@@ -0,0 +1,42 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+  Frequency from the PCNT hardware counters for the HLW8012 CF/CF1 outputs.
+
+  In HLW8012_PULSE_INPUT_PCNT mode (pulse_input.cpp) the pulse counter counts
+  the edges, so the CPU takes no interrupt per pulse; only a counter wrap at
+  PCNT_COUNTER_LIMIT interrupts it, which is minutes apart at HLW8012 rates.
+  hardwareTask reads the running total once per window and
+  pcnt_capture_frequency_hz() keeps those (time, count) snapshots in a small
+  ring:
+    - the estimate is the count difference over the time difference back to
+      the newest snapshot that is at least PCNT_MIN_PULSES pulses behind, so
+      a busy load reads from the last window alone and a light one from a
+      longer span, up to the PCNT_SNAPSHOTS windows the ring holds (8 s)
+    - it drops to 0 once the count has not moved for EDGE_GONE_PERIODS
+      periods of that estimate, or for timeout_us
+  Unlike the per-edge ISR there are no edge timestamps, so each estimate is
+  off by up to one pulse over its span (+-1/PCNT_MIN_PULSES at worst), and a
+  load of a few Hz takes seconds to settle instead of 2-3 edges;
+  host/bench/edge_estimator_bench.cpp compares the two.
+*/
+
+#ifndef PCNT_COUNTER_LIMIT
+#define PCNT_COUNTER_LIMIT 32000      // counter wraps to 0 here (int16 register)
+#endif
+#ifndef PCNT_SNAPSHOTS
+#define PCNT_SNAPSHOTS 16
+#endif
+#ifndef PCNT_MIN_PULSES
+#define PCNT_MIN_PULSES 32
+#endif
+
+struct CountChannel {
+    uint32_t snaps;                   // snapshots taken
+    uint32_t snap_us[PCNT_SNAPSHOTS];
+    uint32_t snap_count[PCNT_SNAPSHOTS];
+    uint32_t last_change_us;          // first snapshot at the current count
+};
+
+float pcnt_capture_frequency_hz(CountChannel& ch, uint32_t total, uint32_t now_us, uint32_t timeout_us);
@@ -0,0 +1,131 @@
+#include "metering_config.h"
+#if METERING_BACKEND == METERING_BACKEND_HLW8012
+#include "pulse_input.h"
+#include "edge_capture.h"
+#include "pcnt_capture.h"
+
+static constexpr int CHANNELS = (int)PulseChannel::count;
+
+#if HLW8012_PULSE_INPUT == HLW8012_PULSE_INPUT_ISR
+
+/* === ISR mode: one GPIO interrupt per edge === */
+static EdgeChannel g_edges[CHANNELS] = {};
+
+static void IRAM_ATTR isr_cf()  { edge_capture_record(g_edges[(int)PulseChannel::cf],  (uint32_t)micros()); }
+static void IRAM_ATTR isr_cf1() { edge_capture_record(g_edges[(int)PulseChannel::cf1], (uint32_t)micros()); }
+
+void pulse_input_init(PulseChannel ch, uint8_t pin) {
+    pinMode(pin, INPUT);  // some boards might need INPUT_PULLUP
+    // the HLW8012 sends the ESP32 square waves, so every rising edge counts as a pulse
+    attachInterrupt(digitalPinToInterrupt(pin), ch == PulseChannel::cf ? isr_cf : isr_cf1, RISING);
+}
+
+float pulse_input_frequency_hz(PulseChannel ch, uint32_t now_us, uint32_t timeout_us) {
+    return edge_capture_frequency_hz(g_edges[(int)ch], now_us, timeout_us);
+}
+
+const char* pulse_input_mode_name() { return "isr"; }
+
+PulseInputStats pulse_input_stats() {
+    PulseInputStats s = {};
+    for (int i = 0; i < CHANNELS; i++) {
+        s.pulses[i] = g_edges[i].count;
+        s.interrupts += g_edges[i].count;
+    }
+    return s;
+}
+
+#else
+
+/* === PCNT mode: hardware counters, read once per window === */
+#include <driver/pcnt.h>
+
+#ifndef PCNT_FILTER_TICKS
+#define PCNT_FILTER_TICKS 100   // APB cycles (80 MHz): ignore glitches under 1.25 us
+#endif
+
+struct PcntInput {
+    pcnt_unit_t unit;
+    volatile uint32_t wraps;    // written by the overflow ISR
+    uint32_t last_total;
+    CountChannel est;
+};
+
+static PcntInput g_pcnt[CHANNELS] = {
+    { PCNT_UNIT_0, 0, 0, {} },
+    { PCNT_UNIT_1, 0, 0, {} },
+};
+static volatile uint32_t g_wrap_interrupts = 0;
+static bool g_isr_service = false;
+
+static void IRAM_ATTR pcnt_overflow_isr(void* arg) {
+    PcntInput* in = (PcntInput*)arg;
+    uint32_t status = 0;
+    pcnt_get_event_status(in->unit, &status);
+    if (status & PCNT_EVT_H_LIM) in->wraps = in->wraps + 1;
+    g_wrap_interrupts = g_wrap_interrupts + 1;
+}
+
+// Running edge count: wraps * limit + counter.
+static uint32_t read_total(PcntInput& in) {
+    uint32_t wraps;
+    int16_t counter = 0;
+    do {
+        wraps = in.wraps;
+        pcnt_get_counter_value(in.unit, &counter);
+    } while (wraps != in.wraps);
+    uint32_t total = wraps * (uint32_t)PCNT_COUNTER_LIMIT + (uint16_t)counter;
+    // The counter wrapped but its ISR hasn't run yet: count the wrap ourselves.
+    if ((int32_t)(total - in.last_total) < 0) total += PCNT_COUNTER_LIMIT;
+    in.last_total = total;
+    return total;
+}
+
+void pulse_input_init(PulseChannel ch, uint8_t pin) {
+    PcntInput& in = g_pcnt[(int)ch];
+    pinMode(pin, INPUT);  // some boards might need INPUT_PULLUP
+
+    pcnt_config_t cfg = {};
+    cfg.pulse_gpio_num = pin;
+    cfg.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+    cfg.lctrl_mode = PCNT_MODE_KEEP;
+    cfg.hctrl_mode = PCNT_MODE_KEEP;
+    cfg.pos_mode = PCNT_COUNT_INC;    // rising edges, like the ISR mode
+    cfg.neg_mode = PCNT_COUNT_DIS;
+    cfg.counter_h_lim = PCNT_COUNTER_LIMIT;
+    cfg.counter_l_lim = 0;
+    cfg.unit = in.unit;
+    cfg.channel = PCNT_CHANNEL_0;
+    pcnt_unit_config(&cfg);
+
+    pcnt_set_filter_value(in.unit, PCNT_FILTER_TICKS);
+    pcnt_filter_enable(in.unit);
+
+    pcnt_event_enable(in.unit, PCNT_EVT_H_LIM);
+    if (!g_isr_service) {
+        pcnt_isr_service_install(0);
+        g_isr_service = true;
+    }
+    pcnt_isr_handler_add(in.unit, pcnt_overflow_isr, &in);
+
+    pcnt_counter_pause(in.unit);
+    pcnt_counter_clear(in.unit);
+    pcnt_counter_resume(in.unit);
+}
+
+float pulse_input_frequency_hz(PulseChannel ch, uint32_t now_us, uint32_t timeout_us) {
+    PcntInput& in = g_pcnt[(int)ch];
+    return pcnt_capture_frequency_hz(in.est, read_total(in), now_us, timeout_us);
+}
+
+const char* pulse_input_mode_name() { return "pcnt"; }
+
+PulseInputStats pulse_input_stats() {
+    PulseInputStats s = {};
+    for (int i = 0; i < CHANNELS; i++) s.pulses[i] = g_pcnt[i].last_total;   // as of the last window
+    s.interrupts = g_wrap_interrupts;
+    return s;
+}
+
+#endif // HLW8012_PULSE_INPUT
+#endif // METERING_BACKEND_HLW8012
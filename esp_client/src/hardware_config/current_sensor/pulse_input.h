@@ -0,0 +1,25 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+  HLW8012 CF/CF1 pulse inputs, behind one interface for both capture modes
+  (HLW8012_PULSE_INPUT in metering_config.h):
+    ISR   a GPIO interrupt timestamps every rising edge (edge_capture.h);
+          one interrupt per pulse, reciprocal (edge-timed) frequency
+    PCNT  the ESP32 pulse counter peripheral counts the edges in hardware,
+          glitch-filtered; the CPU reads each counter once per window and
+          only takes an interrupt when a counter wraps (pcnt_capture.h)
+  ic_sensor.cpp calls pulse_input_frequency_hz() once per measurement window.
+*/
+
+enum class PulseChannel : uint8_t { cf, cf1, count };
+
+struct PulseInputStats {
+    uint32_t pulses[(int)PulseChannel::count];   // edges counted, per channel
+    uint32_t interrupts;                          // CPU interrupts taken for them
+};
+
+void pulse_input_init(PulseChannel ch, uint8_t pin);
+float pulse_input_frequency_hz(PulseChannel ch, uint32_t now_us, uint32_t timeout_us);
+const char* pulse_input_mode_name();
+PulseInputStats pulse_input_stats();
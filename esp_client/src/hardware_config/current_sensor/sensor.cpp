@@ -1,39 +1,229 @@
+#include "metering_config.h"
+#if METERING_BACKEND == METERING_BACKEND_CT
 #include "sensor.h"
 #include <Arduino.h> 
-#include <EmonLib.h>
-EnergyMonitor emon1;
+#include <esp_idf_version.h>
+#if ESP_IDF_VERSION_MAJOR >= 5
+#include <esp_adc/adc_continuous.h>
+#elif ESP_IDF_VERSION_MAJOR == 4
+#include <driver/i2s.h>
+#include <driver/adc.h>
+#else
+#error "The CT backend needs ESP-IDF 4.4 (Arduino core 2.x) or 5.x (core 3.x)"
+#endif
+#include "metering_math.h"
+#include "ct_rms.h"
+#include "../../diagnostics/log.h"
+
+/*
+  CT sensor, sampled continuously: ADC1 runs in DMA mode and fills a ring of
+  buffers in the background. hardwareTask drains that ring every window tick
+  (never blocking) into the incremental RMS in ct_rms.cpp, so nothing
+  busy-samples the ADC any more and every mains cycle is metered.
+    - ESP-IDF 5 (Arduino core 3.x): the adc_continuous driver. The ESP32 ADC
+      won't convert slower than SOC_ADC_SAMPLE_FREQ_THRES_LOW (20 kHz), so it
+      runs CT_ADC_OVERSAMPLE times faster than CT_SAMPLE_RATE_HZ and each run
+      of CT_ADC_OVERSAMPLE conversions is averaged into one sample.
+    - ESP-IDF 4.4 (core 2.x): the legacy I2S driver clocks ADC1 at
+      CT_SAMPLE_RATE_HZ itself. IDF 5 removed its built-in ADC mode.
+*/
 
-#ifndef CURRENT_CAL 
-#define CURRENT_CAL 50.0f
+#if ESP_IDF_VERSION_MAJOR >= 5
+#define CT_ADC_FRAME_BYTES 1024   // one DMA frame: 512 conversions, ~22 ms at 23 kHz
+#define CT_ADC_POOL_FRAMES 24     // ~0.5 s of headroom
+static constexpr uint32_t CT_ADC_OVERSAMPLE = (SOC_ADC_SAMPLE_FREQ_THRES_LOW + CT_SAMPLE_RATE_HZ - 1) / CT_SAMPLE_RATE_HZ;
+static constexpr uint32_t CT_ADC_RATE_HZ = CT_SAMPLE_RATE_HZ * CT_ADC_OVERSAMPLE;
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 2, 0)
+#define CT_ADC_ATTEN ADC_ATTEN_DB_12
+#else
+#define CT_ADC_ATTEN ADC_ATTEN_DB_11
 #endif
 
-unsigned long lastCurrentPrint = 0;
+static adc_continuous_handle_t g_adc = nullptr;
+static adc_channel_t g_adc_channel;
+static uint8_t adc_frame[CT_ADC_FRAME_BYTES];
+static uint32_t g_dec_sum = 0;   // conversions of the sample being averaged
+static uint32_t g_dec_n = 0;
+#else
+#define CT_I2S_PORT I2S_NUM_0
+#define CT_DMA_BUF_COUNT 8
+#define CT_DMA_BUF_LEN 512      // samples; 8 x 512 = ~1 s of headroom at 3840 Hz
+#endif
 
-const float V_LINE = 120.0;
-const float POWER_FACTOR = 1.0;
-double Irms;
-double realPower;
-double energy_kWh = 0;
-unsigned long lastSampleTime = 0;
+static unsigned long lastCurrentPrint = 0;
 
+static const float V_LINE = 120.0;
+static const float POWER_FACTOR = 1.0;
+static float Irms;
+static float realPower;
+static CtRms ct;
+static bool ct_running = false;
+static uint16_t dma_chunk[256];
+// How often hardwareTask drains the DMA ring; stay well under what it holds.
+static constexpr uint32_t WINDOW_MIN_MS = 50;
+#if ESP_IDF_VERSION_MAJOR >= 5
+static constexpr uint32_t WINDOW_MAX_MS = 350;
+#else
+static constexpr uint32_t WINDOW_MAX_MS = 750;
+#endif
+static uint32_t g_window_ms = 250;
+
+// Test-mode (fake readings) energy, integrated at report time
+static EnergyAccumulator energy_kWh = {};
+static unsigned long lastSampleTime = 0;
+
+#if ESP_IDF_VERSION_MAJOR >= 5
+// ADC2 can't run continuously next to WiFi: ADC1 only, GPIO32-39.
 void init_current_sensor_old(unsigned int currentSensorPin){
-	analogSetPinAttenuation(currentSensorPin, ADC_11db);
-	analogReadResolution(12);
-    	emon1.current(currentSensorPin, CURRENT_CAL);  // pin, calibration
+	adc_unit_t unit;
+	adc_channel_t channel;
+	if (adc_continuous_io_to_channel((int)currentSensorPin, &unit, &channel) != ESP_OK || unit != ADC_UNIT_1) {
+		LOG_PRINTLN("CT pin must be an ADC1 pin (GPIO32-39) for continuous sampling");
+		return;
+	}
+	ct_rms_init(ct, CT_AMPS_PER_COUNT, V_LINE, POWER_FACTOR);
+
+	adc_continuous_handle_cfg_t handle_config = {};
+	handle_config.max_store_buf_size = CT_ADC_FRAME_BYTES * CT_ADC_POOL_FRAMES;
+	handle_config.conv_frame_size = CT_ADC_FRAME_BYTES;
+	if (adc_continuous_new_handle(&handle_config, &g_adc) != ESP_OK) {
+		LOG_PRINTLN("CT: adc_continuous_new_handle failed");
+		return;
+	}
+
+	adc_digi_pattern_config_t pattern = {};
+	pattern.atten = CT_ADC_ATTEN;
+	pattern.channel = channel;
+	pattern.unit = ADC_UNIT_1;
+	pattern.bit_width = ADC_BITWIDTH_12;
+	adc_continuous_config_t config = {};
+	config.pattern_num = 1;
+	config.adc_pattern = &pattern;
+	config.sample_freq_hz = CT_ADC_RATE_HZ;
+	config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+	config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+	if (adc_continuous_config(g_adc, &config) != ESP_OK || adc_continuous_start(g_adc) != ESP_OK) {
+		LOG_PRINTLN("CT: adc_continuous start failed");
+		return;
+	}
+	g_adc_channel = channel;
+	ct_running = true;
+}
+
+// Folds everything the DMA has captured since the last call into the RMS. Zero timeout: never blocks.
+// Returns the power over the RMS window in W, or -1 until the first mains cycle closes.
+float sample_current_window_old(){
+	static_assert(CT_ADC_FRAME_BYTES / SOC_ADC_DIGI_RESULT_BYTES / CT_ADC_OVERSAMPLE < sizeof(dma_chunk) / sizeof(dma_chunk[0]),
+	              "a frame's samples must fit dma_chunk");
+	if (!ct_running) return -1.0f;
+	uint32_t bytes = 0;
+	do {
+		if (adc_continuous_read(g_adc, adc_frame, sizeof(adc_frame), &bytes, 0) != ESP_OK) break;
+		size_t n = 0;
+		for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= bytes; i += SOC_ADC_DIGI_RESULT_BYTES) {
+			const adc_digi_output_data_t* d = (const adc_digi_output_data_t*)&adc_frame[i];
+			if (d->type1.channel != g_adc_channel) continue;
+			g_dec_sum += d->type1.data;
+			if (++g_dec_n == CT_ADC_OVERSAMPLE) {
+				dma_chunk[n++] = (uint16_t)((g_dec_sum + CT_ADC_OVERSAMPLE / 2) / CT_ADC_OVERSAMPLE);
+				g_dec_sum = 0;
+				g_dec_n = 0;
+			}
+		}
+		ct_rms_push(ct, dma_chunk, n);
+	} while (bytes == sizeof(adc_frame));
+	return ct.cycles ? ct_rms_irms(ct) * V_LINE * POWER_FACTOR : -1.0f;
+}
+#else
+// I2S can only drive ADC1, which lives on GPIO32-39.
+static int adc1_channel_for_pin(unsigned int pin) {
+	switch (pin) {
+		case 36: return ADC1_CHANNEL_0;
+		case 37: return ADC1_CHANNEL_1;
+		case 38: return ADC1_CHANNEL_2;
+		case 39: return ADC1_CHANNEL_3;
+		case 32: return ADC1_CHANNEL_4;
+		case 33: return ADC1_CHANNEL_5;
+		case 34: return ADC1_CHANNEL_6;
+		case 35: return ADC1_CHANNEL_7;
+		default: return -1;
+	}
+}
+
+void init_current_sensor_old(unsigned int currentSensorPin){
+	int channel = adc1_channel_for_pin(currentSensorPin);
+	if (channel < 0) {
+		LOG_PRINTLN("CT pin must be an ADC1 pin (GPIO32-39) for continuous sampling");
+		return;
+	}
+	ct_rms_init(ct, CT_AMPS_PER_COUNT, V_LINE, POWER_FACTOR);
+
+	i2s_config_t config = {};
+	config.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN);
+	config.sample_rate = CT_SAMPLE_RATE_HZ;
+	config.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+	config.channel_format = I2S_CHANNEL_FMT_ONLY_LEFT;
+	config.communication_format = I2S_COMM_FORMAT_STAND_MSB;
+	config.dma_buf_count = CT_DMA_BUF_COUNT;
+	config.dma_buf_len = CT_DMA_BUF_LEN;
+	config.use_apll = false;
+
+	if (i2s_driver_install(CT_I2S_PORT, &config, 0, NULL) != ESP_OK) {
+		LOG_PRINTLN("CT: i2s_driver_install failed");
+		return;
+	}
+	adc1_config_width(ADC_WIDTH_BIT_12);
+	adc1_config_channel_atten((adc1_channel_t)channel, ADC_ATTEN_DB_11);
+	i2s_set_adc_mode(ADC_UNIT_1, (adc1_channel_t)channel);
+	i2s_adc_enable(CT_I2S_PORT);
+	ct_running = true;
+}
+
+// Folds everything the DMA has captured since the last call into the RMS. Zero timeout: never blocks.
+// Returns the power over the RMS window in W, or -1 until the first mains cycle closes.
+float sample_current_window_old(){
+	if (!ct_running) return -1.0f;
+	size_t bytes = 0;
+	do {
+		i2s_read(CT_I2S_PORT, dma_chunk, sizeof(dma_chunk), &bytes, 0);
+		size_t n = bytes / sizeof(dma_chunk[0]);
+		for (size_t i = 0; i < n; i++) dma_chunk[i] &= 0x0FFF;   // top 4 bits carry the channel
+		ct_rms_push(ct, dma_chunk, n);
+	} while (bytes == sizeof(dma_chunk));
+	return ct.cycles ? ct_rms_irms(ct) * V_LINE * POWER_FACTOR : -1.0f;
+}
+#endif
+
+uint32_t get_window_ms_old(){
+	return g_window_ms;
+}
+
+uint32_t set_window_ms_old(uint32_t ms){
+	if (ms < WINDOW_MIN_MS) ms = WINDOW_MIN_MS;
+	if (ms > WINDOW_MAX_MS) ms = WINDOW_MAX_MS;
+	g_window_ms = ms;
+	return ms;
+}
+
+// gain scales the build-time CT_AMPS_PER_COUNT.
+void set_current_calibration_old(float gain){
+	ct.amps_per_count = CT_AMPS_PER_COUNT * gain;
 }
 
 void read_and_print_Irms_old(){
 	if (millis() - lastCurrentPrint >= 1000) {
-            Irms = emon1.calcIrms(1480);
-            Serial.print("Current (Irms): ");
-            Serial.print(Irms, 2);
-            Serial.println(" A");
+            Irms = (float)get_current_reading(SensorMode::pin);
+            LOG_PRINT("Current (Irms): ");
+            LOG_PRINT(Irms, 2);
+            LOG_PRINTLN(" A");
             lastCurrentPrint = millis();
         }
 }
 
 double get_current_reading(SensorMode mode){
-        return (mode == SensorMode::pin) ? emon1.calcIrms(1480) : random(100, 900) / 1000.0;
+        if (mode != SensorMode::pin) return random(100, 900) / 1000.0;
+        sample_current_window_old();
+        return ct_rms_irms(ct);
 }
 
 int get_voltage_reading(SensorMode mode){
@@ -42,35 +232,31 @@ int get_voltage_reading(SensorMode mode){
 }
 
 void calculate_energy(SensorMode mode){
-            Irms = get_current_reading(mode);
+            Irms = (float)get_current_reading(mode);
             // Estimate real power (Watts)
             realPower = Irms * V_LINE * POWER_FACTOR;
 
-            // Time since last sample in hours
+            // Time since last sample, accumulate energy in kWh
             unsigned long now = millis();
-            double elapsedHours = (now - lastSampleTime) / 3600000.0;
-
-            // Accumulate energy
-            energy_kWh += (realPower * elapsedHours) / 1000.0; // convert W to kW-hours
+            if (mode != SensorMode::pin) energy_kWh.add(energy_kwh(realPower, (uint32_t)(now - lastSampleTime)));
             
             lastSampleTime = now;
 
             // Print results
             // Will want to comment this out, when not testing/ in prod.
             // Printing is a heavy operation.
-            Serial.print("Irms (A): ");
-            Serial.print(Irms, 3);
-            Serial.print(" | Power (W): ");
-            Serial.print(realPower, 1);
-            Serial.print(" | Energy (kWh): ");
-            Serial.println(energy_kWh, 9);
+            LOG_PRINT("Irms (A): ");
+            LOG_PRINT(Irms, 3);
+            LOG_PRINT(" | Power (W): ");
+            LOG_PRINT(realPower, 1);
+            LOG_PRINT(" | Energy (kWh): ");
+            LOG_PRINTLN(energy_kWh.total() + ct.energy.total(), 9);
 }
 
 double get_and_reset_energy_total_old(SensorMode mode){
         calculate_energy(mode);
-        double temp = energy_kWh;
-        energy_kWh = 0;
-        return temp;
+        // In pin mode the sampler integrated every mains cycle since the last report.
+        return mode == SensorMode::pin ? ct_rms_take_energy_kwh(ct) : energy_kWh.take();
 }
 
-
+#endif // METERING_BACKEND_CT
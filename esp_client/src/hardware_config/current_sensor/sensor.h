@@ -1,9 +1,14 @@
 #pragma once
+#include <stdint.h>
 
 typedef enum {test, pin} SensorMode;
 double get_and_reset_energy_total_old(SensorMode mode = pin);
 void init_current_sensor_old(unsigned int currentSensorPin);
 void read_and_print_Irms_old();
+float sample_current_window_old();
+uint32_t get_window_ms_old();
+uint32_t set_window_ms_old(uint32_t ms);   // returns the window actually set
+void set_current_calibration_old(float gain);
 double get_current_reading(SensorMode mode);
 int get_voltage_reading(SensorMode mode);
 
@@ -1,20 +1,26 @@
 #include "relay.h"
+#include <atomic>
 
-volatile boolean relayState = false;
+static std::atomic<bool> relay_state{false};
 
 void init_relay(unsigned int relayPin){
     pinMode(relayPin, OUTPUT);
     digitalWrite(relayPin, LOW);
+    relay_state.store(false, std::memory_order_release);
 }
 
 void turn_on_relay(unsigned int relayPin){
     digitalWrite(relayPin, HIGH);
-    relayState = true;
+    relay_state.store(true, std::memory_order_release);
 }
 
 void turn_off_relay(unsigned int relayPin){
     digitalWrite(relayPin, LOW);
-    relayState = false;
+    relay_state.store(false, std::memory_order_release);
+}
+
+bool relay_is_on() {
+    return relay_state.load(std::memory_order_acquire);
 }
 
 void relay_serial_command_handler(unsigned int relayPin){
@@ -33,7 +39,7 @@ void relay_serial_command_handler(unsigned int relayPin){
         } 
         else if (command == "STATUS") {
             Serial.print("Relay status: ");
-            Serial.println(relayState ? "ON" : "OFF");
+            Serial.println(relay_is_on() ? "ON" : "OFF");
         } 
         else if (command.length() > 0) {
             Serial.println("Invalid command. Use: ON, OFF, 1, 0, or STATUS");
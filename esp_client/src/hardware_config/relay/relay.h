@@ -1,9 +1,14 @@
 #pragma once
 #include <Arduino.h> 
 
-extern volatile boolean relayState;
+/*
+  The relay and its state. Only hardwareTask switches it (commands, policy trips,
+  the serial console); mqttTask reads the state for diag and command acks, so it
+  is kept in one atomic here and nowhere else.
+*/
+
 void init_relay(unsigned int relayPin);
 void turn_on_relay(unsigned int relayPin);
 void turn_off_relay(unsigned int relayPin);
+bool relay_is_on();
 void relay_serial_command_handler(unsigned int relayPin);
-
@@ -1,32 +1,47 @@
 #include "../main.h"
 #include "./mqtt_config/mqtt_config.h"
 #include "./env_config/env_config.h"
-#include "./hardware_config/current_sensor/sensor.h"
-#include "./hardware_config/current_sensor/ic_sensor.h"
+#include "./hardware_config/current_sensor/metering_backend.h"
 #include "./hardware_config/relay/relay.h"
+#include "./telemetry/telemetry.h"
+#include "./telemetry/report_batch.h"
+#include "./telemetry/window_stats.h"
+#include "./telemetry/report_policy.h"
+#include "./reading_store/reading_store.h"
+#include "./energy_register/energy_register.h"
+#include "./reading_clock/reading_clock.h"
+#include "./publish_queue/publish_queue.h"
+#include "./scheduler/scheduler.h"
+#include "./commands/commands.h"
+#include "./tuning/tuning.h"
+#include "./policy/policy.h"
+#include "./diagnostics/diagnostics.h"
 #include "HardwareSerial.h"
 #include <WiFi.h>
 #include <PubSubClient.h>
-#include <ArduinoJson.h>
 
 /* Global Pin Config */
 const unsigned int ledPin_external = 14;
 const unsigned int ledPin_internal = 2;
 const unsigned int button_input = 27; 
 const unsigned int relayPin = 33;      // Pin connected to relay
-const unsigned int currentSensorPin = 26;
-
-/* Global Flags */
-volatile boolean message_recieved = false;
-volatile boolean relay_on = false;
+const unsigned int currentSensorPin = METERING_SENSOR_PIN; // HLW8012 CF1, or the CT's ADC1 pin
 
 /* General Global Vars */
 const unsigned int one_minute = 60000;
 unsigned long lastSendingTime = 0;
 unsigned int timeInterval = 0;
-constexpr unsigned int BUFFER_SIZE = 256;
-StaticJsonDocument<BUFFER_SIZE> doc;
-char buffer[BUFFER_SIZE];
+Tuning tuning;                // hardwareTask only: what the commands set, mirrored to NVS
+bool tuning_dirty = false;    // hardwareTask only: tuning changed since the last save
+constexpr unsigned int BUFFER_SIZE = MQTT_BUFFER_SIZE;
+uint8_t buffer[BUFFER_SIZE];
+DeviceReading backlog[READING_STORE_DRAIN_BATCH];
+uint32_t batch_enqueued_us[REPORT_BATCH_CAPACITY];
+boolean last_reported_relay = false;
+double dropped_energy = 0;   // hardwareTask only: energy from readings the publish queue had no room for
+WindowStats window_stats;    // hardwareTask only: power of every window since the last report
+float last_window_watts = -1.0f;   // hardwareTask only: latest window power, < 0 before the first
+uint32_t last_policy_ms = 0;       // hardwareTask only: when the policy engine last saw a window
 
 /* Metering Global Vars */
 double energyIncrement;
@@ -34,78 +49,430 @@ int volts;
 double amps;
 double power;
 
-// When the server sends a message to this device. Via "client_subscribe_topic", decide what to do with it here.
+// When the server sends a message to this device, via "client_subscribe_topic" ("<cid>/cmd/#").
+// Runs inside client.loop(): parse and queue only, hardwareTask applies it (see commands.h).
 void fn_on_message_received(char* topic, byte* payload, unsigned int length ){
-    if (val_incoming_topic(topic, env.sub.c_str())) {
-        const char* slash = strchr(topic, '/');
-        if (strcmp(slash + 1, "cmd/relay/on") == 0){
-            Serial.println("Relay On");
-            turn_on_relay(relayPin);
-            relay_on = true;
-        } else if (strcmp(slash + 1, "cmd/relay/off") == 0){
-            turn_off_relay(relayPin);
-            Serial.println("Relay off");
-            relay_on = false;
-        }
+    if (val_incoming_topic(topic, env.sub)) {
+        command_dispatch(topic + strlen(env.sub) - 1, payload, length);
+    }
+}
+
+// Meter is the backend picked by METERING_BACKEND (see metering_backend.h).
+void update_metering_vars() {
+    MeterReading r = Meter::read(relay_is_on());
+    energyIncrement = r.energy_kwh;
+    amps = r.amps;
+    volts = r.volts;
+    power = r.watts;
+}
+
+bool publish_reading(const DeviceReading& reading) {
+    size_t len = encode_reading(env.telemetry, reading, env.cid, buffer, BUFFER_SIZE);
+    return len > 0 && publish_message(env.pub, (const char*)buffer, len);
+}
+
+bool batching_enabled() {
+    return env.telemetry == TelemetryFormat::binary && report_batch_enabled();
+}
+
+// Publishes readings oldest first, as one batch message when batching is on. Returns how many went out.
+size_t publish_readings(const DeviceReading* readings, size_t count) {
+    if (batching_enabled()) {
+        size_t len = encode_batch_binary(readings, count, millis(), buffer, BUFFER_SIZE);
+        return (len > 0 && publish_message(env.pub, (const char*)buffer, len)) ? count : 0;
+    }
+    size_t sent = 0;
+    while (sent < count && publish_reading(readings[sent])) sent++;
+    return sent;
+}
+
+void drain_backlog() {
+    size_t n = reading_store_peek(backlog, READING_STORE_DRAIN_BATCH);
+    for (size_t i = 0; i < n; i++) reading_clock_resolve(backlog[i]);
+    if (n > 0) reading_store_consume(publish_readings(backlog, n));
+}
+
+/* === mqttTask side: the only code that publishes === */
+
+bool publish_diag() {
+    char topic[sizeof(env.cid) + 8];
+    snprintf(topic, sizeof(topic), "%s/diag", env.cid);
+    const CommandStats& cs = command_stats();
+    const PublishQueueStats& qs = publish_queue_stats();
+    const PolicyStats& ps = policy_stats();
+    const MqttLinkStats& ls = mqtt_link_stats();
+    const ReadingClockStats& rc = reading_clock_stats();
+    int len = snprintf((char*)buffer, BUFFER_SIZE,
+        "{\"uptimeS\":%lu,\"relay\":%d,\"intervalMs\":%u,\"windowMs\":%lu,\"mode\":\"%s\",\"periodMs\":%lu,"
+        "\"tuneSaves\":%lu,\"reconnects\":%lu,\"publishFailed\":%lu,"
+        "\"queueDropped\":%lu,\"cmd\":{\"received\":%lu,\"unknown\":%lu,\"rejected\":%lu,"
+        "\"dropped\":%lu,\"applied\":%lu,\"callbackMaxUs\":%lu,\"acks\":%lu,\"applyMaxUs\":%lu},"
+        "\"policy\":{\"rules\":%u,\"enforced\":%d,\"violations\":%lu,\"trips\":%lu,\"lastRule\":%d,"
+        "\"lastType\":\"%s\",\"lastValue\":%.3f,\"tripLastUs\":%lu,\"tripMaxUs\":%lu,\"evalMaxUs\":%lu,"
+        "\"energyTodayWh\":%.3f},\"clock\":{\"boot\":%lu,\"seq\":%lu,\"synced\":%d,\"syncs\":%lu,\"stepMs\":%ld},",
+        (unsigned long)(millis() / 1000), relay_is_on() ? 1 : 0, timeInterval, (unsigned long)Meter::window_ms(),
+        report_mode_name(report_policy().mode), (unsigned long)report_policy_period_ms(timeInterval),
+        (unsigned long)tuning_stats().saves, (unsigned long)ls.reconnects, (unsigned long)ls.publish_failures,
+        (unsigned long)qs.dropped,
+        (unsigned long)cs.received, (unsigned long)cs.unknown, (unsigned long)cs.rejected,
+        (unsigned long)cs.dropped, (unsigned long)cs.applied, (unsigned long)cs.callback_max_us,
+        (unsigned long)cs.acks, (unsigned long)cs.apply_max_us,
+        (unsigned)policy_active().count, (policy_active().flags & POLICY_FLAG_ENFORCE) ? 1 : 0,
+        (unsigned long)ps.violations, (unsigned long)ps.trips, ps.last_rule, policy_rule_name(ps.last_type),
+        ps.last_value, (unsigned long)ps.trip_last_us, (unsigned long)ps.trip_max_us, (unsigned long)ps.eval_max_us,
+        ps.energy_today_wh, (unsigned long)rc.boot_id, (unsigned long)rc.seq, rc.synced ? 1 : 0,
+        (unsigned long)rc.syncs, (long)rc.last_step_ms);
+    if (len <= 0 || len >= (int)BUFFER_SIZE) return false;
+    // Task, ISR and heap instrumentation for the period since the last message.
+    size_t more = diag_write_json(diag_collect(millis()), (char*)buffer + len, BUFFER_SIZE - len);
+    if (more == 0 || len + more + 1 >= BUFFER_SIZE) return false;
+    len += more;
+    buffer[len++] = '}';
+    return publish_message(topic, (const char*)buffer, len);
+}
+
+// Publishes the open batch; what doesn't go out is stored.
+static void flush_batch() {
+    // Backlog first, so the fresh readings are the last ones the backend sees.
+    if (client.connected()) drain_backlog();
+
+    size_t count = report_batch_count();
+    const DeviceReading* samples = report_batch_samples();
+    size_t sent = publish_readings(samples, count);
+    for (size_t i = 0; i < sent; i++) publish_queue_record_wire(batch_enqueued_us[i]);
+    for (size_t i = sent; i < count; i++) reading_store_append(samples[i]);
+    report_batch_clear(sent == count);
+}
 
-        Serial.println("Message received");
-        Serial.print("Payload: ");
-        for (unsigned int i = 0; i < length; i++) {
-          Serial.print((char)payload[i]);
+void handle_reading(DeviceReading reading, uint32_t enqueued_us) {
+    // The increment was already reset in the meter; if it can't go out now it must be stored.
+    reading.energyIncrement += reading_store_take_carry();
+    reading_clock_resolve(reading);
+
+    if (batching_enabled()) {
+        size_t slot = report_batch_count();
+        report_batch_add(reading);
+        if (slot < REPORT_BATCH_CAPACITY) batch_enqueued_us[slot] = enqueued_us;
+        if (report_batch_should_flush(reading.capturedMs)) flush_batch();
+        return;
+    }
+
+    // Backlog first, so the fresh reading is the last one the backend sees.
+    if (client.connected()) drain_backlog();
+
+    if (publish_reading(reading)) {
+        publish_queue_record_wire(enqueued_us);
+    } else {
+        reading_store_append(reading);
+    }
+}
+
+// Device-side times of receipt and actuation; the unix ones only once SNTP has synced.
+bool publish_ack(const CommandAck& ack) {
+    char topic[sizeof(env.cid) + 8];
+    snprintf(topic, sizeof(topic), "%s/ack", env.cid);
+    uint64_t rx_ts = reading_clock_unix_ms(ack.rx_ms);
+    size_t len = command_ack_json(ack, rx_ts, rx_ts ? reading_clock_unix_ms(ack.applied_ms) : 0,
+                                  (char*)buffer, BUFFER_SIZE);
+    return len > 0 && publish_message(topic, (const char*)buffer, len);
+}
+
+void service_publish_queue() {
+    // Commands refused in the callback are acked from this task, ahead of anything hardwareTask queued.
+    CommandAck refused;
+    while (command_ack_pop(refused)) publish_ack(refused);
+
+    OutboundMessage msg;
+    while (publish_queue_pop(msg)) {
+        switch (msg.kind) {
+            case OutboundKind::reading:
+                handle_reading(msg.reading, msg.enqueued_us);
+                break;
+            case OutboundKind::test_ping:
+                if (publish_message(env.pub, "65w", 3)) publish_queue_record_wire(msg.enqueued_us);
+                break;
+            case OutboundKind::diag:
+                if (publish_diag()) publish_queue_record_wire(msg.enqueued_us);
+                break;
+            case OutboundKind::ack:
+                if (publish_ack(msg.ack)) publish_queue_record_wire(msg.enqueued_us);
+                break;
         }
-        Serial.println();
-        message_recieved = true;
     }
+
+    // A batch ages out even when no reading follows (exception mode, long intervals).
+    if (batching_enabled() && report_batch_should_flush(millis())) flush_batch();
+}
+
+/* === hardwareTask side: meter and enqueue, never touches the client === */
+
+// Takes a reading and hands it to mqttTask. Runs on the report timer, and early when the relay
+// changes or (report-by-exception) the power leaves the deadband.
+void send_device_reading(ReportReason reason) {
+    update_metering_vars();
+    lastSendingTime = millis();
+    bool relay_on = relay_is_on();
+    last_reported_relay = relay_on;
+
+    OutboundMessage msg = {};
+    msg.kind = OutboundKind::reading;
+    // Only the fresh increment goes into the register; dropped energy was counted when it was measured.
+    double lifetime_kwh = energy_register_add(energyIncrement);
+    DeviceReading& r = msg.reading;
+    r.energyIncrement = energyIncrement + dropped_energy;
+    r.voltage = volts;
+    r.current = amps;
+    r.power = power;
+    r.relayOn = relay_on;
+    r.capturedMs = (uint32_t)lastSendingTime;
+    r.stats = window_stats_summary(window_stats);
+    r.lifetimeKwh = lifetime_kwh;
+    reading_clock_stamp(r);   // bootId, seq, unixMs
+    window_stats_reset(window_stats);
+    report_policy_sent(reason, last_window_watts);
+    // A full queue drops the sample but not the energy; it rides on the next reading.
+    dropped_energy = publish_queue_push(msg) ? 0 : msg.reading.energyIncrement;
+}
+
+void blink(unsigned int pin) {
+    digitalWrite(pin, HIGH);
+    scheduler_after(SCHED_EVT_BLINK, 500);
+}
+
+void publish_diag_snapshot() {
+    OutboundMessage msg = {};
+    msg.kind = OutboundKind::diag;
+    publish_queue_push(msg);
+}
+
+void set_relay(bool on) {
+    if (on) turn_on_relay(relayPin);
+    else turn_off_relay(relayPin);
 }
 
-void update_metering_vars_old(){ // Using old current sensor
-    energyIncrement  = get_and_reset_energy_total_old(SensorMode::test);
-    amps = get_current_reading(SensorMode::test);
-    power = volts * amps;
-    volts = get_voltage_reading(SensorMode::test);      
+static_assert(COMMAND_MAX_ARGS >= 2 * CURRENT_CAL_BANDS_MAX, "bands command can't carry every band");
+
+uint32_t diag_period_ms() {
+    return (tuning.diag_period_s < 0 ? DIAG_PERIOD_S : (uint32_t)tuning.diag_period_s) * 1000;
 }
 
-void update_metering_vars_ic() { 
-    energyIncrement = get_and_reset_energy_total_ic(SensorMode::pin, relay_on);
-    amps = get_current_amps(relay_on);
-    //power = get_active_power_watts(relay_on);
-    volts = relay_on ? 12 : 0;
-    power = volts * amps;
+void set_report_policy(ReportPolicy p) {
+    if (p.heartbeat_ms == 0) p.heartbeat_ms = env.heartbeatS * 1000;
+    report_policy_set(p);
+    scheduler_every(SCHED_EVT_REPORT, report_policy_period_ms(timeInterval));
+    tuning.has_policy = true;
+    tuning.policy = report_policy();
 }
 
-void send_device_reading() {
-    if (millis() - lastSendingTime >= timeInterval) {
-        //update_metering_vars_old();
-        update_metering_vars_ic();
-        
-        // Allocate small JSON document (adjust only if you add many keys)
-        doc["energyIncrement"] = energyIncrement;
-        doc["voltage"] = volts;
-        doc["current"] = amps;
-        doc["deviceName"]  = env.cid;
-        doc["power"] = power;
+// Pushes the saved tuning into the meter and report policy; the timers are armed after this.
+void apply_tuning() {
+    if (tuning.interval_ms) timeInterval = tuning.interval_ms;
+    if (tuning.window_ms) tuning.window_ms = Meter::set_window_ms(tuning.window_ms);
+    if (tuning.cal_gain > 0.0f) Meter::calibrate(tuning.cal_gain, tuning.cal_offset_a);
+    if (tuning.band_count) Meter::set_bands(tuning.bands, tuning.band_count);
+    if (tuning.has_policy) report_policy_set(tuning.policy);
+}
 
-        size_t len = serializeJson(doc, buffer);
+// A command from mqttTask (commands.h). Relay changes report on this same step.
+void apply_command(const Command& cmd) {
+    switch (cmd.id) {
+        case CommandId::relay_on:     set_relay(true); break;
+        case CommandId::relay_off:    set_relay(false); break;
+        case CommandId::relay_toggle: set_relay(!relay_is_on()); break;
+        case CommandId::interval:
+            timeInterval = tuning.interval_ms = cmd.ms;
+            scheduler_every(SCHED_EVT_REPORT, report_policy_period_ms(timeInterval));
+            tuning_dirty = true;
+            break;
+        case CommandId::window:
+            tuning.window_ms = Meter::set_window_ms(cmd.ms);
+            scheduler_every(SCHED_EVT_WINDOW, tuning.window_ms);
+            tuning_dirty = true;
+            break;
+        case CommandId::deadband: {
+            ReportPolicy p = report_policy();
+            p.deadband_w = cmd.arg[0];
+            p.deadband_pct = cmd.arg[1];
+            if (cmd.argc > 2) p.heartbeat_ms = (uint32_t)(cmd.arg[2] * 1000.0f);
+            if (p.mode != ReportMode::adaptive)
+                p.mode = p.deadband_w > 0.0f || p.deadband_pct > 0.0f ? ReportMode::exception : ReportMode::interval;
+            set_report_policy(p);
+            tuning_dirty = true;
+            break;
+        }
+        case CommandId::report_mode: {
+            ReportPolicy p = report_policy();
+            p.mode = cmd.mode;
+            if (cmd.argc > 0) p.heartbeat_ms = (uint32_t)(cmd.arg[0] * 1000.0f);
+            set_report_policy(p);
+            tuning_dirty = true;
+            break;
+        }
+        case CommandId::calibrate:
+            tuning.cal_gain = cmd.arg[0];
+            if (cmd.argc > 1) tuning.cal_offset_a = cmd.arg[1];
+            Meter::calibrate(tuning.cal_gain, tuning.cal_offset_a);
+            tuning_dirty = true;
+            break;
+        case CommandId::bands: {
+            CurrentCalBand bands[CURRENT_CAL_BANDS_MAX];
+            uint8_t n = cmd.argc / 2;
+            for (uint8_t i = 0; i < n; i++) bands[i] = { cmd.arg[2 * i], cmd.arg[2 * i + 1] };
+            if (!Meter::set_bands(bands, n)) break;   // CT backend: no bands to set
+            tuning.band_count = n;
+            memcpy(tuning.bands, bands, n * sizeof(CurrentCalBand));
+            tuning_dirty = true;
+            break;
+        }
+        case CommandId::tune_reset:
+            tuning_clear();
+            tuning_dirty = false;
+            break;
+        case CommandId::policy: {
+            PolicySet set;
+            if (command_take_policy(set)) policy_set(set, millis());
+            break;
+        }
+        case CommandId::time:
+            policy_set_time(cmd.ms, millis());
+            break;
+        case CommandId::diag:
+            publish_diag_snapshot();
+            break;
+        case CommandId::diag_every:
+            tuning.diag_period_s = (int32_t)cmd.ms;
+            if (!scheduler_every(SCHED_EVT_DIAG, diag_period_ms())) scheduler_cancel(SCHED_EVT_DIAG);
+            tuning_dirty = true;
+            break;
+    }
+}
+
+// Local policy (policy.h) on the window just sampled; a trip opens the relay in this same wake.
+void enforce_policy(float window_watts, uint32_t sampled_us) {
+    uint32_t now_ms = millis();
+    bool relay_on = relay_is_on();
+    PolicyInput in = { Meter::window_amps(relay_on), window_watts, now_ms - last_policy_ms, relay_on, now_ms };
+    last_policy_ms = now_ms;
+    if (!policy_evaluate(in).trip) return;
+
+    set_relay(false);
+    policy_record_trip(micros() - sampled_us);
+    publish_diag_snapshot();   // carries the rule and latency; the relay change reports below
+}
+
+// Handles one wakeup of the hardware task. Returns the events handled, 0 if the wait was abandoned (host sim only).
+uint32_t hardware_task_step() {
+    uint32_t events = scheduler_wait();
+    uint32_t woke_us = micros();
+
+    // Commands first, so a relay change below reports on this wake.
+    if (events & SCHED_EVT_MESSAGE) {
+        Command cmd;
+        bool any = false;
+        while (command_pop(cmd)) {
+            apply_command(cmd);
+            if (cmd.ack_id) {
+                // Stamped right after the pin write; it waits in the queue like a reading.
+                OutboundMessage ack = {};
+                ack.kind = OutboundKind::ack;
+                ack.ack = command_applied(cmd, relay_is_on());
+                publish_queue_push(ack);
+            }
+            any = true;
+        }
+        if (any) blink(ledPin_external);
+        // One NVS write for a burst of commands.
+        if (tuning_dirty) {
+            tuning_save(tuning);
+            tuning_dirty = false;
+        }
+    }
+
+    // Window before report, so a report on the same tick integrates the fresh window.
+    bool outside_deadband = false;
+    if (events & SCHED_EVT_WINDOW) {
+        float window_watts = Meter::sample_window(relay_is_on());
+        uint32_t sampled_us = micros();
+        if (window_watts >= 0.0f) {
+            enforce_policy(window_watts, sampled_us);
+            last_window_watts = window_watts;
+            window_stats_add(window_stats, window_watts);
+            outside_deadband = report_policy_window(window_watts);
+        }
+    }
+
+    if (events & SCHED_EVT_REPORT) {
+        uint32_t period_ms = report_policy_period_ms(timeInterval);
+        send_device_reading(report_policy().mode == ReportMode::exception ? ReportReason::heartbeat : ReportReason::interval);
+        // Adaptive mode may have stretched the period.
+        if (report_policy_period_ms(timeInterval) != period_ms)
+            scheduler_every(SCHED_EVT_REPORT, report_policy_period_ms(timeInterval));
+    } else if (relay_is_on() != last_reported_relay || outside_deadband) {
+        // Reported right away; the next interval (or heartbeat) counts from here.
+        send_device_reading(relay_is_on() != last_reported_relay ? ReportReason::relay : ReportReason::deadband);
+        scheduler_every(SCHED_EVT_REPORT, report_policy_period_ms(timeInterval));
+    }
 
-        publish_message(env.pub.c_str(), buffer, len);
+    /* === Testing Logic === */
+    if ((events & SCHED_EVT_BUTTON) && digitalRead(button_input) == HIGH) {
+        OutboundMessage ping = {};
+        ping.kind = OutboundKind::test_ping;
+        publish_queue_push(ping);
+        blink(ledPin_internal);
+    }
+    if (events & SCHED_EVT_BLINK) {
+        digitalWrite(ledPin_internal, LOW);
+        digitalWrite(ledPin_external, LOW);
+    }
+    /* ============================ */
 
-        lastSendingTime = millis();
+    /* === Relay Serial Command Handler === */
+    if (events & SCHED_EVT_SERIAL) {
+        while (Serial.available() > 0) relay_serial_command_handler(relayPin);
     }
+    /* ===================================== */
+
+    if (events & SCHED_EVT_DIAG) publish_diag_snapshot();
+
+    diag_task_loop(DiagTask::hardware, micros() - woke_us);
+    return events;
+}
+
+static void IRAM_ATTR isr_button() {
+    scheduler_notify_from_isr(SCHED_EVT_BUTTON);
+}
+
+// Arms the wake sources. Must run on the task that calls hardware_task_step().
+void start_hardware_schedule() {
+    scheduler_init();
+    scheduler_every(SCHED_EVT_WINDOW, Meter::window_ms());   // no timer if the backend has no window
+    scheduler_every(SCHED_EVT_REPORT, report_policy_period_ms(timeInterval));
+    scheduler_every(SCHED_EVT_DIAG, diag_period_ms());       // no timer if periodic diag is off
+    attachInterrupt(digitalPinToInterrupt(button_input), isr_button, RISING);
+    Serial.onReceive([]() { scheduler_notify(SCHED_EVT_SERIAL); });
 }
 
 // MQTT Task: Assigned to core 0, used to handle network logic, and maintain connection to server/mqtt Broker. 
 // ( Most likly don't have to touch, unless adding bluetooth )
 void mqttTask(void * parameter){
     // Load env vars into mem
-    connect_setup_mqtt(env.ssid.c_str(), env.pass.c_str(), env.mqtt.c_str(), 1883, fn_on_message_received);
+    connect_setup_mqtt(env.ssid, env.pass, env.mqtt, 1883, fn_on_message_received); // returns at once, see mqtt_config.h
+    publish_queue_attach_consumer();
+    diag_task_start(DiagTask::mqtt);
     for(;;){
-        check_maintain_mqtt_connection(env.cid.c_str(), env.cuser.c_str(), env.cpass.c_str(), env.sub.c_str()); 
-        vTaskDelay(500 / portTICK_PERIOD_MS);
+        uint32_t t0 = micros();
+        uint32_t wait_ms = check_maintain_mqtt_connection(env.cid, env.cuser, env.cpass, env.sub);
+        reading_clock_poll();
+        service_publish_queue();
+        diag_task_loop(DiagTask::mqtt, micros() - t0);
+        // woken early by hardwareTask pushes, and in time for the open batch's age limit
+        uint32_t batch_due_ms = report_batch_ms_until_due(millis());
+        publish_queue_wait(batch_due_ms < wait_ms ? batch_due_ms : wait_ms);
     }
 }
 
-// Hardware Task: Assigned to core 1, used to handle hardware logic/ sensor data collection.
-void hardwareTask(void * parameter){
+// Pin/peripheral setup for the hardware task. Split out so the host simulator can run it without the task loop.
+void init_hardware(){
     /* === Testing Pins/ Config === */
     pinMode(ledPin_external, OUTPUT);
     pinMode(ledPin_internal, OUTPUT);
@@ -115,45 +482,43 @@ void hardwareTask(void * parameter){
     /* === Relay + Serial setup === */
     init_relay(relayPin);
     turn_on_relay(relayPin);
-    relay_on = true;
     /* ============================ */
 
     /* === current sensor setup === */
-    //init_current_sensor_old(currentSensorPin);
-    init_current_sensor_ic(currentSensorPin);
+    Meter::init(currentSensorPin);
     /* ============================================ */
 
-    timeInterval = one_minute * .05; // Set interval, in which you send power data to backend
-    //timeInterval = one_minute * .1; // Set interval, in which you send power data to backend
+    /* === store-and-forward for broker outages === */
+    energy_register_init();
+    reading_clock_init();
+    reading_store_init();
+    report_batch_set_policy({ env.batchSamples, env.batchMaxAgeS * 1000 });
+    report_policy_set({ env.reportMode, env.deadbandW, env.deadbandPct, env.heartbeatS * 1000 });
+    last_reported_relay = relay_is_on();
+    /* ============================================ */
 
+    timeInterval = DEFAULT_REPORT_INTERVAL_MS; // Set interval, in which you send power data to backend
 
-    for(;;){
-        /* === Testing Logic === */
-        if(digitalRead(button_input) == HIGH){
-            publish_message(env.pub.c_str(), "65w", 3);
-            digitalWrite(ledPin_internal , HIGH);
-            vTaskDelay(500 / portTICK_PERIOD_MS);
-            digitalWrite(ledPin_internal, LOW);
-        }
-        if(message_recieved){
-            digitalWrite(ledPin_external, HIGH);
-            vTaskDelay(500 / portTICK_PERIOD_MS);
-            digitalWrite(ledPin_external, LOW);
-            message_recieved = false;
-        }
-        /* ============================ */
+    /* === local policy rules, enforced per window === */
+    policy_init();
+    last_policy_ms = millis();
+    /* ============================================ */
 
-        /* === Relay Serial Command Handler === */
-        relay_serial_command_handler(relayPin);
-       /* ===================================== */
+    /* === runtime tuning saved by MQTT commands === */
+    tuning = tuning_load();
+    tuning_dirty = false;
+    apply_tuning();
+    /* ============================================ */
+}
 
-        /* === NEW: Read Irms via EmonLib (prints every ~1s) ===
-           calcIrms(N) samples ~a few mains cycles (1480 is common).
-           Tweak N if you want quicker/steadier reads.
-        */
-        //read_and_print_Irms();
-        send_device_reading();
+// Hardware Task: Assigned to core 1, used to handle hardware logic/ sensor data collection.
+// Sleeps until a timer, ISR or other task raises an event (see scheduler.h).
+void hardwareTask(void * parameter){
+    diag_task_start(DiagTask::hardware);
+    init_hardware();
+    start_hardware_schedule();
 
-        //vTaskDelay(100 / portTICK_PERIOD_MS);  // Small delay to avoid busy looping
+    for(;;){
+        hardware_task_step();
     }
 }
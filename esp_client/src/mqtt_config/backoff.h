@@ -0,0 +1,36 @@
+#pragma once
+#include <stdint.h>
+
+/*
+  Exponential backoff with full jitter: attempt n waits a uniform random time in
+  [0, min(cap, base * 2^n)]. When a brownout reboots a whole building, or the broker
+  restarts, every plug fails at the same moment; a fixed retry period keeps them in
+  lockstep against the AP and broker, jitter spreads them out, and the exponent
+  backs off the load while the far end is still down.
+
+  `rand32` comes from the caller (esp_random() on the device) so the host benchmark
+  can drive the same code from a seeded generator.
+*/
+
+struct Backoff {
+    uint32_t base_ms;
+    uint32_t cap_ms;
+    uint8_t attempt;      // failures since the last success
+};
+
+inline uint32_t backoff_ceiling_ms(const Backoff& b) {
+    uint32_t ceil = b.base_ms;
+    for (uint8_t i = 0; i < b.attempt && ceil < b.cap_ms; i++) ceil <<= 1;
+    return ceil < b.cap_ms ? ceil : b.cap_ms;
+}
+
+// Delay before the next attempt; counts this one as a failure.
+inline uint32_t backoff_next_ms(Backoff& b, uint32_t rand32) {
+    uint32_t ceil = backoff_ceiling_ms(b);
+    if (b.attempt < 31) b.attempt++;
+    return (uint32_t)(((uint64_t)rand32 * ((uint64_t)ceil + 1)) >> 32);
+}
+
+inline void backoff_reset(Backoff& b) {
+    b.attempt = 0;
+}
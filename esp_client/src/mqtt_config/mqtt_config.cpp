@@ -1,62 +1,250 @@
 #include "mqtt_config.h"
-#include "HardwareSerial.h"
+#include "backoff.h"
+#include "../diagnostics/log.h"
+#include "../boot_metrics/boot_metrics.h"
+#include "../reading_clock/reading_clock.h"
+#include "../checksum/crc32.h"
 #include <WiFi.h>
+#include <Preferences.h>
 #include <ArduinoJson.h>
 
 WiFiClient espClient;
+PubSubClient client(espClient);
 
-void setup_wifi(const char *ssid, const char *password){
-  vTaskDelay(10 / portTICK_PERIOD_MS);
-  Serial.println();
-  Serial.print("Connecting to ");
-  Serial.println(ssid);
+static const char* const NVS_NAMESPACE = "net";
+static const char* const K_AP = "ap";
+static constexpr uint32_t CACHE_MAGIC = 0x5A504E31;   // "ZPN1"
 
-  WiFi.begin(ssid, password);
+struct WifiCache {
+  uint32_t magic;
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t has_ip;          // RTC copy only: the fields below hold the last DHCP lease
+  uint32_t ip, gateway, subnet, dns;
+  uint32_t crc;            // CRC-32 of every byte above
+};
 
-  while (WiFi.status() != WL_CONNECTED) {
-    vTaskDelay(500 / portTICK_PERIOD_MS);
-    Serial.print(".");
-  }
+// RTC .noinit: left alone by the bootloader, so it survives software/watchdog/brownout resets.
+// After power-on it holds garbage, hence the reset-reason check and the CRC.
+RTC_NOINIT_ATTR static WifiCache g_rtc_cache;
+static WifiCache g_nvs_cache;      // as stored, to skip rewriting an unchanged AP
+static WifiCache g_cache;          // what the next attempt uses; magic 0 = scan
+
+static const char* g_ssid = nullptr;
+static const char* g_pass = nullptr;
+static LinkState g_state = LinkState::wifi_connecting;
+static bool g_fast = false;        // current attempt targets the cached AP
+static bool g_was_online = false;
+static uint32_t g_attempt_ms = 0;  // when the current WiFi attempt started
+static uint32_t g_next_ms = 0;     // backoff deadline
+static Backoff g_wifi_backoff = { WIFI_BACKOFF_BASE_MS, LINK_BACKOFF_CAP_MS, 0 };
+static Backoff g_mqtt_backoff = { MQTT_BACKOFF_BASE_MS, LINK_BACKOFF_CAP_MS, 0 };
+static MqttLinkStats g_stats = {};
 
-  Serial.println("");
-  Serial.println("WiFi connected");
+static uint32_t cache_crc(const WifiCache& c) {
+  return crc32((const uint8_t*)&c, offsetof(WifiCache, crc));
 }
 
-PubSubClient client(espClient);
+static bool cache_valid(const WifiCache& c) {
+  return c.magic == CACHE_MAGIC && c.crc == cache_crc(c) && c.channel >= 1 && c.channel <= 14;
+}
+
+static void load_cache() {
+  g_cache = {};
+  Preferences p;
+  p.begin(NVS_NAMESPACE, true);
+  if (p.getBytes(K_AP, &g_nvs_cache, sizeof(g_nvs_cache)) != sizeof(g_nvs_cache) || !cache_valid(g_nvs_cache))
+    g_nvs_cache = {};
+  p.end();
+
+  if (esp_reset_reason() != ESP_RST_POWERON && cache_valid(g_rtc_cache)) g_cache = g_rtc_cache;
+  else if (cache_valid(g_nvs_cache)) g_cache = g_nvs_cache;
+}
+
+static void save_cache() {
+  WifiCache c = {};
+  c.magic = CACHE_MAGIC;
+  memcpy(c.bssid, WiFi.BSSID(), sizeof(c.bssid));
+  c.channel = (uint8_t)WiFi.channel();
+  c.has_ip = 1;
+  c.ip = (uint32_t)WiFi.localIP();
+  c.gateway = (uint32_t)WiFi.gatewayIP();
+  c.subnet = (uint32_t)WiFi.subnetMask();
+  c.dns = (uint32_t)WiFi.dnsIP();
+  c.crc = cache_crc(c);
+  g_rtc_cache = c;
+  g_cache = c;
+
+  if (cache_valid(g_nvs_cache) && g_nvs_cache.channel == c.channel && memcmp(g_nvs_cache.bssid, c.bssid, 6) == 0) return;
+  WifiCache ap = c;
+  ap.has_ip = 0;
+  ap.ip = ap.gateway = ap.subnet = ap.dns = 0;
+  ap.crc = cache_crc(ap);
+  Preferences p;
+  p.begin(NVS_NAMESPACE, false);
+  if (p.putBytes(K_AP, &ap, sizeof(ap)) == sizeof(ap)) g_nvs_cache = ap;
+  p.end();
+}
+
+static void drop_cache() {
+  g_cache = {};
+  g_rtc_cache = {};
+}
+
+static void begin_wifi(uint32_t now_ms) {
+  g_fast = g_cache.magic == CACHE_MAGIC;
+  // A cached lease skips DHCP; an all-zero config switches back to it.
+  if (g_fast && g_cache.has_ip)
+    WiFi.config(IPAddress(g_cache.ip), IPAddress(g_cache.gateway), IPAddress(g_cache.subnet), IPAddress(g_cache.dns));
+  else
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+
+  LOG_PRINT("Connecting to ");
+  LOG_PRINT(g_ssid);
+  LOG_PRINTLN(g_fast ? " (cached AP)" : "");
+  if (g_fast) WiFi.begin(g_ssid, g_pass, g_cache.channel, g_cache.bssid, true);
+  else WiFi.begin(g_ssid, g_pass);
 
-void reconnect(const char *client_id, const char *client_user, const char *client_pass, const char* topic){
-   while (!client.connected()) {
-    Serial.print("Attempting MQTT connection...");
-    if (client.connect(client_id , client_user, client_pass)) {
-      client.subscribe(topic);
-      Serial.println("connected");
-      vTaskDelay(500 / portTICK_PERIOD_MS);
-    } else {
-      Serial.print("failed, rc=");
-      Serial.print(client.state());
-      vTaskDelay(500 / portTICK_PERIOD_MS);
-    }
+  g_stats.wifi_attempts++;
+  if (g_fast) g_stats.wifi_fast++;
+  g_attempt_ms = now_ms;
+  g_state = LinkState::wifi_connecting;
+}
+
+static void back_off(Backoff& b, LinkState state, uint32_t now_ms) {
+  g_stats.last_backoff_ms = backoff_next_ms(b, esp_random());
+  g_next_ms = now_ms + g_stats.last_backoff_ms;
+  g_state = state;
+}
+
+// now is before the deadline; the signed difference survives millis() wrapping.
+static bool before(uint32_t now_ms, uint32_t deadline_ms) {
+  return (int32_t)(deadline_ms - now_ms) > 0;
+}
+
+static uint32_t until(uint32_t now_ms, uint32_t deadline_ms) {
+  return before(now_ms, deadline_ms) ? deadline_ms - now_ms : 0;
+}
+
+// One attempt; on failure the next one waits out a jittered backoff.
+static void connect_mqtt(const char *client_id, const char *client_user, const char *client_pass, const char* topic, uint32_t now_ms){
+  LOG_PRINT("Attempting MQTT connection...");
+  g_stats.mqtt_attempts++;
+  if (client.connect(client_id , client_user, client_pass)) {
+    client.subscribe(topic);
+    LOG_PRINTLN("connected");
+    boot_mark(BootMark::mqtt_connected);
+    backoff_reset(g_mqtt_backoff);
+    if (g_was_online) g_stats.reconnects++;
+    g_was_online = true;
+    g_state = LinkState::online;
+  } else {
+    LOG_PRINT("failed, rc=");
+    LOG_PRINTLN(client.state());
+    g_stats.mqtt_failures++;
+    back_off(g_mqtt_backoff, LinkState::mqtt_backoff, now_ms);
   }
 }
 
-void publish_message(const char* topic, const char* payload, unsigned int message_size ){
-  client.publish(topic, payload, message_size);
+bool publish_message(const char* topic, const char* payload, unsigned int message_size ){
+  // Go through the (uint8_t*, length) overload: the (char*, ...) ones strlen() the payload, which
+  // truncates binary reports, and would take message_size as the "retained" flag.
+  if (!client.publish(topic, (const uint8_t*)payload, message_size)) {
+    g_stats.publish_failures++;
+    return false;
+  }
+  boot_mark(BootMark::first_publish);
+  return true;
 }
 
 void connect_setup_mqtt(const char *ssid, const char *password, const char *mqtt_server, unsigned int port, void (*callback)(char*, byte*, unsigned int)){
-  	setup_wifi(ssid, password);
-	client.setServer(mqtt_server, port);
-	client.setCallback(callback);
+  g_ssid = ssid;
+  g_pass = password;
+  client.setServer(mqtt_server, port);
+  client.setBufferSize(MQTT_BUFFER_SIZE);
+  client.setCallback(callback);
+
+  // The link is ours to manage: no flash write per begin(), no core auto-reconnect racing the backoff.
+  WiFi.persistent(false);
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(false);
+  load_cache();
+  g_state = LinkState::wifi_connecting;
+  g_was_online = false;
+  backoff_reset(g_wifi_backoff);
+  backoff_reset(g_mqtt_backoff);
+  begin_wifi(millis());
 }
 
-void check_maintain_mqtt_connection(const char* client_id, const char* client_user, const char*client_pass, const char* topic){
-  	if (!client.connected()) {
-	  reconnect(client_id, client_user, client_pass, topic);
-	}
-	client.loop();
+uint32_t check_maintain_mqtt_connection(const char* client_id, const char* client_user, const char*client_pass, const char* topic){
+  uint32_t now = millis();
+  bool wifi_up = WiFi.status() == WL_CONNECTED;
+
+  // Losing WiFi from any later state rejoins right away, on the cached AP and lease:
+  // auto-reconnect is off, so nothing else would.
+  if (!wifi_up && g_state != LinkState::wifi_connecting && g_state != LinkState::wifi_backoff) {
+    LOG_PRINTLN("WiFi lost");
+    begin_wifi(now);
+    return WIFI_POLL_MS;
+  }
+
+  switch (g_state) {
+    case LinkState::wifi_connecting:
+      if (wifi_up) {
+        LOG_PRINTLN("WiFi connected");
+        boot_mark(BootMark::wifi_connected);
+        reading_clock_start_sync();
+        backoff_reset(g_wifi_backoff);
+        save_cache();
+        connect_mqtt(client_id, client_user, client_pass, topic, now);
+        break;
+      }
+      if (before(now, g_attempt_ms + (g_fast ? WIFI_FAST_TIMEOUT_MS : WIFI_SCAN_TIMEOUT_MS))) return WIFI_POLL_MS;
+      WiFi.disconnect();
+      if (g_fast) {
+        // The AP moved or the lease is gone: forget it and scan right away.
+        g_stats.wifi_fast_failed++;
+        drop_cache();
+        begin_wifi(now);
+        return WIFI_POLL_MS;
+      }
+      back_off(g_wifi_backoff, LinkState::wifi_backoff, now);
+      break;
+
+    case LinkState::wifi_backoff:
+      if (before(now, g_next_ms)) break;
+      begin_wifi(now);
+      return WIFI_POLL_MS;
+
+    case LinkState::mqtt_backoff:
+      if (before(now, g_next_ms)) break;
+      connect_mqtt(client_id, client_user, client_pass, topic, now);
+      break;
+
+    case LinkState::online:
+      if (client.connected()) {
+        client.loop();
+        return MQTT_POLL_MS;
+      }
+      // Broker dropped us: first retry after a jittered wait too, not all plugs at once.
+      back_off(g_mqtt_backoff, LinkState::mqtt_backoff, now);
+      break;
+  }
+
+  if (g_state == LinkState::online) return MQTT_POLL_MS;
+  uint32_t wait = until(now, g_next_ms);
+  return wait < MQTT_POLL_MS ? wait : MQTT_POLL_MS;
+}
+
+LinkState mqtt_link_state() {
+  return g_state;
 }
+
+const MqttLinkStats& mqtt_link_stats() {
+  return g_stats;
+}
+
 //-1 to account for the wildcard "#" char
 boolean val_incoming_topic(const char* topic, const char* client_subscribe_topic){
   return strncmp(topic, client_subscribe_topic, strlen(client_subscribe_topic) - 1) == 0 ? true : false;
 }
-
@@ -1,14 +1,58 @@
 #pragma once
 #include <PubSubClient.h>
 
-extern PubSubClient client;
-boolean val_incoming_topic(const char *topic, const char* client_subscribe_topic);
-void publish_message(const char* topic, const char* payload, unsigned int message_size);
-void connect_setup_mqtt(const char* ssid, const char* password, const char* mqtt_server, unsigned int port, void (*callback)(char*, byte*, unsigned int));
-void check_maintain_mqtt_connection(const char* client_id, const char* client_user, const char*client_pass, const char* topic);
+// PubSubClient's default 256 B buffer can't hold a full report batch (see report_batch.h)
+#ifndef MQTT_BUFFER_SIZE
+#define MQTT_BUFFER_SIZE 1024
+#endif
 
+/*
+  WiFi + broker link, driven as a non-blocking state machine from mqttTask.
 
+  - check_maintain_mqtt_connection() does at most one connect attempt per call and
+    returns how long mqttTask may sleep before calling again (short while WiFi is
+    associating, the remaining backoff while waiting, MQTT_POLL_MS once online).
+  - Failed WiFi and broker attempts back off exponentially with full jitter
+    (backoff.h), so a building full of plugs rebooting together doesn't retry in lockstep.
+  - The AP's BSSID and channel are cached, so a reboot associates directly without a
+    scan. The RTC copy survives every reset except power-on and also holds the DHCP
+    lease (IP, gateway, mask, DNS), which is reused as a static config. The NVS copy
+    only holds BSSID/channel (a lease may have expired across a power cut) and is
+    rewritten only when they change. If a cached connect doesn't come up within
+    WIFI_FAST_TIMEOUT_MS the cache is dropped and the next attempt scans.
+  - Losing WiFi once online rejoins at once the same way (the core's auto-reconnect
+    is off), so a short AP blip costs the blip plus an association, not a timeout.
+*/
 
+#ifndef MQTT_POLL_MS
+#define MQTT_POLL_MS 500
+#endif
+#define WIFI_POLL_MS 50
+#define WIFI_FAST_TIMEOUT_MS 3000
+#define WIFI_SCAN_TIMEOUT_MS 15000
+#define WIFI_BACKOFF_BASE_MS 500
+#define MQTT_BACKOFF_BASE_MS 1000
+#define LINK_BACKOFF_CAP_MS 60000
 
+enum class LinkState : uint8_t { wifi_connecting, wifi_backoff, mqtt_backoff, online };
 
+struct MqttLinkStats {
+    uint32_t wifi_attempts;
+    uint32_t wifi_fast;          // attempts that used the cached BSSID/channel
+    uint32_t wifi_fast_failed;   // ... and timed out, dropping the cache
+    uint32_t mqtt_attempts;
+    uint32_t mqtt_failures;
+    uint32_t reconnects;         // times the link came back after being online
+    uint32_t publish_failures;   // publish_message() calls the client refused
+    uint32_t last_backoff_ms;
+};
 
+extern PubSubClient client;
+boolean val_incoming_topic(const char *topic, const char* client_subscribe_topic);
+bool publish_message(const char* topic, const char* payload, unsigned int message_size);
+// Configures the client and starts associating; returns immediately.
+void connect_setup_mqtt(const char* ssid, const char* password, const char* mqtt_server, unsigned int port, void (*callback)(char*, byte*, unsigned int));
+// One step of the link state machine; returns the ms until it wants to run again.
+uint32_t check_maintain_mqtt_connection(const char* client_id, const char* client_user, const char*client_pass, const char* topic);
+LinkState mqtt_link_state();
+const MqttLinkStats& mqtt_link_stats();
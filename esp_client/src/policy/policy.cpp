@@ -0,0 +1,235 @@
+#include "policy.h"
+#include "../checksum/crc32.h"
+#include <Preferences.h>
+
+static const char* const NVS_NAMESPACE = "policy";
+static const char* const K_BLOB = "set";
+constexpr uint16_t POLICY_BLOB_VERSION = 1;
+static constexpr uint32_t DAY_S = 86400;
+
+struct PolicyBlob {
+    uint16_t version;
+    uint16_t size;         // sizeof(PolicySet) when written
+    PolicySet set;
+    uint32_t crc;          // CRC-32 of every byte above
+};
+
+static PolicySet g_set = {};
+static PolicyStats g_stats = {};
+static uint16_t g_held[POLICY_MAX_RULES];     // consecutive violating windows, per rule
+static bool g_counting[POLICY_MAX_RULES];     // rule past its hold, until it clears
+
+static bool g_tod_known = false;
+static uint32_t g_tod_base_s = 0;             // local time of day at g_tod_base_ms
+static uint32_t g_tod_base_ms = 0;
+static uint32_t g_prev_tod_s = 0;             // last evaluated time of day, for the midnight rollover
+static uint32_t g_day_start_ms = 0;           // rolling budget day while the time is unknown
+
+const char* policy_rule_name(PolicyRuleType type) {
+    switch (type) {
+        case PolicyRuleType::max_current:   return "max_current";
+        case PolicyRuleType::max_power:     return "max_power";
+        case PolicyRuleType::energy_budget: return "energy_budget";
+        case PolicyRuleType::schedule:      return "schedule";
+        default:                            return "none";
+    }
+}
+
+static uint32_t blob_crc(const PolicyBlob& b) {
+    return crc32((const uint8_t*)&b, offsetof(PolicyBlob, crc));
+}
+
+static uint16_t get_u16(const uint8_t* p) { uint16_t v; memcpy(&v, p, sizeof(v)); return v; }
+static uint32_t get_u32(const uint8_t* p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+static float get_f32(const uint8_t* p) { float v; memcpy(&v, p, sizeof(v)); return v; }
+
+bool policy_decode(const uint8_t* buf, size_t len, PolicySet& out) {
+    if (len < POLICY_HEADER_SIZE || buf[0] != POLICY_WIRE_VERSION) return false;
+    uint8_t count = buf[2];
+    if (count > POLICY_MAX_RULES || len != POLICY_HEADER_SIZE + count * POLICY_RULE_SIZE) return false;
+
+    out = {};
+    out.flags = buf[1];
+    out.count = count;
+    out.tod_s = get_u32(buf + 3);
+    if (out.tod_s != POLICY_TOD_UNKNOWN && out.tod_s >= DAY_S) return false;
+    const uint8_t* p = buf + POLICY_HEADER_SIZE;
+    for (uint8_t i = 0; i < count; i++, p += POLICY_RULE_SIZE) {
+        PolicyRule& r = out.rules[i];
+        r.type = (PolicyRuleType)p[0];
+        r.action = p[1];
+        r.hold_windows = get_u16(p + 2);
+        r.limit = get_f32(p + 4);
+        r.start_min = get_u16(p + 8);
+        r.end_min = get_u16(p + 10);
+        if (r.type < PolicyRuleType::max_current || r.type > PolicyRuleType::schedule) return false;
+        if (r.start_min >= 24 * 60 || r.end_min >= 24 * 60) return false;
+        if (r.type != PolicyRuleType::schedule && !(r.limit >= 0.0f)) return false;   // also rejects NaN
+    }
+    return true;
+}
+
+size_t policy_encode(const PolicySet& set, uint8_t* buf, size_t cap) {
+    size_t len = POLICY_HEADER_SIZE + set.count * POLICY_RULE_SIZE;
+    if (set.count > POLICY_MAX_RULES || cap < len) return 0;
+    buf[0] = POLICY_WIRE_VERSION;
+    buf[1] = set.flags;
+    buf[2] = set.count;
+    memcpy(buf + 3, &set.tod_s, 4);
+    uint8_t* p = buf + POLICY_HEADER_SIZE;
+    for (uint8_t i = 0; i < set.count; i++, p += POLICY_RULE_SIZE) {
+        const PolicyRule& r = set.rules[i];
+        p[0] = (uint8_t)r.type;
+        p[1] = r.action;
+        memcpy(p + 2, &r.hold_windows, 2);
+        memcpy(p + 4, &r.limit, 4);
+        memcpy(p + 8, &r.start_min, 2);
+        memcpy(p + 10, &r.end_min, 2);
+    }
+    return len;
+}
+
+static void reset_rule_state() {
+    memset(g_held, 0, sizeof(g_held));
+    memset(g_counting, 0, sizeof(g_counting));
+}
+
+void policy_init() {
+    g_stats = {};
+    g_stats.last_rule = -1;
+    g_set = {};
+    g_tod_known = false;
+    g_day_start_ms = millis();
+    reset_rule_state();
+
+    PolicyBlob b;
+    Preferences p;
+    p.begin(NVS_NAMESPACE, true);
+    size_t got = p.getBytes(K_BLOB, &b, sizeof(b));
+    p.end();
+    if (got != sizeof(b) || b.version != POLICY_BLOB_VERSION || b.size != sizeof(PolicySet) ||
+        b.crc != blob_crc(b) || b.set.count > POLICY_MAX_RULES)
+        return;
+    g_set = b.set;
+    g_stats.restored = true;
+}
+
+void policy_set_time(uint32_t tod_s, uint32_t now_ms) {
+    if (tod_s >= DAY_S) return;
+    g_tod_known = true;
+    g_tod_base_s = tod_s;
+    g_tod_base_ms = now_ms;
+    g_prev_tod_s = tod_s;
+}
+
+void policy_set(const PolicySet& set, uint32_t now_ms) {
+    g_set = set;
+    reset_rule_state();
+    if (set.tod_s != POLICY_TOD_UNKNOWN) policy_set_time(set.tod_s, now_ms);
+
+    PolicyBlob b;
+    memset(&b, 0, sizeof(b));
+    b.version = POLICY_BLOB_VERSION;
+    b.size = sizeof(PolicySet);
+    b.set = set;
+    b.crc = blob_crc(b);
+    Preferences p;
+    p.begin(NVS_NAMESPACE, false);
+    p.putBytes(K_BLOB, &b, sizeof(b));
+    p.end();
+}
+
+static bool in_window(uint32_t minute, uint16_t start, uint16_t end) {
+    if (start == end) return true;
+    if (start < end) return minute >= start && minute < end;
+    return minute >= start || minute < end;   // wraps midnight
+}
+
+PolicyVerdict policy_evaluate(const PolicyInput& in) {
+    PolicyVerdict v = { false, -1 };
+    uint32_t t0 = micros();
+
+    // Budget day: local midnight when the time is known, else 24 h from boot.
+    int32_t minute = -1;
+    if (g_tod_known) {
+        // Rebased every call so now_ms - base_ms stays small and millis() can wrap (49.7 days).
+        uint32_t elapsed_s = (in.now_ms - g_tod_base_ms) / 1000;
+        g_tod_base_s = (g_tod_base_s + elapsed_s) % DAY_S;
+        g_tod_base_ms += elapsed_s * 1000;
+        uint32_t tod = g_tod_base_s;
+        if (tod < g_prev_tod_s) g_stats.energy_today_wh = 0.0f;
+        g_prev_tod_s = tod;
+        minute = (int32_t)(tod / 60);
+    } else if (in.now_ms - g_day_start_ms >= DAY_S * 1000) {
+        g_stats.energy_today_wh = 0.0f;
+        g_day_start_ms = in.now_ms;
+    }
+    if (in.relay_on) g_stats.energy_today_wh += in.watts * (float)in.elapsed_ms * (1.0f / 3600000.0f);
+
+    if (g_set.count == 0) return v;
+    g_stats.evaluations++;
+
+    for (uint8_t i = 0; i < g_set.count; i++) {
+        const PolicyRule& r = g_set.rules[i];
+        bool timed = r.start_min != r.end_min;
+        if ((timed || r.type == PolicyRuleType::schedule) && minute < 0) continue;   // no clock yet
+
+        bool violated = false;
+        float value = 0.0f;
+        if (in.relay_on) {
+            switch (r.type) {
+                case PolicyRuleType::max_current:   value = in.amps; violated = value > r.limit; break;
+                case PolicyRuleType::max_power:     value = in.watts; violated = value > r.limit; break;
+                case PolicyRuleType::energy_budget: value = g_stats.energy_today_wh; violated = value > r.limit; break;
+                case PolicyRuleType::schedule:
+                    value = (float)minute;
+                    violated = !in_window((uint32_t)minute, r.start_min, r.end_min);
+                    break;
+                default: break;
+            }
+            if (r.type != PolicyRuleType::schedule && timed && !in_window((uint32_t)minute, r.start_min, r.end_min))
+                violated = false;
+        }
+
+        if (!violated) {
+            g_held[i] = 0;
+            g_counting[i] = false;
+            continue;
+        }
+        if (g_held[i] < UINT16_MAX) g_held[i]++;
+        if (g_held[i] < (r.hold_windows ? r.hold_windows : 1)) continue;
+
+        if (!g_counting[i]) {
+            g_counting[i] = true;
+            g_stats.violations++;
+            g_stats.last_rule = (int8_t)i;
+            g_stats.last_type = r.type;
+            g_stats.last_value = value;
+        }
+        if (!v.trip && (g_set.flags & POLICY_FLAG_ENFORCE) && (r.action & POLICY_ACTION_TRIP)) {
+            v.trip = true;
+            v.rule = (int8_t)i;
+        }
+    }
+
+    uint32_t us = micros() - t0;
+    if (us > g_stats.eval_max_us) g_stats.eval_max_us = us;
+    return v;
+}
+
+void policy_record_trip(uint32_t latency_us) {
+    g_stats.trips++;
+    g_stats.trip_last_us = latency_us;
+    g_stats.trip_sum_us += latency_us;
+    if (latency_us > g_stats.trip_max_us) g_stats.trip_max_us = latency_us;
+    // The relay is open now; a rule still violated after relay/on counts (and trips) again.
+    reset_rule_state();
+}
+
+const PolicySet& policy_active() {
+    return g_set;
+}
+
+const PolicyStats& policy_stats() {
+    return g_stats;
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+  On-device policy engine (device_policies on the backend). hardwareTask
+  evaluates the rules on every measurement window and can open the relay in
+  the same wake, instead of waiting for a device -> broker -> REST -> DB ->
+  broker -> device round trip that takes seconds and never completes while
+  the link is down.
+
+  Rules, at most POLICY_MAX_RULES:
+    max_current    window current above limit (A)
+    max_power      window power above limit (W)
+    energy_budget  energy since local midnight above limit (Wh); a rolling
+                   24 h from boot while the local time is unknown
+    schedule       relay on outside [start_min, end_min) local time
+  The other rules may be limited to [start_min, end_min) too (equal: always).
+  end < start wraps midnight. A rule counts once it has held for hold_windows
+  consecutive windows, so an inrush spike can be ignored. A rule with the trip
+  action then opens the relay, unless the set is not enforced
+  (is_enforced = false), in which case violations are only counted. The relay
+  stays off until a relay/on command; a rule still violated trips it again on
+  the next window.
+
+  Local time: the set carries the sender's local seconds since midnight, which
+  is then followed with millis(); the "time" command refreshes it. It is not
+  kept across a reboot, and until it is set again the schedule rule and any
+  time-limited rule are skipped.
+
+  Wire format, "<cid>/cmd/policy", binary, little-endian. The backend encoder
+  is infra/rest_api/mqtt_conf/policy.ts; keep the two in sync.
+     off size field
+     0   1    version          = 1
+     1   1    flags            bit0 = enforce
+     2   1    count            rules that follow; 0 clears the set
+     3   4    tod_s            u32, sender's local seconds since midnight, 0xFFFFFFFF = unknown
+     then per rule (12 bytes):
+     +0  1    type             1 max_current, 2 max_power, 3 energy_budget, 4 schedule
+     +1  1    action           bit0 = trip the relay
+     +2  2    hold_windows     u16, consecutive windows before it counts (0 = 1)
+     +4  4    limit            f32, A / W / Wh; unused by schedule
+     +8  2    start_min        u16, minutes since local midnight
+     +10 2    end_min          u16
+
+  The active set is kept in NVS (namespace "policy") as a CRC'd blob and
+  reloaded at boot.
+*/
+
+#ifndef POLICY_MAX_RULES
+#define POLICY_MAX_RULES 8
+#endif
+
+constexpr uint8_t POLICY_WIRE_VERSION = 1;
+constexpr size_t POLICY_HEADER_SIZE = 7;
+constexpr size_t POLICY_RULE_SIZE = 12;
+constexpr size_t POLICY_WIRE_MAX = POLICY_HEADER_SIZE + POLICY_MAX_RULES * POLICY_RULE_SIZE;
+constexpr uint8_t POLICY_FLAG_ENFORCE = 0x01;
+constexpr uint8_t POLICY_ACTION_TRIP = 0x01;
+constexpr uint32_t POLICY_TOD_UNKNOWN = 0xFFFFFFFF;
+
+enum class PolicyRuleType : uint8_t { none = 0, max_current = 1, max_power = 2, energy_budget = 3, schedule = 4 };
+
+struct PolicyRule {
+    PolicyRuleType type;
+    uint8_t action;
+    uint16_t hold_windows;
+    float limit;
+    uint16_t start_min;
+    uint16_t end_min;
+};
+
+struct PolicySet {
+    uint8_t flags;
+    uint8_t count;
+    uint32_t tod_s;
+    PolicyRule rules[POLICY_MAX_RULES];
+};
+
+// One measurement window, as hardwareTask saw it.
+struct PolicyInput {
+    float amps;
+    float watts;
+    uint32_t elapsed_ms;   // since the previous window
+    bool relay_on;
+    uint32_t now_ms;
+};
+
+struct PolicyVerdict {
+    bool trip;             // open the relay now
+    int8_t rule;           // index of the rule that tripped it, -1 = none
+};
+
+struct PolicyStats {
+    uint32_t evaluations;      // windows evaluated with a non-empty set
+    uint32_t violations;       // times a rule started to count (after its hold)
+    uint32_t trips;            // relay openings
+    uint32_t eval_max_us;      // policy_evaluate() time
+    uint32_t trip_last_us;     // window sampled -> relay off, last trip
+    uint32_t trip_max_us;
+    uint64_t trip_sum_us;
+    int8_t last_rule;          // rule of the last violation, -1 = none yet
+    PolicyRuleType last_type;
+    float last_value;          // what it measured: A, W, Wh, or the local minute
+    float energy_today_wh;
+    bool restored;             // a set was loaded from NVS at boot
+};
+
+const char* policy_rule_name(PolicyRuleType type);
+// Parses the wire format in place. False if it is malformed or has too many rules.
+bool policy_decode(const uint8_t* buf, size_t len, PolicySet& out);
+// The inverse, for the host simulator and tests. Returns the bytes written, 0 if cap is too small.
+size_t policy_encode(const PolicySet& set, uint8_t* buf, size_t cap);
+
+void policy_init();                                    // loads the set saved in NVS
+void policy_set(const PolicySet& set, uint32_t now_ms);   // applies and saves it
+void policy_set_time(uint32_t tod_s, uint32_t now_ms);
+PolicyVerdict policy_evaluate(const PolicyInput& in);
+void policy_record_trip(uint32_t latency_us);
+const PolicySet& policy_active();
+const PolicyStats& policy_stats();
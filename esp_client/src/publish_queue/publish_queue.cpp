@@ -0,0 +1,49 @@
+#include "publish_queue.h"
+#include "spsc_queue.h"
+
+static SpscQueue<OutboundMessage, PUBLISH_QUEUE_CAPACITY> queue;
+static PublishQueueStats stats = {};
+static TaskHandle_t consumer = nullptr;
+
+/* === producer === */
+
+bool publish_queue_push(OutboundMessage msg) {
+    msg.enqueued_us = micros();
+    if (!queue.push(msg)) {
+        stats.dropped++;
+        return false;
+    }
+    stats.pushed++;
+    // Wake mqttTask now instead of waiting out its poll period.
+    if (consumer) xTaskNotifyGive(consumer);
+    return true;
+}
+
+/* === consumer === */
+
+void publish_queue_attach_consumer() {
+    consumer = xTaskGetCurrentTaskHandle();
+}
+
+bool publish_queue_pop(OutboundMessage& out) {
+    size_t depth = queue.size();
+    if (!queue.pop(out)) return false;
+    stats.popped++;
+    if (depth > stats.depth_max) stats.depth_max = (uint32_t)depth;
+    return true;
+}
+
+void publish_queue_wait(uint32_t timeout_ms) {
+    ulTaskNotifyTake(pdTRUE, timeout_ms / portTICK_PERIOD_MS);
+}
+
+void publish_queue_record_wire(uint32_t enqueued_us) {
+    uint32_t latency = micros() - enqueued_us;
+    stats.latency_count++;
+    stats.latency_sum_us += latency;
+    if (latency > stats.latency_max_us) stats.latency_max_us = latency;
+}
+
+size_t publish_queue_depth() { return queue.size(); }
+
+const PublishQueueStats& publish_queue_stats() { return stats; }
@@ -0,0 +1,55 @@
+#pragma once
+#include <Arduino.h>
+#include "../telemetry/telemetry.h"
+#include "../commands/commands.h"
+
+/*
+  Hand-off from hardwareTask (core 1) to mqttTask (core 0).
+
+  Only mqttTask touches the PubSubClient, the report batch and the reading
+  store; hardwareTask just pushes what it wants sent and returns to metering.
+  The queue is lock-free SPSC, so push never blocks: when it is full the
+  message is dropped and counted, and the caller decides what to keep.
+*/
+
+#ifndef PUBLISH_QUEUE_CAPACITY
+#define PUBLISH_QUEUE_CAPACITY 16   // power of two; ~48 s of 3 s reports before dropping
+#endif
+
+enum class OutboundKind : uint8_t {
+    reading,      // metering report, goes through batching/store-and-forward
+    test_ping,    // button test path, publishes a fixed payload
+    diag,         // one snapshot to <cid>/diag: "diag" command, diag timer, policy trip
+    ack           // <cid>/ack for an applied command (commands.h)
+};
+
+struct OutboundMessage {
+    OutboundKind kind;
+    DeviceReading reading;
+    CommandAck ack;
+    uint32_t enqueued_us;   // stamped by publish_queue_push
+};
+
+struct PublishQueueStats {
+    // producer side
+    uint32_t pushed;
+    uint32_t dropped;          // queue full at push
+    // consumer side
+    uint32_t popped;
+    uint32_t depth_max;        // high-water mark seen at pop
+    uint32_t latency_count;    // messages whose publish succeeded
+    uint64_t latency_sum_us;   // enqueue -> publish_message() returned, incl. time held in a report batch
+    uint32_t latency_max_us;
+};
+
+/* === producer (hardwareTask) === */
+bool publish_queue_push(OutboundMessage msg);
+
+/* === consumer (mqttTask) === */
+void publish_queue_attach_consumer();            // call once from the consuming task
+bool publish_queue_pop(OutboundMessage& out);
+void publish_queue_wait(uint32_t timeout_ms);    // sleep until a push or the timeout
+void publish_queue_record_wire(uint32_t enqueued_us);   // after publish_message() succeeded
+
+size_t publish_queue_depth();
+const PublishQueueStats& publish_queue_stats();
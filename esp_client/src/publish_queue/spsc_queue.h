@@ -0,0 +1,46 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/*
+  Fixed-capacity, lock-free single-producer/single-consumer ring.
+
+  Exactly one task may call push() and exactly one (other) task may call pop().
+  head_ is only written by the producer and tail_ only by the consumer; the
+  release/acquire pair on them publishes the slot contents across cores.
+  N must be a power of two; indices run free and are masked on access, so
+  all N slots are usable.
+*/
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    bool push(const T& item) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) == N) return false;   // full
+        slots_[head & (N - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& out) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) return false;       // empty
+        out = slots_[tail & (N - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called from a third party, exact from either end.
+    size_t size() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+    static constexpr size_t capacity() { return N; }
+
+private:
+    T slots_[N];
+    std::atomic<uint32_t> head_{0};
+    std::atomic<uint32_t> tail_{0};
+};
@@ -0,0 +1,66 @@
+#include "reading_clock.h"
+#include <Preferences.h>
+#include <sys/time.h>
+#include <esp_sntp.h>
+
+static const char* const NVS_NAMESPACE = "rclock";
+static const char* const K_BOOT = "boot";
+
+static uint32_t g_seq = 0;              // hardwareTask only
+static bool g_sync_started = false;     // mqttTask only, as is the anchor
+static uint64_t g_anchor_unix_ms = 0;
+static uint32_t g_anchor_ms = 0;        // millis() at g_anchor_unix_ms
+static ReadingClockStats g_stats = {};
+
+void reading_clock_init() {
+    Preferences p;
+    p.begin(NVS_NAMESPACE, false);
+    uint32_t boot = p.getUInt(K_BOOT, 0) + 1;
+    p.putUInt(K_BOOT, boot);
+    p.end();
+
+    // The anchor is mqttTask's and may already be set; only this boot's identity starts over.
+    g_seq = 0;
+    g_stats.boot_id = boot;
+}
+
+void reading_clock_stamp(DeviceReading& r) {
+    r.bootId = g_stats.boot_id;
+    r.seq = ++g_seq;
+    r.unixMs = 0;
+}
+
+void reading_clock_start_sync() {
+    if (g_sync_started) return;
+    g_sync_started = true;
+    configTime(0, 0, TIME_SYNC_SERVER);
+}
+
+uint64_t reading_clock_unix_ms(uint32_t ms) {
+    if (!g_stats.synced) return 0;
+    // Signed distance from the anchor: right for anything within 24 days of the latest sync.
+    return g_anchor_unix_ms + (int64_t)(int32_t)(ms - g_anchor_ms);
+}
+
+// sntp_get_sync_status() reports COMPLETED once per sync, so this anchors exactly once each time.
+void reading_clock_poll() {
+    if (!g_sync_started || sntp_get_sync_status() != SNTP_SYNC_STATUS_COMPLETED) return;
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    uint32_t now = millis();
+    uint64_t unix_ms = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    if (g_stats.synced) g_stats.last_step_ms = (int32_t)((int64_t)unix_ms - (int64_t)reading_clock_unix_ms(now));
+    g_anchor_unix_ms = unix_ms;
+    g_anchor_ms = now;
+    g_stats.synced = true;
+    g_stats.syncs++;
+}
+
+void reading_clock_resolve(DeviceReading& r) {
+    if (r.unixMs == 0 && r.bootId == g_stats.boot_id) r.unixMs = reading_clock_unix_ms(r.capturedMs);
+}
+
+const ReadingClockStats& reading_clock_stats() {
+    g_stats.seq = g_seq;
+    return g_stats;
+}
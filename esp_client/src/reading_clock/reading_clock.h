@@ -0,0 +1,46 @@
+#pragma once
+#include "../telemetry/telemetry.h"
+
+/*
+  Identity and wall-clock time of every reading, so the backend can order readings,
+  drop duplicates and spot gaps no matter how late, batched or retried they arrive.
+
+  - boot ID: a counter in NVS, bumped once per boot (one NVS write per boot).
+  - seq: per-boot sequence number, assigned at capture on hardwareTask, from 1.
+    A reading the publish queue has no room for still used its number (its energy
+    rides on the next one), so a gap in seq is a lost sample, never lost energy.
+  - unixMs: SNTP time of capture. mqttTask starts SNTP at the first WiFi connect and
+    anchors millis() to UTC each time a sync completes (lwIP re-syncs hourly).
+    Readings are stamped when mqttTask picks them up and again when they're drained
+    from the store: capturedMs + the anchor, so one taken before the first sync still
+    gets its real capture time if it waited out the sync (outage at boot). 0 = unknown:
+    published before the first sync, or stored by an earlier boot that never synced;
+    the backend falls back to the arrival time for those.
+
+  Only mqttTask touches the anchor and only hardwareTask the sequence, so neither
+  needs a lock.
+*/
+
+#ifndef TIME_SYNC_SERVER
+#define TIME_SYNC_SERVER "pool.ntp.org"
+#endif
+
+struct ReadingClockStats {
+    uint32_t boot_id;
+    uint32_t seq;           // last sequence number handed out
+    bool synced;
+    uint32_t syncs;         // SNTP syncs picked up since boot
+    int32_t last_step_ms;   // new anchor minus where the old one had drifted to at the latest re-sync
+};
+
+// hardwareTask, before the first reading.
+void reading_clock_init();
+// hardwareTask: boot ID and the next sequence number.
+void reading_clock_stamp(DeviceReading& r);
+// mqttTask: SNTP start (once; later calls are no-ops) and pick-up of completed syncs.
+void reading_clock_start_sync();
+void reading_clock_poll();
+// mqttTask: fills unixMs from capturedMs when it's still 0 and the reading is from this boot.
+void reading_clock_resolve(DeviceReading& r);
+uint64_t reading_clock_unix_ms(uint32_t ms);   // 0 until the first sync
+const ReadingClockStats& reading_clock_stats();
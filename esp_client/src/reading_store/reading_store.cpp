@@ -0,0 +1,229 @@
+#include "reading_store.h"
+#include "../checksum/crc32.h"
+#include "../diagnostics/log.h"
+#include <SPIFFS.h>
+#include <Preferences.h>
+
+static const char* const RING_PATH = "/readings.ring";
+static const char* const NVS_NAMESPACE = "rstore";
+static const char* const K_TAIL = "tail";
+
+static constexpr uint8_t RECORD_MAGIC = 0xA8;   // 0xA7: 64 B without identity, 0xA6: no lifetime, 0xA5: no stats
+
+struct StoredReading {
+    uint32_t seq;             // ring position, not the reading's own sequence number
+    uint8_t magic;
+    uint8_t flags;
+    int16_t voltage;
+    double energyIncrement;   // kept as double so replayed totals match what was measured
+    double lifetimeKwh;
+    uint64_t unix_ms;
+    float current;
+    float power;
+    uint32_t captured_ms;
+    uint32_t boot_id;
+    uint32_t reading_seq;
+    PowerStats stats;         // 24 B with padding
+    uint32_t crc;             // CRC-32 of every byte above
+};
+static_assert(sizeof(StoredReading) == 80, "ring record layout changed");
+static constexpr size_t RING_BYTES = (size_t)READING_STORE_SLOTS * sizeof(StoredReading);
+
+static uint32_t g_head = 0;      // next seq to assign
+static uint32_t g_flushed = 0;   // seqs below this are on flash, [g_flushed, g_head) are staged
+static uint32_t g_tail = 0;      // next seq to publish
+static StoredReading g_stage[READING_STORE_STAGE];
+static uint32_t g_peeked_seq[READING_STORE_DRAIN_BATCH];
+static size_t g_peeked = 0;
+static double g_carry_kwh = 0.0;
+static ReadingStoreStats g_stats = {};
+
+static uint32_t record_crc(const StoredReading& s) {
+    return crc32((const uint8_t*)&s, offsetof(StoredReading, crc));
+}
+
+static bool record_valid(const StoredReading& s) {
+    return s.magic == RECORD_MAGIC && s.crc == record_crc(s);
+}
+
+static size_t slot_offset(uint32_t seq) {
+    return (size_t)(seq % READING_STORE_SLOTS) * sizeof(StoredReading);
+}
+
+static StoredReading pack(const DeviceReading& r, uint32_t seq) {
+    StoredReading s = {};
+    s.seq = seq;
+    s.magic = RECORD_MAGIC;
+    s.flags = r.relayOn ? TELEMETRY_FLAG_RELAY_ON : 0;
+    s.voltage = (int16_t)r.voltage;
+    s.energyIncrement = r.energyIncrement;
+    s.lifetimeKwh = r.lifetimeKwh;
+    s.current = (float)r.current;
+    s.power = (float)r.power;
+    s.captured_ms = r.capturedMs;
+    s.stats = r.stats;
+    s.unix_ms = r.unixMs;
+    s.boot_id = r.bootId;
+    s.reading_seq = r.seq;
+    s.crc = record_crc(s);
+    return s;
+}
+
+static DeviceReading unpack(const StoredReading& s) {
+    return { s.energyIncrement, s.voltage, s.current, s.power, (s.flags & TELEMETRY_FLAG_RELAY_ON) != 0, s.captured_ms, s.stats,
+             s.lifetimeKwh, s.boot_id, s.reading_seq, s.unix_ms };
+}
+
+static void save_tail() {
+    Preferences p;
+    p.begin(NVS_NAMESPACE, false);
+    p.putUInt(K_TAIL, g_tail);
+    p.end();
+    g_stats.nvs_writes++;
+}
+
+// Zero-fill once so every slot can be overwritten in place with "r+".
+static bool format_ring() {
+    File f = SPIFFS.open(RING_PATH, FILE_WRITE);
+    if (!f) return false;
+    uint8_t zeros[256] = {};
+    for (size_t left = RING_BYTES; left > 0; ) {
+        size_t n = left < sizeof(zeros) ? left : sizeof(zeros);
+        if (f.write(zeros, n) != n) { f.close(); return false; }
+        left -= n;
+    }
+    f.close();
+    return true;
+}
+
+// A ring left by a firmware with another record size or slot count can't be read: start over.
+static bool ring_fits() {
+    File f = SPIFFS.open(RING_PATH, FILE_READ);
+    if (!f) return false;
+    size_t size = f.size();
+    f.close();
+    return size == RING_BYTES;
+}
+
+// Rebuild head from the highest valid sequence number on flash.
+static void scan_ring() {
+    File f = SPIFFS.open(RING_PATH, FILE_READ);
+    if (!f) return;
+    StoredReading s;
+    for (uint32_t slot = 0; slot < READING_STORE_SLOTS; slot++) {
+        if (f.read((uint8_t*)&s, sizeof(s)) != sizeof(s)) break;
+        if (!record_valid(s) || s.seq % READING_STORE_SLOTS != slot) continue;
+        if (s.seq + 1 > g_head) g_head = s.seq + 1;
+    }
+    f.close();
+}
+
+void reading_store_init() {
+    Preferences p;
+    p.begin(NVS_NAMESPACE, true);
+    g_tail = p.getUInt(K_TAIL, 0);
+    p.end();
+
+    g_head = g_tail;
+    if (SPIFFS.exists(RING_PATH) && ring_fits()) scan_ring();
+    else if (!format_ring()) LOG_PRINTLN("reading_store: could not create ring file");
+
+    if (g_head < g_tail) g_head = g_tail;
+    if (g_head - g_tail > READING_STORE_SLOTS) g_tail = g_head - READING_STORE_SLOTS;
+    g_flushed = g_head;
+}
+
+uint32_t reading_store_pending() {
+    return g_head - g_tail;
+}
+
+double reading_store_take_carry() {
+    double carry = g_carry_kwh;
+    g_carry_kwh = 0.0;
+    return carry;
+}
+
+const ReadingStoreStats& reading_store_stats() {
+    return g_stats;
+}
+
+void reading_store_flush() {
+    if (g_flushed == g_head) return;
+
+    File f = SPIFFS.open(RING_PATH, "r+");
+    if (!f) return;
+    // Staged records are contiguous in seq; split at most once where the ring wraps.
+    uint32_t seq = g_flushed;
+    while (seq < g_head) {
+        uint32_t run = g_head - seq;
+        uint32_t to_end = READING_STORE_SLOTS - (seq % READING_STORE_SLOTS);
+        if (run > to_end) run = to_end;
+        size_t bytes = run * sizeof(StoredReading);
+        f.seek(slot_offset(seq));
+        f.write((const uint8_t*)&g_stage[seq - g_flushed], bytes);
+        g_stats.flash_writes++;
+        g_stats.flash_bytes += bytes;
+        seq += run;
+    }
+    f.close();
+    g_flushed = g_head;
+}
+
+bool reading_store_append(const DeviceReading& r) {
+    if (reading_store_pending() >= READING_STORE_SLOTS) {
+        g_carry_kwh += r.energyIncrement;
+        g_stats.overflowed++;
+        return false;
+    }
+
+    DeviceReading carried = r;
+    carried.energyIncrement += reading_store_take_carry();
+
+    g_stage[g_head - g_flushed] = pack(carried, g_head);
+    g_head++;
+    g_stats.appended++;
+
+    if (g_head - g_flushed >= READING_STORE_STAGE) reading_store_flush();
+    return true;
+}
+
+size_t reading_store_peek(DeviceReading* out, size_t max) {
+    if (max > READING_STORE_DRAIN_BATCH) max = READING_STORE_DRAIN_BATCH;
+    size_t n = 0;
+    uint32_t seq = g_tail;
+    File f;
+
+    while (n < max && seq < g_head) {
+        StoredReading s;
+        if (seq >= g_flushed) {
+            s = g_stage[seq - g_flushed];
+        } else {
+            if (!f) f = SPIFFS.open(RING_PATH, FILE_READ);
+            if (!f) break;
+            f.seek(slot_offset(seq));
+            if (f.read((uint8_t*)&s, sizeof(s)) != sizeof(s) || !record_valid(s) || s.seq != seq) {
+                // Unreadable slots can never be sent; step the tail over them now.
+                g_stats.corrupt++;
+                if (seq == g_tail) g_tail++;
+                seq++;
+                continue;
+            }
+        }
+        g_peeked_seq[n] = seq;
+        out[n++] = unpack(s);
+        seq++;
+    }
+    if (f) f.close();
+    g_peeked = n;
+    return n;
+}
+
+void reading_store_consume(size_t n) {
+    if (n == 0 || n > g_peeked) return;
+    g_tail = g_peeked_seq[n - 1] + 1;
+    g_stats.drained += n;
+    g_peeked = 0;
+    // Everything staged has gone out: drop it instead of ever writing it to flash.
+    if (g_tail == g_head) g_flushed = g_head;
+    save_tail();
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "../telemetry/telemetry.h"
+
+/*
+  Store-and-forward ring for readings that couldn't be published (broker/WiFi down).
+
+  - Fixed-size file of READING_STORE_SLOTS records on SPIFFS; record `seq` lives in slot seq % SLOTS.
+  - Records are staged in RAM and written READING_STORE_STAGE at a time (one SPIFFS page),
+    so an outage costs one flash write per STAGE intervals. Outages shorter than that never touch flash.
+  - The send cursor (tail) is checkpointed to NVS once per drained batch; head is rebuilt
+    from the ring's sequence numbers at boot.
+  - If the ring fills up, new readings' energy is carried instead of overwriting unsent ones, and
+    goes out with the next reading (reading_store_take_carry()), so energy is never dropped,
+    only per-interval resolution.
+*/
+
+#ifndef READING_STORE_SLOTS
+#define READING_STORE_SLOTS 8192      // 80 B each -> 640 KB, ~6.8 h of 3 s reports
+#endif
+
+#ifndef READING_STORE_STAGE
+#define READING_STORE_STAGE 16        // 16 * 80 B = five whole 256 B SPIFFS pages per flash write
+#endif
+
+#ifndef READING_STORE_DRAIN_BATCH
+#define READING_STORE_DRAIN_BATCH 14  // max backlog records published per report tick (one batch message when batching)
+#endif
+
+struct ReadingStoreStats {
+    uint32_t appended;       // readings that went into the store
+    uint32_t drained;        // readings later published from it
+    uint32_t overflowed;     // readings folded into the carry because the ring was full
+    uint32_t corrupt;        // slots skipped on drain (bad CRC / wrong seq)
+    uint32_t flash_writes;   // SPIFFS write calls (excluding the one-time file format)
+    uint32_t flash_bytes;
+    uint32_t nvs_writes;     // tail checkpoints
+};
+
+void reading_store_init();
+bool reading_store_append(const DeviceReading& r);
+// Oldest pending readings, up to min(max, READING_STORE_DRAIN_BATCH). They stay pending
+// until reading_store_consume() confirms how many of them were published.
+size_t reading_store_peek(DeviceReading* out, size_t max);
+void reading_store_consume(size_t n);
+void reading_store_flush();
+double reading_store_take_carry();
+uint32_t reading_store_pending();
+const ReadingStoreStats& reading_store_stats();
@@ -0,0 +1,115 @@
+#include "scheduler.h"
+#include <esp_timer.h>
+
+struct SchedTimer {
+    esp_timer_handle_t handle;
+    uint32_t event;
+    uint64_t period_us;   // 0 = one-shot
+    int64_t due_us;       // nominal deadline of the next firing
+};
+
+static TaskHandle_t task = nullptr;
+static SchedTimer timers[SCHED_MAX_TIMERS];
+static size_t timer_count = 0;
+static SchedulerStats stats = {};
+static int64_t last_wake_us = 0;
+
+// Runs in the esp_timer task, not an ISR.
+static void on_timer(void* arg) {
+    scheduler_notify(((SchedTimer*)arg)->event);
+}
+
+static SchedTimer* timer_for(uint32_t event) {
+    for (size_t i = 0; i < timer_count; i++)
+        if (timers[i].event == event) return &timers[i];
+    if (timer_count == SCHED_MAX_TIMERS) return nullptr;
+
+    SchedTimer* t = &timers[timer_count];
+    esp_timer_create_args_t args = {};
+    args.callback = on_timer;
+    args.arg = t;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "sched";
+    if (esp_timer_create(&args, &t->handle) != ESP_OK) return nullptr;
+    t->event = event;
+    timer_count++;
+    return t;
+}
+
+static bool start_timer(uint32_t event, uint64_t us, bool periodic) {
+    SchedTimer* t = timer_for(event);
+    if (!t) return false;
+    if (esp_timer_is_active(t->handle)) esp_timer_stop(t->handle);
+    t->period_us = periodic ? us : 0;
+    t->due_us = esp_timer_get_time() + (int64_t)us;
+    esp_err_t err = periodic ? esp_timer_start_periodic(t->handle, us) : esp_timer_start_once(t->handle, us);
+    return err == ESP_OK;
+}
+
+void scheduler_init() {
+    task = xTaskGetCurrentTaskHandle();
+    last_wake_us = esp_timer_get_time();
+}
+
+bool scheduler_every(uint32_t event, uint32_t period_ms) {
+    return period_ms > 0 && start_timer(event, (uint64_t)period_ms * 1000, true);
+}
+
+bool scheduler_after(uint32_t event, uint32_t delay_ms) {
+    return start_timer(event, (uint64_t)delay_ms * 1000, false);
+}
+
+void scheduler_cancel(uint32_t event) {
+    for (size_t i = 0; i < timer_count; i++)
+        if (timers[i].event == event && esp_timer_is_active(timers[i].handle)) esp_timer_stop(timers[i].handle);
+}
+
+void scheduler_notify(uint32_t events) {
+    if (task) xTaskNotify(task, events, eSetBits);
+}
+
+void IRAM_ATTR scheduler_notify_from_isr(uint32_t events) {
+    if (!task) return;
+    BaseType_t woken = pdFALSE;
+    xTaskNotifyFromISR(task, events, eSetBits, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static void record_jitter(uint32_t events, int64_t now_us) {
+    for (size_t i = 0; i < timer_count; i++) {
+        SchedTimer& t = timers[i];
+        if (!(events & t.event)) continue;
+
+        int64_t late = now_us - t.due_us;
+        if (late < 0) late = 0;   // re-armed between firing and handling
+        stats.timer_events++;
+        stats.jitter_sum_us += (uint64_t)late;
+        if ((uint64_t)late > stats.jitter_max_us) stats.jitter_max_us = (uint32_t)late;
+
+        // Missed periods merged into this wake; step to the next deadline still ahead.
+        if (t.period_us) do { t.due_us += (int64_t)t.period_us; } while (t.due_us <= now_us);
+    }
+}
+
+uint32_t scheduler_wait() {
+    int64_t blocked_at = esp_timer_get_time();
+    stats.busy_us += (uint64_t)(blocked_at - last_wake_us);
+
+    uint32_t events = 0;
+    BaseType_t got = xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY);
+
+    last_wake_us = esp_timer_get_time();
+    stats.idle_us += (uint64_t)(last_wake_us - blocked_at);
+    if (got != pdTRUE) return 0;
+
+    stats.wakes++;
+    record_jitter(events, last_wake_us);
+    return events;
+}
+
+const SchedulerStats& scheduler_stats() { return stats; }
+
+float scheduler_idle_percent() {
+    uint64_t total = stats.idle_us + stats.busy_us;
+    return total ? 100.0f * (float)stats.idle_us / (float)total : 0.0f;
+}
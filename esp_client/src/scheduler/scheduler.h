@@ -0,0 +1,52 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+  Event-driven wakeups for hardwareTask.
+
+  Every source of work raises a bit in the task's notification value and the
+  task sleeps in scheduler_wait() until at least one is set:
+    - esp_timer timers (measurement window, report interval, LED blink, diag)
+    - ISRs (button) via scheduler_notify_from_isr()
+    - other tasks / callbacks (MQTT commands, UART receive) via scheduler_notify()
+  Bits raised while the task is busy merge rather than queue, so a handler must
+  do all the work its event stands for.
+
+  Metrics: idle is the share of time the task spent blocked in scheduler_wait();
+  jitter is how late a timer event was handled relative to its nominal
+  deadline (esp_timer dispatch + time the task was still busy).
+*/
+
+enum SchedEvent : uint32_t {
+    SCHED_EVT_WINDOW  = 1u << 0,   // measurement window elapsed
+    SCHED_EVT_REPORT  = 1u << 1,   // report interval elapsed
+    SCHED_EVT_BUTTON  = 1u << 2,   // test button edge
+    SCHED_EVT_SERIAL  = 1u << 3,   // bytes waiting on Serial
+    SCHED_EVT_MESSAGE = 1u << 4,   // MQTT command handled by mqttTask
+    SCHED_EVT_BLINK   = 1u << 5,   // indicator LED on-time over
+    SCHED_EVT_DIAG    = 1u << 6,   // periodic diag message due (diagnostics.h)
+};
+
+#ifndef SCHED_MAX_TIMERS
+#define SCHED_MAX_TIMERS 4
+#endif
+
+struct SchedulerStats {
+    uint32_t wakes;
+    uint64_t idle_us;          // blocked in scheduler_wait()
+    uint64_t busy_us;          // between a wake and the next wait
+    uint32_t timer_events;     // timer events handled (jitter samples)
+    uint64_t jitter_sum_us;
+    uint32_t jitter_max_us;
+};
+
+void scheduler_init();                                    // binds to the calling task
+bool scheduler_every(uint32_t event, uint32_t period_ms); // (re)starts a periodic timer
+bool scheduler_after(uint32_t event, uint32_t delay_ms);  // (re)starts a one-shot timer
+void scheduler_cancel(uint32_t event);                    // stops its timer, if any
+void scheduler_notify(uint32_t events);
+void IRAM_ATTR scheduler_notify_from_isr(uint32_t events);
+uint32_t scheduler_wait();                                // 0 only if the wait was abandoned
+
+const SchedulerStats& scheduler_stats();
+float scheduler_idle_percent();
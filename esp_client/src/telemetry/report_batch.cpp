@@ -0,0 +1,56 @@
+#include "report_batch.h"
+
+static ReportBatchPolicy g_policy = { 1, 0 };
+static DeviceReading g_samples[REPORT_BATCH_CAPACITY];
+static size_t g_count = 0;
+static bool g_relay_changed = false;
+static ReportBatchStats g_stats = {};
+
+void report_batch_set_policy(ReportBatchPolicy policy) {
+    if (policy.max_samples > REPORT_BATCH_CAPACITY) policy.max_samples = REPORT_BATCH_CAPACITY;
+    g_policy = policy;
+}
+
+bool report_batch_enabled() {
+    return g_policy.max_samples > 1;
+}
+
+void report_batch_add(const DeviceReading& r) {
+    if (g_count > 0 && g_samples[g_count - 1].relayOn != r.relayOn) g_relay_changed = true;
+    if (g_count < REPORT_BATCH_CAPACITY) g_samples[g_count++] = r;
+}
+
+bool report_batch_should_flush(uint32_t now_ms) {
+    if (g_count == 0) return false;
+    if (g_relay_changed) { g_stats.flush_relay++; return true; }
+    if (g_count >= g_policy.max_samples) { g_stats.flush_full++; return true; }
+    if (g_policy.max_age_ms && now_ms - g_samples[0].capturedMs >= g_policy.max_age_ms) { g_stats.flush_age++; return true; }
+    return false;
+}
+
+uint32_t report_batch_ms_until_due(uint32_t now_ms) {
+    if (g_count == 0 || !g_policy.max_age_ms) return UINT32_MAX;
+    uint32_t age = now_ms - g_samples[0].capturedMs;
+    return age >= g_policy.max_age_ms ? 0 : g_policy.max_age_ms - age;
+}
+
+size_t report_batch_count() {
+    return g_count;
+}
+
+const DeviceReading* report_batch_samples() {
+    return g_samples;
+}
+
+void report_batch_clear(bool published) {
+    if (published) {
+        g_stats.batches++;
+        g_stats.samples += g_count;
+    }
+    g_count = 0;
+    g_relay_changed = false;
+}
+
+const ReportBatchStats& report_batch_stats() {
+    return g_stats;
+}
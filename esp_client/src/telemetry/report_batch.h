@@ -0,0 +1,42 @@
+#pragma once
+#include "telemetry.h"
+
+/*
+  Collects readings into one v8 batch message (binary format only; JSON devices
+  keep one reading per publish).
+
+  A batch is flushed when any of these holds:
+    - it holds max_samples readings
+    - its oldest reading is max_age_ms old
+    - the relay changed state since the previous reading
+  max_samples <= 1 disables batching. The first two are checked as each
+  reading is added; the age also on mqttTask's own wake-ups, which
+  report_batch_ms_until_due() bounds, so it holds when no readings come.
+*/
+
+#ifndef REPORT_BATCH_CAPACITY
+#define REPORT_BATCH_CAPACITY 14   // 2 + 14 * 67 = 940 B payload, fits MQTT_BUFFER_SIZE
+#endif
+
+struct ReportBatchPolicy {
+    uint8_t max_samples;
+    uint32_t max_age_ms;
+};
+
+struct ReportBatchStats {
+    uint32_t batches;          // successful batch publishes
+    uint32_t samples;          // readings carried by them
+    uint32_t flush_full;
+    uint32_t flush_age;
+    uint32_t flush_relay;
+};
+
+void report_batch_set_policy(ReportBatchPolicy policy);
+bool report_batch_enabled();
+void report_batch_add(const DeviceReading& r);
+bool report_batch_should_flush(uint32_t now_ms);
+uint32_t report_batch_ms_until_due(uint32_t now_ms);   // UINT32_MAX: no age limit pending
+size_t report_batch_count();
+const DeviceReading* report_batch_samples();
+void report_batch_clear(bool published);
+const ReportBatchStats& report_batch_stats();
@@ -0,0 +1,101 @@
+#include "report_policy.h"
+#include <math.h>
+
+static ReportPolicy g_policy = { ReportMode::interval, 0.0f, 0.0f, 0 };
+static float g_reported_watts = -1.0f;     // deadband centre; < 0 until the first report
+static float g_prev_window_watts = -1.0f;  // adaptive: the window before this one
+static uint8_t g_stretch = 0;              // adaptive: period = interval << g_stretch, capped at the heartbeat
+static constexpr uint8_t STRETCH_MAX = 16; // 1 s << 16 is past any heartbeat
+static bool g_transient = false;           // adaptive: a window left the band since the last report
+static ReportPolicyStats g_stats = {};
+
+ReportMode parse_report_mode(const char* value) {
+    if (value && strcasecmp(value, "exception") == 0) return ReportMode::exception;
+    if (value && strcasecmp(value, "adaptive") == 0) return ReportMode::adaptive;
+    return ReportMode::interval;
+}
+
+const char* report_mode_name(ReportMode mode) {
+    switch (mode) {
+        case ReportMode::exception: return "exception";
+        case ReportMode::adaptive:  return "adaptive";
+        default:                    return "interval";
+    }
+}
+
+void report_policy_set(ReportPolicy policy) {
+    // Without a heartbeat a steady load would never report again.
+    if (policy.mode == ReportMode::exception && policy.heartbeat_ms == 0) policy.mode = ReportMode::interval;
+    g_policy = policy;
+    g_stretch = 0;
+    g_transient = false;
+}
+
+const ReportPolicy& report_policy() {
+    return g_policy;
+}
+
+uint32_t report_policy_period_ms(uint32_t interval_ms) {
+    if (g_policy.mode == ReportMode::exception) return g_policy.heartbeat_ms;
+    if (g_policy.mode != ReportMode::adaptive) return interval_ms;
+    uint64_t period = (uint64_t)interval_ms << g_stretch;
+    if (period > g_policy.heartbeat_ms) period = g_policy.heartbeat_ms;
+    return period > interval_ms ? (uint32_t)period : interval_ms;
+}
+
+static bool outside_band(float watts, float centre, float band_w, float band_pct) {
+    float band = band_pct * 0.01f * centre;
+    if (band_w > band) band = band_w;
+    return fabsf(watts - centre) > band;
+}
+
+static bool adaptive_window(float window_watts) {
+    float prev = g_prev_window_watts;
+    g_prev_window_watts = window_watts;
+    if (prev < 0.0f) return false;
+
+    float w = g_policy.deadband_w, pct = g_policy.deadband_pct;
+    if (w <= 0.0f && pct <= 0.0f) {
+        w = ADAPTIVE_DEFAULT_W;
+        pct = ADAPTIVE_DEFAULT_PCT;
+    }
+    if (!outside_band(window_watts, prev, w, pct)) return false;
+
+    g_stats.transients++;
+    g_transient = true;
+    if (g_stretch == 0) return false;   // already reporting at the interval
+    g_stretch = 0;
+    return true;
+}
+
+bool report_policy_window(float window_watts) {
+    if (g_policy.mode == ReportMode::adaptive) return adaptive_window(window_watts);
+    if (g_policy.mode != ReportMode::exception) return false;
+    if (g_reported_watts < 0.0f) return true;
+
+    if (outside_band(window_watts, g_reported_watts, g_policy.deadband_w, g_policy.deadband_pct)) return true;
+
+    g_stats.windows_quiet++;
+    return false;
+}
+
+void report_policy_sent(ReportReason reason, float window_watts) {
+    if (window_watts >= 0.0f) g_reported_watts = window_watts;
+    if (g_policy.mode == ReportMode::adaptive) {
+        // A steady interval stretches the next one; the cap is applied in report_policy_period_ms().
+        if (reason == ReportReason::relay) g_stretch = 0;
+        else if (reason == ReportReason::interval && !g_transient && g_stretch < STRETCH_MAX) g_stretch++;
+        g_transient = false;
+    }
+    switch (reason) {
+        case ReportReason::interval:  g_stats.interval++; break;
+        case ReportReason::heartbeat: g_stats.heartbeat++; break;
+        case ReportReason::deadband:  g_stats.deadband++; break;
+        case ReportReason::relay:     g_stats.relay++; break;
+        case ReportReason::none:      break;
+    }
+}
+
+const ReportPolicyStats& report_policy_stats() {
+    return g_stats;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+  When hardwareTask sends a reading.
+
+  interval  : every report interval (timeInterval), plus right away on a relay change.
+  exception : report by exception. A reading goes out right away when
+                - the relay changes state, or
+                - a measurement window's power moves out of the deadband around
+                  the last reported power: |P - P_last| > max(deadband_w, deadband_pct% of P_last)
+              and otherwise only as a heartbeat every heartbeat_ms. Energy and
+              window stats keep accumulating in between, so the heartbeat carries
+              everything since the previous report and no energy is lost.
+  adaptive  : the report period follows the load. It starts at the interval and
+              doubles after every report whose windows all stayed inside the
+              deadband around the window before them, up to heartbeat_ms. A window
+              outside it (a load transient) drops the period back to the interval,
+              reporting right away if it had stretched. With no deadband set,
+              ADAPTIVE_DEFAULT_W / ADAPTIVE_DEFAULT_PCT are used.
+  Setting both deadbands lets the absolute one act as a noise floor at low load
+  while the relative one scales with it.
+*/
+
+#ifndef ADAPTIVE_DEFAULT_W
+#define ADAPTIVE_DEFAULT_W 2.0f
+#endif
+#ifndef ADAPTIVE_DEFAULT_PCT
+#define ADAPTIVE_DEFAULT_PCT 10.0f
+#endif
+
+enum class ReportMode : uint8_t { interval = 0, exception = 1, adaptive = 2 };
+
+enum class ReportReason : uint8_t { none = 0, interval, heartbeat, deadband, relay };
+
+struct ReportPolicy {
+    ReportMode mode;
+    float deadband_w;
+    float deadband_pct;
+    uint32_t heartbeat_ms;
+};
+
+struct ReportPolicyStats {
+    uint32_t interval;         // readings sent, by reason
+    uint32_t heartbeat;
+    uint32_t deadband;
+    uint32_t relay;
+    uint32_t windows_quiet;    // windows evaluated in exception mode that stayed inside the deadband
+    uint32_t transients;       // adaptive: windows that left the deadband around the previous one
+};
+
+ReportMode parse_report_mode(const char* value);
+const char* report_mode_name(ReportMode mode);
+
+void report_policy_set(ReportPolicy policy);
+const ReportPolicy& report_policy();
+// Report timer period: the interval, the heartbeat in exception mode, or the
+// current stretch of the interval in adaptive mode.
+uint32_t report_policy_period_ms(uint32_t interval_ms);
+// True if this window's power calls for a report now (exception and adaptive modes).
+bool report_policy_window(float window_watts);
+// Records a sent reading; window_watts is the power the deadband re-centres on.
+void report_policy_sent(ReportReason reason, float window_watts);
+const ReportPolicyStats& report_policy_stats();
@@ -0,0 +1,108 @@
+#include "telemetry.h"
+#include <ArduinoJson.h>
+
+static uint8_t* put_f32(uint8_t* p, float v) {
+    // ESP32 (and every host we build on) is little-endian, which is the wire order.
+    memcpy(p, &v, sizeof(v));
+    return p + sizeof(v);
+}
+
+static uint8_t* put_f64(uint8_t* p, double v) {
+    memcpy(p, &v, sizeof(v));
+    return p + sizeof(v);
+}
+
+static uint8_t* put_identity(uint8_t* p, const DeviceReading& r) {
+    memcpy(p, &r.bootId, sizeof(r.bootId));
+    p += sizeof(r.bootId);
+    memcpy(p, &r.seq, sizeof(r.seq));
+    p += sizeof(r.seq);
+    memcpy(p, &r.unixMs, sizeof(r.unixMs));
+    return p + sizeof(r.unixMs);
+}
+
+static uint8_t* put_stats(uint8_t* p, const PowerStats& st) {
+    memcpy(p, &st.windows, sizeof(st.windows));
+    p += sizeof(st.windows);
+    p = put_f32(p, st.min);
+    p = put_f32(p, st.max);
+    p = put_f32(p, st.mean);
+    p = put_f32(p, st.var);
+    return put_f32(p, st.p95);
+}
+
+TelemetryFormat parse_telemetry_format(const char* value) {
+    if (value && strcasecmp(value, "binary") == 0) return TelemetryFormat::binary;
+    return TelemetryFormat::json;
+}
+
+const char* telemetry_format_name(TelemetryFormat fmt) {
+    return fmt == TelemetryFormat::binary ? "binary" : "json";
+}
+
+size_t encode_reading_json(const DeviceReading& r, const char* deviceName, char* buf, size_t cap) {
+    StaticJsonDocument<384> doc;
+    doc["energyIncrement"] = r.energyIncrement;
+    doc["lifetimeKwh"] = r.lifetimeKwh;
+    doc["voltage"] = r.voltage;
+    doc["current"] = r.current;
+    doc["deviceName"] = deviceName;
+    doc["power"] = r.power;
+    doc["boot"] = r.bootId;
+    doc["seq"] = r.seq;
+    if (r.unixMs) doc["ts"] = r.unixMs;
+    if (r.stats.windows) {
+        JsonObject st = doc.createNestedObject("stats");
+        st["n"] = r.stats.windows;
+        st["min"] = r.stats.min;
+        st["max"] = r.stats.max;
+        st["mean"] = r.stats.mean;
+        st["var"] = r.stats.var;
+        st["p95"] = r.stats.p95;
+    }
+    return serializeJson(doc, buf, cap);
+}
+
+size_t encode_reading_binary(const DeviceReading& r, uint8_t* buf, size_t cap) {
+    if (cap < TELEMETRY_BINARY_SIZE) return 0;
+
+    uint8_t* p = buf;
+    *p++ = TELEMETRY_BINARY_VERSION;
+    *p++ = r.relayOn ? TELEMETRY_FLAG_RELAY_ON : 0;
+    p = put_f32(p, (float)r.energyIncrement);
+    p = put_f32(p, (float)r.voltage);
+    p = put_f32(p, (float)r.current);
+    p = put_f32(p, (float)r.power);
+    p = put_stats(p, r.stats);
+    p = put_f64(p, r.lifetimeKwh);
+    p = put_identity(p, r);
+    return p - buf;
+}
+
+size_t encode_batch_binary(const DeviceReading* r, size_t count, uint32_t now_ms, uint8_t* buf, size_t cap) {
+    if (count == 0 || count > 255) return 0;
+    if (cap < TELEMETRY_BATCH_HEADER_SIZE + count * TELEMETRY_BATCH_SAMPLE_SIZE) return 0;
+
+    uint8_t* p = buf;
+    *p++ = TELEMETRY_BATCH_VERSION;
+    *p++ = (uint8_t)count;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t age_ms = now_ms - r[i].capturedMs;
+        memcpy(p, &age_ms, sizeof(age_ms));
+        p += sizeof(age_ms);
+        *p++ = r[i].relayOn ? TELEMETRY_FLAG_RELAY_ON : 0;
+        p = put_f32(p, (float)r[i].energyIncrement);
+        p = put_f32(p, (float)r[i].voltage);
+        p = put_f32(p, (float)r[i].current);
+        p = put_f32(p, (float)r[i].power);
+        p = put_stats(p, r[i].stats);
+        p = put_f64(p, r[i].lifetimeKwh);
+        p = put_identity(p, r[i]);
+    }
+    return p - buf;
+}
+
+size_t encode_reading(TelemetryFormat fmt, const DeviceReading& r, const char* deviceName, uint8_t* buf, size_t cap) {
+    if (fmt == TelemetryFormat::binary) return encode_reading_binary(r, buf, cap);
+    return encode_reading_json(r, deviceName, (char*)buf, cap);
+}
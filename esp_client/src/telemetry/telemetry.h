@@ -0,0 +1,112 @@
+#pragma once
+#include <Arduino.h>
+
+/*
+  Report payload encodings for "<cid>/data".
+
+  json   : {"energyIncrement":..,"lifetimeKwh":..,"voltage":..,"current":..,"deviceName":..,"power":..,
+            "boot":..,"seq":..,"ts":..,"stats":{"n":..,"min":..,"max":..,"mean":..,"var":..,"p95":..}}
+           The original format, kept for devices that haven't been switched over.
+           "stats" is left out when no measurement window closed in the interval,
+           "ts" when the capture time is unknown (see reading_clock.h).
+
+  binary : versioned fixed layout, little-endian, no device name (the topic already carries it).
+           The backend tells the two apart by the first byte: '{' is JSON, anything else is a version.
+
+     v1 (18 bytes), no longer sent
+       off size field
+       0   1    version          = 1
+       1   1    flags            bit0 = relay on
+       2   4    energyIncrement  f32, kWh since the last report
+       6   4    voltage          f32, V
+       10  4    current          f32, A
+       14  4    power            f32, W
+
+     v2 batch (2 + 21 * count bytes), no longer sent
+       0   1    version          = 2
+       1   1    count            samples that follow, oldest first
+       then per sample:
+       +0  4    age_ms           u32, how long before the publish the sample was taken
+       +4  1    flags            as v1
+       +5  4    energyIncrement  f32, kWh since the previous sample
+       +9  4    voltage          f32, V
+       +13 4    current          f32, A
+       +17 4    power            f32, W
+
+     stats block (22 bytes): power over the report's measurement windows (see window_stats.h)
+       +0  2    windows          u16, 0 = no window closed (the rest is 0 too)
+       +2  4    min              f32, W
+       +6  4    max              f32, W
+       +10 4    mean             f32, W
+       +14 4    var              f32, W^2 (population)
+       +18 4    p95              f32, W (P-square estimate)
+
+     v3 (40 bytes), no longer sent: v1 followed by the stats block at 18
+     v4 batch (2 + 43 * count bytes), no longer sent: v2 with the stats block at +21 of every sample
+
+     v5 (48 bytes), no longer sent: v3 followed by
+       40  8    lifetimeKwh      f64, kWh metered since first boot (energy_register.h), monotonic
+     v6 batch (2 + 51 * count bytes), no longer sent: v4 with lifetimeKwh (f64) at +43 of every sample
+
+     identity block (16 bytes): which reading this is and when it was taken (see reading_clock.h)
+       +0  4    boot             u32, boot ID
+       +4  4    seq              u32, per-boot sequence number, from 1
+       +8  8    unix_ms          u64, UTC capture time in ms, 0 = unknown
+
+     v7 (64 bytes): v5 followed by the identity block at 48
+     v8 batch (2 + 67 * count bytes): v6 with the identity block at +51 of every sample;
+        sent by binary devices with batching enabled (see report_batch.h)
+
+  (boot, seq) is unique per device, so the backend drops re-sent readings by it.
+
+  Any change to the layout bumps the version; decoders must keep accepting older ones.
+*/
+
+enum class TelemetryFormat : uint8_t { json = 0, binary = 1 };
+
+constexpr size_t TELEMETRY_BINARY_V1_SIZE = 18;
+constexpr size_t TELEMETRY_BATCH_HEADER_SIZE = 2;
+constexpr size_t TELEMETRY_BATCH_V2_SAMPLE_SIZE = 21;
+constexpr size_t TELEMETRY_STATS_SIZE = 22;
+
+constexpr size_t TELEMETRY_LIFETIME_SIZE = 8;
+constexpr size_t TELEMETRY_IDENTITY_SIZE = 16;
+
+constexpr uint8_t TELEMETRY_BINARY_VERSION = 7;
+constexpr size_t TELEMETRY_BINARY_V5_SIZE = TELEMETRY_BINARY_V1_SIZE + TELEMETRY_STATS_SIZE + TELEMETRY_LIFETIME_SIZE;
+constexpr size_t TELEMETRY_BINARY_SIZE = TELEMETRY_BINARY_V5_SIZE + TELEMETRY_IDENTITY_SIZE;
+constexpr uint8_t TELEMETRY_BATCH_VERSION = 8;
+constexpr size_t TELEMETRY_BATCH_V6_SAMPLE_SIZE = TELEMETRY_BATCH_V2_SAMPLE_SIZE + TELEMETRY_STATS_SIZE + TELEMETRY_LIFETIME_SIZE;
+constexpr size_t TELEMETRY_BATCH_SAMPLE_SIZE = TELEMETRY_BATCH_V6_SAMPLE_SIZE + TELEMETRY_IDENTITY_SIZE;
+
+constexpr uint8_t TELEMETRY_FLAG_RELAY_ON = 0x01;
+
+struct PowerStats {
+    uint16_t windows;      // measurement windows summarised; 0 = none
+    float min;
+    float max;
+    float mean;
+    float var;
+    float p95;
+};
+
+struct DeviceReading {
+    double energyIncrement;
+    int voltage;
+    double current;
+    double power;
+    bool relayOn;
+    uint32_t capturedMs;   // millis() when the sample was taken
+    PowerStats stats;      // power over the interval's measurement windows
+    double lifetimeKwh;    // energy register after this reading's increment
+    uint32_t bootId;       // reading_clock.h; 0 before it's stamped
+    uint32_t seq;
+    uint64_t unixMs;       // UTC capture time, 0 = unknown
+};
+
+TelemetryFormat parse_telemetry_format(const char* value);
+const char* telemetry_format_name(TelemetryFormat fmt);
+size_t encode_reading_json(const DeviceReading& r, const char* deviceName, char* buf, size_t cap);
+size_t encode_reading_binary(const DeviceReading& r, uint8_t* buf, size_t cap);
+size_t encode_batch_binary(const DeviceReading* r, size_t count, uint32_t now_ms, uint8_t* buf, size_t cap);
+size_t encode_reading(TelemetryFormat fmt, const DeviceReading& r, const char* deviceName, uint8_t* buf, size_t cap);
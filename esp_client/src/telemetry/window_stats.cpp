@@ -0,0 +1,107 @@
+#include "window_stats.h"
+
+// Increments of the desired marker positions per observation.
+static constexpr float P = WINDOW_STATS_PERCENTILE / 100.0f;
+static const float DNP[5] = { 0.0f, P / 2, P, (1.0f + P) / 2, 1.0f };
+
+void window_stats_reset(WindowStats& s) {
+    s = {};
+}
+
+static void sort_small(float* v, size_t n) {
+    for (size_t i = 1; i < n; i++) {
+        float x = v[i];
+        size_t j = i;
+        for (; j > 0 && v[j - 1] > x; j--) v[j] = v[j - 1];
+        v[j] = x;
+    }
+}
+
+static float parabolic(const WindowStats& s, int i, int d) {
+    const float* q = s.q;
+    const int32_t* n = s.n;
+    return q[i] + (float)d / (n[i + 1] - n[i - 1]) *
+        ((n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+         (n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+}
+
+static void p2_add(WindowStats& s, float x) {
+    // The first five observations just fill the markers.
+    if (s.count <= 5) {
+        s.q[s.count - 1] = x;
+        if (s.count == 5) {
+            sort_small(s.q, 5);
+            for (int i = 0; i < 5; i++) {
+                s.n[i] = i;
+                s.np[i] = 4 * DNP[i];
+            }
+        }
+        return;
+    }
+
+    int k;
+    if (x < s.q[0])       { s.q[0] = x; k = 0; }
+    else if (x < s.q[1])  k = 0;
+    else if (x < s.q[2])  k = 1;
+    else if (x < s.q[3])  k = 2;
+    else if (x <= s.q[4]) k = 3;
+    else                  { s.q[4] = x; k = 3; }
+
+    for (int i = k + 1; i < 5; i++) s.n[i]++;
+    for (int i = 0; i < 5; i++) s.np[i] += DNP[i];
+
+    // Nudge the middle markers toward their desired positions.
+    for (int i = 1; i <= 3; i++) {
+        float d = s.np[i] - s.n[i];
+        if ((d >= 1.0f && s.n[i + 1] - s.n[i] > 1) || (d <= -1.0f && s.n[i - 1] - s.n[i] < -1)) {
+            int step = d > 0 ? 1 : -1;
+            float h = parabolic(s, i, step);
+            if (!(s.q[i - 1] < h && h < s.q[i + 1]))
+                h = s.q[i] + step * (s.q[i + step] - s.q[i]) / (s.n[i + step] - s.n[i]);
+            s.q[i] = h;
+            s.n[i] += step;
+        }
+    }
+}
+
+static void top_add(WindowStats& s, float x) {
+    size_t held = s.count < WINDOW_STATS_TOP ? s.count : WINDOW_STATS_TOP;   // before this one
+    if (held == WINDOW_STATS_TOP && x <= s.top[held - 1]) return;
+    size_t i = held < WINDOW_STATS_TOP ? held : held - 1;
+    for (; i > 0 && s.top[i - 1] < x; i--) s.top[i] = s.top[i - 1];
+    s.top[i] = x;
+}
+
+void window_stats_add(WindowStats& s, float x) {
+    top_add(s, x);
+    s.count++;
+    if (s.count == 1) {
+        s.min = s.max = s.mean = x;
+        s.m2 = 0.0f;
+    } else {
+        if (x < s.min) s.min = x;
+        if (x > s.max) s.max = x;
+        float delta = x - s.mean;
+        s.mean += delta / s.count;
+        s.m2 += delta * (x - s.mean);
+    }
+    p2_add(s, x);
+}
+
+// Nearest rank of the percentile, counted from the largest (1 = max).
+static uint32_t rank_from_top(uint32_t n) {
+    return n - (WINDOW_STATS_PERCENTILE * n + 99) / 100 + 1;
+}
+
+PowerStats window_stats_summary(const WindowStats& s) {
+    PowerStats p = {};
+    if (s.count == 0) return p;
+    p.windows = s.count > UINT16_MAX ? UINT16_MAX : (uint16_t)s.count;
+    p.min = s.min;
+    p.max = s.max;
+    p.mean = s.mean;
+    p.var = s.m2 / s.count;
+    uint32_t r = rank_from_top(s.count);
+    p.p95 = r <= WINDOW_STATS_TOP ? s.top[r - 1] : s.q[2];
+    return p;
+}
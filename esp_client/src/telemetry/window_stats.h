@@ -0,0 +1,37 @@
+#pragma once
+#include "telemetry.h"
+
+/*
+  Streaming statistics over the measurement windows of one report interval.
+
+  hardwareTask adds every window's power as it is measured; the report takes
+  a PowerStats summary and resets. Memory is constant (~100 B) whatever the
+  interval length:
+    - min / max exactly
+    - mean / variance with Welford's update (no sum-of-squares cancellation)
+    - p95 exactly (nearest rank) from the WINDOW_STATS_TOP largest windows while
+      that is enough, i.e. up to 159 windows: a 3 s report has 6, a minute 120
+    - past that, the P-square estimator (Jain & Chlamtac): five markers whose
+      heights track the quantile, fed from the first window on
+*/
+
+constexpr uint32_t WINDOW_STATS_PERCENTILE = 95;
+constexpr size_t WINDOW_STATS_TOP = 8;
+
+struct WindowStats {
+    uint32_t count;
+    float min;
+    float max;
+    float mean;
+    float m2;              // sum of squared deviations from the running mean
+    float top[WINDOW_STATS_TOP];   // largest values, descending
+
+    // P-square markers: heights, actual and desired positions (0-based)
+    float q[5];
+    int32_t n[5];
+    float np[5];
+};
+
+void window_stats_reset(WindowStats& s);
+void window_stats_add(WindowStats& s, float x);
+PowerStats window_stats_summary(const WindowStats& s);
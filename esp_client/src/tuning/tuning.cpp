@@ -0,0 +1,64 @@
+#include "tuning.h"
+#include "../checksum/crc32.h"
+#include <Preferences.h>
+
+static const char* const NVS_NAMESPACE = "tune";
+static const char* const K_BLOB = "cfg";
+
+// Plain bytes, so the blob stays trivially copyable whatever Tuning's initializers.
+struct TuningBlob {
+    uint16_t version;
+    uint16_t size;                    // sizeof(Tuning) when written
+    uint8_t tuning[sizeof(Tuning)];
+    uint32_t crc;                     // CRC-32 of every byte above
+};
+
+static TuningStats g_stats = {};
+
+static uint32_t blob_crc(const TuningBlob& b) {
+    return crc32((const uint8_t*)&b, offsetof(TuningBlob, crc));
+}
+
+Tuning tuning_load() {
+    TuningBlob b;
+    Preferences p;
+    p.begin(NVS_NAMESPACE, true);
+    size_t got = p.getBytes(K_BLOB, &b, sizeof(b));
+    p.end();
+
+    Tuning t;
+    g_stats.restored = got == sizeof(b) && b.version == TUNING_BLOB_VERSION && b.size == sizeof(Tuning) &&
+                       b.crc == blob_crc(b);
+    if (g_stats.restored) {
+        memcpy(&t, b.tuning, sizeof(Tuning));
+        g_stats.restored = t.band_count <= CURRENT_CAL_BANDS_MAX;
+    }
+    return g_stats.restored ? t : Tuning{};
+}
+
+bool tuning_save(const Tuning& t) {
+    TuningBlob b{};
+    b.version = TUNING_BLOB_VERSION;
+    b.size = sizeof(Tuning);
+    memcpy(b.tuning, &t, sizeof(Tuning));
+    b.crc = blob_crc(b);
+
+    Preferences p;
+    p.begin(NVS_NAMESPACE, false);
+    bool ok = p.putBytes(K_BLOB, &b, sizeof(b)) == sizeof(b);
+    p.end();
+    if (ok) g_stats.saves++;
+    else g_stats.failed++;
+    return ok;
+}
+
+void tuning_clear() {
+    Preferences p;
+    p.begin(NVS_NAMESPACE, false);
+    p.clear();
+    p.end();
+}
+
+const TuningStats& tuning_stats() {
+    return g_stats;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <Arduino.h>
+#include "../telemetry/report_policy.h"
+#include "../hardware_config/current_sensor/metering_math.h"
+
+/*
+  Runtime tuning: the settings the MQTT commands change (commands.h), kept in
+  NVS so they survive a reboot without reflashing or editing config.env.
+
+  - One CRC'd blob (namespace "tune", key "cfg"), the same layout rules as the
+    Env blob: a version and the struct size in front, so a firmware that
+    changes Tuning ignores an old blob instead of misreading it.
+  - Every field has an "unset" value that keeps the build / config.env
+    default, so a plug that was never tuned behaves exactly as before.
+  - hardwareTask applies commands and saves once per wake that changed
+    something; commands are rare, so this is a handful of NVS writes, not a
+    steady wear source.
+  - "tune/reset" erases the blob; the defaults come back at the next boot.
+*/
+
+#ifndef DEFAULT_REPORT_INTERVAL_MS
+#define DEFAULT_REPORT_INTERVAL_MS 3000   // report interval of an untuned plug
+#endif
+
+constexpr uint16_t TUNING_BLOB_VERSION = 2;   // 2: diag_period_s
+
+struct Tuning {
+    uint32_t interval_ms = 0;      // report interval; 0: DEFAULT_REPORT_INTERVAL_MS
+    uint32_t window_ms = 0;        // measurement window; 0: the backend's default
+    float cal_gain = 0.0f;         // current gain on the build-time calibration; 0: 1
+    float cal_offset_a = -1.0f;    // HLW8012 base offset; < 0: the build-time one
+    uint8_t band_count = 0;        // 0: the built-in calibration bands
+    CurrentCalBand bands[CURRENT_CAL_BANDS_MAX] = {};
+    bool has_policy = false;       // policy overrides REPORT_MODE / DEADBAND_* / HEARTBEAT_S
+    ReportPolicy policy = {};
+    int32_t diag_period_s = -1;    // periodic diag message; < 0: DIAG_PERIOD_S, 0: off
+};
+
+struct TuningStats {
+    bool restored;        // a valid blob was found at boot
+    uint32_t saves;       // NVS writes since boot
+    uint32_t failed;      // writes that did not complete
+};
+
+Tuning tuning_load();
+bool tuning_save(const Tuning& t);
+void tuning_clear();
+const TuningStats& tuning_stats();
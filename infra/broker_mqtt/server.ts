@@ -1,4 +1,4 @@
-import { broker, publish_to_topic } from './server_conf'
+import { broker, isLoadtestClient, publish_to_topic } from './server_conf'
 import { Client, PublishPacket } from 'aedes'
 
 /* START: General Purpose MQTT functions */
@@ -7,10 +7,12 @@ const test_payload = "Test test payload"
 
 broker.on('client', (client: Client) => {
 	const username = client['username']
-	console.log(`Client: ${username}, connected`)
+	if (!isLoadtestClient(username)) console.log(`Client: ${username}, connected`)
 })
 
 broker.on('publish', (packet: PublishPacket, client: Client | null) => {
+	// A load test publishes thousands of messages a second: no per-message log or test echo.
+	if (client && isLoadtestClient(client['username'])) return
 	if (client) {
 		console.log(`Recieved message\nTopic: ${packet.topic}\nPayload: ${packet.payload.toString()}`)
 	}
@@ -15,15 +15,33 @@ server.listen(1883, '0.0.0.0', () => {
 // That creates a unique client code, i.e: Hard set creds before MCU flash.
 // Also creates a new entry in our device db. That adds to the ACL bellow.
 const clients = {
-	'zot_plug_000001': { password: 'secret01', allowedPublish: ['zot_plug_000001/data'], allowedSubscribe: ['zot_plug_000001/cmd/#'] },
-	'zot_plug_000002': { password: 'secret02', allowedPublish: ['zot_plug_000002/data'], allowedSubscribe: ['zot_plug_000002/cmd/#'] },
-	'zot_plug_000003': { password: 'secret03', allowedPublish: ['zot_plug_000003/data'], allowedSubscribe: ['zot_plug_000003/cmd/#'] },
-	'zot_plug_000004': { password: 'secret04', allowedPublish: ['zot_plug_000004/data'], allowedSubscribe: ['zot_plug_000004/cmd/#'] },
-	'zot_plug_000005': { password: 'secret05', allowedPublish: ['zot_plug_000005/data'], allowedSubscribe: ['zot_plug_000005/cmd/#'] },
-	'api': { password: 'apipass', allowedPublish: ['+/cmd/#'], allowedSubscribe: ['+/data'] },
+	'zot_plug_000001': { password: 'secret01', allowedPublish: ['zot_plug_000001/data', 'zot_plug_000001/diag', 'zot_plug_000001/ack'], allowedSubscribe: ['zot_plug_000001/cmd/#'] },
+	'zot_plug_000002': { password: 'secret02', allowedPublish: ['zot_plug_000002/data', 'zot_plug_000002/diag', 'zot_plug_000002/ack'], allowedSubscribe: ['zot_plug_000002/cmd/#'] },
+	'zot_plug_000003': { password: 'secret03', allowedPublish: ['zot_plug_000003/data', 'zot_plug_000003/diag', 'zot_plug_000003/ack'], allowedSubscribe: ['zot_plug_000003/cmd/#'] },
+	'zot_plug_000004': { password: 'secret04', allowedPublish: ['zot_plug_000004/data', 'zot_plug_000004/diag', 'zot_plug_000004/ack'], allowedSubscribe: ['zot_plug_000004/cmd/#'] },
+	'zot_plug_000005': { password: 'secret05', allowedPublish: ['zot_plug_000005/data', 'zot_plug_000005/diag', 'zot_plug_000005/ack'], allowedSubscribe: ['zot_plug_000005/cmd/#'] },
+	'api': { password: 'apipass', allowedPublish: ['+/cmd/#'], allowedSubscribe: ['+/data', '+/ack'] },
 	'admin': { password: 'adminpass', allowedPublish: ['#'], allowedSubscribe: ['#'] },  // full access
 }
 
+// Load-test plugs (esp_client/host/fleet): any "<LOADTEST_PREFIX><name>" client, all
+// with LOADTEST_PASSWORD, each confined to its own topics like the plugs above.
+// Off unless LOADTEST_PASSWORD is set.
+const LOADTEST_PASSWORD = process.env.LOADTEST_PASSWORD ?? ''
+const LOADTEST_PREFIX = process.env.LOADTEST_PREFIX ?? 'loadtest_'
+
+export function isLoadtestClient(username?: string | null) {
+	return !!LOADTEST_PASSWORD && !!username && username.startsWith(LOADTEST_PREFIX) && !(username in clients)
+}
+
+function lookupUser(username?: string | null) {
+	if (!username) return undefined
+	if (isLoadtestClient(username)) {
+		return { password: LOADTEST_PASSWORD, allowedPublish: [`${username}/data`, `${username}/diag`, `${username}/ack`], allowedSubscribe: [`${username}/cmd/#`] }
+	}
+	return clients[username]
+}
+
 function topicAllowed(topic: string, allowedTopics: string[]) {
 	return allowedTopics.some(allowed => matches(allowed, topic))
 }
@@ -34,9 +52,9 @@ broker.authenticate = (client, username, password, callback) => {
 		return callback(null, false)
 	}
 
-	const user = clients[username]
+	const user = lookupUser(username)
 	if (user && password?.toString() === user.password) {
-		console.log(`Client: ${username}, authenticated`)
+		if (!isLoadtestClient(username)) console.log(`Client: ${username}, authenticated`)
 		client['username'] = username  // store username for later ACL checks
 		return callback(null, true)
 	}
@@ -47,7 +65,7 @@ broker.authenticate = (client, username, password, callback) => {
 
 broker.authorizePublish = (client, packet, callback) => {
 	const username = client ? client['username'] : null
-	const user = clients[username]
+	const user = lookupUser(username)
 
 	if (user && topicAllowed(packet.topic, user.allowedPublish)) {
 		// You can also mutate the packet (e.g., enforce retain=false)
@@ -61,7 +79,7 @@ broker.authorizePublish = (client, packet, callback) => {
 
 broker.authorizeSubscribe = (client, sub, callback) => {
 	const username = client['username']
-	const user = clients[username]
+	const user = lookupUser(username)
 
 	if (user && topicAllowed(sub.topic, user.allowedSubscribe)) {
 		return callback(null, sub)
@@ -0,0 +1,161 @@
+import pool from './pg_db/db_config'
+
+/*
+ * Incremental energy aggregation, run every few minutes.
+ *
+ * 1. Fold the power_readings rows ingested since the last run (aggregation_watermarks,
+ *    on ingested_at) into device_energy_hourly, bucketed by the hour they were recorded in,
+ *    so late and backlogged readings land in their own hour.
+ * 2. Recompute the daily, weekly and monthly device_energy_stats rows those hours belong
+ *    to, from the hourly rows (never the raw table).
+ * 3. Partition upkeep: create the coming months of power_readings, and with
+ *    READINGS_RETENTION_MONTHS drop the raw partitions older than that.
+ *
+ * Energy per period is MAX - MIN cumulative energy over the period, as the nightly job
+ * computed it; readings with window stats contribute their window mean (weighted by window
+ * count) and window max, older readings their snapshot power.
+ *
+ * Only rows ingested more than SETTLE behind now are folded, so a transaction that was
+ * still open when the job started isn't skipped once its rows commit.
+ */
+
+const JOB = 'energy_hourly'
+const SETTLE = '1 minute'
+const PARTITIONS_AHEAD = 2
+const RETENTION_MONTHS = Number(process.env.READINGS_RETENTION_MONTHS ?? 0)     // 0: keep everything
+
+const PERIODS = [
+    { type: 'daily', trunc: 'day', length: '1 day' },
+    { type: 'weekly', trunc: 'week', length: '1 week' },
+    { type: 'monthly', trunc: 'month', length: '1 month' },
+] as const
+
+async function aggregateEnergy() {
+    const client = await pool.connect()
+    try {
+        await client.query('BEGIN')
+        // one run at a time; a slow run makes the next one wait instead of double-folding
+        await client.query(`SELECT pg_advisory_xact_lock(hashtext($1))`, [JOB])
+
+        const { rows: [window] } = await client.query<{ from_ts: string, to_ts: string }>(`
+            SELECT
+                COALESCE((SELECT watermark FROM aggregation_watermarks WHERE job = $1), '-infinity'::timestamp)::text AS from_ts,
+                (clock_timestamp() - $2::interval)::timestamp::text AS to_ts
+        `, [JOB, SETTLE])     // as text: round-tripping TIMESTAMP through JS Dates shifts it by the client's zone
+
+        // 1. new rows -> their hours; returns the (device, day) pairs touched
+        const { rows: touched } = await client.query<{ device_id: number, day: string }>(`
+            WITH fresh AS (
+                SELECT
+                    device_id,
+                    date_trunc('hour', recorded_at) AS hour_start,
+                    MIN(cumulative_energy) AS min_cumulative,
+                    MAX(cumulative_energy) AS max_cumulative,
+                    SUM(COALESCE(power_mean, power) * COALESCE(window_count, 1)) AS power_sum,
+                    SUM(COALESCE(window_count, 1)) AS power_windows,
+                    MAX(COALESCE(power_max, power)) AS max_power,
+                    COUNT(*) AS reading_count
+                FROM power_readings
+                WHERE ingested_at >= $1::timestamp AND ingested_at < $2::timestamp
+                    AND device_id IS NOT NULL AND cumulative_energy IS NOT NULL
+                GROUP BY device_id, hour_start
+            ),
+            folded AS (
+                INSERT INTO device_energy_hourly AS h (
+                    device_id, hour_start, min_cumulative, max_cumulative,
+                    power_sum, power_windows, max_power, reading_count, updated_at
+                )
+                SELECT device_id, hour_start, min_cumulative, max_cumulative,
+                    COALESCE(power_sum, 0), power_windows, COALESCE(max_power, 0), reading_count, NOW()
+                FROM fresh
+                ON CONFLICT (device_id, hour_start) DO UPDATE SET
+                    min_cumulative = LEAST(h.min_cumulative, EXCLUDED.min_cumulative),
+                    max_cumulative = GREATEST(h.max_cumulative, EXCLUDED.max_cumulative),
+                    power_sum = h.power_sum + EXCLUDED.power_sum,
+                    power_windows = h.power_windows + EXCLUDED.power_windows,
+                    max_power = GREATEST(h.max_power, EXCLUDED.max_power),
+                    reading_count = h.reading_count + EXCLUDED.reading_count,
+                    updated_at = EXCLUDED.updated_at
+                RETURNING h.device_id, h.hour_start
+            )
+            SELECT DISTINCT device_id, hour_start::date::text AS day FROM folded
+        `, [window.from_ts, window.to_ts])
+
+        // 2. roll the touched periods up from their hours
+        if (touched.length > 0) {
+            const deviceIds = touched.map(t => t.device_id)
+            const days = touched.map(t => t.day)
+            for (const period of PERIODS) {
+                await client.query(`
+                    WITH periods AS (
+                        SELECT DISTINCT t.device_id, date_trunc($2, t.day::timestamp)::date AS period_start
+                        FROM unnest($3::int[], $4::date[]) AS t(device_id, day)
+                    )
+                    INSERT INTO device_energy_stats (
+                        device_id, period_type, period_start, total_energy, avg_power, max_power, updated_at
+                    )
+                    SELECT
+                        p.device_id,
+                        $1 AS period_type,
+                        p.period_start,
+                        GREATEST(MAX(h.max_cumulative) - MIN(h.min_cumulative), 0) AS total_energy,
+                        COALESCE(SUM(h.power_sum) / NULLIF(SUM(h.power_windows), 0), 0) AS avg_power,
+                        MAX(h.max_power) AS max_power,
+                        NOW() AS updated_at
+                    FROM periods p
+                    JOIN device_energy_hourly h
+                        ON h.device_id = p.device_id
+                        AND h.hour_start >= p.period_start
+                        AND h.hour_start < p.period_start + $5::interval
+                    GROUP BY p.device_id, p.period_start
+                    ON CONFLICT (device_id, period_type, period_start)
+                    DO UPDATE SET
+                        total_energy = EXCLUDED.total_energy,
+                        avg_power = EXCLUDED.avg_power,
+                        max_power = EXCLUDED.max_power,
+                        updated_at = EXCLUDED.updated_at
+                `, [period.type, period.trunc, deviceIds, days, period.length])
+            }
+        }
+
+        await client.query(`
+            INSERT INTO aggregation_watermarks (job, watermark, updated_at)
+            VALUES ($1, $2::timestamp, NOW())
+            ON CONFLICT (job) DO UPDATE SET watermark = EXCLUDED.watermark, updated_at = EXCLUDED.updated_at
+        `, [JOB, window.to_ts])
+
+        await client.query('COMMIT')
+        console.log(`[AGG] folded ${touched.length} device-days up to ${window.to_ts}`)
+
+    } catch (err) {
+        await client.query('ROLLBACK')
+        throw err
+
+    } finally {
+        client.release()
+    }
+
+    // 3. partitions: outside the fold's transaction, DDL takes its own locks
+    await pool.query(`SELECT ensure_power_readings_partitions($1)`, [PARTITIONS_AHEAD])
+    if (RETENTION_MONTHS > 0) {
+        // only months the hourly rollup has already folded
+        const { rows } = await pool.query(`
+            SELECT drop_power_readings_before(LEAST(
+                date_trunc('month', NOW()) - make_interval(months => $1),
+                (SELECT watermark FROM aggregation_watermarks WHERE job = $2)
+            )::timestamp) AS dropped
+        `, [RETENTION_MONTHS, JOB])
+        for (const r of rows) if (r.dropped) console.log(`[AGG] retention: dropped ${r.dropped}`)
+    }
+}
+
+aggregateEnergy()
+    .then(async () => {
+        await pool.end()
+        process.exit(0)
+    })
+    .catch(async (err) => {
+        console.error('Error aggregating energy:', err)
+        await pool.end()
+        process.exit(1)
+    })
@@ -195,16 +195,111 @@ CREATE TABLE IF NOT EXISTS device_registration_info (
 -- =========================================================
 -- POWER_READINGS
 -- Stores real-time and historical power usage metrics per device.
+-- Range-partitioned by month on recorded_at: retention drops whole partitions
+-- (drop_power_readings_before), and time-bounded queries only touch the months
+-- they cover. Partitions are created ahead by ensure_power_readings_partitions(),
+-- called below and by the aggregation job (cron/aggregateEnergy.ts).
 -- =========================================================
 DROP TABLE IF EXISTS power_readings CASCADE;
 CREATE TABLE IF NOT EXISTS power_readings (
-  id BIGSERIAL PRIMARY KEY,                                                   -- Metric entry ID
+  id BIGSERIAL,                                                               -- Metric entry ID
   device_id INTEGER REFERENCES devices(id) ON DELETE CASCADE,                 -- FK to device
   voltage FlOAT CHECK (voltage >= 0),                                         -- Measured voltage (V)
   current FLOAT CHECK (current >= 0),                                         -- Measured current (A)
   power FLOAT CHECK (power >= 0),                                             -- Instantaneous power (W)
   cumulative_energy FLOAT DEFAULT 0 CHECK (cumulative_energy >= 0),           -- Cumulative energy (kWh)
-  recorded_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP                             -- When the reading was taken
+  recorded_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,                   -- When the reading was taken (partition key)
+  ingested_at TIMESTAMP NOT NULL DEFAULT clock_timestamp(),                   -- When the row was stored (aggregation watermark)
+  -- Power over the device's measurement windows since its previous report; NULL from older firmware
+  window_count INTEGER CHECK (window_count > 0),                              -- Windows summarised
+  power_min FLOAT,                                                            -- Lowest window power (W)
+  power_max FLOAT,                                                            -- Highest window power (W)
+  power_mean FLOAT,                                                           -- Mean window power (W)
+  power_var FLOAT CHECK (power_var >= 0),                                     -- Variance of window power (W^2)
+  power_p95 FLOAT,                                                            -- 95th percentile window power (W)
+  lifetime_energy FLOAT CHECK (lifetime_energy >= 0),                         -- Device's own lifetime register (kWh); NULL from older firmware
+  boot_id BIGINT,                                                             -- Device boot ID; with seq, identifies the reading (NULL from older firmware)
+  seq BIGINT,                                                                 -- Per-boot sequence number of the reading
+  PRIMARY KEY (id, recorded_at)                                               -- Must include the partition key
+) PARTITION BY RANGE (recorded_at);
+
+-- Readings outside every monthly partition (e.g. a device clock far off) land here.
+CREATE TABLE IF NOT EXISTS power_readings_default PARTITION OF power_readings DEFAULT;
+
+-- Monthly partitions "power_readings_YYYYMM" from the current month to months_ahead months out.
+CREATE OR REPLACE FUNCTION ensure_power_readings_partitions(months_ahead INTEGER DEFAULT 2)
+RETURNS VOID AS $$
+DECLARE
+  month_start DATE;
+BEGIN
+  FOR i IN 0..months_ahead LOOP
+    month_start := (date_trunc('month', CURRENT_DATE) + make_interval(months => i))::date;
+    BEGIN
+      EXECUTE format(
+        'CREATE TABLE IF NOT EXISTS %I PARTITION OF power_readings FOR VALUES FROM (%L) TO (%L)',
+        'power_readings_' || to_char(month_start, 'YYYYMM'), month_start, (month_start + INTERVAL '1 month')::date);
+    EXCEPTION WHEN check_violation THEN
+      -- rows for that month already sit in the default partition; leave them there
+      RAISE NOTICE 'power_readings: default partition holds rows for %, partition not created', month_start;
+    END;
+  END LOOP;
+END;
+$$ LANGUAGE plpgsql;
+
+-- Retention: drop the monthly partitions that end on or before cutoff. Returns the tables dropped.
+CREATE OR REPLACE FUNCTION drop_power_readings_before(cutoff TIMESTAMP)
+RETURNS SETOF TEXT AS $$
+DECLARE
+  part RECORD;
+BEGIN
+  FOR part IN
+    SELECT c.relname
+    FROM pg_inherits i
+    JOIN pg_class c ON c.oid = i.inhrelid
+    WHERE i.inhparent = 'power_readings'::regclass
+      AND c.relname ~ '^power_readings_[0-9]{6}$'
+      AND (to_date(right(c.relname, 6), 'YYYYMM') + INTERVAL '1 month') <= cutoff
+  LOOP
+    EXECUTE format('DROP TABLE %I', part.relname);
+    RETURN NEXT part.relname;
+  END LOOP;
+END;
+$$ LANGUAGE plpgsql;
+
+SELECT ensure_power_readings_partitions(2);
+
+
+-- =========================================================
+-- DEVICE_ENERGY_HOURLY
+-- Per device and hour, folded incrementally from new power_readings rows by the
+-- aggregation job. Kept as mergeable parts (min/max cumulative, weighted power sums)
+-- so late rows update their hour, and days/weeks/months roll up from these rows
+-- instead of the raw table.
+-- =========================================================
+DROP TABLE IF EXISTS device_energy_hourly CASCADE;
+CREATE TABLE IF NOT EXISTS device_energy_hourly (
+  device_id INTEGER REFERENCES devices(id) ON DELETE CASCADE,                 -- FK to device
+  hour_start TIMESTAMP NOT NULL,                                              -- date_trunc('hour', recorded_at)
+  min_cumulative FLOAT NOT NULL,                                              -- Lowest cumulative_energy in the hour (kWh)
+  max_cumulative FLOAT NOT NULL,                                              -- Highest cumulative_energy in the hour (kWh)
+  power_sum FLOAT NOT NULL DEFAULT 0,                                         -- Sum of window mean power x window count
+  power_windows BIGINT NOT NULL DEFAULT 0,                                    -- Sum of window counts (1 per reading without stats)
+  max_power FLOAT NOT NULL DEFAULT 0,                                         -- Peak window (or snapshot) power (W)
+  reading_count INTEGER NOT NULL DEFAULT 0,                                   -- Readings folded in
+  updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,                             -- Last fold
+  PRIMARY KEY (device_id, hour_start)
+);
+
+
+-- =========================================================
+-- AGGREGATION_WATERMARKS
+-- How far (in power_readings.ingested_at) each incremental job has folded.
+-- =========================================================
+DROP TABLE IF EXISTS aggregation_watermarks CASCADE;
+CREATE TABLE IF NOT EXISTS aggregation_watermarks (
+  job VARCHAR(64) PRIMARY KEY,                                                -- Job name
+  watermark TIMESTAMP NOT NULL,                                               -- Rows ingested before this are folded
+  updated_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP                              -- Last run
 );
 
 
@@ -362,12 +457,12 @@ CREATE INDEX idx_user_sessions_active
 -- =========================================================
 CREATE INDEX idx_power_device_time_desc 
   ON power_readings(device_id, recorded_at DESC);                            -- Fast retrieval of latest readings per device
-CREATE INDEX idx_power_recorded_at 
-  ON power_readings(recorded_at);                                            -- Global time-based queries or cleanup jobs
--- (Optional) For very large datasets, consider partitioning + BRIN on recorded_at
--- CREATE INDEX idx_power_recorded_at_brin ON power_readings USING BRIN (recorded_at);
-CREATE INDEX idx_power_device_time_energy
-  ON power_readings (device_id, recorded_at, cumulative_energy);               -- for 24h most used devices
+CREATE INDEX idx_power_recorded_at_brin
+  ON power_readings USING BRIN (recorded_at);                                -- Global time-based queries; tiny, rows arrive in time order
+CREATE INDEX idx_power_ingested_at_brin
+  ON power_readings USING BRIN (ingested_at);                                -- Incremental aggregation: rows since the watermark
+CREATE UNIQUE INDEX idx_power_device_boot_seq
+  ON power_readings(device_id, boot_id, seq, recorded_at);                   -- Replayed readings: dedupe lookups by (device, boot, seq); must include the partition key
 
 -- =========================================================
 -- ENERGY STATISTICS (aggregates)
@@ -376,6 +471,8 @@ CREATE UNIQUE INDEX idx_energy_device_period
   ON device_energy_stats(device_id, period_type, period_start);              -- Ensure one record per device per period
 CREATE INDEX idx_energy_period_type_start
   ON device_energy_stats(period_type, period_start);
+CREATE INDEX idx_energy_hourly_hour
+  ON device_energy_hourly(hour_start);                                       -- Recent hours across devices
 
 -- =========================================================
 -- DEVICE POLICIES
@@ -4,6 +4,7 @@ import {
     DeviceIdentifier,
     NewDevice, 
     NewReading, 
+    IncomingReading,
     EnergyStatsInput,
     UpdateDevice, 
     UpdateDeviceMetadata,
@@ -12,10 +13,12 @@ import {
     UsageSeriesPoint,
     MostUsedDevice,
     ResolvedRange,
-    UsageOverview
+    UsageOverview,
+    ReadingOutcome
 } from "./types/types";
 import { resolveDeviceId } from "./deviceResolver";
 import { Buffer } from "buffer";
+import type { PoolClient } from "pg";
 
 //=========================================================
 // HELPER FUNCTIONS
@@ -54,6 +57,49 @@ function resolveRange(range: TimeRange): ResolvedRange {
     }
 }
 
+/**
+ * Energy to add for a new reading. When both it and the previous row carry the device's
+ * lifetime register, the difference covers any reports lost in between; otherwise (older
+ * firmware, first reading, register reset by a reflash) fall back to the reported increment.
+ * So does a reading from another boot than the previous row: the register resumes at its
+ * NVS ceiling after a reset, up to ENERGY_REGISTER_LEASE_KWH above what was metered, and
+ * that gap must not be billed on every reboot.
+ */
+export function energySinceLatest(latest: { lifetime_energy?: number | null, boot_id?: number | null }, energyIncrement: number,
+    lifetimeEnergy?: number, bootId?: number): number {
+    if (typeof lifetimeEnergy !== 'number' || latest.lifetime_energy == null) return energyIncrement
+    if (typeof bootId === 'number' && latest.boot_id != null && bootId !== latest.boot_id) return energyIncrement
+    const delta = lifetimeEnergy - latest.lifetime_energy
+    return delta >= 0 ? delta : energyIncrement
+}
+
+// Latest stored reading of a device, the one the next reading's energy builds on.
+type ChainHead = {
+    cumulative_energy: number
+    lifetime_energy: number | null
+    boot_id: number | null
+    seq: number | null
+    recorded_ms: number
+}
+
+function hasReadingIdentity(r: IncomingReading): boolean {
+    return typeof r.bootId === 'number' && typeof r.seq === 'number'
+}
+
+/**
+ * Whether a reading was taken before the device's latest stored one of the same boot
+ * (a lower sequence number). Only for readings with identity and a lifetime register on
+ * both sides, so it can be placed by the register difference. Across boots the chain
+ * adds increments (energySinceLatest), so the latest row doesn't hold an older boot's
+ * backlog yet: that is chained like any other reading.
+ */
+function readingBehind(r: IncomingReading, head: ChainHead): boolean {
+    if (!hasReadingIdentity(r) || typeof r.lifetimeEnergy !== 'number') return false
+    if (head.boot_id === null || head.seq === null || head.lifetime_energy == null) return false
+    if (r.lifetimeEnergy > head.lifetime_energy) return false
+    return r.bootId === head.boot_id && r.seq! < head.seq
+}
+
 //=========================================================
 // READ
 //=========================================================
@@ -132,7 +178,7 @@ export async function getLatestReadings(identifier: DeviceIdentifier) {
     if (deviceId === null) return null
 
     const { rows } = await pool.query(
-        `SELECT voltage, current, power, cumulative_energy, recorded_at
+        `SELECT voltage, current, power, cumulative_energy, lifetime_energy, recorded_at
         FROM power_readings 
         WHERE device_id = $1 
         ORDER BY recorded_at DESC 
@@ -270,7 +316,7 @@ export async function getFaultyDevices(): Promise<any[]> {
  * - weekly/monthly: sum of daily totals from the last 7 or 30 days relative to CURRENT_DATE.
  * - Optional deviceId parameter filters to a single device; otherwise sums across all active devices for the user.
  * 
- * Note: Uses pre-aggregated daily totals from device_energy_stats, not raw hourly readings.
+ * Note: Uses pre-aggregated daily totals from device_energy_stats, not raw readings.
  */
 export async function getUsageOverview(
     userId: number,
@@ -281,7 +327,10 @@ export async function getUsageOverview(
             SELECT 
                 COALESCE(
                     SUM(des.total_energy)
-                    FILTER (WHERE des.period_start = (SELECT MAX(period_start) FROM device_energy_stats)),
+                    FILTER (WHERE des.period_start = (
+                        SELECT MAX(period_start) FROM device_energy_stats
+                        WHERE period_type = 'daily' AND period_start < CURRENT_DATE    -- today is still being folded in
+                    )),
                     0
                 ) AS daily,
                 
@@ -326,7 +375,7 @@ export async function getUsageOverview(
 
 /**
  * Fetch time-series energy usage for a user's devices.
- * For 24h: calculate hourly energy by taking the difference betwen max and min cumulative_energy within each hour (raw data).
+ * For 24h: hourly energy per device (max - min cumulative_energy within the hour) from device_energy_hourly.
  * For 7d/30d: use pre-aggregated daily/weekly totals from device_energy_stats.
  */
 export async function getUsageSeries(
@@ -348,28 +397,28 @@ export async function getUsageSeries(
                     ) AS bucket
                 ),
 
-                -- 2. Calculate energy used per hour. 
-                -- Since devices store cumulative energy, we compute energy in each hour as: 
-                -- max(cumulative_energy) - min(cumulative_energy)
+                -- 2. Energy used per hour, from the hourly rollup (cron/aggregateEnergy.ts, a few minutes behind).
+                -- Since devices store cumulative energy, a device's energy in an hour is
+                -- max(cumulative_energy) - min(cumulative_energy); the user's devices are summed.
                 energy AS (
                     SELECT
-                        DATE_TRUNC('hour', pr.recorded_at) AS bucket,
-                        MAX(pr.cumulative_energy) - MIN(pr.cumulative_energy) AS energy
-                    FROM power_readings pr
+                        h.hour_start AS bucket,
+                        SUM(h.max_cumulative - h.min_cumulative) AS energy
+                    FROM device_energy_hourly h
                     
                     -- Only include devices that belong to this user, active, and not deleted
                     JOIN user_device_map udm 
-                        ON pr.device_id = udm.device_id
+                        ON h.device_id = udm.device_id
                         AND udm.user_id = $1
                         AND udm.status = 'active'
                     JOIN devices d
-                        ON d.id = pr.device_id
+                        ON d.id = h.device_id
                         AND d.is_deleted = FALSE
                     
-                    -- Only look at last 24h of data
-                    WHERE pr.recorded_at >= NOW() - INTERVAL '24 hours'
+                    -- Only look at the 24 hourly buckets
+                    WHERE h.hour_start >= DATE_TRUNC('hour', NOW()) - INTERVAL '23 hours'
                         -- Optional filter: single device
-                        AND ($2::int IS NULL OR pr.device_id = $2)
+                        AND ($2::int IS NULL OR h.device_id = $2)
                     GROUP BY bucket
                 )
 
@@ -444,7 +493,7 @@ export async function getUsageSeries(
 
 /**
  * Fetch top energy-consuming devices for a user.
- * For 24h: compute energy from raw cumulative readings. 
+ * For 24h: compute energy from the hourly rollup (device_energy_hourly). 
  * For 7d/30d: sum pre-aggregated totals. 
  */
 export async function getMostUsedDevices(
@@ -459,21 +508,21 @@ export async function getMostUsedDevices(
                     d.id AS device_id,
                     d.name AS device_name,
 
-                    -- Calculate energy used in last 24h for each device as:
-                    MAX(pr.cumulative_energy) - MIN(pr.cumulative_energy) AS total_energy
-                FROM power_readings pr
+                    -- Calculate energy used in the last 24 hourly buckets for each device as:
+                    MAX(h.max_cumulative) - MIN(h.min_cumulative) AS total_energy
+                FROM device_energy_hourly h
 
                 -- Join device and user_device_map to filter only devices that belong to this user, active, and not deleted
                 JOIN devices d 
-                    ON d.id = pr.device_id
+                    ON d.id = h.device_id
                     AND d.is_deleted = FALSE
                 JOIN user_device_map udm 
                     ON udm.device_id = d.id
                     AND udm.user_id = $1
                     AND udm.status = 'active'
                 
-                -- Only consider last 24h of readings
-                WHERE pr.recorded_at >= NOW() - INTERVAL '24 hours'
+                -- Only consider the last 24 hours (whole hours, hourly rollup)
+                WHERE h.hour_start >= DATE_TRUNC('hour', NOW()) - INTERVAL '23 hours'
 
                 -- Compute total per device, highest energy first, and limit results (5)
                 GROUP BY d.id, d.name
@@ -601,7 +650,9 @@ export async function addReadings(payload: NewReading): Promise<any> {
         current, 
         power, 
         cumulativeEnergy, 
-        recordedAt 
+        lifetimeEnergy,
+        recordedAt,
+        stats
     } = payload
     
     const deviceId = await requireDeviceId(inputDeviceId, deviceName)
@@ -618,8 +669,9 @@ export async function addReadings(payload: NewReading): Promise<any> {
 
     // Insert values or default to zero
     const { rows } = await pool.query(`
-        INSERT INTO power_readings (device_id, voltage, current, power, cumulative_energy, recorded_at)
-        VALUES ($1, $2, $3, $4, $5, $6)
+        INSERT INTO power_readings (device_id, voltage, current, power, cumulative_energy, recorded_at,
+            window_count, power_min, power_max, power_mean, power_var, power_p95, lifetime_energy)
+        VALUES ($1, $2, $3, $4, $5, $6, $7, $8, $9, $10, $11, $12, $13)
         RETURNING *`, 
         [
             deviceId, 
@@ -627,7 +679,14 @@ export async function addReadings(payload: NewReading): Promise<any> {
             current ?? 0,
             power ?? 0,
             cumulativeEnergy ?? 0,
-            recordedAtVal
+            recordedAtVal,
+            stats?.n ?? null,
+            stats?.min ?? null,
+            stats?.max ?? null,
+            stats?.mean ?? null,
+            stats?.var ?? null,
+            stats?.p95 ?? null,
+            lifetimeEnergy ?? null
         ]
     )
 
@@ -666,6 +725,268 @@ export async function addReadings(payload: NewReading): Promise<any> {
 }
 
 
+const INSERT_READINGS = `
+    INSERT INTO power_readings (device_id, voltage, current, power, cumulative_energy, recorded_at,
+        window_count, power_min, power_max, power_mean, power_var, power_p95, lifetime_energy, boot_id, seq)
+    SELECT * FROM unnest($1::int[], $2::float8[], $3::float8[], $4::float8[], $5::float8[], $6::timestamp[],
+        $7::int[], $8::float8[], $9::float8[], $10::float8[], $11::float8[], $12::float8[], $13::float8[],
+        $14::bigint[], $15::bigint[])
+    ON CONFLICT DO NOTHING
+    RETURNING device_id, boot_id, seq
+`
+
+// A reading's power_readings columns, in INSERT_READINGS order.
+function readingRow(deviceId: number, r: IncomingReading, cumulativeEnergy: number, recordedMs: number): any[] {
+    const stats = r.stats && r.stats.n > 0 ? r.stats : undefined
+    return [
+        deviceId,
+        r.voltage ?? 0,
+        r.current ?? 0,
+        r.power ?? 0,
+        cumulativeEnergy,
+        new Date(recordedMs).toISOString(),
+        stats?.n ?? null,
+        stats?.min ?? null,
+        stats?.max ?? null,
+        stats?.mean ?? null,
+        stats?.var ?? null,
+        stats?.p95 ?? null,
+        typeof r.lifetimeEnergy === 'number' ? r.lifetimeEnergy : null,
+        hasReadingIdentity(r) ? r.bootId : null,
+        hasReadingIdentity(r) ? r.seq : null
+    ]
+}
+
+function toChainHead(r: any): ChainHead {
+    return {
+        cumulative_energy: r.cumulative_energy ?? 0,
+        lifetime_energy: r.lifetime_energy,
+        boot_id: r.boot_id === null ? null : Number(r.boot_id),
+        seq: r.seq === null ? null : Number(r.seq),
+        recorded_ms: r.recorded_ms,
+    }
+}
+
+/**
+ * Store a reading taken before the device's latest row whose energy that row doesn't
+ * hold yet (an older boot's backlog sent after the new boot's readings), at the time the
+ * device stamped it. It chains on its own boot's latest row, and every later row moves up
+ * by its energy, so the cumulative curve stays monotonic; the hourly rollups already
+ * folded from those rows (cron/aggregateEnergy.ts) move with them, under the job's lock.
+ * Returns whether the row was stored (false: a concurrent writer's copy was).
+ */
+async function insertPastReading(client: PoolClient, deviceId: number, r: IncomingReading, recordedMs: number): Promise<boolean> {
+    await client.query(`SELECT pg_advisory_xact_lock(hashtext('energy_hourly'))`)
+
+    let bootHead: ChainHead | undefined
+    if (hasReadingIdentity(r)) {
+        const { rows } = await client.query(`
+            SELECT cumulative_energy, lifetime_energy, boot_id, seq,
+                (EXTRACT(EPOCH FROM recorded_at) * 1000)::float8 AS recorded_ms
+            FROM power_readings
+            WHERE device_id = $1 AND boot_id = $2
+            ORDER BY seq DESC
+            LIMIT 1
+        `, [deviceId, r.bootId])
+        if (rows[0]) bootHead = toChainHead(rows[0])
+    }
+    const insert = async (cumulativeEnergy: number, ms: number) => {
+        const row = readingRow(deviceId, r, cumulativeEnergy, ms)
+        const { rows } = await client.query(INSERT_READINGS, row.map(v => [v]))
+        return rows.length > 0
+    }
+
+    // a later reading of its boot is stored already, and its lifetime difference covers this one
+    if (bootHead && readingBehind(r, bootHead)) {
+        return insert(Math.max(0, bootHead.cumulative_energy - (bootHead.lifetime_energy! - r.lifetimeEnergy!)),
+            Math.min(recordedMs, bootHead.recorded_ms))
+    }
+
+    const at = new Date(recordedMs).toISOString()
+    const { rows: [before] } = await client.query(`
+        SELECT cumulative_energy
+        FROM power_readings
+        WHERE device_id = $1 AND recorded_at <= $2::timestamp
+        ORDER BY recorded_at DESC, cumulative_energy DESC
+        LIMIT 1
+    `, [deviceId, at])
+    const energy = bootHead ? energySinceLatest(bootHead, r.energyIncrement, r.lifetimeEnergy, r.bootId) : r.energyIncrement
+    if (!await insert((before?.cumulative_energy ?? 0) + energy, recordedMs)) return false
+    if (!(energy > 0)) return true
+
+    await client.query(`
+        UPDATE power_readings
+        SET cumulative_energy = cumulative_energy + $3
+        WHERE device_id = $1 AND recorded_at > $2::timestamp
+    `, [deviceId, at, energy])
+    // later hours moved as a whole; the reading's own hour is refolded from the rows already in it
+    await client.query(`
+        UPDATE device_energy_hourly
+        SET min_cumulative = min_cumulative + $3, max_cumulative = max_cumulative + $3
+        WHERE device_id = $1 AND hour_start > date_trunc('hour', $2::timestamp)
+    `, [deviceId, at, energy])
+    await client.query(`
+        UPDATE device_energy_hourly h
+        SET min_cumulative = f.lo, max_cumulative = f.hi
+        FROM (
+            SELECT MIN(cumulative_energy) AS lo, MAX(cumulative_energy) AS hi
+            FROM power_readings
+            WHERE device_id = $1
+                AND recorded_at >= date_trunc('hour', $2::timestamp)
+                AND recorded_at < date_trunc('hour', $2::timestamp) + INTERVAL '1 hour'
+                AND ingested_at < (SELECT watermark FROM aggregation_watermarks WHERE job = 'energy_hourly')
+        ) f
+        WHERE h.device_id = $1 AND h.hour_start = date_trunc('hour', $2::timestamp) AND f.lo IS NOT NULL
+    `, [deviceId, at])
+    return true
+}
+
+/**
+ * Store a batch of device reports in one transaction: one lookup of the devices, of
+ * readings already stored and of the devices' latest rows, one multi-row INSERT (column
+ * arrays through unnest, so the batch size isn't bound by the parameter limit), one reset
+ * of empty_payload_count / is_faulty.
+ * Readings chain in the given order, each cumulative energy building on the previous
+ * reading of its device, as successive updateAllReadings calls would.
+ * Readings that carry bootId + seq are idempotent: one already stored (a replay, a QoS1
+ * redelivery) or repeated within the batch is skipped before it can add energy again,
+ * and one taken before the device's latest row of the same boot (store-and-forward
+ * backlog sent after fresher readings) is placed on that row's cumulative curve instead
+ * of added on top. Any other reading older than the device's latest row keeps its time
+ * and goes in through insertPastReading, after the batch.
+ * Returns what became of each input reading.
+ */
+export async function addReadingsBulk(readings: IncomingReading[]): Promise<ReadingOutcome[]> {
+    if (readings.length === 0) return []
+    const names = [...new Set(readings.map(r => r.deviceName.trim()))]
+
+    const client = await pool.connect()
+    try {
+        await client.query("BEGIN")
+
+        const { rows: devices } = await client.query<{ id: number, name: string }>(`
+            SELECT id, name
+            FROM devices
+            WHERE name = ANY($1::text[]) AND is_deleted = FALSE
+        `, [names])
+        const idByName = new Map(devices.map(d => [d.name, d.id]))
+        const deviceIds = devices.map(d => d.id)
+        const readingIds = readings.map(r => idByName.get(r.deviceName.trim()))
+
+        // identified readings already stored (idx_power_device_boot_seq)
+        const probe: [number[], number[], number[]] = [[], [], []]
+        readings.forEach((r, i) => {
+            const deviceId = readingIds[i]
+            if (deviceId === undefined || !hasReadingIdentity(r)) return
+            probe[0].push(deviceId)
+            probe[1].push(r.bootId!)
+            probe[2].push(r.seq!)
+        })
+        const seen = new Set<string>()
+        if (probe[0].length > 0) {
+            const { rows: existing } = await client.query(`
+                SELECT DISTINCT p.device_id, p.boot_id, p.seq
+                FROM unnest($1::int[], $2::bigint[], $3::bigint[]) AS k(device_id, boot_id, seq)
+                JOIN power_readings p USING (device_id, boot_id, seq)
+            `, probe)
+            for (const e of existing) seen.add(`${e.device_id}:${e.boot_id}:${e.seq}`)
+        }
+
+        // latest row per device: one index probe each (idx_power_device_time_desc)
+        const { rows: latestRows } = await client.query(`
+            SELECT d.id AS device_id, l.cumulative_energy, l.lifetime_energy, l.boot_id, l.seq, l.recorded_ms
+            FROM unnest($1::int[]) AS d(id)
+            CROSS JOIN LATERAL (
+                SELECT cumulative_energy, lifetime_energy, boot_id, seq,
+                    (EXTRACT(EPOCH FROM recorded_at) * 1000)::float8 AS recorded_ms
+                FROM power_readings
+                WHERE device_id = d.id
+                ORDER BY recorded_at DESC, cumulative_energy DESC
+                LIMIT 1
+            ) l
+        `, [deviceIds])
+        const latest = new Map<number, ChainHead>(latestRows.map(r => [r.device_id, toChainHead(r)]))
+
+        const now = Date.now()
+        const cols: any[][] = Array.from({ length: 15 }, () => [])
+        const rowReading: number[] = []      // input index of each row in cols
+        const past: { i: number, deviceId: number, recordedMs: number }[] = []
+        const outcomes = readings.map((r, i): ReadingOutcome => {
+            const deviceId = readingIds[i]
+            if (deviceId === undefined) return 'rejected'
+            if (hasReadingIdentity(r)) {
+                const key = `${deviceId}:${r.bootId}:${r.seq}`
+                if (seen.has(key)) return 'duplicate'
+                seen.add(key)
+            }
+
+            const prev = latest.get(deviceId) ?? { cumulative_energy: 0, lifetime_energy: null, boot_id: null, seq: null, recorded_ms: -Infinity }
+            let recordedMs = r.recordedAt ? new Date(r.recordedAt).getTime() : now
+            let cumulativeEnergy: number
+            if (readingBehind(r, prev)) {
+                // its energy is inside the latest row's lifetime difference already
+                cumulativeEnergy = Math.max(0, prev.cumulative_energy - (prev.lifetime_energy! - r.lifetimeEnergy!))
+                recordedMs = Math.min(recordedMs, prev.recorded_ms)
+            } else if (recordedMs < prev.recorded_ms) {
+                past.push({ i, deviceId, recordedMs })
+                return 'stored'
+            } else {
+                cumulativeEnergy = prev.cumulative_energy + energySinceLatest(prev, r.energyIncrement, r.lifetimeEnergy,
+                    hasReadingIdentity(r) ? r.bootId : undefined)
+                latest.set(deviceId, {
+                    cumulative_energy: cumulativeEnergy,
+                    lifetime_energy: typeof r.lifetimeEnergy === 'number' ? r.lifetimeEnergy : null,
+                    boot_id: r.bootId ?? null,
+                    seq: r.seq ?? null,
+                    recorded_ms: recordedMs,
+                })
+            }
+
+            readingRow(deviceId, r, cumulativeEnergy, recordedMs).forEach((v, c) => cols[c].push(v))
+            rowReading.push(i)
+            return 'stored'
+        })
+
+        const stored = new Set<number>()
+        if (cols[0].length > 0) {
+            // idx_power_device_boot_seq includes recorded_at (the partition key), so it only
+            // stops a concurrent writer's copy stamped with the same time; a redelivery with
+            // another arrival time is caught by the lookup above alone. Rows it did skip
+            // aren't returned, and are reported as duplicates.
+            const { rows: inserted } = await client.query(INSERT_READINGS, cols)
+            const keys = new Set(inserted.map(r => `${r.device_id}:${r.boot_id}:${r.seq}`))
+            rowReading.forEach((i, row) => {
+                if (cols[13][row] !== null && !keys.has(`${cols[0][row]}:${cols[13][row]}:${cols[14][row]}`)) outcomes[i] = 'duplicate'
+                else stored.add(cols[0][row])
+            })
+        }
+        // one at a time, in order: each moves the rows after it
+        for (const p of past) {
+            if (await insertPastReading(client, p.deviceId, readings[p.i], p.recordedMs)) stored.add(p.deviceId)
+            else outcomes[p.i] = 'duplicate'
+        }
+
+        if (stored.size > 0) {
+            // a valid reading clears the empty-payload streak (addReadings); skip rows already clear
+            await client.query(`
+                UPDATE devices
+                SET empty_payload_count = 0, is_faulty = FALSE
+                WHERE id = ANY($1::int[]) AND (empty_payload_count <> 0 OR is_faulty)
+            `, [[...stored]])
+        }
+
+        await client.query("COMMIT")
+        return outcomes
+
+    } catch (err: any) {
+        await client.query("ROLLBACK")
+        throw err
+
+    } finally {
+        client.release()
+    }
+}
+
 //=========================================================
 // UPDATE
 //=========================================================
@@ -50,6 +50,16 @@ export type DeviceIdentifier = {
     deviceName?: string
 }
 
+// Power over the measurement windows of one report interval (esp_client window_stats.h)
+export type PowerStats = {
+    n: number               // windows summarised
+    min: number
+    max: number
+    mean: number
+    var: number             // population variance, W^2
+    p95: number
+}
+
 export interface NewReading {
     deviceId? : number
     deviceName? : string
@@ -57,9 +67,30 @@ export interface NewReading {
     current? : number
     power? : number
     cumulativeEnergy? : number
+    lifetimeEnergy?: number
     recordedAt?: string
+    stats?: PowerStats
 }
 
+// A device report as it arrives (MQTT or PUT /devices/updateAllReadings); cumulative
+// energy is derived from the device's previous reading when it is stored
+export interface IncomingReading {
+    deviceName: string
+    voltage: number
+    current: number
+    power: number
+    energyIncrement: number
+    lifetimeEnergy?: number
+    recordedAt?: string
+    stats?: PowerStats
+    bootId?: number         // with seq, identifies the reading (esp_client reading_clock.h); absent on older firmware
+    seq?: number
+}
+
+// What became of one IncomingReading: stored, already stored earlier (same device, bootId
+// and seq: a replay or redelivery), or dropped (unknown or deleted device)
+export type ReadingOutcome = 'stored' | 'duplicate' | 'rejected'
+
 export interface UpdateDevice {
     deviceId?: number
     deviceName?: string
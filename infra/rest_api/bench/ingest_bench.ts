@@ -0,0 +1,109 @@
+// Ingestion benchmark against a local Postgres (PG_* env, schema from pg_db/init.sql):
+// rows/s storing device readings one at a time, the way PUT /devices/updateAllReadings
+// does (latest row + insert + device update per reading; the loopback HTTP request the
+// MQTT client used to make comes on top), vs the batched pipeline (mqtt_conf/ingest.ts).
+//   npx tsx bench/ingest_bench.ts [readings] [devices] [batchRows]
+// Creates devices "ingest_bench_NNNN" and deletes them (and their readings) at the end.
+import pool from '../../pg_db/db_config'
+import { getLatestReadings, addReadings, addReadingsBulk, energySinceLatest } from '../../pg_db/queries/devices'
+import { IncomingReading } from '../../pg_db/queries/types/types'
+import { IngestPipeline } from '../mqtt_conf/ingest'
+
+const N = Number(process.argv[2] ?? 20_000)
+const DEVICES = Number(process.argv[3] ?? 1000)
+const BATCH_ROWS = Number(process.argv[4] ?? 500)
+const PREFIX = "ingest_bench_"
+
+function reading(i: number): IncomingReading {
+	const device = i % DEVICES
+	const current = 0.5 + (device % 20) / 4
+	const power = current * 120
+	return {
+		deviceName: `${PREFIX}${String(device + 1).padStart(4, '0')}`,
+		voltage: 120,
+		current,
+		power,
+		energyIncrement: power * (3 / 3600) / 1000,
+		lifetimeEnergy: Math.floor(i / DEVICES + 1) * power * (3 / 3600) / 1000,
+		recordedAt: new Date(Date.now() - (N - i) * 3).toISOString(),
+		stats: { n: 6, min: power * 0.98, max: power * 1.02, mean: power, var: 1.5, p95: power * 1.01 },
+	}
+}
+
+// Old path: PUT /devices/updateAllReadings, minus HTTP.
+async function perReading(rows: IncomingReading[]) {
+	for (const r of rows) {
+		const latest = await getLatestReadings({ deviceName: r.deviceName })
+		const prev = latest ?? { cumulative_energy: 0, lifetime_energy: null }
+		await addReadings({
+			deviceName: r.deviceName,
+			voltage: r.voltage,
+			current: r.current,
+			power: r.power,
+			cumulativeEnergy: (prev.cumulative_energy ?? 0) + energySinceLatest(prev, r.energyIncrement, r.lifetimeEnergy),
+			lifetimeEnergy: r.lifetimeEnergy,
+			recordedAt: r.recordedAt,
+			stats: r.stats,
+		})
+	}
+}
+
+// New path: one message per reading into the pipeline, as fast as backpressure allows.
+async function pipelined(rows: IncomingReading[]) {
+	let resume: (() => void) | null = null
+	let paused = false
+	const ingest = new IngestPipeline({
+		write: addReadingsBulk,
+		batchRows: BATCH_ROWS,
+		maxAgeMs: 200,
+		queueRows: BATCH_ROWS * 40,
+		onPressure: (p) => { paused = p; if (!p && resume) { resume(); resume = null } },
+	})
+	const done: Promise<boolean>[] = []
+	for (const r of rows) {
+		if (paused) await new Promise<void>(res => { resume = res })
+		done.push(ingest.enqueue([r]))
+	}
+	const stored = await Promise.all(done)
+	if (stored.some(ok => !ok)) throw new Error("pipeline failed to store some readings")
+	return ingest.stats()
+}
+
+async function clearReadings() {
+	await pool.query(`
+		DELETE FROM power_readings
+		WHERE device_id IN (SELECT id FROM devices WHERE name LIKE $1)
+	`, [`${PREFIX}%`])
+}
+
+async function main() {
+	await pool.query(`
+		INSERT INTO devices (name)
+		SELECT $1 || lpad(g::text, 4, '0') FROM generate_series(1, $2::int) g
+		ON CONFLICT (name) DO NOTHING
+	`, [PREFIX, DEVICES])
+	const rows = Array.from({ length: N }, (_, i) => reading(i))
+	console.log(`${N} readings over ${DEVICES} devices`)
+
+	try {
+		await clearReadings()
+		let t0 = performance.now()
+		await perReading(rows)
+		const oldS = (performance.now() - t0) / 1000
+		console.log(`per reading   ${(N / oldS).toFixed(0).padStart(8)} rows/s  (${oldS.toFixed(1)} s)`)
+
+		await clearReadings()
+		t0 = performance.now()
+		const s = await pipelined(rows)
+		const newS = (performance.now() - t0) / 1000
+		console.log(`batched       ${(N / newS).toFixed(0).padStart(8)} rows/s  (${newS.toFixed(1)} s)  x${(oldS / newS).toFixed(1)}`)
+		console.log(`              ${s.batches} batches of ${s.batchRows.mean.toFixed(0)} rows, write p50 ${s.writeMs.p50.toFixed(1)} ms ` +
+			`p99 ${s.writeMs.p99.toFixed(1)} ms, queue wait p50 ${s.waitMs.p50.toFixed(1)} ms p99 ${s.waitMs.p99.toFixed(1)} ms, ` +
+			`max queued ${s.maxQueued}`)
+	} finally {
+		await pool.query(`DELETE FROM devices WHERE name LIKE $1`, [`${PREFIX}%`])
+		await pool.end()
+	}
+}
+
+main().catch(err => { console.error(err); process.exit(1) })
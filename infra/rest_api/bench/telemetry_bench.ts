@@ -0,0 +1,50 @@
+// Ingestion-side benchmark: decode cost and bytes per report, JSON vs binary v1.
+//   npx tsx bench/telemetry_bench.ts [iterations]
+// Device-side encode cost: esp_client env "native_bench_telemetry".
+import { decodeReadings, TELEMETRY_BINARY_V1_SIZE, TELEMETRY_FLAG_RELAY_ON } from '../mqtt_conf/telemetry'
+
+const N = Number(process.argv[2] ?? 1_000_000)
+const TOPIC = "zot_plug_000001/data"
+
+// Mirrors encode_reading_binary() in esp_client/src/telemetry/telemetry.cpp
+function encodeBinaryV1(r: { energyIncrement: number, voltage: number, current: number, power: number }): Buffer {
+	const buf = Buffer.alloc(TELEMETRY_BINARY_V1_SIZE)
+	buf.writeUInt8(1, 0)
+	buf.writeUInt8(TELEMETRY_FLAG_RELAY_ON, 1)
+	buf.writeFloatLE(r.energyIncrement, 2)
+	buf.writeFloatLE(r.voltage, 6)
+	buf.writeFloatLE(r.current, 10)
+	buf.writeFloatLE(r.power, 14)
+	return buf
+}
+
+function bench(name: string, payloads: Buffer[]) {
+	let sink = 0
+	const t0 = process.hrtime.bigint()
+	for (const p of payloads) sink += decodeReadings(TOPIC, p)[0].power
+	const ns = Number(process.hrtime.bigint() - t0) / payloads.length
+	const bytes = payloads.reduce((acc, p) => acc + p.length, 0) / payloads.length
+	console.log(`${name.padEnd(8)} payload ${bytes.toFixed(1).padStart(6)} B  decode ${ns.toFixed(1).padStart(7)} ns  (${sink > 0 ? 'ok' : '-'})`)
+}
+
+const json: Buffer[] = []
+const binary: Buffer[] = []
+for (let i = 0; i < N; i++) {
+	const current = Math.random() * 12
+	const reading = { energyIncrement: current * 120 * (3 / 3600) / 1000, voltage: 120, current, power: current * 120 }
+	// Same key order the firmware's encode_reading_json() produces
+	json.push(Buffer.from(JSON.stringify({
+		energyIncrement: reading.energyIncrement,
+		voltage: reading.voltage,
+		current: reading.current,
+		deviceName: "zot_plug_000001",
+		power: reading.power,
+	})))
+	binary.push(encodeBinaryV1(reading))
+}
+
+console.log(`${N} readings, topic "${TOPIC}"`)
+// warm both paths before timing
+bench("warmup", json.slice(0, 10_000)); bench("warmup", binary.slice(0, 10_000))
+bench("json", json)
+bench("binary", binary)
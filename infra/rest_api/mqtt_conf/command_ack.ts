@@ -0,0 +1,149 @@
+/*
+	Command acks (esp_client/src/commands/commands.h). A command published as
+	"<device>/cmd/<name>@<id>" is answered by the device on "<device>/ack" once it is
+	applied, or right away if it is refused. POST /mqtt/publish with awaitAck registers the
+	id here and waits for that ack; every matched ack goes into fleet-wide histograms:
+
+	- roundTripMs: publish -> ack received by the API (broker, device queue, relay, back)
+	- deviceMs:    receipt -> applied on the device (its applyUs)
+
+	Ids are per API process; an ack nobody waits for any more (timed out, or from before a
+	restart) is counted as unmatched and dropped.
+*/
+
+export type AckResult = 'applied' | 'unknown' | 'rejected' | 'dropped'
+
+export type CommandAck = {
+	id: number
+	cmd: string
+	result: AckResult
+	relay: number                            // 1: on, after the command
+	rxMs: number                             // device millis() at receipt / once applied
+	appliedMs: number
+	applyUs: number
+	rxTs?: number                            // the same in unix ms, once the device has synced SNTP
+	appliedTs?: number
+}
+
+export type AwaitedAck = CommandAck & { roundTripMs: number }
+
+export const DEFAULT_ACK_TIMEOUT_MS = 5000
+export const MAX_ACK_TIMEOUT_MS = 60_000
+
+// Upper bounds; the last bucket counts everything above the largest.
+const LATENCY_BUCKETS_MS = [5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10_000]
+
+class LatencyHistogram {
+	private counts = new Array<number>(LATENCY_BUCKETS_MS.length + 1).fill(0)
+	private n = 0
+	private sum = 0
+	private max = 0
+
+	add(ms: number) {
+		let b = LATENCY_BUCKETS_MS.findIndex(le => ms <= le)
+		if (b < 0) b = LATENCY_BUCKETS_MS.length
+		this.counts[b]++
+		this.n++
+		this.sum += ms
+		this.max = Math.max(this.max, ms)
+	}
+
+	// Upper bound of the bucket holding the p-th percentile (max for the overflow bucket).
+	private percentile(p: number): number {
+		if (this.n === 0) return 0
+		const rank = Math.ceil(p / 100 * this.n)
+		let seen = 0
+		for (let b = 0; b < this.counts.length; b++) {
+			seen += this.counts[b]
+			if (seen >= rank) return b < LATENCY_BUCKETS_MS.length ? Math.min(LATENCY_BUCKETS_MS[b], this.max) : this.max
+		}
+		return this.max
+	}
+
+	toJSON() {
+		return {
+			n: this.n,
+			meanMs: this.n ? this.sum / this.n : 0,
+			p50: this.percentile(50),
+			p99: this.percentile(99),
+			maxMs: this.max,
+			bucketsMs: LATENCY_BUCKETS_MS,
+			counts: this.counts,
+		}
+	}
+}
+
+type Waiter = {
+	sentAt: number
+	resolve: (ack: AwaitedAck | null) => void
+	timer: NodeJS.Timeout
+}
+
+export class CommandAcks {
+	// Random start, so a device still acking the previous process's ids doesn't match new ones.
+	private nextId = 1 + Math.floor(Math.random() * 0x7fffffff)
+	private waiting = new Map<string, Waiter>()
+	private counters = { sent: 0, acked: 0, refused: 0, timedOut: 0, unmatched: 0 }
+	private roundTrip = new LatencyHistogram()
+	private device = new LatencyHistogram()
+
+	// A fresh id to append to the topic, and the ack for it (null once timeoutMs has passed).
+	expect(deviceName: string, timeoutMs: number): { id: number, ack: Promise<AwaitedAck | null> } {
+		const id = this.nextId
+		this.nextId = this.nextId >= 0xffffffff ? 1 : this.nextId + 1
+		const key = `${deviceName}@${id}`
+		const ack = new Promise<AwaitedAck | null>(resolve => {
+			const timer = setTimeout(() => {
+				this.waiting.delete(key)
+				this.counters.timedOut++
+				resolve(null)
+			}, timeoutMs)
+			this.waiting.set(key, { sentAt: performance.now(), resolve, timer })
+		})
+		this.counters.sent++
+		return { id, ack }
+	}
+
+	// The publish failed: nothing to wait for.
+	cancel(deviceName: string, id: number) {
+		const key = `${deviceName}@${id}`
+		const w = this.waiting.get(key)
+		if (!w) return
+		clearTimeout(w.timer)
+		this.waiting.delete(key)
+		this.counters.sent--
+		w.resolve(null)
+	}
+
+	// A "<device>/ack" message.
+	handle(deviceName: string, payload: Buffer) {
+		let ack: CommandAck
+		try {
+			ack = JSON.parse(payload.toString('utf8'))
+		} catch {
+			this.counters.unmatched++
+			return
+		}
+		const key = `${deviceName}@${ack.id}`
+		const w = this.waiting.get(key)
+		if (!w) { this.counters.unmatched++; return }
+		clearTimeout(w.timer)
+		this.waiting.delete(key)
+
+		const roundTripMs = performance.now() - w.sentAt
+		this.counters.acked++
+		if (ack.result !== 'applied') this.counters.refused++
+		this.roundTrip.add(roundTripMs)
+		if (ack.result === 'applied' && typeof ack.applyUs === 'number') this.device.add(ack.applyUs / 1000)
+		w.resolve({ ...ack, roundTripMs })
+	}
+
+	stats() {
+		return {
+			...this.counters,
+			waiting: this.waiting.size,
+			roundTripMs: this.roundTrip.toJSON(),
+			deviceMs: this.device.toJSON(),
+		}
+	}
+}
@@ -0,0 +1,177 @@
+import { IncomingReading, ReadingOutcome } from '../../pg_db/queries/types/types'
+
+/*
+	In-process ingestion of device readings. MQTT messages queue their decoded readings
+	here and a single writer stores them in batches (addReadingsBulk: one transaction and
+	one multi-row INSERT per batch), instead of a loopback HTTP PUT and a transaction
+	per reading.
+
+	- A batch is written once batchRows readings are queued or the oldest has waited maxAgeMs.
+	- One write at a time, in arrival order: cumulative energy chains from batch to batch.
+	- A reading the database already has (same device, boot ID and seq: a replay or a QoS1
+	  redelivery) counts as delivered, so the message is acked as if it were stored.
+	- Bounded: at highWater queued readings onPressure(true) (the MQTT client pauses its
+	  socket, so the broker and TCP hold the rest) until the queue is back to half of it;
+	  readings beyond queueRows are dropped and counted.
+
+	Tuned with INGEST_BATCH_ROWS, INGEST_MAX_AGE_MS and INGEST_QUEUE_ROWS.
+*/
+
+export type IngestOptions = {
+	write: (rows: IncomingReading[]) => Promise<ReadingOutcome[]>
+	batchRows: number
+	maxAgeMs: number
+	queueRows: number
+	highWater?: number                       // default 3/4 of queueRows
+	onPressure?: (paused: boolean) => void
+}
+
+export type IngestStats = {
+	queued: number                           // readings waiting now
+	maxQueued: number
+	paused: boolean
+	batches: number
+	rows: number                             // stored
+	duplicateRows: number                    // already stored, skipped
+	failedRows: number                       // batch write failed, or unknown device
+	droppedRows: number                      // queue full
+	batchRows: { mean: number }
+	waitMs: { p50: number, p99: number }     // oldest reading of a batch: queued -> write starts
+	writeMs: { p50: number, p99: number, max: number }
+}
+
+type Pending = {
+	rows: IncomingReading[]
+	queuedAt: number
+	resolve: (stored: boolean) => void
+}
+
+const LATENCY_SAMPLES = 1024                 // last batches kept for the percentiles
+
+function percentile(samples: number[], p: number): number {
+	if (samples.length === 0) return 0
+	const sorted = [...samples].sort((a, b) => a - b)
+	return sorted[Math.min(sorted.length - 1, Math.floor(p / 100 * sorted.length))]
+}
+
+export class IngestPipeline {
+	private queue: Pending[] = []
+	private queuedRows = 0
+	private timer: NodeJS.Timeout | null = null
+	private writing = false
+	private paused = false
+	private readonly highWater: number
+	private counters = { batches: 0, rows: 0, duplicateRows: 0, failedRows: 0, droppedRows: 0, maxQueued: 0 }
+	private waitMs: number[] = []
+	private writeMs: number[] = []
+	private writeMsMax = 0
+
+	constructor(private readonly opts: IngestOptions) {
+		this.highWater = opts.highWater ?? Math.floor(opts.queueRows * 3 / 4)
+	}
+
+	// Queue one message's readings; resolves true once all of them are stored (or were already).
+	enqueue(rows: IncomingReading[]): Promise<boolean> {
+		if (rows.length === 0) return Promise.resolve(true)
+		if (this.queuedRows + rows.length > this.opts.queueRows) {
+			this.counters.droppedRows += rows.length
+			return Promise.resolve(false)
+		}
+		return new Promise<boolean>(resolve => {
+			this.queue.push({ rows, queuedAt: performance.now(), resolve })
+			this.queuedRows += rows.length
+			this.counters.maxQueued = Math.max(this.counters.maxQueued, this.queuedRows)
+			this.setPressure()
+			if (this.queuedRows >= this.opts.batchRows) this.kick()
+			else if (!this.timer && !this.writing) this.timer = setTimeout(() => this.kick(), this.opts.maxAgeMs)
+		})
+	}
+
+	// Write whatever is queued, e.g. on shutdown.
+	async drain(): Promise<void> {
+		while (this.queue.length > 0 || this.writing) {
+			this.kick()
+			await new Promise(r => setTimeout(r, 5))
+		}
+	}
+
+	stats(): IngestStats {
+		const c = this.counters
+		return {
+			queued: this.queuedRows,
+			maxQueued: c.maxQueued,
+			paused: this.paused,
+			batches: c.batches,
+			rows: c.rows,
+			duplicateRows: c.duplicateRows,
+			failedRows: c.failedRows,
+			droppedRows: c.droppedRows,
+			batchRows: { mean: c.batches ? (c.rows + c.duplicateRows + c.failedRows) / c.batches : 0 },
+			waitMs: { p50: percentile(this.waitMs, 50), p99: percentile(this.waitMs, 99) },
+			writeMs: { p50: percentile(this.writeMs, 50), p99: percentile(this.writeMs, 99), max: this.writeMsMax },
+		}
+	}
+
+	private setPressure() {
+		const paused = this.paused ? this.queuedRows > this.highWater / 2 : this.queuedRows >= this.highWater
+		if (paused === this.paused) return
+		this.paused = paused
+		this.opts.onPressure?.(paused)
+	}
+
+	private kick() {
+		if (this.timer) { clearTimeout(this.timer); this.timer = null }
+		if (!this.writing && this.queue.length > 0) void this.writeBatch()
+	}
+
+	// Whole messages, up to batchRows readings (a message larger than that goes alone).
+	private async writeBatch() {
+		this.writing = true
+		const batch: Pending[] = []
+		let n = 0
+		while (this.queue.length > 0 && (n === 0 || n + this.queue[0].rows.length <= this.opts.batchRows)) {
+			const p = this.queue.shift()!
+			batch.push(p)
+			n += p.rows.length
+		}
+		this.queuedRows -= n
+		this.setPressure()
+
+		const started = performance.now()
+		let outcomes: ReadingOutcome[]
+		try {
+			outcomes = await this.opts.write(batch.flatMap(p => p.rows))
+		} catch (err) {
+			console.error(`[ingest] batch of ${n} readings failed:`, (err as Error).message)
+			outcomes = new Array(n).fill('rejected')
+		}
+		const writeMs = performance.now() - started
+
+		this.record(started - batch[0].queuedAt, writeMs)
+		this.counters.batches++
+		let i = 0
+		for (const p of batch) {
+			let ok = true
+			for (let k = 0; k < p.rows.length; k++, i++) {
+				if (outcomes[i] === 'stored') this.counters.rows++
+				else if (outcomes[i] === 'duplicate') this.counters.duplicateRows++
+				else { this.counters.failedRows++; ok = false }
+			}
+			p.resolve(ok)
+		}
+
+		this.writing = false
+		if (this.queuedRows >= this.opts.batchRows) this.kick()
+		else if (this.queue.length > 0) {
+			const age = performance.now() - this.queue[0].queuedAt
+			this.timer = setTimeout(() => this.kick(), Math.max(0, this.opts.maxAgeMs - age))
+		}
+	}
+
+	private record(waitMs: number, writeMs: number) {
+		this.waitMs.push(waitMs)
+		this.writeMs.push(writeMs)
+		if (this.waitMs.length > LATENCY_SAMPLES) { this.waitMs.shift(); this.writeMs.shift() }
+		this.writeMsMax = Math.max(this.writeMsMax, writeMs)
+	}
+}
@@ -1,11 +1,34 @@
 import mqtt, { IClientOptions, MqttClient } from 'mqtt'
 import { matches } from 'mqtt-pattern'
-import { updateAllReadings } from './util'
+import { decodeReadings, deviceNameFromTopic } from './telemetry'
+import { IngestPipeline } from './ingest'
+import { CommandAcks } from './command_ack'
+import { addReadingsBulk } from '../../pg_db/queries/devices'
 
 let client: MqttClient | null = null
 let reconnectAttempts = 0
 let maxReconnectAttempts = 5
 const ALLOW: string[] = ["+/data", "+/cmd/#"]
+// INGEST_ACK=1: once a message's readings are all stored, publish "<device>/cmd/ingested"
+// with the FNV-1a hash of its payload, so a load test (esp_client/host/fleet) can time
+// device -> database. Off in normal operation.
+const INGEST_ACK = process.env.INGEST_ACK === '1'
+
+// Acks of commands sent with an id ("<device>/cmd/<name>@<id>"), see command_ack.ts.
+export const commandAcks = new CommandAcks()
+
+export const ingest = new IngestPipeline({
+	write: addReadingsBulk,
+	batchRows: Number(process.env.INGEST_BATCH_ROWS ?? 500),
+	maxAgeMs: Number(process.env.INGEST_MAX_AGE_MS ?? 200),
+	queueRows: Number(process.env.INGEST_QUEUE_ROWS ?? 20000),
+	// stop reading the socket while the database catches up
+	onPressure: (paused) => {
+		if (paused) client?.stream.pause()
+		else client?.stream.resume()
+		console.log(`[ingest] ${paused ? 'paused' : 'resumed'} at ${ingest.stats().queued} queued readings`)
+	},
+})
 const c = getMqttClient()
 
 export function topicAllowed(topic: string) {
@@ -29,9 +52,13 @@ export function getMqttClient(): MqttClient {
 
 	client.on("connect", () => {
 		if (client) {
-			client.subscribe("+/data", (err) => {
+			// QoS1 where the publisher offers it: a redelivered reading is deduped on ingest
+			client.subscribe("+/data", { qos: 1 }, (err) => {
 				if (err) console.error('Subscribe failed: ', err)
 			}) // Sub to all topics. I.e: All messages going to broker, will also be avail in the rest api.
+			client.subscribe("+/ack", { qos: 1 }, (err) => {
+				if (err) console.error('Subscribe failed: ', err)
+			})
 			console.log("[mqtt] connected")
 		}
 	})
@@ -44,23 +71,23 @@ export function getMqttClient(): MqttClient {
 		}
 		else ++reconnectAttempts
 	})
-	client.on('message', (topic, payload) => {
-		console.log("Received Message")
-		console.log("Topic:", topic)
-		const text = payload.toString()
-		console.log("Payload:", text)
-
-		let data = null
+	client.on('message', async (topic, payload) => {
+		if (topic.endsWith('/ack')) {
+			commandAcks.handle(deviceNameFromTopic(topic), payload)
+			return
+		}
+		let readings = null
 		try {
-			data = JSON.parse(text)
+			readings = decodeReadings(topic, payload)
 		} catch (err) {
-			console.error("Invalid JSON payload:", text)
+			console.error("Invalid payload:", (err as Error).message)
 			return
 		}
 
 		try {
-			if (data === null) throw new Error("Data from device is null.")
-			updateAllReadings(data)
+			// Queued in arrival order: each reading's cumulative energy builds on the previous one.
+			const stored = await ingest.enqueue(readings)
+			if (INGEST_ACK && stored) await publishAsync(`${deviceNameFromTopic(topic)}/cmd/ingested`, fnv1a32Hex(payload))
 
 		} catch (err) {
 			console.error("Error in update db req. Device to db: ", err)
@@ -69,12 +96,18 @@ export function getMqttClient(): MqttClient {
 	client.on("close", () => console.log("[mqtt] closed"))
 	client.on("error", (err) => console.error("[mqtt] error:", err.message))
 	// graceful shutdown in Docker
-	const shutdown = () => client?.end(true, () => process.exit(0))
+	const shutdown = () => client?.end(true, () => ingest.drain().finally(() => process.exit(0)))
 	process.on("SIGTERM", shutdown)
 	process.on("SIGINT", shutdown)
 	return client
 }
 
+function fnv1a32Hex(buf: Buffer) {
+	let h = 0x811c9dc5
+	for (const b of buf) h = Math.imul(h ^ b, 0x01000193) >>> 0
+	return h.toString(16).padStart(8, '0')
+}
+
 // Promise helper to await PUBACK for QoS1
 export function publishAsync(topic: string, payload: Buffer | string, qos: 0 | 1 = 0, retain = false) {
 	return new Promise<void>((resolve, reject) => {
@@ -0,0 +1,74 @@
+/*
+	Encoder for the binary policy set devices enforce locally ("<cid>/cmd/policy").
+	Layout is documented in esp_client/src/policy/policy.h; keep the two in sync.
+
+	A device_policies row becomes:
+	  - daily_energy_limit -> energy_budget rule (Wh since local midnight)
+	  - allowed_start/end  -> schedule rule (relay only on inside the window)
+	  - is_enforced        -> the enforce flag; without it the device only counts violations
+	Extra rules (max current / power) can be passed alongside the row.
+*/
+
+export const POLICY_WIRE_VERSION = 1
+export const POLICY_HEADER_SIZE = 7
+export const POLICY_RULE_SIZE = 12
+export const POLICY_MAX_RULES = 8
+export const POLICY_FLAG_ENFORCE = 0x01
+export const POLICY_ACTION_TRIP = 0x01
+export const POLICY_TOD_UNKNOWN = 0xffffffff
+
+export enum PolicyRuleType { maxCurrent = 1, maxPower = 2, energyBudget = 3, schedule = 4 }
+
+export type PolicyRule = {
+	type: PolicyRuleType,
+	trip?: boolean             // default true
+	holdWindows?: number       // consecutive measurement windows before it counts
+	limit?: number             // A, W or Wh; unused by schedule
+	startMin?: number          // minutes since local midnight; start == end: all day
+	endMin?: number
+}
+
+export type DevicePolicyRow = {
+	daily_energy_limit: number | null,
+	allowed_start: string | null,      // "HH:MM[:SS]"
+	allowed_end: string | null,
+	is_enforced: boolean | null,
+}
+
+function minutesOf(time: string): number {
+	const [h, m] = time.split(':').map(Number)
+	return ((h * 60 + (m || 0)) % 1440 + 1440) % 1440
+}
+
+// Local seconds since midnight on this server, which the device then follows with its own clock.
+export function localTimeOfDay(now = new Date()): number {
+	return now.getHours() * 3600 + now.getMinutes() * 60 + now.getSeconds()
+}
+
+export function rulesFromPolicy(row: DevicePolicyRow): PolicyRule[] {
+	const rules: PolicyRule[] = []
+	if (row.daily_energy_limit != null)
+		rules.push({ type: PolicyRuleType.energyBudget, limit: row.daily_energy_limit })
+	if (row.allowed_start && row.allowed_end)
+		rules.push({ type: PolicyRuleType.schedule, startMin: minutesOf(row.allowed_start), endMin: minutesOf(row.allowed_end) })
+	return rules
+}
+
+export function encodePolicySet(rules: PolicyRule[], enforce: boolean, todS: number = POLICY_TOD_UNKNOWN): Buffer {
+	if (rules.length > POLICY_MAX_RULES) throw new Error(`At most ${POLICY_MAX_RULES} policy rules`)
+	const buf = Buffer.alloc(POLICY_HEADER_SIZE + rules.length * POLICY_RULE_SIZE)
+	buf.writeUInt8(POLICY_WIRE_VERSION, 0)
+	buf.writeUInt8(enforce ? POLICY_FLAG_ENFORCE : 0, 1)
+	buf.writeUInt8(rules.length, 2)
+	buf.writeUInt32LE(todS >>> 0, 3)
+	rules.forEach((r, i) => {
+		const off = POLICY_HEADER_SIZE + i * POLICY_RULE_SIZE
+		buf.writeUInt8(r.type, off)
+		buf.writeUInt8(r.trip === false ? 0 : POLICY_ACTION_TRIP, off + 1)
+		buf.writeUInt16LE(r.holdWindows ?? 0, off + 2)
+		buf.writeFloatLE(r.limit ?? 0, off + 4)
+		buf.writeUInt16LE(r.startMin ?? 0, off + 8)
+		buf.writeUInt16LE(r.endMin ?? 0, off + 10)
+	})
+	return buf
+}
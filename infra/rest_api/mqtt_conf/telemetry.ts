@@ -0,0 +1,165 @@
+import { AcceptingBody } from './util'
+import { PowerStats } from '../../pg_db/queries/types/types'
+
+/*
+	Decoder for device report payloads on "<cid>/data".
+	Layouts are documented in esp_client/src/telemetry/telemetry.h; keep the two in sync.
+
+	- JSON   : first byte is '{'. Carries deviceName itself.
+	- Binary : first byte is the layout version. Little-endian, no device name,
+	           so the name is taken from the topic ("<cid>/data").
+*/
+
+const JSON_OPEN_BRACE = 0x7b
+
+export const TELEMETRY_BINARY_V1_SIZE = 18
+export const TELEMETRY_BATCH_HEADER_SIZE = 2
+export const TELEMETRY_BATCH_SAMPLE_SIZE = 21
+export const TELEMETRY_STATS_SIZE = 22
+export const TELEMETRY_BINARY_V3_SIZE = TELEMETRY_BINARY_V1_SIZE + TELEMETRY_STATS_SIZE
+export const TELEMETRY_BATCH_V4_SAMPLE_SIZE = TELEMETRY_BATCH_SAMPLE_SIZE + TELEMETRY_STATS_SIZE
+export const TELEMETRY_LIFETIME_SIZE = 8
+export const TELEMETRY_BINARY_V5_SIZE = TELEMETRY_BINARY_V3_SIZE + TELEMETRY_LIFETIME_SIZE
+export const TELEMETRY_BATCH_V6_SAMPLE_SIZE = TELEMETRY_BATCH_V4_SAMPLE_SIZE + TELEMETRY_LIFETIME_SIZE
+export const TELEMETRY_IDENTITY_SIZE = 16
+export const TELEMETRY_BINARY_V7_SIZE = TELEMETRY_BINARY_V5_SIZE + TELEMETRY_IDENTITY_SIZE
+export const TELEMETRY_BATCH_V8_SAMPLE_SIZE = TELEMETRY_BATCH_V6_SAMPLE_SIZE + TELEMETRY_IDENTITY_SIZE
+export const TELEMETRY_FLAG_RELAY_ON = 0x01
+
+// A device clock this far ahead of ours is wrong, not early; such readings keep the arrival time.
+const MAX_DEVICE_CLOCK_AHEAD_MS = 5 * 60_000
+const MIN_DEVICE_TIME_MS = Date.UTC(2024, 0, 1)
+
+export type DecodedReading = AcceptingBody & {
+	relayOn?: boolean
+}
+
+// Device capture time (unix ms, 0 = unknown) as an ISO string, if it's plausible.
+function deviceTime(unixMs: number, receivedAt: number): string | undefined {
+	if (!(unixMs >= MIN_DEVICE_TIME_MS) || unixMs > receivedAt + MAX_DEVICE_CLOCK_AHEAD_MS) return undefined
+	return new Date(unixMs).toISOString()
+}
+
+// Identity block of v7/v8: boot ID, per-boot sequence number, capture time.
+function decodeIdentity(buf: Buffer, off: number) {
+	return {
+		bootId: buf.readUInt32LE(off),
+		seq: buf.readUInt32LE(off + 4),
+		unixMs: Number(buf.readBigUInt64LE(off + 8)),
+	}
+}
+
+// Stats block of v3-v8; undefined when no measurement window closed in the interval.
+function decodeStats(buf: Buffer, off: number): PowerStats | undefined {
+	const n = buf.readUInt16LE(off)
+	if (n === 0) return undefined
+	return {
+		n,
+		min: buf.readFloatLE(off + 2),
+		max: buf.readFloatLE(off + 6),
+		mean: buf.readFloatLE(off + 10),
+		var: buf.readFloatLE(off + 14),
+		p95: buf.readFloatLE(off + 18),
+	}
+}
+
+export function deviceNameFromTopic(topic: string): string {
+	const slash = topic.indexOf('/')
+	return slash < 0 ? topic : topic.slice(0, slash)
+}
+
+// What follows the v1/v2 fields, by version.
+type Extras = { stats: boolean, lifetime: boolean, identity: boolean }
+
+// v1, v3 (v1 + stats block), v5 (v3 + lifetime register) or v7 (v5 + identity block).
+function decodeBinarySingle(buf: Buffer, deviceName: string, receivedAt: number, extras: Extras): DecodedReading {
+	const size = extras.identity ? TELEMETRY_BINARY_V7_SIZE : extras.lifetime ? TELEMETRY_BINARY_V5_SIZE
+		: extras.stats ? TELEMETRY_BINARY_V3_SIZE : TELEMETRY_BINARY_V1_SIZE
+	if (buf.length < size)
+		throw new Error(`Binary v${buf[0]} payload too short: ${buf.length} bytes`)
+
+	const flags = buf.readUInt8(1)
+	const id = extras.identity ? decodeIdentity(buf, TELEMETRY_BINARY_V5_SIZE) : undefined
+	return {
+		energyIncrement: buf.readFloatLE(2),
+		voltage: buf.readFloatLE(6),
+		current: buf.readFloatLE(10),
+		power: buf.readFloatLE(14),
+		deviceName,
+		relayOn: (flags & TELEMETRY_FLAG_RELAY_ON) !== 0,
+		stats: extras.stats ? decodeStats(buf, TELEMETRY_BINARY_V1_SIZE) : undefined,
+		lifetimeEnergy: extras.lifetime ? buf.readDoubleLE(TELEMETRY_BINARY_V3_SIZE) : undefined,
+		recordedAt: id ? deviceTime(id.unixMs, receivedAt) : undefined,
+		bootId: id?.bootId,
+		seq: id?.seq,
+	}
+}
+
+// v2, v4 (stats block after every sample), v6 (v4 + lifetime register per sample) or
+// v8 (v6 + identity block per sample). Samples without a device time carry their age
+// relative to the publish, so stamp those against our receive time.
+function decodeBatch(buf: Buffer, deviceName: string, receivedAt: number, extras: Extras): DecodedReading[] {
+	const count = buf.readUInt8(1)
+	const sampleSize = extras.identity ? TELEMETRY_BATCH_V8_SAMPLE_SIZE : extras.lifetime ? TELEMETRY_BATCH_V6_SAMPLE_SIZE
+		: extras.stats ? TELEMETRY_BATCH_V4_SAMPLE_SIZE : TELEMETRY_BATCH_SAMPLE_SIZE
+	const expected = TELEMETRY_BATCH_HEADER_SIZE + count * sampleSize
+	if (buf.length < expected)
+		throw new Error(`Batch v${buf[0]} payload too short: ${buf.length} bytes for ${count} samples`)
+
+	const readings: DecodedReading[] = []
+	for (let i = 0, off = TELEMETRY_BATCH_HEADER_SIZE; i < count; i++, off += sampleSize) {
+		const ageMs = buf.readUInt32LE(off)
+		const flags = buf.readUInt8(off + 4)
+		const id = extras.identity ? decodeIdentity(buf, off + TELEMETRY_BATCH_V6_SAMPLE_SIZE) : undefined
+		readings.push({
+			energyIncrement: buf.readFloatLE(off + 5),
+			voltage: buf.readFloatLE(off + 9),
+			current: buf.readFloatLE(off + 13),
+			power: buf.readFloatLE(off + 17),
+			deviceName,
+			relayOn: (flags & TELEMETRY_FLAG_RELAY_ON) !== 0,
+			recordedAt: (id && deviceTime(id.unixMs, receivedAt)) || new Date(receivedAt - ageMs).toISOString(),
+			stats: extras.stats ? decodeStats(buf, off + TELEMETRY_BATCH_SAMPLE_SIZE) : undefined,
+			lifetimeEnergy: extras.lifetime ? buf.readDoubleLE(off + TELEMETRY_BATCH_V4_SAMPLE_SIZE) : undefined,
+			bootId: id?.bootId,
+			seq: id?.seq,
+		})
+	}
+	return readings
+}
+
+/**
+ * Decode a device report into one or more readings (oldest first),
+ * whichever encoding the device is configured for.
+ * Throws on malformed or unknown-version payloads.
+ */
+export function decodeReadings(topic: string, payload: Buffer, receivedAt = Date.now()): DecodedReading[] {
+	if (payload.length === 0) throw new Error("Empty payload")
+
+	if (payload[0] === JSON_OPEN_BRACE) {
+		const data = JSON.parse(payload.toString())
+		if (data === null || typeof data !== 'object') throw new Error("Data from device is null.")
+		// Firmware names the register after its unit; the rest of the backend calls it lifetimeEnergy.
+		if (typeof data.lifetimeKwh === 'number' && data.lifetimeEnergy === undefined)
+			data.lifetimeEnergy = data.lifetimeKwh
+		// Identity and capture time go by short names on the wire ("boot", "seq", "ts").
+		if (typeof data.boot === 'number' && typeof data.seq === 'number') data.bootId = data.boot
+		else delete data.seq
+		if (typeof data.ts === 'number' && data.recordedAt === undefined) data.recordedAt = deviceTime(data.ts, receivedAt)
+		return [data]
+	}
+
+	const version = payload[0]
+	const deviceName = deviceNameFromTopic(topic)
+	switch (version) {
+		case 1: return [decodeBinarySingle(payload, deviceName, receivedAt, { stats: false, lifetime: false, identity: false })]
+		case 2: return decodeBatch(payload, deviceName, receivedAt, { stats: false, lifetime: false, identity: false })
+		case 3: return [decodeBinarySingle(payload, deviceName, receivedAt, { stats: true, lifetime: false, identity: false })]
+		case 4: return decodeBatch(payload, deviceName, receivedAt, { stats: true, lifetime: false, identity: false })
+		case 5: return [decodeBinarySingle(payload, deviceName, receivedAt, { stats: true, lifetime: true, identity: false })]
+		case 6: return decodeBatch(payload, deviceName, receivedAt, { stats: true, lifetime: true, identity: false })
+		case 7: return [decodeBinarySingle(payload, deviceName, receivedAt, { stats: true, lifetime: true, identity: true })]
+		case 8: return decodeBatch(payload, deviceName, receivedAt, { stats: true, lifetime: true, identity: true })
+		default: throw new Error(`Unknown telemetry version ${version}`)
+	}
+}
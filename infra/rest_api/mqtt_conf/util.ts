@@ -1,10 +1,13 @@
 import { Router, Request, Response, NextFunction, RequestHandler } from "express"
+import { PowerStats } from '../../pg_db/queries/types/types'
 
 export type PublishBody = {
 	topic: string;
 	payload?: unknown;
 	qos?: 0 | 1;
 	retain?: boolean;
+	awaitAck?: boolean;         // wait for the device's ack ("<device>/cmd/..." topics only)
+	timeoutMs?: number;         // how long, default DEFAULT_ACK_TIMEOUT_MS
 }
 
 export type AcceptingBody = {
@@ -12,32 +15,15 @@ export type AcceptingBody = {
 	voltage: number,
 	current: number,
 	power: number,
-	deviceName: string
+	deviceName: string,
+	recordedAt?: string         // ISO time the device took the reading; defaults to arrival time
+	stats?: PowerStats          // absent on older firmware
+	lifetimeEnergy?: number     // device's monotonic lifetime register (kWh); absent on older firmware
+	bootId?: number             // boot ID + per-boot sequence number; absent on older firmware
+	seq?: number
 }
 
 export const asyncHandler = (fn: (req: Request, res: Response, next: NextFunction) => Promise<void>): RequestHandler =>
 	(req, res, next) => {
 		fn(req, res, next).catch(next);
 	}
-
-export async function updateAllReadings(params: AcceptingBody) {
-	try {
-		const res = await fetch(`http://localhost:4000/api/devices/updateAllReadings`, {
-			method: 'PUT',
-			headers: {
-				'Content-Type': 'application/json'
-			},
-			body: JSON.stringify(params)
-		})
-
-		if (!res.ok) {
-			console.error("HTTP error:", res.status);
-			const errBody = await res.text(); // body may not be JSON if it's an error
-			throw new Error(`Response body: ${errBody}`)
-		}
-	} catch (err) {
-		console.error('Error updating READINGS from device to db: ', err)
-	}
-}
-
-
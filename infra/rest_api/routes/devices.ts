@@ -16,12 +16,16 @@ import {
     getMostUsedDevices,
     addDevice,
     addReadings,
+    addReadingsBulk,
+    energySinceLatest,
     updateDevice,
     upsertDeviceEnergyStats,
     upsertDeviceImage,
     deleteDevice,
 } from '../../pg_db/queries/devices'
 import { TimeRange } from '../../pg_db/queries/types/types'
+import { publishAsync } from '../mqtt_conf/mqtt_client_conf'
+import { encodePolicySet, rulesFromPolicy, localTimeOfDay } from '../mqtt_conf/policy'
 
 const router = Router()
 
@@ -58,7 +62,7 @@ async function getLatest(deviceId?: number, deviceName?: string) {
     const latest = await getLatestReadings({ deviceId, deviceName })
     if (!latest) {
         console.warn(`[INFO] No previous reading found for ${deviceName || deviceId}. Creating initial record.`)
-        return { voltage: 0, current: 0, power: 0, cumulative_energy: 0, recorded_at: new Date().toISOString() }
+        return { voltage: 0, current: 0, power: 0, cumulative_energy: 0, lifetime_energy: null, recorded_at: new Date().toISOString() }
     }
     return latest
 }
@@ -548,6 +552,61 @@ router.get('/getDevicePolicy', async (req: Request, res: Response) => {
 })
 
 
+/**
+ * @swagger
+ * /devices/pushDevicePolicy:
+ *   post:
+ *     summary: Push a device's policy to the device for local enforcement
+ *     description: Encodes the stored policy (daily energy limit, allowed hours, enforcement flag) as a binary policy set and publishes it to `<deviceName>/cmd/policy`. The device evaluates it on every measurement window and opens the relay itself, so enforcement does not depend on the backend or the link. The server's local time of day is included so schedules and the daily budget line up with local midnight.
+ *     tags: [Devices]
+ *     requestBody:
+ *       required: true
+ *       content:
+ *         application/json:
+ *           schema:
+ *             type: object
+ *             properties:
+ *               deviceId:
+ *                 type: integer
+ *               deviceName:
+ *                 type: string
+ *     responses:
+ *       200:
+ *         description: Policy published.
+ *       400:
+ *         description: Missing deviceId or deviceName.
+ *       404:
+ *         description: Device or policy not found.
+ *       500:
+ *         description: Failed to push device policy.
+ */
+router.post('/pushDevicePolicy', async (req: Request, res: Response) => {
+    try {
+        const deviceId = getNumber(req.body?.deviceId)
+        let deviceName = getString(req.body?.deviceName)
+
+        if (!deviceId && !deviceName) return res.status(400).json({ error: 'Missing deviceId or deviceName' })
+        if (!deviceName) {
+            const device = await getDeviceById(deviceId!)
+            if (!device) return res.status(404).json({ error: 'Device not found' })
+            deviceName = device.name as string
+        }
+
+        const policy = await getDevicePolicy({ deviceId, deviceName })
+        if (!policy) return res.status(404).json({ error: 'No policy found' })
+
+        const rules = rulesFromPolicy(policy)
+        const payload = encodePolicySet(rules, !!policy.is_enforced, localTimeOfDay())
+        await publishAsync(`${deviceName}/cmd/policy`, payload, 1)
+
+        res.json({ ok: true, deviceName, rules: rules.length, enforced: !!policy.is_enforced })
+    } catch (err) {
+        console.error('Push device policy error:', err)
+        res.status(500).json({ error: 'Failed to push device policy' })
+    }
+})
+
+
 /**
  * @swagger
  * /devices/getFaultyDevices:
@@ -1117,6 +1176,46 @@ router.put('/updateDeviceImage', async (req: Request, res: Response) => {
  *                   Amount of energy (Wh) to add to the existing cumulative energy.
  *                   Does not overwrite the stored cumulative energy; it increments it.
  *                 example: 0.12
+ *               lifetimeEnergy:
+ *                 type: number
+ *                 description: >
+ *                   The device's monotonic lifetime energy register (kWh). When this and the previous
+ *                   reading both carry it, the difference is added instead of energyIncrement, so
+ *                   lost reports don't lose energy.
+ *                 example: 152.734
+ *               recordedAt:
+ *                 type: string
+ *                 format: date-time
+ *                 description: When the device took the reading (batched reports). Defaults to now.
+ *               bootId:
+ *                 type: integer
+ *                 description: >
+ *                   The device's boot counter. With seq and deviceName the reading is idempotent:
+ *                   one already stored is skipped, and one older than the device's latest reading
+ *                   is placed before it instead of adding its energy again.
+ *               seq:
+ *                 type: integer
+ *                 description: Per-boot sequence number of the reading.
+ *               stats:
+ *                 type: object
+ *                 description: >
+ *                   Power over the device's measurement windows since its previous report.
+ *                   Stored alongside the reading and used by the energy aggregates in place of the snapshot power.
+ *                 properties:
+ *                   n:
+ *                     type: integer
+ *                     description: Number of windows summarised
+ *                   min:
+ *                     type: number
+ *                   max:
+ *                     type: number
+ *                   mean:
+ *                     type: number
+ *                   var:
+ *                     type: number
+ *                     description: Population variance (W^2)
+ *                   p95:
+ *                     type: number
  *     responses:
  *       200:
  *         description: New device reading entry recorded successfully
@@ -1124,8 +1223,20 @@ router.put('/updateDeviceImage', async (req: Request, res: Response) => {
  *           application/json:
  *             schema:
  *               $ref: '#/components/schemas/DeviceReading'
+ *       202:
+ *         description: Identified reading (bootId + seq) handled; outcome is "stored" or "duplicate".
+ *         content:
+ *           application/json:
+ *             schema:
+ *               type: object
+ *               properties:
+ *                 outcome:
+ *                   type: string
+ *                   enum: [stored, duplicate]
  *       400:
  *         description: Missing one or more required fields (deviceId/deviceName, voltage, current, power, energyIncrement).
+ *       404:
+ *         description: Identified reading for an unknown device.
  *       500:
  *         description: Failed to update all readings.
  */
@@ -1134,13 +1245,24 @@ router.put('/updateAllReadings', async (req: Request, res: Response) => {
 
         const deviceId = getNumber(req.body.deviceId)
         const deviceName = getString(req.body.deviceName)
-        const { voltage, current, power, energyIncrement } = req.body
+        const { voltage, current, power, energyIncrement, lifetimeEnergy, recordedAt, stats, bootId, seq } = req.body
 
         if ((!deviceId && !deviceName) || voltage === undefined || current === undefined || power === undefined || energyIncrement === undefined)
             return res.status(400).json({ error: 'Missing one of: deviceId/deviceName, voltage, current, power, or energyIncrement' })
 
+        // identified readings take the ingest path, which dedupes and orders them
+        if (deviceName && typeof bootId === 'number' && typeof seq === 'number') {
+            const [outcome] = await addReadingsBulk([{
+                deviceName, voltage, current, power, energyIncrement,
+                lifetimeEnergy: typeof lifetimeEnergy === 'number' ? lifetimeEnergy : undefined,
+                recordedAt, stats, bootId, seq
+            }])
+            if (outcome === 'rejected') return res.status(404).json({ error: 'Device not found' })
+            return res.status(202).json({ outcome })
+        }
+
         const latest = await getLatest(deviceId, deviceName)
-        const newCumulative = (latest.cumulative_energy ?? 0) + energyIncrement
+        const newCumulative = (latest.cumulative_energy ?? 0) + energySinceLatest(latest, energyIncrement, lifetimeEnergy)
 
         const updated = await addReadings({
             deviceId,
@@ -1149,7 +1271,9 @@ router.put('/updateAllReadings', async (req: Request, res: Response) => {
             current,
             power,
             cumulativeEnergy: newCumulative,
-            recordedAt: new Date().toISOString()
+            lifetimeEnergy: typeof lifetimeEnergy === 'number' ? lifetimeEnergy : undefined,
+            recordedAt: recordedAt ?? new Date().toISOString(),
+            stats: stats && stats.n > 0 ? stats : undefined
         })
 
         res.json(updated)
@@ -1,4 +1,7 @@
-import { publishAsync, topicAllowed } from '../mqtt_conf/mqtt_client_conf'
+import { publishAsync, topicAllowed, ingest, commandAcks } from '../mqtt_conf/mqtt_client_conf'
+import { DEFAULT_ACK_TIMEOUT_MS, MAX_ACK_TIMEOUT_MS } from '../mqtt_conf/command_ack'
+import { deviceNameFromTopic } from '../mqtt_conf/telemetry'
+import { matches } from 'mqtt-pattern'
 import { PublishBody, asyncHandler } from '../mqtt_conf/util'
 import { Router, Request, Response } from "express"
 
@@ -18,6 +21,10 @@ const router = Router()
  *     tags:
  *       - Mqtt
  *     summary: Publish a message to our MQTT server/ broker.
+ *     description: >
+ *       With awaitAck, a device command ("<device>/cmd/<name>") is sent with an id and the
+ *       response waits for the device's ack: the state it applied, its receipt and actuation
+ *       times and the round trip. Round trips are collected in GET /mqtt/commandStats.
  *     requestBody:
  *       required: true
  *       content:
@@ -32,7 +39,7 @@ const router = Router()
  *             schema:
  *               $ref: '#/components/schemas/PublishSuccess'
  *       400:
- *         description: Missing required topic
+ *         description: Missing required topic, or awaitAck on a topic that isn't a device command
  *         content:
  *           application/json:
  *             schema:
@@ -47,6 +54,20 @@ const router = Router()
  *               $ref: '#/components/schemas/ErrorResponse'
  *             example:
  *               error: topic not allowed
+ *       422:
+ *         description: The device refused the command (unknown, rejected payload, or its queue was full)
+ *         content:
+ *           application/json:
+ *             schema:
+ *               $ref: '#/components/schemas/PublishSuccess'
+ *       504:
+ *         description: No ack within timeoutMs (device offline, or firmware without acks)
+ *         content:
+ *           application/json:
+ *             schema:
+ *               $ref: '#/components/schemas/ErrorResponse'
+ *             example:
+ *               error: no ack
  *       500:
  *         description: Internal server error
  *         content:
@@ -59,15 +80,71 @@ router.post("/publish", asyncHandler(async (
     req: Request<{}, any, PublishBody>,
     res: Response
 ): Promise<void> => {
-    const { topic, payload, qos = 0, retain = false } = req.body ?? {};
+    const { topic, payload, qos = 0, retain = false, awaitAck = false, timeoutMs = DEFAULT_ACK_TIMEOUT_MS } = req.body ?? {};
     if (!topic) { res.status(400).json({ error: "topic required" }); return; }
     if (!topicAllowed(topic)) { res.status(403).json({ error: "topic not allowed" }); return; }
 
     const body = typeof payload === "object" ? JSON.stringify(payload) : String(payload ?? "");
-    await publishAsync(topic, body, qos === 1 ? 1 : 0, !!retain);
+    if (!awaitAck) {
+        await publishAsync(topic, body, qos === 1 ? 1 : 0, !!retain);
+        // IMPORTANT: don’t `return res.json(...)` — just send and end the function (Promise<void>)
+        res.json({ ok: true });
+        return;
+    }
+
+    if (!matches("+/cmd/#", topic)) { res.status(400).json({ error: "awaitAck needs a <device>/cmd/<name> topic" }); return; }
+    const device = deviceNameFromTopic(topic);
+    const wait = Math.min(Math.max(Number(timeoutMs) || DEFAULT_ACK_TIMEOUT_MS, 1), MAX_ACK_TIMEOUT_MS);
+    const { id, ack } = commandAcks.expect(device, wait);
+    try {
+        await publishAsync(`${topic}@${id}`, body, qos === 1 ? 1 : 0, !!retain);
+    } catch (err) {
+        commandAcks.cancel(device, id);
+        throw err;
+    }
 
-    // IMPORTANT: don’t `return res.json(...)` — just send and end the function (Promise<void>)
-    res.json({ ok: true });
+    const got = await ack;
+    if (!got) { res.status(504).json({ error: "no ack", id }); return; }
+    res.status(got.result === 'applied' ? 200 : 422).json({ ok: got.result === 'applied', ack: got });
 }))
 
+/**
+ * @swagger
+ * /mqtt/ingestStats:
+ *   get:
+ *     tags:
+ *       - Mqtt
+ *     summary: Counters and batch latencies of the MQTT ingestion pipeline.
+ *     description: >
+ *       Readings from "+/data" are queued and stored in batches. Shows the queue depth,
+ *       whether the MQTT socket is paused for backpressure, rows stored / failed / dropped,
+ *       and the queue wait and write time of recent batches (ms).
+ *     responses:
+ *       200:
+ *         description: Pipeline statistics since the API started
+ */
+router.get("/ingestStats", (_req: Request, res: Response) => {
+    res.json(ingest.stats())
+})
+
+/**
+ * @swagger
+ * /mqtt/commandStats:
+ *   get:
+ *     tags:
+ *       - Mqtt
+ *     summary: Round-trip latency of acked device commands, across the fleet.
+ *     description: >
+ *       Commands published with awaitAck: how many were sent, acked, refused by the device or
+ *       timed out, and latency histograms (ms; bucketsMs are upper bounds, the last count is
+ *       everything above them) of publish -> ack at the API (roundTripMs) and of receipt ->
+ *       applied on the device (deviceMs).
+ *     responses:
+ *       200:
+ *         description: Command ack statistics since the API started
+ */
+router.get("/commandStats", (_req: Request, res: Response) => {
+    res.json(commandAcks.stats())
+})
+
 export default router
@@ -272,6 +272,14 @@
  *         retain:
  *           type: boolean
  *           description: Whether to retain the last message on the broker.
+ *         awaitAck:
+ *           type: boolean
+ *           description: >
+ *             Device commands only ("<device>/cmd/<name>"): send the command with an id and
+ *             respond with the device's ack instead of right after publishing.
+ *         timeoutMs:
+ *           type: integer
+ *           description: How long to wait for the ack (default 5000, at most 60000).
  *       example:
  *         topic: "zotplug_000002/cmd/relay/on"
  *         payload:
@@ -288,6 +296,14 @@
  *         ok:
  *           type: boolean
  *           example: true
+ *         ack:
+ *           type: object
+ *           description: >
+ *             The device's ack (awaitAck only): command id and name, result (applied, unknown,
+ *             rejected, dropped), relay state after it, device millis() and unix ms (rxTs /
+ *             appliedTs, once the device has synced its clock) at receipt and once applied,
+ *             applyUs between them, and roundTripMs as seen by the API.
+ *           additionalProperties: true
  *
  *     ErrorResponse:
  *       type: object